@@ -0,0 +1,137 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef AGGREGATOR_HPP
+#define AGGREGATOR_HPP
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nlohmann/json_fwd.hpp"
+
+#include "encoder.hpp"
+#include "parallelreports.hpp"
+#include "refdate.hpp"
+#include "reportvalues.hpp"
+
+// Count, minimum, maximum, mean and variance updated with each value
+// (Welford's algorithm); partial moments are merged with Chan's formula
+struct Moments
+{
+    void add(double value);
+    void merge(const Moments &other);
+    // Population variance, zero if count is below 2
+    double variance() const;
+
+    uint64_t count = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    double m2 = 0.0; // Sum of squared differences from the mean
+};
+
+// Counts of values in fixed-width bins starting from zero; values beyond
+// the last bin are counted in the last bin
+class Histogram
+{
+public:
+    Histogram(float binWidth, size_t bins);
+
+    void add(float value);
+    void merge(const Histogram &other);
+    uint64_t count() const { return total; }
+    // Nearest-rank percentile (0 to 100) as the lower bound of the bin; if
+    // the rank is within 'greater' values which exceed all bins, or there
+    // are no values, returns empty optional
+    std::optional<float> percentile(float p, uint64_t greater = 0) const;
+
+private:
+    float width;
+    std::vector<uint32_t> bins;
+    uint64_t total = 0;
+};
+
+// Climatology of a station aggregated from METAR reports
+struct StationClimate
+{
+    static const size_t windSectors = 16;
+    // Lower bounds of wind speed bins, knots; slower wind is calm
+    static constexpr std::array<float, 6> windSpeedBins = {1, 7, 11, 17, 22, 28};
+
+    StationClimate();
+    void merge(const StationClimate &other);
+    // Sort and remove repeated hours with precipitation
+    void compactPrecipitationHours();
+
+    uint64_t reports = 0;
+    Moments temperature; // Degrees C
+    Moments qnh;         // Hectopascal
+    uint64_t calm = 0;
+    uint64_t variableWind = 0;
+    // Counts of wind by direction sector (clockwise from north) and speed
+    std::array<std::array<uint32_t, windSpeedBins.size()>, windSectors> windRose{};
+    // Hours (since Unix epoch) of the reports with precipitation
+    std::vector<uint32_t> precipitationHours;
+    size_t compactedHours = 0;
+    Histogram ceiling;    // Feet
+    uint64_t noCeiling = 0;
+    Histogram visibility; // Meters
+};
+
+// Per-station climatology (see StationClimate) aggregated from METAR
+// reports: temperature and QNH moments, wind rose, number of hours with
+// precipitation and ceiling and visibility percentiles.
+//
+// Values are taken from ReportValues; TAF, SPECI, NIL reports and reports
+// with errors are not used.
+// Reports are parsed and aggregated by worker threads into partial states
+// (see ParallelReports) which are merged when all reports are added.
+class Aggregator
+{
+public:
+    using Stations = std::unordered_map<uint32_t, StationClimate>;
+    // Partial state of a worker thread
+    struct Partial
+    {
+        Stations stations;
+        ReportValues values; // Reused between reports
+    };
+
+    // If threads is 0, number of hardware threads is used
+    explicit Aggregator(size_t threads = 0,
+                        size_t batchSize = ParallelReports<Partial>::defaultBatchSize)
+        : reports(aggregate, threads, batchSize)
+    {
+    }
+
+    void add(std::string report, const RefDate &refDate)
+    {
+        reports.add(std::move(report), refDate);
+    }
+    // Aggregate remaining reports, merge the partial states and write one
+    // record per station ordered by station; nothing may be added after
+    // finish() is called
+    void finish(const Encoder &encoder, std::ostream &out);
+
+    // Aggregate the parsed report into the climate of its station
+    static void aggregate(const metaf::ParseResult &parseResult,
+                          const RefDate &refDate,
+                          Partial &partial);
+    // Summary record of the station
+    static nlohmann::json toJson(uint32_t station, StationClimate &climate);
+
+private:
+    ParallelReports<Partial> reports;
+};
+
+#endif //#ifndef AGGREGATOR_HPP
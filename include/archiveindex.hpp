@@ -0,0 +1,112 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef ARCHIVEINDEX_HPP
+#define ARCHIVEINDEX_HPP
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "refdate.hpp"
+#include "settings.hpp"
+
+// Sidecar index of a gzip or zstd compressed archive of reports, which
+// allows to read reports of particular stations and time range without
+// decompressing the whole archive.
+//
+// Index holds blocks, i.e. points where decompression may be restarted
+// (starts of gzip members and zstd frames; in gzip also checkpoints between
+// deflate blocks every span bytes of uncompressed data, which require the
+// preceding 32 KiB of uncompressed data as dictionary), and entries
+// (station, report time) -> (block, offset) sorted by station and time.
+//
+// Index file is mapped to memory rather than read; it consists of header,
+// blocks, entries and dictionary windows. Integers are stored in the byte
+// order of the host which is checked when index is opened.
+class ArchiveIndex
+{
+public:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t format;        // DecompressedInput::Format
+        uint32_t reserved;
+        uint64_t archiveSize;   // Size of compressed archive in bytes
+        uint64_t blockCount;
+        uint64_t entryCount;
+        uint64_t windowCount;
+        uint64_t blocksOffset;  // Offsets from the beginning of index file
+        uint64_t entriesOffset;
+        uint64_t windowsOffset;
+    };
+    struct Block
+    {
+        uint64_t compressedOffset;   // Where decompression restarts
+        uint64_t uncompressedOffset; // Offset of the restart in the output
+        uint32_t window;             // Dictionary index or noWindow
+        uint8_t bits;                // Bits of previous byte to be used
+        uint8_t reserved[3];
+    };
+    struct Entry
+    {
+        uint32_t station; // Packed ICAO location, see StationFilter
+        uint32_t block;   // Last block restarting before the report
+        int64_t time;     // Unix time of the report
+        uint64_t offset;  // Offset of the report text in uncompressed data
+        uint32_t length;  // Length of the report text
+        uint32_t reserved;
+    };
+
+    static const uint32_t version = 1;
+    static const uint32_t noWindow = 0xFFFFFFFF;
+    static const size_t windowSize = 32768;
+    static const size_t defaultSpan = 1024 * 1024;
+
+    // Name of the index file for the archive
+    static std::string fileName(const std::string &archiveName);
+    // Decompress archive and write its index; reports without ICAO location
+    // or report time are not indexed
+    static void build(std::istream &archive,
+                      std::ostream &index,
+                      Settings::RefDateSource refDateSource,
+                      const RefDate &refDate,
+                      size_t span = defaultSpan);
+
+    // Map index file; throws if file is not a valid index
+    explicit ArchiveIndex(const std::string &indexFileName);
+
+    size_t blockCount() const { return header->blockCount; }
+    size_t entryCount() const { return header->entryCount; }
+
+    // Entries of the stations (packed ICAO locations; if empty all stations
+    // are selected) with report time from..to inclusive, ordered by offset
+    std::vector<Entry> select(const std::vector<uint32_t> &stations,
+                              int64_t from,
+                              int64_t to) const;
+    // Decompress only the parts of archive which include entries (ordered
+    // by offset) and call f with report text of each entry; throws if
+    // archive does not match the index
+    void read(std::istream &archive,
+              const std::vector<Entry> &selected,
+              const std::function<void(const std::string &, const Entry &)> &f) const;
+
+private:
+    MappedFile file;
+    const Header *header = nullptr;
+    const Block *blocks = nullptr;
+    const Entry *entries = nullptr;
+    const char *windows = nullptr;
+};
+
+#endif //#ifndef ARCHIVEINDEX_HPP
@@ -0,0 +1,87 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef ARROWWRITER_HPP
+#define ARROWWRITER_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes table in Apache Arrow IPC streaming format: schema message, record
+// batch messages and end-of-stream marker.
+//
+// Rows are accumulated column by column (each column keeps its own validity
+// bitmap and value buffers, so batch body is written without conversion);
+// flatbuffer metadata of the messages is built in-tree, Arrow library is not
+// required. All columns are nullable.
+class ArrowWriter
+{
+public:
+    enum class ColumnType
+    {
+        STRING,     // Utf8
+        INT16,      // Int, 16 bit signed
+        FLOAT32,    // FloatingPoint, single precision
+        TIMESTAMP,  // Timestamp, seconds, UTC
+        STRING_LIST // List of Utf8
+    };
+    struct Column
+    {
+        std::string name;
+        ColumnType type;
+    };
+
+    explicit ArrowWriter(std::vector<Column> columns);
+
+    // Append value to the column of the current row; a value must be
+    // appended to each column before endRow() is called; empty optional is
+    // appended as null
+    void appendInt(size_t column, std::optional<int64_t> value);
+    void appendFloat(size_t column, std::optional<float> value);
+    void appendString(size_t column, std::optional<std::string_view> value);
+    void appendList(size_t column, const std::vector<std::string> &values);
+    // Complete the current row
+    void endRow() { rowCount++; }
+    // Number of rows not written yet
+    size_t rows() const { return rowCount; }
+
+    // Write schema (unless already written) and a record batch with the rows
+    // appended since the previous batch
+    void writeBatch(std::ostream &out);
+    // Write the remaining rows and end-of-stream marker
+    void finish(std::ostream &out);
+
+private:
+    struct ColumnBuilder
+    {
+        ColumnType type;
+        size_t nullCount = 0;
+        std::string validity;
+        std::string values;           // Values or string data
+        std::vector<int32_t> offsets; // String offsets or list offsets
+        std::vector<int32_t> itemOffsets; // List items string offsets
+        std::string itemValues;           // List items string data
+
+        explicit ColumnBuilder(ColumnType t) : type(t) { clear(); }
+        void appendValidity(size_t row, bool valid);
+        void clear();
+    };
+
+    void writeSchema(std::ostream &out);
+
+    std::vector<Column> columns;
+    std::vector<ColumnBuilder> builders;
+    size_t rowCount = 0;
+    bool schemaWritten = false;
+};
+
+#endif //#ifndef ARROWWRITER_HPP
@@ -29,13 +29,26 @@ private:
 
     // Process the value of --output arg
     OutputFormat getOutputFormat(std::string format);
+    // Process the value of --also-output arg
+    OutputSpec getOutputSpec(std::string spec);
     // Process the value of --datetime arg
     DateTimeFormat getDateTimeFormat(std::string format);
     // Process the value of --unit arg
     UnitFormat getUnitFormat(std::string format);
+    // Process the value of --encoding arg
+    Encoding getEncoding(std::string encoding);
+    // Process the value of --compress arg
+    Compression getCompression(std::string compression);
+    // Process the value of --refdate-from arg
+    RefDateSource getRefDateSource(std::string source);
+    // Process the value of --gust-thresholds arg
+    std::vector<unsigned> getGustThresholds(std::string thresholds);
 
     // Set reference date from command line args
     void setRefDate(std::string yyyymmdd);
+    // Process the value of --time-from or --time-to arg; if time of day is 
+    // not specified, start or end of day is used
+    int64_t getTime(std::string yyyymmddhhmm, bool endOfDay);
 };
 
 #endif //#ifndef COMMANDLINEARGS_HPP
\ No newline at end of file
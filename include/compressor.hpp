@@ -0,0 +1,121 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef COMPRESSOR_HPP
+#define COMPRESSOR_HPP
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "threadpool.hpp"
+
+// Compresses a block of output into a self-contained gzip member or zstd
+// frame; concatenated compressed blocks form a valid multi-member gzip or
+// multi-frame zstd file
+class Compressor
+{
+public:
+    Compressor() = default;
+    virtual ~Compressor() {}
+    // Compress block and append the result to out; must be safe to call
+    // from several threads concurrently
+    virtual void compress(std::string_view block, std::string &out) const = 0;
+};
+
+// Each gzip member includes extra field with subfield 'M','J' holding total
+// size of the member (4 bytes, little-endian), similar to BGZF; this allows
+// to locate members without inflating them
+class CompressorGzip : public Compressor
+{
+public:
+    // If level is 0, zlib default compression level is used
+    explicit CompressorGzip(int level = 0);
+    virtual ~CompressorGzip() {}
+    virtual void compress(std::string_view block, std::string &out) const;
+
+    static const int minLevel = 1;
+    static const int maxLevel = 9;
+    // Size of member header including extra field
+    static const size_t headerSize = 20;
+    // Offset of member size within the member header
+    static const size_t memberSizeOffset = 16;
+    // Member size stored in the header if the member was written by
+    // CompressorGzip, or empty optional otherwise
+    static std::optional<uint32_t> memberSize(std::string_view header);
+
+private:
+    int level;
+};
+
+#ifdef METAFJSON_ZSTD
+// Each frame includes uncompressed content size
+class CompressorZstd : public Compressor
+{
+public:
+    // If level is 0, zstd default compression level is used
+    explicit CompressorZstd(int level = 0);
+    virtual ~CompressorZstd() {}
+    virtual void compress(std::string_view block, std::string &out) const;
+
+    static const int minLevel = 1;
+    static const int maxLevel = 19;
+
+private:
+    int level;
+};
+#endif
+
+// Stream buffer which splits output into fixed size blocks, compresses
+// blocks in parallel on the worker threads and writes compressed blocks to
+// the sink in the original order; uncompressed output is never written to
+// the sink
+class CompressedOutput : public std::streambuf
+{
+public:
+    // If threads is 0, number of hardware threads is used
+    CompressedOutput(std::ostream &sink,
+                     std::unique_ptr<const Compressor> compressor,
+                     size_t threads = 0,
+                     size_t blockSize = defaultBlockSize);
+    virtual ~CompressedOutput();
+
+    // Compress remaining output and write all compressed blocks to the sink;
+    // nothing may be written after finish() is called
+    void finish();
+
+    static const size_t defaultBlockSize = 256 * 1024;
+
+protected:
+    virtual int_type overflow(int_type c);
+    // Write blocks compressed so far without waiting for the others
+    virtual int sync();
+
+private:
+    void submitBlock();
+    void writeBlocks(size_t keepPending);
+
+    std::ostream &sink;
+    std::unique_ptr<const Compressor> compressor;
+    size_t blockSize;
+    std::string block;
+    bool blockSubmitted = false;
+    bool finished = false;
+    // Blocks being compressed in the order of submission; number of blocks
+    // is limited to keep memory bounded if sink is slower than workers
+    std::deque<std::future<std::string>> pending;
+    size_t maxPending;
+    ThreadPool pool;
+};
+
+#endif //#ifndef COMPRESSOR_HPP
@@ -0,0 +1,134 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef CONVERSIONCACHE_HPP
+#define CONVERSIONCACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "refdate.hpp"
+
+// Persistent cache of serialised output of the reports, shared by the runs
+// of the program, so that the reports converted by previous runs are not
+// parsed again.
+//
+// Entries are keyed by hash of the report and its reference date and hash
+// of the settings which affect the output; report text and reference date
+// are stored and compared too, so hash collisions do not produce wrong
+// output.
+//
+// The cache directory holds the data file, where the entries are only ever
+// appended, each with a checksum, and the index, an open-addressing hash
+// table mapped to memory. Index is marked as clean only when the cache is
+// closed; if the program was terminated while the cache was open, or if
+// the index does not match the data file, the index is rebuilt from the
+// data file, and the data file is truncated after the last valid entry.
+//
+// When data file grows beyond the size limit, it is compacted keeping the
+// entries used most recently, up to half of the limit.
+class ConversionCache
+{
+public:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+    };
+    struct Record
+    {
+        uint64_t reportHash;
+        uint64_t settingsHash;
+        uint32_t textLength;   // Length of the report text following record
+        uint32_t outputLength; // Length of the output following text
+        uint32_t checksum;     // CRC-32 of the hashes, date, text and output
+        uint32_t refDate;      // Reference date of the report, YYYYMMDD
+    };
+    struct IndexHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t slotCount;    // Power of 2
+        uint64_t entryCount;
+        uint64_t dataSize;     // Size of the data file covered by index
+        uint32_t generation;   // Incremented when cache is opened
+        uint32_t clean;        // Non-zero if cache was closed properly
+    };
+    struct Slot
+    {
+        uint64_t reportHash;
+        uint64_t settingsHash;
+        uint64_t offset;       // Offset of the record in the data file
+        uint32_t length;       // Size of the record including padding; 0 if empty
+        uint32_t generation;   // Generation when the entry was last used
+    };
+    struct Statistics
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t added = 0;
+        uint64_t compactions = 0;
+        uint64_t entries = 0;
+        uint64_t size = 0;     // Size of the data file
+        bool rebuilt = false;  // Index was rebuilt when cache was opened
+    };
+
+    static const uint32_t version = 2;
+    static const uint64_t defaultMaxSize = 1024 * 1024 * 1024;
+
+    // Open or create the cache in the directory; settings is a description
+    // of the settings which affect the output. Throws if cache cannot be
+    // opened or is used by another process.
+    ConversionCache(const std::string &directory,
+                    std::string_view settings,
+                    uint64_t maxSize = defaultMaxSize);
+    ~ConversionCache();
+    ConversionCache(const ConversionCache &) = delete;
+    ConversionCache &operator=(const ConversionCache &) = delete;
+
+    // If output of the report is cached, append it to output and return true
+    bool find(std::string_view report, const RefDate &refDate, std::string &output);
+    // Add output of the report to the cache; throws if cache cannot be written
+    void add(std::string_view report, const RefDate &refDate, std::string_view output);
+
+    Statistics statistics() const;
+
+private:
+    // Reference date as stored in the record
+    static uint32_t packDate(const RefDate &refDate);
+    static uint64_t reportHash(std::string_view report, uint32_t date);
+    Slot *findSlot(uint64_t rHash);
+    bool readRecord(const Slot &slot, std::string &record) const;
+    void mapIndex(uint64_t slotCount);
+    void unmapIndex();
+    void rebuildIndex();
+    void insert(const Slot &slot);
+    void grow();
+    void compact(uint64_t targetSize);
+    void syncIndex(bool clean);
+
+    std::string directory;
+    uint64_t settingsHash;
+    uint64_t maxSize;
+    int lockFd = -1;
+    int dataFd = -1;
+    int indexFd = -1;
+    uint64_t dataSize = 0;
+    IndexHeader *index = nullptr;
+    Slot *slots = nullptr;
+    size_t indexSize = 0;
+    uint32_t generation = 0;
+    std::string buffer;
+    Statistics stats;
+};
+
+#endif //#ifndef CONVERSIONCACHE_HPP
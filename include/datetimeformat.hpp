@@ -11,6 +11,8 @@
 
 #include "nlohmann/json_fwd.hpp"
 
+#include "valuewriter.hpp"
+
 namespace metaf
 {
     class MetafTime;
@@ -55,10 +57,18 @@ public:
 
     DateTimeFormat() = default;
     virtual ~DateTimeFormat() {}
-    virtual nlohmann::json format(const DateTime &dateTime) const = 0;
-    nlohmann::json format(const metaf::MetafTime &time,
-                          const DateTime &reportTime,
-                          bool forecast = false) const;
+    virtual void write(ValueWriter &writer, const DateTime &dateTime) const = 0;
+    void write(ValueWriter &writer,
+               const metaf::MetafTime &time,
+               const DateTime &reportTime,
+               bool forecast = false) const;
+
+    // Format date/time as JSON, arguments are the same as for write()
+    template <typename... Args>
+    auto format(const Args &... args) const
+    {
+        return toJsonValue([&](ValueWriter &writer) { write(writer, args...); });
+    }
 
 protected:
 };
@@ -68,7 +78,7 @@ class DateTimeFormatBasic : public DateTimeFormat
 public:
     DateTimeFormatBasic() = default;
     virtual ~DateTimeFormatBasic() {}
-    virtual nlohmann::json format(const DateTime &dateTime) const;
+    virtual void write(ValueWriter &writer, const DateTime &dateTime) const;
 };
 
 #endif // #ifndef DATETIMEFORMAT_HPP
\ No newline at end of file
@@ -0,0 +1,89 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef DECOMPRESSOR_HPP
+#define DECOMPRESSOR_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "threadpool.hpp"
+
+// Stream buffer which reads gzip or zstd compressed input; input is
+// decompressed on a separate thread ahead of reading.
+//
+// Gzip input which consists of several members (e.g. concatenated gzip
+// files or output of CompressedOutput) is decompressed in parallel by
+// worker threads: member boundaries are located by member size if stored
+// in the header, or by searching for member header bytes, and are verified
+// by inflating the members. Single-member gzip files and zstd files are
+// decompressed sequentially.
+class DecompressedInput : public std::streambuf
+{
+public:
+    enum class Format
+    {
+        NONE, // Not compressed
+        GZIP,
+        ZSTD
+    };
+    // Detect compression by magic bytes at the current position; stream
+    // position is restored afterwards, so stream must be seekable
+    static Format detect(std::istream &in);
+
+    // If threads is 0, number of hardware threads is used; throws if input
+    // format is not supported in this build
+    DecompressedInput(std::istream &source, Format format, size_t threads = 0);
+    virtual ~DecompressedInput();
+    DecompressedInput(const DecompressedInput &) = delete;
+    DecompressedInput &operator=(const DecompressedInput &) = delete;
+
+    // Description of the error which stopped decompression, or empty string
+    // if no error occurred
+    const std::string &error() const { return errorMessage; }
+
+protected:
+    virtual int_type underflow();
+
+private:
+    // Run on the decompression thread
+    void decompress();
+    void decompressGzipMembers();
+    void decompressGzip(std::string prefix);
+    void decompressZstd();
+    // Read up to size bytes from source and append to buffer; return false
+    // if nothing was read
+    bool read(std::string &buffer, size_t size);
+    // Queue decompressed chunk; return false if reading was stopped
+    bool push(std::future<std::string> chunk);
+    bool push(std::string chunk);
+
+    std::istream &source;
+    Format format;
+    ThreadPool pool;
+
+    // Decompressed chunks in the order of input; number of chunks is
+    // limited to keep memory bounded if the reader is slower
+    std::deque<std::future<std::string>> chunks;
+    size_t maxChunks;
+    bool finished = false; // No more chunks will be queued
+    bool stopping = false; // Reader does not need more chunks
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread decompressor;
+
+    std::string current;
+    std::string errorMessage;
+};
+
+#endif //#ifndef DECOMPRESSOR_HPP
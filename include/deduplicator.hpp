@@ -0,0 +1,93 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef DEDUPLICATOR_HPP
+#define DEDUPLICATOR_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "refdate.hpp"
+
+// Removes repeated reports and replaces reports by their corrections,
+// without parsing the reports.
+//
+// Reports are identified by station, report type and report time found in
+// the report text (see ReportKey), and compared by hash of their groups;
+// report which has the same identity and groups as one of the previous
+// reports is removed. Fingerprints of the reports are kept in a hash table
+// of fixed size; when it is full, the fingerprints of the older half of the
+// reports are discarded, so memory used does not depend on the number of
+// reports, and only the repeats which are far apart are not removed.
+//
+// Reports are passed on with a delay of a fixed number of reports; a
+// correction (report with COR) replaces the delayed report with the same
+// identity, and an original report following its delayed correction is
+// removed. Correction which follows the original report after the delay
+// is passed on as is. Reports without station or report time are passed on
+// as is.
+class Deduplicator
+{
+public:
+    using Output = std::function<void(const std::string &report,
+                                      const RefDate &refDate,
+                                      size_t lineNumber)>;
+
+    struct Statistics
+    {
+        uint64_t reports = 0;     // Reports added
+        uint64_t duplicates = 0;  // Repeated reports removed
+        uint64_t corrections = 0; // Reports replaced by corrections
+    };
+
+    explicit Deduplicator(size_t memoryLimit = defaultMemoryLimit,
+                          size_t delay = defaultDelay);
+
+    // Output receives the reports passed on, in the order they were added
+    void add(const std::string &report,
+             const RefDate &refDate,
+             size_t lineNumber,
+             const Output &output);
+    // Pass on all delayed reports
+    void finish(const Output &output);
+    const Statistics &statistics() const { return stats; }
+
+    static const size_t defaultMemoryLimit = 256 * 1024 * 1024;
+    static const size_t defaultDelay = 10000;
+
+private:
+    struct Delayed
+    {
+        uint64_t identity;
+        std::string report;
+        RefDate refDate;
+        size_t lineNumber;
+        bool correction;
+    };
+    bool insert(uint64_t fingerprint);
+    void passOn(const Output &output);
+
+    // Current and previous generation of fingerprints, 0 is empty slot
+    std::vector<uint64_t> current;
+    std::vector<uint64_t> previous;
+    size_t currentCount = 0;
+    unsigned slotBits;
+    std::deque<Delayed> delayed;
+    uint64_t delayedFirst = 0; // Sequence number of the first delayed report
+    // Sequence number of the last delayed report of each identity
+    std::unordered_map<uint64_t, uint64_t> delayedIdentities;
+    size_t delay;
+    Statistics stats;
+};
+
+#endif //#ifndef DEDUPLICATOR_HPP
@@ -0,0 +1,96 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef ENCODER_HPP
+#define ENCODER_HPP
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "nlohmann/json_fwd.hpp"
+
+#include "valuewriter.hpp"
+
+// Writes serialised reports to the output stream in a particular encoding
+class Encoder
+{
+public:
+    Encoder() = default;
+    virtual ~Encoder() {}
+    // Begin a single serialised report; report is written to the returned 
+    // writer as it is serialised and then written to the output by end()
+    virtual ValueWriter &begin() const = 0;
+    virtual void end(std::ostream &out) const = 0;
+    // Write a single report already serialised to JSON
+    virtual void write(const nlohmann::json &j, std::ostream &out) const;
+};
+
+// Text JSON, one report per line
+class EncoderJson : public Encoder
+{
+public:
+    EncoderJson();
+    virtual ~EncoderJson();
+    virtual ValueWriter &begin() const;
+    virtual void end(std::ostream &out) const;
+    virtual void write(const nlohmann::json &j, std::ostream &out) const;
+
+private:
+    // Report is built as JSON and dumped by end(); document and writer are
+    // reused for each report
+    std::unique_ptr<nlohmann::json> document;
+    mutable JsonValueWriter writer;
+};
+
+// Binary encodings are framed: each report is preceded by its length in 
+// bytes as a 32-bit big-endian unsigned integer; reports are encoded 
+// directly by the writer, without building JSON
+class EncoderBinary : public Encoder
+{
+public:
+    EncoderBinary() = default;
+    virtual ~EncoderBinary() {}
+    virtual ValueWriter &begin() const;
+    virtual void end(std::ostream &out) const;
+
+protected:
+    virtual BinaryValueWriter &writer() const = 0;
+};
+
+// CBOR (RFC 7049)
+class EncoderCbor : public EncoderBinary
+{
+public:
+    EncoderCbor() = default;
+    virtual ~EncoderCbor() {}
+
+protected:
+    virtual BinaryValueWriter &writer() const { return cborWriter; }
+
+private:
+    // Writer is reused to avoid allocations for each report
+    mutable CborWriter cborWriter;
+};
+
+// MessagePack
+class EncoderMsgpack : public EncoderBinary
+{
+public:
+    EncoderMsgpack() = default;
+    virtual ~EncoderMsgpack() {}
+
+protected:
+    virtual BinaryValueWriter &writer() const { return msgpackWriter; }
+
+private:
+    // Writer is reused to avoid allocations for each report
+    mutable MsgpackWriter msgpackWriter;
+};
+
+#endif // #ifndef ENCODER_HPP
@@ -0,0 +1,116 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef EVENTDETECTOR_HPP
+#define EVENTDETECTOR_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "refdate.hpp"
+#include "reportvalues.hpp"
+
+namespace metaf
+{
+struct ParseResult;
+} // namespace metaf
+
+// Detects significant changes between consecutive METAR and SPECI reports
+// of the same station: flight category transitions, surface wind gust
+// crossing one of the thresholds and onset or cessation of thunderstorm,
+// freezing rain or snow.
+//
+// Only a small typed state is kept per station; values of each report are
+// taken from ReportValues and compared to the state, so no history is
+// needed. The first report of a station only sets the state. TAF, NIL
+// reports, reports with errors or without report time and reports older
+// than the previous report of the same station are skipped. Values which
+// are not reported do not change the state.
+class EventDetector
+{
+public:
+    enum class FlightCategory : uint8_t
+    {
+        UNKNOWN,
+        LIFR, // Ceiling below 500 ft or visibility below 1 statute mile
+        IFR,  // Ceiling below 1000 ft or visibility below 3 statute miles
+        MVFR, // Ceiling 3000 ft or below or visibility 5 statute miles or below
+        VFR
+    };
+
+    // Weather phenomena tracked for onset and cessation, used as bit flags
+    enum class Weather : uint8_t
+    {
+        TS = 1,   // Thunderstorm
+        FZRA = 2, // Freezing rain
+        SN = 4    // Snow (but not blowing or drifting snow)
+    };
+
+    struct Event
+    {
+        enum class Type
+        {
+            FLIGHT_CATEGORY, // Flight category changed from 'from' to 'to'
+            GUST_ABOVE,      // Gust reached the threshold
+            GUST_BELOW,      // Gust dropped below the threshold or ceased
+            ONSET,           // Weather began
+            CESSATION        // Weather ended
+        };
+        Type type = Type::FLIGHT_CATEGORY;
+        FlightCategory from = FlightCategory::UNKNOWN;
+        FlightCategory to = FlightCategory::UNKNOWN;
+        unsigned threshold = 0;     // Gust threshold, knots
+        std::optional<float> gust;  // Gust speed, knots
+        Weather weather = Weather::TS;
+    };
+
+    // Events of a single report; capacity is reused between reports
+    struct Result
+    {
+        std::string station;
+        std::vector<Event> events;
+    };
+
+    // Gust thresholds are in knots; throws std::invalid_argument if there
+    // are more thresholds than supported
+    explicit EventDetector(std::vector<unsigned> gustThresholds = defaultGustThresholds());
+
+    // Update the state of the report's station and store the events found
+    // in result; returns false if the report was skipped
+    bool detect(const metaf::ParseResult &parseResult,
+                const RefDate &refDate,
+                Result &result);
+    // Number of stations for which the state is kept
+    size_t size() const { return stations.size(); }
+
+    static std::vector<unsigned> defaultGustThresholds() { return {25, 35}; }
+    static constexpr size_t maxGustThresholds = 16;
+
+private:
+    // Typed state of a station, 16 bytes
+    struct State
+    {
+        int64_t time = 0;
+        FlightCategory category = FlightCategory::UNKNOWN;
+        int8_t gustLevel = -1;  // Number of thresholds reached, -1 if unknown
+        uint8_t weather = 0;    // Weather flags
+        bool weatherKnown = false;
+    };
+    static FlightCategory flightCategory(const ReportValues &values);
+    int8_t gustLevel(std::optional<float> gust) const;
+
+    std::vector<unsigned> thresholds;
+    ReportValues values;
+    // Packed ICAO location (see StationFilter) to state
+    std::unordered_map<uint32_t, State> stations;
+};
+
+#endif //#ifndef EVENTDETECTOR_HPP
@@ -0,0 +1,53 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef FILTEREXPRESSION_HPP
+#define FILTEREXPRESSION_HPP
+
+#include <memory>
+#include <string_view>
+
+namespace metaf
+{
+struct ParseResult;
+} // namespace metaf
+
+// Predicate over parsed report, e.g.
+// "wind_speed > 25 kt or visibility < 1600 m or weather contains TS".
+// Expression is compiled once into a tree of nodes and then evaluated on
+// each parsed report before it is serialised.
+//
+// Grammar:
+//   expression := term { ("or" | "||") term }
+//   term       := factor { ("and" | "&&") factor }
+//   factor     := ("not" | "!") factor | "(" expression ")" | condition
+//   condition  := field operator number [unit] | "weather" "contains" code
+//   operator   := "<" | "<=" | ">" | ">=" | "=" | "==" | "!="
+//
+// Fields: wind_speed, gust_speed, wind_direction, visibility, ceiling,
+// cloud_height, temperature, dew_point, pressure (two-word fields may also
+// be separated by space, e.g. "wind speed"). Condition is true if any group
+// in the report satisfies it; if value is not reported the condition is false.
+class FilterExpression
+{
+public:
+    // Compile expression, throws std::invalid_argument if expression has
+    // syntax errors
+    explicit FilterExpression(std::string_view expression);
+    ~FilterExpression();
+
+    // Evaluate the expression on the parsed report
+    bool matches(const metaf::ParseResult &result) const;
+
+    class Node;
+
+private:
+    std::unique_ptr<const Node> root;
+};
+
+#endif //#ifndef FILTEREXPRESSION_HPP
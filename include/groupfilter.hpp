@@ -0,0 +1,46 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef GROUPFILTER_HPP
+#define GROUPFILTER_HPP
+
+#include <bitset>
+#include <optional>
+#include <string_view>
+
+// Selects which kinds of groups are included in the output. Group kind is the
+// index of the group type in metaf::Group variant, so that the check before 
+// visiting a group is a single bit test.
+class GroupFilter
+{
+public:
+    // Include all groups
+    GroupFilter() { groupKinds.set(); }
+    // Include only groups listed in comma-separated list of group names 
+    // (same as "group" value in JSON output)
+    explicit GroupFilter(std::string_view list);
+
+    // Group kind (i.e. index in metaf::Group variant) is included in output
+    bool includes(size_t groupKind) const
+    {
+        return groupKind < maxGroupKinds && groupKinds.test(groupKind);
+    }
+    // All group kinds are included in output
+    bool includesAll() const { return groupKinds.all(); }
+
+    // Get group kind by name used in JSON output
+    static std::optional<size_t> groupKind(std::string_view name);
+    // Get group name used in JSON output by group kind
+    static std::string_view groupName(size_t groupKind);
+
+private:
+    static const size_t maxGroupKinds = 32;
+    std::bitset<maxGroupKinds> groupKinds;
+};
+
+#endif //#ifndef GROUPFILTER_HPP
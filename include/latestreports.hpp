@@ -0,0 +1,54 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef LATESTREPORTS_HPP
+#define LATESTREPORTS_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "refdate.hpp"
+
+// Keeps only the newest raw report of each station and report type, so that
+// only these reports need to be converted.
+//
+// Station and report time are found in the report text (see ReportKey);
+// TAF and the other reports (METAR and SPECI) are kept separately. Report
+// replaces the kept one if its report time is the same or later. Reports
+// without station or report time are not kept.
+class LatestReports
+{
+public:
+    using Output = std::function<void(const std::string &report,
+                                      const RefDate &refDate)>;
+
+    // Returns false if report is older than the kept one or cannot be kept
+    bool add(const std::string &report, const RefDate &refDate);
+    // Output receives the reports which were kept after the previous call,
+    // ordered by station, with METAR before TAF
+    void flush(const Output &output);
+    // Number of stations and report types kept
+    size_t size() const { return slots.size(); }
+
+private:
+    struct Slot
+    {
+        int64_t time = 0;
+        std::string report;
+        RefDate refDate;
+        bool updated = false;
+    };
+    // Station packed with report type
+    std::unordered_map<uint64_t, Slot> slots;
+    std::vector<uint64_t> updated;
+};
+
+#endif //#ifndef LATESTREPORTS_HPP
@@ -0,0 +1,32 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+
+// Read-only memory mapping of the whole file
+class MappedFile
+{
+public:
+    // Throws if file cannot be opened or mapped
+    explicit MappedFile(const std::string &fileName);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return static_cast<const char *>(address); }
+    size_t size() const { return length; }
+
+private:
+    void *address = nullptr;
+    size_t length = 0;
+};
+
+#endif //#ifndef MAPPEDFILE_HPP
@@ -10,49 +10,93 @@
 #define METAFVISITOR_HPP
 
 #include <stdexcept>
+#include <string_view>
 #include "metaf.hpp"
 #include "datetimeformat.hpp"
+#include "valueformat.hpp"
+#include "refdate.hpp"
 
-class MetafVisitor : public metaf::Visitor<nlohmann::json>
+// Visits groups of the report and writes them to the writer as they are
+// visited
+class MetafVisitor : public metaf::Visitor<void>
 {
 public:
     MetafVisitor() = delete;
     MetafVisitor(const metaf::ParseResult &result,
+                 ValueWriter &writer,
                  const DateTimeFormat *dtFormat,
                  const ValueFormat *valFormat,
                  bool rawStrings,
-                 int refYear,
-                 unsigned refMonth,
-                 unsigned refDay)
-        : dateTimeFormat(dtFormat),
+                 const RefDate &refDate,
+                 bool omitNotReported = false)
+        : writer(writer),
+          dateTimeFormat(dtFormat),
           valueFormat(valFormat),
           includeRawStrings(rawStrings),
-          referenceYear(refYear),
-          referenceMonth(refMonth),
-          referenceDay(refDay)
+          omitNotReported(omitNotReported),
+          referenceDate(refDate)
     {
         if (!dtFormat)
             throw(std::runtime_error("dateTimeFormat is null when creating MetafVisitor"));
         if (!valFormat)
             throw(std::runtime_error("valueFormat is null when creating MetafVisitor"));
         
-        reportDateTime.year = refYear;
-        reportDateTime.month = refMonth;
-        reportDateTime.day = refDay;
+        reportDateTime.year = refDate.year;
+        reportDateTime.month = refDate.month;
+        reportDateTime.day = refDate.day;
         if (const auto rt = result.reportMetadata.reportTime; rt.has_value()) {
-            reportDateTime = DateTimeFormat::DateTime(*rt, refYear, refMonth, refDay);
+            reportDateTime = DateTimeFormat::DateTime(
+                *rt, refDate.year, refDate.month, refDate.day);
         }
     }
 
 protected:
+    // Format value and write it under key; if not-reported values are 
+    // omitted and value is not reported, it is not formatted at all
+    template <typename T, typename... Args>
+    void setValue(const char *key,
+                  const T &value,
+                  Args... args)
+    {
+        if (omitNotReported && !isReported(value)) return;
+        field(key);
+        valueFormat->write(writer, value, args...);
+    }
+    template <typename T>
+    static bool isReported(const T &value) { return value.isReported(); }
+    static bool isReported(const metaf::SurfaceFriction &value)
+    {
+        return value.type() != metaf::SurfaceFriction::Type::NOT_REPORTED;
+    }
+    // Same as setValue() for the sector between two directions
+    void setSector(const char *key,
+                   const metaf::Direction &begin,
+                   const metaf::Direction &end)
+    {
+        if (omitNotReported && !begin.isReported() && !end.isReported())
+            return;
+        field(key);
+        valueFormat->write(writer, begin, end);
+    }
+    // Format time relative to report time and write it under key
+    void setTime(const char *key,
+                 const metaf::MetafTime &time)
+    {
+        field(key);
+        dateTimeFormat->write(writer, time, reportDateTime);
+    }
+
+    // Write key of the group's field before its value; visitors which do not
+    // write groups as objects override this
+    virtual void field(std::string_view name) { writer.key(name); }
 
+    ValueWriter &writer;
     const DateTimeFormat *dateTimeFormat;
     const ValueFormat *valueFormat;
     bool includeRawStrings = false;
+    bool omitNotReported = false;
 
-    int referenceYear = 0;
-    int referenceMonth = 0;
-    int referenceDay = 0;
+    RefDate referenceDate;
 
     DateTimeFormat::DateTime reportDateTime;     
 };
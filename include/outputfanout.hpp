@@ -0,0 +1,103 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef OUTPUTFANOUT_HPP
+#define OUTPUTFANOUT_HPP
+
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metaf.hpp"
+
+#include "compressor.hpp"
+#include "outputformat.hpp"
+#include "outputformatevents.hpp"
+#include "refdate.hpp"
+#include "threadpool.hpp"
+
+// Serialises each parsed report with several output formats, each writing
+// to its own stream, so that the report is only parsed once.
+//
+// Parsed reports are collected in batches; each output serialises the batch
+// on a worker thread while the next batch is collected. The outputs are thus
+// produced in parallel, and each output receives the reports in the order
+// they were added.
+class OutputFanOut
+{
+public:
+    // If threads is 0, number of hardware threads is used
+    explicit OutputFanOut(size_t threads = 0, size_t batchSize = defaultBatchSize);
+    // Waits until the batch being serialised is complete
+    ~OutputFanOut();
+    OutputFanOut(const OutputFanOut &) = delete;
+    OutputFanOut &operator=(const OutputFanOut &) = delete;
+
+    // Outputs must be added before the first report; output format is started
+    // when added
+    void addOutput(std::unique_ptr<const OutputFormat> format, std::ostream &out);
+    // Output of the events found by the detector
+    void addOutput(std::unique_ptr<OutputFormatEvents::Detector> events, std::ostream &out);
+    void add(std::string report, const RefDate &refDate, metaf::ParseResult parseResult);
+    // Serialise remaining reports and finish each output format; nothing may
+    // be added after finish() is called
+    void finish();
+
+    static const size_t defaultBatchSize = 256;
+
+private:
+    struct Output
+    {
+        std::unique_ptr<const OutputFormat> format; // Null if events is set
+        std::unique_ptr<OutputFormatEvents::Detector> events;
+        std::ostream *out;
+        std::future<void> done;
+    };
+    struct Parsed
+    {
+        std::string report;
+        RefDate refDate;
+        metaf::ParseResult parseResult;
+    };
+    void wait();
+    void submitBatch();
+
+    std::vector<Output> outputs;
+    size_t batchSize;
+    // Batch being collected and batch being serialised by workers
+    std::vector<Parsed> batch;
+    std::vector<Parsed> submitted;
+    ThreadPool pool;
+};
+
+// Output file, compressed if compressor is specified
+class OutputFile : public std::ostream
+{
+public:
+    // If threads is 0, number of hardware threads is used for compression
+    OutputFile(const std::string &fileName,
+               std::unique_ptr<const Compressor> compressor = nullptr,
+               size_t threads = 0);
+    OutputFile(const OutputFile &) = delete;
+    OutputFile &operator=(const OutputFile &) = delete;
+
+    const std::string &name() const { return fileName; }
+    // Write all remaining output to the file; returns false if file cannot
+    // be written
+    bool finish();
+
+private:
+    std::string fileName;
+    std::ofstream file;
+    std::unique_ptr<CompressedOutput> compressed;
+};
+
+#endif //#ifndef OUTPUTFANOUT_HPP
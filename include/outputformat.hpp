@@ -16,6 +16,10 @@
 
 #include "datetimeformat.hpp"
 #include "valueformat.hpp"
+#include "refdate.hpp"
+#include "groupfilter.hpp"
+#include "filterexpression.hpp"
+#include "encoder.hpp"
 
 class Settings;
 
@@ -43,42 +47,78 @@ public:
                  bool rawStrings,
                  int refYear,
                  unsigned refMonth,
-                 unsigned refDay)
+                 unsigned refDay,
+                 GroupFilter groups = GroupFilter(),
+                 std::unique_ptr<const FilterExpression> filter = nullptr,
+                 std::unique_ptr<const Encoder> enc = nullptr)
         : dateTimeFormat(std::move(dtFormat)),
           valueFormat(std::move(valFormat)),
           includeRawStrings(rawStrings),
-          referenceYear(refYear),
-          referenceMonth(refMonth),
-          referenceDay(refDay)
+          referenceDate(refYear, refMonth, refDay),
+          groupFilter(std::move(groups)),
+          reportFilter(std::move(filter)),
+          encoder(std::move(enc))
     {
+        if (!encoder)
+            encoder = std::make_unique<EncoderJson>();
     }
     virtual ~OutputFormat() {}
     // Result of METAR or TAF report parsing and serialising to JSON
     enum class Result
     {
         OK,       // Result parsed and serialised OK
+        FILTERED, // Result parsed but not serialised because it did not match filter
         EXCEPTION // Exception occurred during parsing or serialising
     };
-    //
+    // Parse a METAR or TAF report and serialise to JSON using default 
+    // reference date
     Result toJson(const std::string &report, std::ostream &out = std::cout) const;
+    // Parse a METAR or TAF report and serialise to JSON using the reference
+    // date specific for this report
+    Result toJson(const std::string &report,
+                  const RefDate &refDate,
+                  std::ostream &out = std::cout) const;
+    // Serialise already parsed METAR or TAF report to JSON
+    Result toJson(const metaf::ParseResult &parseResult,
+                  const RefDate &refDate,
+                  std::ostream &out) const;
+    // Write the output which precedes all reports (e.g. schema) before the
+    // first report is serialised
+    virtual void start(std::ostream &out = std::cout) const { (void)out; }
+    // Write the output held back by the format (e.g. last batch of the 
+    // columnar output) after all reports were serialised
+    virtual void finish(std::ostream &out = std::cout) const { (void)out; }
 
 protected:
-    // Parse a METAR or TAF report and serialise to JSON
-    virtual nlohmann::json toJson(
-        const metaf::ParseResult &parseResult) const = 0;
+    // Serialise parsed METAR or TAF report and write it to the output; by 
+    // default report is written to the encoder by writeReport()
+    virtual void serialise(const metaf::ParseResult &parseResult,
+                           const RefDate &refDate,
+                           std::ostream &out) const;
+    // Write parsed METAR or TAF report to the writer as it is serialised; 
+    // formats which do not use the encoder override serialise() instead
+    virtual void writeReport(const metaf::ParseResult &parseResult,
+                             const RefDate &refDate,
+                             ValueWriter &writer) const;
 
     std::unique_ptr<const DateTimeFormat> dateTimeFormat;
     std::unique_ptr<const ValueFormat> valueFormat;
 
+    // Report is serialised unless excluded by the report filter
+    bool matchesFilter(const metaf::ParseResult &parseResult) const
+    {
+        return !reportFilter || reportFilter->matches(parseResult);
+    }
     bool getIncludeRawStrings() const { return includeRawStrings; }
-    int getReferenceYear() const { return referenceYear; }
-    int getReferenceMonth() const { return referenceMonth; }
-    int getReferenceDay() const { return referenceDay; }
+    const RefDate &getReferenceDate() const { return referenceDate; }
+    const GroupFilter &getGroupFilter() const { return groupFilter; }
+    const Encoder &getEncoder() const { return *encoder; }
 private:
     bool includeRawStrings = false;
-    int referenceYear = 0;
-    int referenceMonth = 0;
-    int referenceDay = 0;
+    RefDate referenceDate;
+    GroupFilter groupFilter;
+    std::unique_ptr<const FilterExpression> reportFilter;
+    std::unique_ptr<const Encoder> encoder;
 };
 
 #endif //#ifndef OUTPUTFORMAT_HPP
\ No newline at end of file
@@ -0,0 +1,47 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef OUTPUTFORMATARROW_HPP
+#define OUTPUTFORMATARROW_HPP
+
+#include "outputformat.hpp"
+#include "arrowwriter.hpp"
+#include "reportvalues.hpp"
+
+// Apache Arrow IPC stream with one row per report and flattened columns 
+// (see ReportValues); rows are written in record batches
+class OutputFormatArrow : public OutputFormat
+{
+public:
+    static const size_t defaultBatchSize = 65536;
+
+    OutputFormatArrow(std::unique_ptr<DateTimeFormat> dtFormat,
+                      std::unique_ptr<ValueFormat> valFormat,
+                      int refYear,
+                      unsigned refMonth,
+                      unsigned refDay,
+                      std::unique_ptr<const FilterExpression> filter = nullptr,
+                      size_t rowsPerBatch = defaultBatchSize);
+    virtual ~OutputFormatArrow() {}
+
+    virtual void finish(std::ostream &out = std::cout) const;
+
+protected:
+    virtual void serialise(const metaf::ParseResult &parseResult,
+                           const RefDate &refDate,
+                           std::ostream &out) const;
+
+private:
+    size_t batchSize;
+    // Rows are accumulated until the batch is complete
+    mutable ArrowWriter writer;
+    // Values are reused to avoid allocations for each report
+    mutable ReportValues values;
+};
+
+#endif // #ifndef OUTPUTFORMATARROW_HPP
@@ -9,32 +9,152 @@
 #ifndef OUTPUTFORMATBASIC_HPP
 #define OUTPUTFORMATBASIC_HPP
 
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
 #include "outputformat.hpp"
+#include "valuewriter.hpp"
+
+namespace metaf
+{
+enum class ReportType;
+enum class ReportPart;
+struct GroupInfo;
+} // namespace metaf
 
 class OutputFormatBasic : public OutputFormat
 {
 public:
+    // If tuples is true, each group is serialised as an array of values in
+    // the order of fields specified by schema (see tupleSchema()) rather 
+    // than as an object; if compact is true, values which are not reported
+    // are omitted from the groups rather than serialised as null
     OutputFormatBasic(std::unique_ptr<DateTimeFormat> dtFormat,
                  std::unique_ptr<ValueFormat> valFormat,
                  bool rawStrings,
                  int refYear,
                  unsigned refMonth,
-                 unsigned refDay)
-        : OutputFormat(std::move(dtFormat),
-        std::move (valFormat),
-        rawStrings,
-        refYear,
-        refMonth,
-        refDay)
-    {
-    }
-    virtual ~OutputFormatBasic() {}
+                 unsigned refDay,
+                 GroupFilter groups = GroupFilter(),
+                 std::unique_ptr<const FilterExpression> filter = nullptr,
+                 std::unique_ptr<const Encoder> enc = nullptr,
+                 bool tuples = false,
+                 bool compact = false);
+    virtual ~OutputFormatBasic();
+
+    // Order of fields of each group kind when groups are serialised as 
+    // arrays: {"schema":{"wind":["type","direction",...],...}}
+    static nlohmann::json tupleSchema();
+
+    // Schema is written before the first report if groups are serialised
+    // as arrays
+    virtual void start(std::ostream &out = std::cout) const;
+
+    class Delta;
 
 protected:
-    virtual nlohmann::json toJson(const metaf::ParseResult &parseResult) const;
+    virtual void writeReport(const metaf::ParseResult &parseResult,
+                             const RefDate &refDate,
+                             ValueWriter &writer) const;
 
 private:
     class MetafVisitorBasic;
+
+    // Report type, error and raw string
+    void writeReportInfo(const metaf::ParseResult &parseResult,
+                         ValueWriter &writer) const;
+
+    bool tupleGroups = false;
+    bool compact = false;
+};
+
+// Serialises the first report of each station and report type in full, and
+// each next report as changes from the previous one:
+// {"report":{"type":"metar"},"delta":{"location":"EGYP","removed":[2],
+// "added":[{"index":2,"group":{...}}],"changed":[{"index":5,
+// "fields":{"height":{"ft":1000}}}]}}
+// Report fields which changed are included and removed ones are null.
+// Removed are indices of the groups of the previous report which are not in
+// this report; added are the groups of this report which are not in the
+// previous report; changed are the groups of this report with the fields
+// which differ from the previous report, removed fields are null. Indices of
+// added and changed groups are in this report.
+//
+// Groups of the same kind and report part are paired in the order of
+// reports; a few groups are looked ahead to find the pair when groups were
+// added or removed. Field values of the paired groups are compared as
+// written by the visitor, without serialising the reports.
+//
+// Groups are compared field by field, so the format must not serialise
+// groups as arrays (tuples).
+//
+// Unlike output formats, serialisation changes the state (the previous
+// report of each station).
+class OutputFormatBasic::Delta
+{
+public:
+    explicit Delta(std::unique_ptr<const OutputFormatBasic> format);
+    ~Delta();
+
+    // Parse METAR or TAF report and serialise as delta
+    Result toJson(const std::string &report,
+                  const RefDate &refDate,
+                  std::ostream &out = std::cout);
+    // Serialise already parsed METAR or TAF report as delta
+    Result toJson(const metaf::ParseResult &parseResult,
+                  const RefDate &refDate,
+                  std::ostream &out);
+
+private:
+    struct Group
+    {
+        size_t kind; // Index of the group type in metaf::Group
+        metaf::ReportPart reportPart;
+        const metaf::GroupInfo *info; // Only valid for the current report
+        ValueRecorder::Range value;
+    };
+    struct Report
+    {
+        ValueRecorder values;
+        ValueRecorder::Range info; // Report type, error and raw string
+        std::vector<Group> groups;
+    };
+    // Field which changed; if value range is empty, field was removed
+    struct Change
+    {
+        std::string_view key;
+        ValueRecorder::Range value;
+    };
+
+    void serialise(const metaf::ParseResult &parseResult,
+                   const RefDate &refDate,
+                   std::ostream &out);
+    // Record the values of the report to the current report
+    void record(const metaf::ParseResult &parseResult, const RefDate &refDate);
+    // Pair groups of the previous and current report
+    void pairGroups(const Report &previous);
+    // Find fields of the object recorded in current report which differ from
+    // the object recorded in previous report; return false if none differ
+    bool compare(const Report &previous,
+                 ValueRecorder::Range previousObject,
+                 ValueRecorder::Range currentObject);
+    // Write fields found by compare() to the object being written
+    void writeChanges(ValueWriter &writer) const;
+
+    std::unique_ptr<const OutputFormatBasic> format;
+    // Previous report of each station (ICAO location) and report type
+    std::map<std::pair<std::string, metaf::ReportType>, Report> previousReports;
+    Report current;
+    // Reused when comparing the reports
+    std::vector<ValueRecorder::Member> previousMembers;
+    std::vector<ValueRecorder::Member> currentMembers;
+    std::vector<Change> changes;
+    std::vector<size_t> removedGroups; // Indices in previous report
+    std::vector<size_t> addedGroups;   // Indices in current report
+    std::vector<std::pair<size_t, size_t>> pairedGroups;
 };
 
-#endif // #ifndef OUTPUTFORMATBASIC_HPP
\ No newline at end of file
+#endif // #ifndef OUTPUTFORMATBASIC_HPP
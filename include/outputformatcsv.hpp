@@ -0,0 +1,74 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef OUTPUTFORMATCSV_HPP
+#define OUTPUTFORMATCSV_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "outputformat.hpp"
+#include "reportvalues.hpp"
+
+// Delimiter-separated values (CSV or TSV) with one row per report and 
+// user-selected columns (see ReportValues); the first row contains column 
+// names
+class OutputFormatCsv : public OutputFormat
+{
+public:
+    // Columns is a comma-separated list of column names; if empty all 
+    // columns are included; throws std::invalid_argument if column name is
+    // not recognised
+    OutputFormatCsv(std::unique_ptr<DateTimeFormat> dtFormat,
+                    std::unique_ptr<ValueFormat> valFormat,
+                    int refYear,
+                    unsigned refMonth,
+                    unsigned refDay,
+                    std::unique_ptr<const FilterExpression> filter = nullptr,
+                    std::string_view columns = std::string_view(),
+                    char separator = ',');
+    virtual ~OutputFormatCsv() {}
+
+    // Header row with column names is written before the first report
+    virtual void start(std::ostream &out = std::cout) const;
+
+    // Check comma-separated list of column names, throws 
+    // std::invalid_argument if column name is not recognised
+    static void checkColumns(std::string_view columns);
+    // Comma-separated list of all supported column names
+    static std::string allColumns();
+
+protected:
+    virtual void serialise(const metaf::ParseResult &parseResult,
+                           const RefDate &refDate,
+                           std::ostream &out) const;
+
+private:
+    using Extractor = void (*)(const ReportValues &values, std::string &result);
+    struct Column
+    {
+        std::string_view name;
+        Extractor extract;
+    };
+    // Columns are resolved once so that formatting a row is a single loop
+    // over the extractors
+    static std::vector<Column> resolveColumns(std::string_view columns);
+
+    void appendField(std::string_view field) const;
+
+    std::vector<Column> columnList;
+    char delimiter;
+    std::string quotedChars;
+    // Values, row and field are reused to avoid allocations for each report
+    mutable ReportValues values;
+    mutable std::string row;
+    mutable std::string field;
+};
+
+#endif // #ifndef OUTPUTFORMATCSV_HPP
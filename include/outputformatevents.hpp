@@ -0,0 +1,90 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef OUTPUTFORMATEVENTS_HPP
+#define OUTPUTFORMATEVENTS_HPP
+
+#include <vector>
+
+#include "outputformat.hpp"
+#include "eventdetector.hpp"
+
+// Significant changes between consecutive METAR and SPECI reports of the
+// same station (see EventDetector) with one record per change, e.g.
+// {"station":"EGYP","report_time":{...},"event":"flight_category","from":"VFR","to":"IFR"}
+// {"station":"EGYP","report_time":{...},"event":"gust_above","threshold":25,"gust":30}
+// {"station":"EGYP","report_time":{...},"event":"onset","weather":"TS"}
+// Reports without changes produce no output.
+//
+// Events depend on the previous reports of the station, so reports are
+// serialised by Detector which keeps the state of the stations; the format
+// itself only writes the records.
+class OutputFormatEvents : public OutputFormat
+{
+public:
+    OutputFormatEvents(std::unique_ptr<DateTimeFormat> dtFormat,
+                       std::unique_ptr<ValueFormat> valFormat,
+                       int refYear,
+                       unsigned refMonth,
+                       unsigned refDay,
+                       std::unique_ptr<const FilterExpression> filter = nullptr,
+                       std::unique_ptr<const Encoder> enc = nullptr,
+                       std::vector<unsigned> gustThresholds = 
+                           EventDetector::defaultGustThresholds());
+    virtual ~OutputFormatEvents() {}
+
+    const std::vector<unsigned> &gustThresholds() const { return thresholds; }
+
+    class Detector;
+
+protected:
+    // Throws std::runtime_error, since events cannot be found without the
+    // previous reports (see Detector)
+    virtual void serialise(const metaf::ParseResult &parseResult,
+                           const RefDate &refDate,
+                           std::ostream &out) const;
+
+private:
+    // Write a record for each event found in the report
+    void writeEvents(const metaf::ParseResult &parseResult,
+                     const RefDate &refDate,
+                     const EventDetector::Result &result,
+                     std::ostream &out) const;
+
+    std::vector<unsigned> thresholds;
+};
+
+// Serialises the events found in each report with the format. Unlike output
+// formats, serialisation changes the state (see EventDetector) of the report's
+// station.
+class OutputFormatEvents::Detector
+{
+public:
+    // Throws std::invalid_argument if the format has more gust thresholds
+    // than supported by EventDetector
+    explicit Detector(std::unique_ptr<const OutputFormatEvents> format);
+
+    const OutputFormatEvents &outputFormat() const { return *format; }
+
+    // Parse METAR or TAF report and serialise its events
+    Result toJson(const std::string &report,
+                  const RefDate &refDate,
+                  std::ostream &out = std::cout);
+    // Serialise the events of already parsed METAR or TAF report
+    Result toJson(const metaf::ParseResult &parseResult,
+                  const RefDate &refDate,
+                  std::ostream &out);
+
+private:
+    std::unique_ptr<const OutputFormatEvents> format;
+    EventDetector detector;
+    // Result is reused to avoid allocations for each report
+    EventDetector::Result result;
+};
+
+#endif // #ifndef OUTPUTFORMATEVENTS_HPP
@@ -0,0 +1,124 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef OUTPUTINDEX_HPP
+#define OUTPUTINDEX_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "reportkey.hpp"
+
+// Index of the converted output, which allows to read records of particular
+// stations and time range by their byte offsets in the output file.
+//
+// Index file is mapped to memory rather than read; it consists of header,
+// station directory sorted by station, and entries sorted by station and
+// time. Each station of the directory refers to the range of its entries.
+// Integers are stored in the byte order of the host which is checked when
+// index is opened.
+class OutputIndex
+{
+public:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t outputSize;     // Size of the output in bytes
+        uint64_t stationCount;
+        uint64_t entryCount;
+        uint64_t stationsOffset; // Offsets from the beginning of index file
+        uint64_t entriesOffset;
+    };
+    struct Station
+    {
+        uint32_t station; // Packed ICAO location, see StationFilter
+        uint32_t reserved;
+        uint64_t first;   // Index of the first entry of the station
+        uint64_t count;   // Number of entries of the station
+    };
+    struct Entry
+    {
+        uint32_t station; // Packed ICAO location, see StationFilter
+        uint32_t length;  // Length of the output record in bytes
+        int64_t time;     // Unix time of the report
+        uint64_t offset;  // Offset of the output record
+    };
+
+    static const uint32_t version = 1;
+
+    // Collects entries while the output is written
+    class Builder
+    {
+    public:
+        void add(const ReportKey &key, uint64_t offset, uint32_t length);
+        // Sort entries and write index of the output of outputSize bytes
+        void write(std::ostream &index, uint64_t outputSize);
+
+    private:
+        std::vector<Entry> entries;
+    };
+
+    // Map index file; throws if file is not a valid index
+    explicit OutputIndex(const std::string &indexFileName);
+
+    uint64_t outputSize() const { return header->outputSize; }
+    size_t stationCount() const { return header->stationCount; }
+    size_t entryCount() const { return header->entryCount; }
+    const Station *stationsBegin() const { return stations; }
+    const Station *stationsEnd() const { return stations + header->stationCount; }
+
+    // Entries of the station (packed ICAO location) with report time
+    // from..to inclusive, sorted by time
+    std::pair<const Entry *, const Entry *> find(uint32_t station,
+                                                 int64_t from,
+                                                 int64_t to) const;
+
+private:
+    MappedFile file;
+    const Header *header = nullptr;
+    const Station *stations = nullptr;
+    const Entry *entries = nullptr;
+};
+
+// Passes the output to another stream buffer, counting bytes written, so
+// that output offsets of the records are known. Output is collected in a
+// buffer and passed on when the buffer is full or on sync.
+class CountingOutput : public std::streambuf
+{
+public:
+    explicit CountingOutput(std::streambuf *sink, size_t bufferSize = defaultBufferSize);
+    // Passes the remaining buffered output
+    virtual ~CountingOutput();
+    CountingOutput(const CountingOutput &) = delete;
+    CountingOutput &operator=(const CountingOutput &) = delete;
+
+    // Bytes written, including those not passed on yet
+    uint64_t count() const { return written + (pptr() - pbase()); }
+
+    static const size_t defaultBufferSize = 64 * 1024;
+
+protected:
+    virtual int_type overflow(int_type c);
+    virtual int sync();
+
+private:
+    // Pass the buffered output to the sink; returns false if the sink
+    // cannot write it
+    bool passBuffer();
+
+    std::streambuf *sink;
+    std::string buffer;
+    uint64_t written = 0; // Bytes passed to the sink
+};
+
+#endif //#ifndef OUTPUTINDEX_HPP
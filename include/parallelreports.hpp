@@ -0,0 +1,137 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef PARALLELREPORTS_HPP
+#define PARALLELREPORTS_HPP
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metaf.hpp"
+
+#include "refdate.hpp"
+#include "threadpool.hpp"
+
+// Parses reports on worker threads and reduces each parsed report into a
+// partial state.
+//
+// Reports are collected in batches; each batch is parsed and reduced by a
+// worker thread into the partial state owned by that worker, so no locking
+// is needed per report. Partial states are returned to be merged when all
+// reports are added. Reports which cannot be parsed are skipped.
+template <typename State>
+class ParallelReports
+{
+public:
+    using Reduce = std::function<void(const metaf::ParseResult &parseResult,
+                                       const RefDate &refDate,
+                                       State &state)>;
+
+    // If threads is 0, number of hardware threads is used
+    ParallelReports(Reduce reduce, size_t threads = 0, size_t batchSize = defaultBatchSize)
+        : reduce(std::move(reduce)), batchSize(batchSize ? batchSize : 1), pool(threads)
+    {
+        batch.reserve(this->batchSize);
+        // At most one task per worker runs at a time, so each running task
+        // always finds a free partial state
+        partials.resize(pool.size());
+        for (auto i = 0u; i < partials.size(); i++)
+            freePartials.push_back(i);
+    }
+    // Waits until the submitted batches are complete
+    ~ParallelReports()
+    {
+        for (auto &s : submitted)
+            if (s.valid())
+                s.wait();
+    }
+    ParallelReports(const ParallelReports &) = delete;
+    ParallelReports &operator=(const ParallelReports &) = delete;
+
+    void add(std::string report, const RefDate &refDate)
+    {
+        batch.push_back(Report{std::move(report), refDate});
+        if (batch.size() >= batchSize)
+            submitBatch();
+    }
+    // Reduce remaining reports and return the partial states, one per
+    // worker; exceptions thrown by workers are rethrown here
+    std::vector<State> &finish()
+    {
+        submitBatch();
+        while (!submitted.empty())
+        {
+            submitted.front().get();
+            submitted.pop_front();
+        }
+        return partials;
+    }
+
+    static const size_t defaultBatchSize = 1024;
+
+private:
+    struct Report
+    {
+        std::string text;
+        RefDate refDate;
+    };
+
+    void submitBatch()
+    {
+        if (batch.empty())
+            return;
+        // Limit the number of batches kept in memory
+        while (submitted.size() >= 2 * pool.size())
+        {
+            submitted.front().get();
+            submitted.pop_front();
+        }
+        auto reports = std::make_shared<std::vector<Report>>(std::move(batch));
+        batch = std::vector<Report>();
+        batch.reserve(batchSize);
+        submitted.push_back(pool.submit([this, reports]() {
+            size_t partial;
+            {
+                std::lock_guard<std::mutex> lock(partialsMutex);
+                partial = freePartials.back();
+                freePartials.pop_back();
+            }
+            for (const auto &r : *reports)
+            {
+                try
+                {
+                    reduce(metaf::Parser::parse(r.text), r.refDate, partials[partial]);
+                }
+                catch (const std::exception &)
+                {
+                    // Reports which cannot be parsed are skipped
+                }
+            }
+            std::lock_guard<std::mutex> lock(partialsMutex);
+            freePartials.push_back(partial);
+        }));
+    }
+
+    Reduce reduce;
+    size_t batchSize;
+    std::vector<Report> batch;
+    // Partial states owned by the workers; a task takes a free partial state
+    // and returns it when the batch is reduced
+    std::vector<State> partials;
+    std::vector<size_t> freePartials;
+    std::mutex partialsMutex;
+    std::deque<std::future<void>> submitted;
+    ThreadPool pool;
+};
+
+#endif //#ifndef PARALLELREPORTS_HPP
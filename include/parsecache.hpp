@@ -0,0 +1,120 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef PARSECACHE_HPP
+#define PARSECACHE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "mappedfile.hpp"
+#include "refdate.hpp"
+
+namespace metaf
+{
+struct ParseResult;
+} // namespace metaf
+
+// Binary file of parsed reports, which allows to serialise the same reports
+// with different settings without parsing them again.
+//
+// For each report the file holds reference date, report text, metadata
+// used by output formats, and for each group its kind (index of the group
+// type in metaf::Group), report part and raw string. Groups are restored
+// by parsing the raw string only as the group type stored, rather than
+// trying every group type for every group as metaf::Parser does; if this
+// fails (e.g. the file was written by a different version of metaf) the
+// report is parsed again.
+//
+// Cache file is mapped to memory rather than read; it consists of header
+// followed by records, each aligned to 8 bytes. Integers are stored in the
+// byte order of the host which is checked when cache is opened.
+class ParseCache
+{
+public:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t metafVersion; // Major * 1000 + minor version of metaf
+        uint32_t groupKinds;   // Number of types in metaf::Group
+        uint64_t reportCount;  // 0 if unknown (output was not seekable)
+    };
+    struct Record
+    {
+        uint32_t size;        // Size of the record including padding
+        uint32_t textLength;  // Length of the report text following groups
+        int32_t refYear;
+        uint8_t refMonth;
+        uint8_t refDay;
+        uint8_t type;         // metaf::ReportType
+        uint8_t error;        // metaf::ReportError
+        uint16_t flags;       // Metadata flags, see below
+        uint16_t groupCount;
+        uint32_t reserved;
+    };
+    struct Group
+    {
+        uint8_t kind;         // Index of the type in metaf::Group
+        uint8_t reportPart;   // metaf::ReportPart
+        uint16_t reserved;
+        uint32_t length;      // Length of the raw string following text
+    };
+    enum Flags : uint16_t
+    {
+        SPECI = 1,
+        NIL = 2,
+        CANCELLED = 4,
+        AMENDED = 8,
+        CORRECTIONAL = 16,
+        AUTOMATED = 32
+    };
+
+    static const uint32_t version = 1;
+
+    // Writes parsed reports to the stream
+    class Writer
+    {
+    public:
+        // Header is written immediately
+        explicit Writer(std::ostream &out);
+        void add(const std::string &report,
+                 const RefDate &refDate,
+                 const metaf::ParseResult &parseResult);
+        // Update report count in the header if stream is seekable
+        void finish();
+        uint64_t reportCount() const { return count; }
+
+    private:
+        std::ostream &output;
+        std::streampos start;
+        uint64_t count = 0;
+        std::string record;
+    };
+
+    // Map cache file; throws if file is not a valid cache
+    explicit ParseCache(const std::string &fileName);
+
+    // Call f for each report in the cache, in the order they were written;
+    // throws if cache file is corrupted
+    void read(const std::function<void(const std::string &report,
+                                       const RefDate &refDate,
+                                       const metaf::ParseResult &parseResult)> &f) const;
+    // Number of reports restored by parsing the report again
+    uint64_t reparsedCount() const { return reparsed; }
+
+private:
+    MappedFile file;
+    std::string name;
+    mutable uint64_t reparsed = 0;
+};
+
+#endif //#ifndef PARSECACHE_HPP
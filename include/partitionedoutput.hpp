@@ -0,0 +1,154 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef PARTITIONEDOUTPUT_HPP
+#define PARTITIONEDOUTPUT_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "compressor.hpp"
+#include "refdate.hpp"
+#include "threadpool.hpp"
+
+namespace metaf
+{
+struct ParseResult;
+} // namespace metaf
+
+// Path of the partition file of each report, made from the path template by
+// replacing placeholders with the values of the partition keys:
+//  {type}: report type, metar, speci or taf;
+//  {date}: report date in YYYY-MM-DD format;
+//  {hash}: hash of ICAO location modulo N, 0 to N-1.
+// If the value cannot be determined from the report, unknown is used.
+class Partitioning
+{
+public:
+    // Keys is a comma-separated list of type, date and station-hash:N; the
+    // template must contain placeholders of all keys and no other
+    // placeholders; throws std::invalid_argument if keys or template are
+    // not valid
+    Partitioning(std::string_view keys, std::string_view pathTemplate);
+
+    std::string path(std::string_view report,
+                     const metaf::ParseResult &parseResult,
+                     const RefDate &refDate) const;
+
+private:
+    enum class Key
+    {
+        NONE,
+        TYPE,
+        DATE,
+        HASH
+    };
+    // Literal part of the template followed by the key value
+    struct Segment
+    {
+        std::string text;
+        Key key;
+    };
+    std::vector<Segment> segments;
+    uint32_t stationHashes = 0;
+};
+
+// Writes each output record to its partition file.
+//
+// Records are written to this stream buffer, each one completed by calling
+// endRecord() with the path of its partition file. Records are collected in
+// a buffer of each partition; full buffers are written to the files by
+// worker threads (and compressed if compressor is specified) while the next
+// records are collected. Number of files kept open is limited; the least
+// recently written files are closed and reopened for appending when needed.
+// Partition files are overwritten when first written to, and directories
+// of the partition files are created as required.
+class PartitionedOutput : public std::streambuf
+{
+public:
+    // If threads is 0, number of hardware threads is used
+    explicit PartitionedOutput(std::unique_ptr<const Compressor> compressor = nullptr,
+                               size_t maxOpenFiles = defaultMaxOpenFiles,
+                               size_t threads = 0,
+                               size_t bufferSize = defaultBufferSize,
+                               size_t memoryLimit = defaultMemoryLimit);
+    // Waits until the buffers being written are complete; remaining records
+    // are not written
+    virtual ~PartitionedOutput();
+    PartitionedOutput(const PartitionedOutput &) = delete;
+    PartitionedOutput &operator=(const PartitionedOutput &) = delete;
+
+    // Complete the record written since the previous record; empty record is
+    // ignored
+    void endRecord(const std::string &path);
+    // Write all remaining records and close the files; returns false if any
+    // partition file cannot be written; nothing may be written after
+    // finish() is called
+    bool finish();
+    // Partition files which cannot be written
+    std::vector<std::string> failedFiles() const;
+    size_t partitionCount() const { return partitions.size(); }
+    // Maximum number of files open at the same time
+    size_t maxOpenFileCount() const { return maxOpenFilesReached; }
+
+    static const size_t defaultMaxOpenFiles = 64;
+    static const size_t defaultBufferSize = 256 * 1024;
+    static const size_t defaultMemoryLimit = 256 * 1024 * 1024;
+
+protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char *s, std::streamsize n);
+
+private:
+    struct Partition
+    {
+        std::string path;
+        std::string buffer;
+        std::FILE *file = nullptr;
+        // Position in the list of open files if file is open
+        std::list<Partition *>::iterator openPosition;
+        bool created = false;
+        bool full = false;
+        bool failed = false;
+    };
+    struct Write
+    {
+        Partition *partition;
+        std::string data;
+    };
+    void writeBuffers(bool all);
+    void wait();
+    void open(Partition &partition);
+    void close(Partition &partition);
+
+    std::unique_ptr<const Compressor> compressor;
+    size_t maxOpenFiles;
+    size_t bufferSize;
+    size_t memoryLimit;
+    std::string record;
+    std::unordered_map<std::string, Partition> partitions;
+    std::vector<Partition *> fullPartitions;
+    size_t buffered = 0;
+    // Open files, most recently written first
+    std::list<Partition *> openFiles;
+    size_t maxOpenFilesReached = 0;
+    // Buffers being written by workers
+    std::vector<Write> submitted;
+    std::vector<std::future<void>> pending;
+    ThreadPool pool;
+};
+
+#endif //#ifndef PARTITIONEDOUTPUT_HPP
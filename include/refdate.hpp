@@ -0,0 +1,54 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef REFDATE_HPP
+#define REFDATE_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Reference date (i.e. date when the report was received), used to infer
+// month and year which are not included in METAR or TAF
+struct RefDate
+{
+    RefDate() = default;
+    RefDate(int y, unsigned m, unsigned d) : year(y), month(m), day(d) {}
+
+    bool isEmpty() const { return !year && !month && !day; }
+    bool operator==(const RefDate &other) const
+    {
+        return year == other.year && month == other.month && day == other.day;
+    }
+
+    // Date in YYYYMMDD, YYYY-MM-DD or YYYY/MM/DD format, optionally followed
+    // by time which is ignored
+    static std::optional<RefDate> fromString(std::string_view s);
+    // Timestamp line preceding the report in NOAA files, "YYYY/MM/DD HH:MM"
+    static std::optional<RefDate> fromTimestampLine(std::string_view s);
+    // First date in YYYYMMDD, YYYY-MM-DD or YYYY_MM_DD format found in the
+    // file name (directories are not searched)
+    static std::optional<RefDate> fromFileName(std::string_view path);
+    // Date of the Unix time
+    static RefDate fromUnixTime(int64_t time);
+    // Unix time of the date in YYYYMMDD format, optionally followed by time 
+    // in HHMM format; if time is not specified, start or end of day is used
+    static std::optional<int64_t> unixTimeFromString(std::string_view s, bool endOfDay);
+
+    int year = 0;
+    unsigned month = 0;
+    unsigned day = 0;
+
+private:
+    // Parse date at the beginning of the string; separator is an optional
+    // character between year, month and day; returns number of characters
+    // consumed or 0 if no valid date found
+    static size_t parseDate(std::string_view s, RefDate &date, char separator);
+};
+
+#endif //#ifndef REFDATE_HPP
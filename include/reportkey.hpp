@@ -0,0 +1,42 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef REPORTKEY_HPP
+#define REPORTKEY_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "refdate.hpp"
+
+namespace metaf
+{
+struct ParseResult;
+} // namespace metaf
+
+// Station and report time of the report, used to index and sort reports
+struct ReportKey
+{
+    uint32_t station = 0; // Packed ICAO location, see StationFilter
+    int64_t time = 0;     // Unix time of the report
+
+    // Key of the report with ICAO location followed by report time in 
+    // DDHHMMZ format; month and year are inferred from the reference date;
+    // returns empty optional if location or report time is not found in the
+    // raw report without parsing it
+    static std::optional<ReportKey> fromReport(std::string_view report,
+                                               const RefDate &refDate);
+    // Key of the parsed report with ICAO location and report time; month
+    // and year are inferred from the reference date; returns empty optional
+    // if location or report time is not reported
+    static std::optional<ReportKey> fromParseResult(const metaf::ParseResult &parseResult,
+                                                    const RefDate &refDate);
+};
+
+#endif //#ifndef REPORTKEY_HPP
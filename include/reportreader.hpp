@@ -0,0 +1,52 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef REPORTREADER_HPP
+#define REPORTREADER_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "settings.hpp"
+#include "refdate.hpp"
+
+// Reads METAR or TAF reports from input stream (one report per line) and 
+// determines reference date for each report
+class ReportReader
+{
+public:
+    struct Report
+    {
+        std::string text;      // METAR or TAF report
+        RefDate refDate;       // Reference date for this report
+        size_t lineNumber = 0; // Number of the input line containing report
+        uint64_t offset = 0;   // Byte offset of the report text in the input
+    };
+
+    // Reference date is used for all reports unless source specifies that 
+    // reference date is included in the input data
+    ReportReader(std::istream &in,
+                 Settings::RefDateSource source,
+                 const RefDate &refDate)
+        : input(in), refDateSource(source), currentRefDate(refDate)
+    {
+    }
+
+    // Read next report from input, return false if no more reports available
+    bool next(Report &report);
+
+private:
+    std::istream &input;
+    Settings::RefDateSource refDateSource;
+    RefDate currentRefDate;
+    size_t lineCount = 0;
+    uint64_t inputOffset = 0;
+};
+
+#endif //#ifndef REPORTREADER_HPP
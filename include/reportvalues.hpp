@@ -0,0 +1,98 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef REPORTVALUES_HPP
+#define REPORTVALUES_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "refdate.hpp"
+
+namespace metaf
+{
+struct ParseResult;
+class WindGroup;
+class VisibilityGroup;
+class KeywordGroup;
+class CloudGroup;
+} // namespace metaf
+
+// Most used values of a METAR or TAF report flattened into a single record,
+// for the tabular and columnar output formats.
+//
+// Values are taken from the observed conditions of METAR or from the
+// prevailing conditions of TAF: groups from remarks and trends are not
+// used. If the same value is reported more than once, the first one is used
+// (except for ceiling which is the lowest broken or overcast layer or
+// vertical visibility). CAVOK is visibility of 10 km with no ceiling.
+struct ReportValues
+{
+    enum class Type
+    {
+        UNKNOWN,
+        METAR,
+        SPECI,
+        TAF
+    };
+
+    // Current weather, used as bit flags in weatherFlags; recent weather and
+    // weather in vicinity are not included
+    enum class Weather : uint8_t
+    {
+        THUNDERSTORM = 1,
+        FREEZING_RAIN = 2,
+        SNOW = 4,          // Not blowing or drifting snow
+        PRECIPITATION = 8, // Any precipitation, including snow
+        NOT_REPORTED = 16  // Weather is not reported, e.g. // in automated reports
+    };
+
+    // Clear all values and fill them from the parsed report in a single pass
+    // over the groups; capacity of strings and vectors is reused
+    void extract(const metaf::ParseResult &result, const RefDate &refDate);
+    // Clear all values
+    void clear();
+    // Current weather includes the phenomena
+    bool hasWeather(Weather w) const { return weatherFlags & static_cast<uint8_t>(w); }
+
+    // Name of the report type as used in the output, e.g. "METAR"
+    static std::string_view typeName(Type type);
+    // Surface wind, including calm wind
+    static bool isSurfaceWind(const metaf::WindGroup &group);
+    // Broken or overcast cloud layer or vertical visibility
+    static bool isCeiling(const metaf::CloudGroup &group);
+    // Prevailing visibility in meters (minimum of variable prevailing
+    // visibility), empty for other visibility groups
+    static std::optional<float> prevailingVisibility(const metaf::VisibilityGroup &group);
+    // Visibility implied by CAVOK in meters, empty for other keywords
+    static std::optional<float> prevailingVisibility(const metaf::KeywordGroup &group);
+    // Height of ceiling in feet, empty if the group is not ceiling
+    static std::optional<float> ceilingHeight(const metaf::CloudGroup &group);
+
+    std::string station;                   // ICAO location
+    std::optional<int64_t> time;           // Unix time of the report
+    Type type = Type::UNKNOWN;
+    std::optional<unsigned> windDirection; // Surface wind direction, degrees
+    std::optional<float> windSpeed;        // Surface wind speed, knots
+    std::optional<float> gustSpeed;        // Surface wind gust speed, knots
+    bool variableWind = false;             // Surface wind direction is variable
+    std::optional<float> visibility;       // Prevailing visibility, meters
+    std::optional<float> ceiling;          // Ceiling, feet
+    bool skyReported = false;              // Clouds, no clouds or CAVOK reported
+    std::optional<float> temperature;      // Air temperature, degrees C
+    std::optional<float> dewPoint;         // Dew point, degrees C
+    std::optional<float> qnh;              // Observed QNH, hectopascal
+    std::vector<std::string> clouds;       // Cloud groups, e.g. "BKN030CB"
+    std::vector<std::string> weather;      // Current weather, e.g. "+TSRA"
+    uint8_t weatherFlags = 0;              // Current weather, see Weather
+};
+
+#endif //#ifndef REPORTVALUES_HPP
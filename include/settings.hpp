@@ -9,7 +9,12 @@
 #ifndef SETTINGS_HPP
 #define SETTINGS_HPP
 
+#include <cstdint>
+#include <limits>
 #include <string>
+#include <vector>
+
+#include "refdate.hpp"
 
 class Settings
 {
@@ -20,7 +25,11 @@ public:
         BASIC,    // As close to original report as possible
         COLLATED, // Comlete data from report, semantically grouped and structured
         SIMPLE,   // Simplified format to display simple current weather and forecast
-        HOURLY    // Simplified format with hourly forecast rather than trend-based
+        HOURLY,   // Simplified format with hourly forecast rather than trend-based
+        ARROW,    // Apache Arrow IPC stream with flattened columns
+        CSV,      // Comma-separated values, one row per report
+        TSV,      // Tab-separated values, one row per report
+        EVENTS    // Significant changes between consecutive reports of a station
     };
     // Which format for date and time was set by command line args
     enum class DateTimeFormat
@@ -35,6 +44,28 @@ public:
         BASIC, // Only use same measurement units as in the report
         ALL    // Use all supported measurement units
     };
+    // Where the reference date for each report is taken from
+    enum class RefDateSource
+    {
+        FIXED,     // Same reference date (--refdate or today) for all reports
+        TIMESTAMP, // Timestamp line "YYYY/MM/DD HH:MM" preceding the report
+        FILENAME,  // Date included in the name of the input file
+        COLUMN     // Date in the first tab-separated column before the report
+    };
+    // Which encoding of the output was set by command line args
+    enum class Encoding
+    {
+        JSON,   // Text JSON, one report per line
+        CBOR,   // CBOR, each report prefixed with its length
+        MSGPACK // MessagePack, each report prefixed with its length
+    };
+    // Which compression of the output was set by command line args
+    enum class Compression
+    {
+        NONE, // Output is not compressed
+        GZIP, // Multi-member gzip
+        ZSTD  // Multi-frame zstd
+    };
     // How program should proceed after command line args are processed
     enum class Status
     {
@@ -42,6 +73,16 @@ public:
         EXIT_OK,   // Program should exit with status OK
         EXIT_ERROR // Program should exit with status ERROR
     };
+    // Additional output written from the same parsed reports; settings not
+    // included here are the same as for the main output
+    struct OutputSpec
+    {
+        std::string file;
+        OutputFormat outputFormat = OutputFormat::BASIC;
+        DateTimeFormat dateTimeFormat = DateTimeFormat::BASIC;
+        UnitFormat unitFormat = UnitFormat::BASIC;
+        bool includeRawStrings = false;
+    };
 
     Settings() = default;
     
@@ -53,16 +94,107 @@ public:
     DateTimeFormat dateTimeFormat() const { return dtFormat; }
     // Which measurement units to use in JSON output
     UnitFormat unitFormat() const { return uFormat; }
+    // Encoding of the output
+    Encoding encoding() const { return enc; }
+    // Compression of the output
+    Compression compression() const { return compr; }
+    // Compression level; if 0 default level of the compression is used
+    int compressionLevel() const { return comprLevel; }
+    // Number of worker threads; if 0 number of hardware threads is used
+    unsigned threads() const { return threadCount; }
     // Reference date day-of-month
     unsigned refDateDay() const { return refDay; }
     // Reference date month
     unsigned refDateMonth() const { return refMonth; }
     // Reference dare year
     int refDateYear() const { return refYear; }
+    // Reference date used when no per-report reference date is available
+    RefDate refDate() const { return RefDate(refYear, refMonth, refDay); }
+    // Where the per-report reference date is taken from
+    RefDateSource refDateSource() const { return rdSource; }
+    // Input files to read reports from; if empty standard input is used
+    const std::vector<std::string> &inputFiles() const { return inFiles; }
+    // Comma-separated lists of ICAO locations to select reports
+    const std::vector<std::string> &stations() const { return stationLists; }
+    // Files with the lists of ICAO locations to select reports
+    const std::vector<std::string> &stationFiles() const { return stationFileNames; }
+    // Comma-separated list of group names to include in output; if empty 
+    // all groups are included
+    const std::string &groups() const { return groupList; }
+    // Expression to select reports after parsing; if empty all reports are 
+    // selected
+    const std::string &filter() const { return filterExpression; }
+    // Comma-separated list of columns for CSV and TSV output; if empty all 
+    // columns are included
+    const std::string &columns() const { return columnList; }
+    // Gust thresholds in knots for events output
+    const std::vector<unsigned> &gustThresholds() const { return gustThresholdList; }
     // Wrap JSON to keep essential parameters in front of the JSON output 
     bool wrapJson() const { return(wrapOption); }
     // Include raw group and report strings in output JSON
     bool includeRawStrings() const { return(rawOption); }
+    // Serialise groups as arrays of values in the order specified by schema
+    bool tupleGroups() const { return(tupleOption); }
+    // Omit values which are not reported rather than output them as null
+    bool compact() const { return(compactOption); }
+    // Only parse reports and print statistics rather than JSON output
+    bool validate() const { return(validateOption); }
+    // Include line numbers of reports with errors in statistics
+    bool listFailedLines() const { return(failedLinesOption); }
+    // Only build indexes of compressed input files rather than JSON output
+    bool buildIndex() const { return(buildIndexOption); }
+    // Read only the reports selected via indexes of compressed input files
+    bool useIndex() const { return(useIndexOption); }
+    // Unix time range of the reports selected via index, inclusive
+    int64_t timeFrom() const { return timeRangeFrom; }
+    int64_t timeTo() const { return timeRangeTo; }
+    // File to write index of the output to; if empty index is not written
+    const std::string &outputIndex() const { return outputIndexFile; }
+    // File to write parsed reports to; if empty parsed reports are not written
+    const std::string &emitParsed() const { return emitParsedFile; }
+    // File to read parsed reports from rather than input files
+    const std::string &fromParsed() const { return fromParsedFile; }
+    // Additional outputs written from the same parsed reports
+    const std::vector<OutputSpec> &additionalOutputs() const { return addOutputs; }
+    // Settings for the additional output
+    Settings forOutput(const OutputSpec &spec) const;
+    // Directory of the persistent conversion cache; if empty cache is not used
+    const std::string &cacheDir() const { return cacheDirectory; }
+    // Size limit of the conversion cache in megabytes
+    uint64_t cacheSize() const { return cacheSizeLimit; }
+    // Print statistics of the conversion cache at the end
+    bool cacheStats() const { return(cacheStatsOption); }
+    // Sort output records by station and report time
+    bool sortOutput() const { return(sortOption); }
+    // Memory used to sort the output in megabytes; records which do not fit
+    // are sorted in temporary files
+    uint64_t sortMemory() const { return sortMemoryLimit; }
+    // Comma-separated partition keys; if empty output is not partitioned
+    const std::string &partitionBy() const { return partitionKeys; }
+    // Template of the partition file paths
+    const std::string &partitionPath() const { return partitionPathTemplate; }
+    // Maximum number of partition files open at the same time
+    size_t partitionOpenFiles() const { return partitionOpenFilesLimit; }
+    // Remove repeated reports and replace reports by their corrections
+    bool dedup() const { return(dedupOption); }
+    // Memory used to find repeated reports in megabytes
+    uint64_t dedupMemory() const { return dedupMemoryLimit; }
+    // Only convert the newest report of each station and report type
+    bool latest() const { return(latestOption); }
+    // Interval of writing the newest reports in seconds; if 0 they are only
+    // written at the end
+    unsigned latestInterval() const { return latestIntervalSeconds; }
+    // Serialise each report as delta from the previous report of the station
+    bool delta() const { return(deltaOption); }
+    // Write per-station climatology aggregated from the reports
+    bool aggregate() const { return(aggregateOption); }
+    // Write approximate summary of all reports built with mergeable sketches
+    bool sketch() const { return(sketchOption); }
+    // File to save the sketches to; if empty sketches are not saved
+    const std::string &sketchSave() const { return sketchSaveFile; }
+    // Files with the sketches saved by previous runs to merge with the
+    // sketches of the reports
+    const std::vector<std::string> &sketchMerge() const { return sketchMergeFiles; }
 
 protected:
     // Set program status
@@ -74,16 +206,94 @@ protected:
     void setUnitFormat(UnitFormat f) { uFormat = f; }
     // Set date/time format
     void setDateTimeFormat(DateTimeFormat f) { dtFormat = f; }
+    // Set output encoding
+    void setEncoding(Encoding e) { enc = e; }
+    // Set output compression
+    void setCompression(Compression c) { compr = c; }
+    // Set compression level
+    void setCompressionLevel(int l) { comprLevel = l; }
+    // Set number of worker threads
+    void setThreads(unsigned t) { threadCount = t; }
 
     // Set wrapping into additional layer of JSON
     void setWrapJson(bool w = true) { wrapOption = w; }
     // Set including of raw strings
     void setRawStrings(bool r = true) { rawOption = r; }
+    // Set serialising groups as arrays of values
+    void setTupleGroups(bool t = true) { tupleOption = t; }
+    // Set omitting of values which are not reported
+    void setCompact(bool c = true) { compactOption = c; }
+    // Set validation mode
+    void setValidate(bool v = true) { validateOption = v; }
+    // Set listing of line numbers of reports with errors
+    void setListFailedLines(bool l = true) { failedLinesOption = l; }
+    // Set building of input file indexes
+    void setBuildIndex(bool b = true) { buildIndexOption = b; }
+    // Set reading of input files via indexes
+    void setUseIndex(bool u = true) { useIndexOption = u; }
+    // Set Unix time range of the reports selected via index
+    void setTimeRange(int64_t from, int64_t to) { timeRangeFrom = from; timeRangeTo = to; }
+    // Set file to write index of the output to
+    void setOutputIndex(std::string f) { outputIndexFile = std::move(f); }
+    // Set file to write parsed reports to
+    void setEmitParsed(std::string f) { emitParsedFile = std::move(f); }
+    // Set file to read parsed reports from
+    void setFromParsed(std::string f) { fromParsedFile = std::move(f); }
+    // Set additional outputs written from the same parsed reports
+    void setAdditionalOutputs(std::vector<OutputSpec> o) { addOutputs = std::move(o); }
+    // Set directory of the conversion cache
+    void setCacheDir(std::string d) { cacheDirectory = std::move(d); }
+    // Set size limit of the conversion cache in megabytes
+    void setCacheSize(uint64_t s) { cacheSizeLimit = s; }
+    // Set printing of the conversion cache statistics
+    void setCacheStats(bool s = true) { cacheStatsOption = s; }
+    // Set sorting of output records by station and report time
+    void setSortOutput(bool s = true) { sortOption = s; }
+    // Set memory used to sort the output in megabytes
+    void setSortMemory(uint64_t m) { sortMemoryLimit = m; }
+    // Set partition keys and template of the partition file paths
+    void setPartitioning(std::string k, std::string p) { partitionKeys = std::move(k); partitionPathTemplate = std::move(p); }
+    // Set maximum number of partition files open at the same time
+    void setPartitionOpenFiles(size_t n) { partitionOpenFilesLimit = n; }
+    // Set removal of repeated reports
+    void setDedup(bool d = true) { dedupOption = d; }
+    // Set memory used to find repeated reports in megabytes
+    void setDedupMemory(uint64_t m) { dedupMemoryLimit = m; }
+    // Set conversion of the newest reports only
+    void setLatest(bool l = true) { latestOption = l; }
+    // Set interval of writing the newest reports in seconds
+    void setLatestInterval(unsigned i) { latestIntervalSeconds = i; }
+    // Set serialisation of reports as delta
+    void setDelta(bool d = true) { deltaOption = d; }
+    // Set aggregation of the reports into per-station climatology
+    void setAggregate(bool a = true) { aggregateOption = a; }
+    // Set summary of the reports with sketches
+    void setSketch(bool s = true) { sketchOption = s; }
+    // Set file to save the sketches to
+    void setSketchSave(std::string f) { sketchSaveFile = std::move(f); }
+    // Set files with the sketches to merge
+    void setSketchMerge(std::vector<std::string> f) { sketchMergeFiles = std::move(f); }
 
     // Set reference date year, month, and day
     void setRefDate(int year, unsigned month, unsigned day);
     // Set reference date to today's date
     void setRefDate();
+    // Set source of per-report reference date
+    void setRefDateSource(RefDateSource s) { rdSource = s; }
+    // Set list of input files
+    void setInputFiles(std::vector<std::string> files) { inFiles = std::move(files); }
+    // Set lists of ICAO locations to select reports
+    void setStations(std::vector<std::string> s) { stationLists = std::move(s); }
+    // Set files with lists of ICAO locations to select reports
+    void setStationFiles(std::vector<std::string> f) { stationFileNames = std::move(f); }
+    // Set list of group names to include in output
+    void setGroups(std::string g) { groupList = std::move(g); }
+    // Set expression to select reports after parsing
+    void setFilter(std::string f) { filterExpression = std::move(f); }
+    // Set list of columns for CSV and TSV output
+    void setColumns(std::string c) { columnList = std::move(c); }
+    // Set gust thresholds for events output
+    void setGustThresholds(std::vector<unsigned> t) { gustThresholdList = std::move(t); }
 
 private:
     Status stat = Status::EXIT_ERROR;
@@ -91,13 +301,55 @@ private:
     OutputFormat outFormat = OutputFormat::BASIC;
     DateTimeFormat dtFormat = DateTimeFormat::BASIC;
     UnitFormat uFormat = UnitFormat::BASIC;
+    Encoding enc = Encoding::JSON;
+    Compression compr = Compression::NONE;
+    int comprLevel = 0;
+    unsigned threadCount = 0;
     
     unsigned refDay = 0;
     unsigned refMonth = 0;
     int refYear = 0;
+    RefDateSource rdSource = RefDateSource::FIXED;
+
+    std::vector<std::string> inFiles;
+    std::vector<std::string> stationLists;
+    std::vector<std::string> stationFileNames;
+    std::string groupList;
+    std::string filterExpression;
+    std::string columnList;
+    std::vector<unsigned> gustThresholdList = {25, 35};
+    std::string outputIndexFile;
+    std::string emitParsedFile;
+    std::string fromParsedFile;
+    std::vector<OutputSpec> addOutputs;
+    std::string cacheDirectory;
+    uint64_t cacheSizeLimit = 1024;
+    uint64_t sortMemoryLimit = 1024;
+    std::string partitionKeys;
+    std::string partitionPathTemplate;
+    size_t partitionOpenFilesLimit = 64;
+    uint64_t dedupMemoryLimit = 256;
+    unsigned latestIntervalSeconds = 0;
 
     bool wrapOption = false;
     bool rawOption = false;
+    bool tupleOption = false;
+    bool compactOption = false;
+    bool validateOption = false;
+    bool failedLinesOption = false;
+    bool buildIndexOption = false;
+    bool useIndexOption = false;
+    bool cacheStatsOption = false;
+    bool sortOption = false;
+    bool dedupOption = false;
+    bool latestOption = false;
+    bool deltaOption = false;
+    bool aggregateOption = false;
+    bool sketchOption = false;
+    std::string sketchSaveFile;
+    std::vector<std::string> sketchMergeFiles;
+    int64_t timeRangeFrom = std::numeric_limits<int64_t>::min();
+    int64_t timeRangeTo = std::numeric_limits<int64_t>::max();
 
 };
 
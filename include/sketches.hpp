@@ -0,0 +1,180 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef SKETCHES_HPP
+#define SKETCHES_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nlohmann/json_fwd.hpp"
+
+#include "parallelreports.hpp"
+#include "refdate.hpp"
+#include "reportvalues.hpp"
+
+// Sketches are fixed-size (or bounded) summaries which can be merged, so
+// that partial sketches built by worker threads or by different runs are
+// combined into the sketch of all values. Each sketch is written to and
+// read from a binary stream; integers and floating point values are stored
+// in the byte order of the host (see ReportSketches for the file header).
+// read() throws std::runtime_error if the stream does not contain a valid
+// sketch; merge() throws std::invalid_argument if the sketches have
+// different parameters.
+
+// Estimate of the number of distinct items (HyperLogLog with linear
+// counting for small cardinalities); items are added as 64-bit hashes and
+// 2^precision one-byte registers are kept
+class HyperLogLog
+{
+public:
+    explicit HyperLogLog(unsigned precision = defaultPrecision);
+
+    void add(uint64_t hash);
+    void merge(const HyperLogLog &other);
+    double estimate() const;
+
+    void write(std::ostream &out) const;
+    void read(std::istream &in);
+
+    static const unsigned defaultPrecision = 14; // About 0.8% standard error
+
+private:
+    unsigned precision;
+    std::vector<uint8_t> registers;
+};
+
+// Estimate of the quantiles of a distribution (merging t-digest); values are
+// buffered and merged into centroids whose size is bounded by the
+// compression, with smaller centroids near the tails
+class TDigest
+{
+public:
+    explicit TDigest(double compression = defaultCompression);
+
+    void add(double value, double weight = 1.0);
+    void merge(const TDigest &other);
+    // Estimated quantile, q is 0 to 1; empty optional if there are no values
+    std::optional<double> quantile(double q) const;
+    uint64_t count() const { return static_cast<uint64_t>(totalWeight); }
+    double min() const { return minValue; }
+    double max() const { return maxValue; }
+
+    void write(std::ostream &out) const;
+    void read(std::istream &in);
+
+    static constexpr double defaultCompression = 100.0;
+
+private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+    // Merge the buffered values into centroids
+    void compress() const;
+
+    double compression;
+    double totalWeight = 0.0;
+    double minValue = 0.0;
+    double maxValue = 0.0;
+    // Centroids are sorted by mean after compress()
+    mutable std::vector<Centroid> centroids;
+    mutable std::vector<Centroid> buffer;
+};
+
+// Estimate of the frequencies of items (count-min sketch); items are added
+// as 64-bit hashes; estimate is never less than the actual count and
+// exceeds it by at most 2/width of the total count with probability
+// 1 - 2^-depth
+class CountMinSketch
+{
+public:
+    CountMinSketch(size_t width = defaultWidth, size_t depth = defaultDepth);
+
+    void add(uint64_t hash, uint64_t count = 1);
+    uint64_t estimate(uint64_t hash) const;
+    void merge(const CountMinSketch &other);
+
+    void write(std::ostream &out) const;
+    void read(std::istream &in);
+
+    static const size_t defaultWidth = 2048;
+    static const size_t defaultDepth = 4;
+
+private:
+    size_t index(uint64_t hash, size_t row) const;
+
+    size_t width;
+    size_t depth;
+    std::vector<uint64_t> counters;
+};
+
+// Approximate summary of a large number of reports: number of distinct
+// stations (all reports), quantiles of visibility, ceiling, wind speed and
+// temperature and the most frequent weather phenomena (METAR reports only;
+// SPECI and TAF are not used). Values are taken from ReportValues.
+//
+// The most frequent weather phenomena are candidates kept along with the
+// count-min sketch; a phenomena replaces the least frequent candidate when
+// its estimated count is greater.
+class ReportSketches
+{
+public:
+    void add(const metaf::ParseResult &parseResult, const RefDate &refDate);
+    void merge(const ReportSketches &other);
+    nlohmann::json toJson() const;
+
+    // Write the sketches with the file header
+    void write(std::ostream &out) const;
+    // Read the sketches written by write()
+    void read(std::istream &in);
+
+    static const size_t weatherCandidates = 32;
+
+private:
+    void addWeather(std::string_view weather, uint64_t count = 1);
+
+    uint64_t reports = 0;
+    HyperLogLog stations;
+    TDigest visibility;  // Meters
+    TDigest ceiling;     // Feet
+    TDigest windSpeed;   // Knots
+    TDigest temperature; // Degrees C
+    CountMinSketch weather;
+    std::vector<std::string> topWeather;
+    // Values are reused to avoid allocations for each report
+    ReportValues values;
+};
+
+// Builds ReportSketches on worker threads (see ParallelReports) and merges
+// the partial sketches
+class Sketcher
+{
+public:
+    // If threads is 0, number of hardware threads is used
+    explicit Sketcher(size_t threads = 0,
+                      size_t batchSize = ParallelReports<ReportSketches>::defaultBatchSize);
+
+    void add(std::string report, const RefDate &refDate)
+    {
+        reports.add(std::move(report), refDate);
+    }
+    // Sketches of all reports added; nothing may be added after finish() is
+    // called
+    ReportSketches finish();
+
+private:
+    ParallelReports<ReportSketches> reports;
+};
+
+#endif //#ifndef SKETCHES_HPP
@@ -0,0 +1,82 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef SORTEDOUTPUT_HPP
+#define SORTEDOUTPUT_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "reportkey.hpp"
+#include "threadpool.hpp"
+
+// Collects output records and writes them sorted by station and report time;
+// records with the same key, and records without key (which follow all the
+// others), keep the order they were written in.
+//
+// Records are written to this stream buffer, each one completed by calling
+// endRecord(). Records are kept in memory up to the memory limit; when the
+// limit is reached, the records are sorted by worker threads and written to
+// a temporary file as a sorted run. finish() merges the runs.
+class SortedOutput : public std::streambuf
+{
+public:
+    // If threads is 0, number of hardware threads is used; temporary files
+    // are created in the directory specified by TMPDIR or in /tmp
+    explicit SortedOutput(size_t memoryLimit = defaultMemoryLimit, size_t threads = 0);
+    // Temporary files are removed
+    virtual ~SortedOutput();
+    SortedOutput(const SortedOutput &) = delete;
+    SortedOutput &operator=(const SortedOutput &) = delete;
+
+    // Complete the record written since the previous record; empty record is
+    // ignored
+    void endRecord(const std::optional<ReportKey> &key);
+    // Call f for each record in sorted order; nothing may be written after
+    // finish() is called
+    void finish(const std::function<void(const std::optional<ReportKey> &key,
+                                         std::string_view record)> &f);
+    // Number of sorted runs written to temporary files
+    size_t runCount() const { return runs.size(); }
+
+    static const size_t defaultMemoryLimit = 1024 * 1024 * 1024;
+
+protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char *s, std::streamsize n);
+
+private:
+    struct Entry
+    {
+        uint64_t station; // Packed location, or noStation if record has no key
+        int64_t time;
+        uint64_t sequence;
+        uint64_t offset;  // Offset of the record in memory or in the run
+        uint64_t length;
+    };
+    void sortEntries();
+    void writeRun();
+    void mergeRuns(const std::function<void(const std::optional<ReportKey> &,
+                                            std::string_view)> &f);
+
+    size_t memoryLimit;
+    std::string records;
+    size_t recordStart = 0;
+    std::vector<Entry> entries;
+    uint64_t sequence = 0;
+    std::vector<std::FILE *> runs;
+    ThreadPool pool;
+};
+
+#endif //#ifndef SORTEDOUTPUT_HPP
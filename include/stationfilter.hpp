@@ -0,0 +1,55 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef STATIONFILTER_HPP
+#define STATIONFILTER_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Selects reports by ICAO location before they are parsed. Location is found 
+// by scanning the raw report string, so that rejected reports do not incur 
+// parsing and serialising.
+class StationFilter
+{
+public:
+    StationFilter() = default;
+
+    // Add ICAO locations from comma-separated list
+    void addStations(std::string_view list);
+    // Add ICAO locations from stream, separated by whitespace or commas; 
+    // text after # to the end of line is ignored
+    void addStations(std::istream &in);
+
+    // No stations added, filter accepts all reports
+    bool isEmpty() const { return stations.empty(); }
+    // Number of different stations in the filter
+    size_t size() const { return stations.size(); }
+    // Packed ICAO locations in the filter, sorted
+    const std::vector<uint32_t> &packedStations() const { return stations; }
+    // Report's ICAO location is one of the stations added to the filter
+    bool matches(std::string_view report) const;
+
+    // Find ICAO location in the raw report, skipping report type and 
+    // modifier keywords; returns empty string if location was not found
+    static std::string_view findLocation(std::string_view report);
+    // Pack four-character ICAO location into an integer; 
+    // returns empty optional if location is not valid
+    static std::optional<uint32_t> packLocation(std::string_view location);
+
+private:
+    void addStation(std::string_view station);
+
+    // Packed ICAO locations, sorted for binary search
+    std::vector<uint32_t> stations;
+};
+
+#endif //#ifndef STATIONFILTER_HPP
@@ -0,0 +1,64 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed number of worker threads running submitted tasks in the order of
+// submission; result of each task is obtained via std::future
+class ThreadPool
+{
+public:
+    // If threads is 0, number of hardware threads is used
+    explicit ThreadPool(size_t threads = 0);
+    // Waits until all submitted tasks are complete
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Number of worker threads
+    size_t size() const { return workers.size(); }
+    // Number of hardware threads, at least 1
+    static size_t hardwareThreads();
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F &&task)
+    {
+        using R = std::invoke_result_t<F>;
+        // std::function requires copyable target
+        auto t = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        auto result = t->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([t]() { (*t)(); });
+        }
+        taskAdded.notify_one();
+        return result;
+    }
+
+private:
+    void run();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAdded;
+    bool stopping = false;
+};
+
+#endif //#ifndef THREADPOOL_HPP
@@ -9,14 +9,20 @@
 #ifndef UTILITY_HPP
 #define UTILITY_HPP
 
+#include <cstdint>
 #include <string_view>
 #include <string>
 #include <memory>
 
 class OutputFormat;
+class OutputFormatBasic;
+class OutputFormatEvents;
 class ValueFormat;
 class DateTimeFormat;
 class Settings;
+class Encoder;
+class StationFilter;
+class Compressor;
 
 namespace util
 {
@@ -29,15 +35,42 @@ std::string toLower(std::string_view s);
 // Convert a string_view to lowercase
 std::string toLower(std::string s);
 
+// Stable hash of the data (64-bit FNV-1a); h is the hash of the preceding
+// data, so that the data can be hashed in parts
+uint64_t hash(std::string_view data, uint64_t h = 14695981039346656037ull);
+
 // Create an OutputFormat object specified in settings
 std::unique_ptr<OutputFormat> makeOutputFormat(const Settings & settings);
 
+// Create an OutputFormatBasic object with the options specified in settings
+// regardless of the output format specified
+std::unique_ptr<OutputFormatBasic> makeOutputFormatBasic(const Settings & settings);
+
+// Create an OutputFormatEvents object with the options specified in settings
+// regardless of the output format specified
+std::unique_ptr<OutputFormatEvents> makeOutputFormatEvents(const Settings & settings);
+
 // Create an ValueFormat object specified in settings
 std::unique_ptr<ValueFormat> makeValueFormat(const Settings & settings);
 
 // Create a DateTimeFormat object specified in settings
 std::unique_ptr<DateTimeFormat> makeDateTimeFormat(const Settings & settings);
 
+// Create an Encoder object specified in settings
+std::unique_ptr<Encoder> makeEncoder(const Settings & settings);
+
+// Create a Compressor for the output compression specified in settings, or 
+// nullptr if output is not compressed
+std::unique_ptr<Compressor> makeCompressor(const Settings & settings);
+
+// Description of the settings which affect the output of each report, used
+// to key the conversion cache
+std::string conversionSettings(const Settings & settings);
+
+// Create a StationFilter with the stations and station files specified in 
+// settings
+std::unique_ptr<StationFilter> makeStationFilter(const Settings & settings);
+
 } // namespace util
 
 #endif // #ifndef UTILITY_HPP
\ No newline at end of file
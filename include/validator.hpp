@@ -0,0 +1,60 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef VALIDATOR_HPP
+#define VALIDATOR_HPP
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json_fwd.hpp"
+
+// Parses reports without serialising them and tallies report types, report 
+// errors, group types and stations for feed quality control
+class Validator
+{
+public:
+    // If listFailedLines is true, numbers of input lines containing reports 
+    // with errors are included in the summary
+    explicit Validator(bool listFailedLines = false) : listLines(listFailedLines) {}
+
+    // Set name of the input (e.g. file name) for the reports that follow
+    void setInputName(std::string name) { inputName = std::move(name); }
+    // Parse report and add results to statistics
+    void validate(const std::string &report, size_t lineNumber = 0);
+    // Summary of the statistics collected so far
+    nlohmann::json summary() const;
+    // Print summary to the stream as JSON
+    void printSummary(std::ostream &out = std::cout) const;
+
+private:
+    struct StationStats
+    {
+        size_t reports = 0;
+        size_t failed = 0;
+        size_t unknownGroups = 0;
+    };
+    static const size_t maxCounters = 64;
+
+    bool listLines = false;
+    std::string inputName;
+
+    size_t totalReports = 0;
+    size_t failedReports = 0;
+    size_t exceptions = 0;
+    size_t unknownGroups = 0;
+    size_t reportTypes[maxCounters] = {};
+    size_t reportErrors[maxCounters] = {};
+    size_t groupKinds[maxCounters] = {};
+    std::map<std::string, StationStats> stations;
+    std::map<std::string, std::vector<size_t>> failedLines;
+};
+
+#endif //#ifndef VALIDATOR_HPP
@@ -13,6 +13,8 @@
 #include <string>
 #include "nlohmann/json_fwd.hpp"
 
+#include "valuewriter.hpp"
+
 namespace metaf
 {
     class Runway;
@@ -33,42 +35,60 @@ class ValueFormat
 public:
     ValueFormat() = default;
     virtual ~ValueFormat() {}
-    // Methods below format various values as JSON objects. Non-reported values 
-    // result in empty JSON. If value must be explicitly specified as 
+    // Methods below write various values as objects. Non-reported values 
+    // are written as null. If value must be explicitly specified as 
     // non-reported, set parameter addNotReported to true.   
 
     // Runway identification
-    virtual nlohmann::json format(const metaf::Runway &runway) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Runway &runway) const = 0;
     // Temperature value
-    virtual nlohmann::json format(const metaf::Temperature &temperature,
-                                  bool addNotReported = false) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Temperature &temperature,
+                       bool addNotReported = false) const = 0;
     // Speed value
-    virtual nlohmann::json format(const metaf::Speed &speed,
-                                  bool addNotReported = false) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Speed &speed,
+                       bool addNotReported = false) const = 0;
     // Distance, height or runway visual range value
-    virtual nlohmann::json format(const metaf::Distance &distance,
-                                  bool heightOrRvr = false,
-                                  bool addNotReported = false) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Distance &distance,
+                       bool heightOrRvr = false,
+                       bool addNotReported = false) const = 0;
     // Direction value
-    virtual nlohmann::json format(const metaf::Direction &direction,
-                                  bool addNotReported = false) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Direction &direction,
+                       bool addNotReported = false) const = 0;
     // Direction sector
-    virtual nlohmann::json format(const metaf::Direction &sectorBegin,
-                                  const metaf::Direction &sectorEnd) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Direction &sectorBegin,
+                       const metaf::Direction &sectorEnd) const = 0;
     // Vector of directions
-    virtual nlohmann::json format(const std::vector<metaf::Direction> &directions) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const std::vector<metaf::Direction> &directions) const = 0;
     // Pressure value
-    virtual nlohmann::json format(const metaf::Pressure &pressure,
-                                  bool addNotReported = false) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Pressure &pressure,
+                       bool addNotReported = false) const = 0;
     // Precipitation or snow/ice accumulation value
-    virtual nlohmann::json format(const metaf::Precipitation &precipitation,
-                                  bool addNotReported = false) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Precipitation &precipitation,
+                       bool addNotReported = false) const = 0;
     // Surface friction value
-    virtual nlohmann::json format(const metaf::SurfaceFriction &surfaceFriction,
-                                  bool addNotReported = false) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::SurfaceFriction &surfaceFriction,
+                       bool addNotReported = false) const = 0;
     // Wave height value or descriptive state of sea surface
-    virtual nlohmann::json format(const metaf::WaveHeight &waveHeight,
-                                  bool addNotReported = false) const = 0;
+    virtual void write(ValueWriter &writer,
+                       const metaf::WaveHeight &waveHeight,
+                       bool addNotReported = false) const = 0;
+
+    // Format value as JSON, arguments are the same as for write()
+    template <typename... Args>
+    auto format(const Args &... args) const
+    {
+        return toJsonValue([&](ValueWriter &writer) { write(writer, args...); });
+    }
 };
 
 class ValueFormatBasic : public ValueFormat
@@ -76,27 +96,38 @@ class ValueFormatBasic : public ValueFormat
 public:
     ValueFormatBasic() = default;
     virtual ~ValueFormatBasic() {}
-    virtual nlohmann::json format(const metaf::Runway &runway) const;
-    virtual nlohmann::json format(const metaf::Temperature &temperature,
-                                  bool addNotReported = false) const;
-    virtual nlohmann::json format(const metaf::Speed &speed,
-                                  bool addNotReported = false) const;
-    virtual nlohmann::json format(const metaf::Distance &distance,
-                                  bool heightOrRvr = false,
-                                  bool addNotReported = false) const;
-    virtual nlohmann::json format(const metaf::Direction &direction,
-                                  bool addNotReported = false) const;
-    virtual nlohmann::json format(const metaf::Direction &sectorBegin,
-                                  const metaf::Direction &sectorEnd) const;
-    virtual nlohmann::json format(const std::vector<metaf::Direction> &directions) const;
-    virtual nlohmann::json format(const metaf::Pressure &pressure,
-                                  bool addNotReported = false) const;
-    virtual nlohmann::json format(const metaf::Precipitation &precipitation,
-                                  bool addNotReported = false) const;
-    virtual nlohmann::json format(const metaf::SurfaceFriction &surfaceFriction,
-                                  bool addNotReported = false) const;
-    virtual nlohmann::json format(const metaf::WaveHeight &waveHeight,
-                                  bool addNotReported = false) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Runway &runway) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Temperature &temperature,
+                       bool addNotReported = false) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Speed &speed,
+                       bool addNotReported = false) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Distance &distance,
+                       bool heightOrRvr = false,
+                       bool addNotReported = false) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Direction &direction,
+                       bool addNotReported = false) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Direction &sectorBegin,
+                       const metaf::Direction &sectorEnd) const;
+    virtual void write(ValueWriter &writer,
+                       const std::vector<metaf::Direction> &directions) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Pressure &pressure,
+                       bool addNotReported = false) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::Precipitation &precipitation,
+                       bool addNotReported = false) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::SurfaceFriction &surfaceFriction,
+                       bool addNotReported = false) const;
+    virtual void write(ValueWriter &writer,
+                       const metaf::WaveHeight &waveHeight,
+                       bool addNotReported = false) const;
 };
 
 #endif // #ifndef VALUEFORMAT_HPP
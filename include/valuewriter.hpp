@@ -0,0 +1,294 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#ifndef VALUEWRITER_HPP
+#define VALUEWRITER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nlohmann/json_fwd.hpp"
+
+// Writes the values of serialised report to a particular encoding as they
+// are produced, without building an intermediate document. Values of
+// objects and arrays are written between begin and end calls; each value
+// of an object is preceded by its key.
+class ValueWriter
+{
+public:
+    ValueWriter() = default;
+    virtual ~ValueWriter() {}
+
+    virtual void beginObject() = 0;
+    virtual void endObject() = 0;
+    virtual void beginArray() = 0;
+    virtual void endArray() = 0;
+    virtual void key(std::string_view k) = 0;
+
+    virtual void writeNull() = 0;
+    virtual void writeBool(bool b) = 0;
+    virtual void writeInt(int64_t i) = 0;
+    virtual void writeUint(uint64_t u) = 0;
+    virtual void writeDouble(double d) = 0;
+    virtual void writeString(std::string_view s) = 0;
+
+    void value(std::nullptr_t) { writeNull(); }
+    void value(bool b) { writeBool(b); }
+    void value(int i) { writeInt(i); }
+    void value(long i) { writeInt(i); }
+    void value(long long i) { writeInt(i); }
+    void value(unsigned int u) { writeUint(u); }
+    void value(unsigned long u) { writeUint(u); }
+    void value(unsigned long long u) { writeUint(u); }
+    void value(float d) { writeDouble(d); }
+    void value(double d) { writeDouble(d); }
+    void value(const char *s) { writeString(s); }
+    void value(std::string_view s) { writeString(s); }
+    void value(const std::string &s) { writeString(s); }
+
+    // Key followed by value
+    template <typename T>
+    void member(std::string_view k, const T &v)
+    {
+        key(k);
+        value(v);
+    }
+
+    // Write a value already serialised to JSON
+    void json(const nlohmann::json &j);
+};
+
+// Builds JSON value in the target (e.g. for text JSON output)
+class JsonValueWriter : public ValueWriter
+{
+public:
+    explicit JsonValueWriter(nlohmann::json &target) : target(&target) {}
+    virtual ~JsonValueWriter() {}
+
+    virtual void beginObject();
+    virtual void endObject();
+    virtual void beginArray();
+    virtual void endArray();
+    virtual void key(std::string_view k);
+
+    virtual void writeNull();
+    virtual void writeBool(bool b);
+    virtual void writeInt(int64_t i);
+    virtual void writeUint(uint64_t u);
+    virtual void writeDouble(double d);
+    virtual void writeString(std::string_view s);
+
+    // Discard unfinished objects and arrays
+    void clear();
+
+private:
+    // Add value to the current object or array (or set target if the value
+    // is not nested) and return added value
+    template <typename T>
+    nlohmann::json &add(T &&v);
+
+    nlohmann::json *target;
+    // Objects and arrays not ended yet
+    std::vector<nlohmann::json *> stack;
+    std::string currentKey;
+};
+
+// Base for binary encodings. Values are appended to the buffer; number of
+// values of an object or array is not known until the object or array
+// ends, thus a slot of the maximum header length is reserved before its
+// values when it begins, and the header is written to the end of the slot
+// when it ends. Unused starts of the slots are removed in a single pass
+// when the outermost object or array ends.
+class BinaryValueWriter : public ValueWriter
+{
+public:
+    BinaryValueWriter() = default;
+    virtual ~BinaryValueWriter() {}
+
+    virtual void beginObject();
+    virtual void endObject();
+    virtual void beginArray();
+    virtual void endArray();
+    virtual void key(std::string_view k);
+
+    virtual void writeNull();
+    virtual void writeBool(bool b);
+    virtual void writeInt(int64_t i);
+    virtual void writeUint(uint64_t u);
+    virtual void writeDouble(double d);
+    virtual void writeString(std::string_view s);
+
+    // Encoded values
+    const std::string &data() const { return buffer; }
+    // Discard encoded values and unfinished objects and arrays
+    void clear();
+
+protected:
+    // Append encoded values to the output; header of an object specifies
+    // number of key/value pairs and header of an array specifies number of
+    // values
+    virtual void appendHeader(std::string &out, bool object, size_t size) const = 0;
+    virtual void appendNull(std::string &out) const = 0;
+    virtual void appendBool(std::string &out, bool b) const = 0;
+    virtual void appendInt(std::string &out, int64_t i) const = 0;
+    virtual void appendUint(std::string &out, uint64_t u) const = 0;
+    virtual void appendDouble(std::string &out, double d) const = 0;
+    virtual void appendString(std::string &out, std::string_view s) const = 0;
+
+private:
+    struct Container
+    {
+        bool object;
+        size_t position; // Position of the first value in the buffer
+        size_t size = 0;
+    };
+    // Unused bytes of the header slot
+    struct Gap
+    {
+        size_t position;
+        size_t length;
+    };
+    // Longest header of both encodings (CBOR with 64-bit size)
+    static const size_t maxHeaderLength = 9;
+
+    // Count value written to the current array
+    void addValue();
+    void begin(bool object);
+    void end(bool object);
+    // Remove gaps from the buffer
+    void compact();
+
+    std::string buffer;
+    std::vector<Container> stack;
+    std::vector<Gap> gaps;
+    std::string header;
+};
+
+// CBOR (RFC 7049); floating point values are encoded as single precision
+// if no precision is lost
+class CborWriter : public BinaryValueWriter
+{
+public:
+    CborWriter() = default;
+    virtual ~CborWriter() {}
+
+protected:
+    virtual void appendHeader(std::string &out, bool object, size_t size) const;
+    virtual void appendNull(std::string &out) const;
+    virtual void appendBool(std::string &out, bool b) const;
+    virtual void appendInt(std::string &out, int64_t i) const;
+    virtual void appendUint(std::string &out, uint64_t u) const;
+    virtual void appendDouble(std::string &out, double d) const;
+    virtual void appendString(std::string &out, std::string_view s) const;
+};
+
+// MessagePack; floating point values are encoded as single precision if no
+// precision is lost
+class MsgpackWriter : public BinaryValueWriter
+{
+public:
+    MsgpackWriter() = default;
+    virtual ~MsgpackWriter() {}
+
+protected:
+    virtual void appendHeader(std::string &out, bool object, size_t size) const;
+    virtual void appendNull(std::string &out) const;
+    virtual void appendBool(std::string &out, bool b) const;
+    virtual void appendInt(std::string &out, int64_t i) const;
+    virtual void appendUint(std::string &out, uint64_t u) const;
+    virtual void appendDouble(std::string &out, double d) const;
+    virtual void appendString(std::string &out, std::string_view s) const;
+};
+
+// Records the values written so that they can be compared with other
+// recorded values and written to another writer later. Recorded value is
+// identified by the range of positions before and after it was written.
+class ValueRecorder : public ValueWriter
+{
+public:
+    struct Range
+    {
+        size_t begin = 0;
+        size_t end = 0;
+    };
+    struct Member
+    {
+        std::string_view key; // Valid until next value is recorded
+        Range value;
+    };
+
+    ValueRecorder() = default;
+    virtual ~ValueRecorder() {}
+
+    virtual void beginObject();
+    virtual void endObject();
+    virtual void beginArray();
+    virtual void endArray();
+    virtual void key(std::string_view k);
+
+    virtual void writeNull();
+    virtual void writeBool(bool b);
+    virtual void writeInt(int64_t i);
+    virtual void writeUint(uint64_t u);
+    virtual void writeDouble(double d);
+    virtual void writeString(std::string_view s);
+
+    size_t position() const { return events.size(); }
+    // Whether the value in the range is the same as the value in the range
+    // of other recorder
+    bool equal(Range range, const ValueRecorder &other, Range otherRange) const;
+    // Write the value in the range to the writer
+    void replay(Range range, ValueWriter &writer) const;
+    // Keys and values of the object in the range; result is cleared first
+    void members(Range object, std::vector<Member> &result) const;
+    // Discard recorded values; capacity is reused
+    void clear();
+
+private:
+    enum class Type : uint8_t
+    {
+        BEGIN_OBJECT,
+        END_OBJECT,
+        BEGIN_ARRAY,
+        END_ARRAY,
+        KEY,
+        NULL_VALUE,
+        BOOL,
+        INT,
+        UINT,
+        DOUBLE,
+        STRING
+    };
+    struct Event
+    {
+        Type type;
+        uint64_t value = 0;  // Bits of scalar or offset of key or string
+        size_t length = 0;   // Length of key or string
+    };
+    void addString(Type type, std::string_view s);
+    std::string_view string(const Event &e) const;
+
+    std::vector<Event> events;
+    std::string strings; // Keys and strings of all events
+};
+
+// Value written by the function to JsonValueWriter; Json is a template
+// parameter so that this header does not require complete JSON type
+template <typename F, typename Json = nlohmann::json>
+Json toJsonValue(F &&write)
+{
+    Json j;
+    JsonValueWriter writer(j);
+    write(writer);
+    return j;
+}
+
+#endif //#ifndef VALUEWRITER_HPP
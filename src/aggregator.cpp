@@ -0,0 +1,285 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "aggregator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include "nlohmann/json.hpp"
+#include "metaf.hpp"
+
+#include "stationfilter.hpp"
+#include "utility.hpp"
+
+using namespace metaf;
+
+//////////////////////////////////////////////////////////////////////////////
+// Moments
+//////////////////////////////////////////////////////////////////////////////
+
+void Moments::add(double value)
+{
+    if (!count)
+        min = max = value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+    count++;
+    const auto delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+}
+
+void Moments::merge(const Moments &other)
+{
+    if (!other.count)
+        return;
+    if (!count)
+    {
+        *this = other;
+        return;
+    }
+    const auto total = count + other.count;
+    const auto delta = other.mean - mean;
+    mean += delta * other.count / total;
+    m2 += other.m2 + delta * delta * count * other.count / total;
+    count = total;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+double Moments::variance() const
+{
+    if (count < 2)
+        return 0.0;
+    return m2 / count;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Histogram
+//////////////////////////////////////////////////////////////////////////////
+
+Histogram::Histogram(float binWidth, size_t bins) : width(binWidth), bins(bins ? bins : 1)
+{
+}
+
+void Histogram::add(float value)
+{
+    const auto bin = value > 0 ? static_cast<size_t>(value / width) : 0;
+    bins[std::min(bin, bins.size() - 1)]++;
+    total++;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    for (auto i = 0u; i < bins.size() && i < other.bins.size(); i++)
+        bins[i] += other.bins[i];
+    total += other.total;
+}
+
+std::optional<float> Histogram::percentile(float p, uint64_t greater) const
+{
+    const auto n = total + greater;
+    if (!n)
+        return std::optional<float>();
+    const auto rank = std::max(uint64_t(1),
+                               static_cast<uint64_t>(std::ceil(p / 100 * n)));
+    uint64_t cumulative = 0;
+    for (auto i = 0u; i < bins.size(); i++)
+    {
+        cumulative += bins[i];
+        if (cumulative >= rank)
+            return i * width;
+    }
+    return std::optional<float>();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// StationClimate
+//////////////////////////////////////////////////////////////////////////////
+
+// Ceiling up to 25000 ft and visibility up to 10 km in 100 ft or 100 m bins
+StationClimate::StationClimate() : ceiling(100, 251), visibility(100, 101)
+{
+}
+
+void StationClimate::merge(const StationClimate &other)
+{
+    reports += other.reports;
+    temperature.merge(other.temperature);
+    qnh.merge(other.qnh);
+    calm += other.calm;
+    variableWind += other.variableWind;
+    for (auto i = 0u; i < windSectors; i++)
+        for (auto j = 0u; j < windSpeedBins.size(); j++)
+            windRose[i][j] += other.windRose[i][j];
+    precipitationHours.insert(precipitationHours.end(),
+                              other.precipitationHours.begin(),
+                              other.precipitationHours.end());
+    compactPrecipitationHours();
+    ceiling.merge(other.ceiling);
+    noCeiling += other.noCeiling;
+    visibility.merge(other.visibility);
+}
+
+void StationClimate::compactPrecipitationHours()
+{
+    std::sort(precipitationHours.begin(), precipitationHours.end());
+    precipitationHours.erase(
+        std::unique(precipitationHours.begin(), precipitationHours.end()),
+        precipitationHours.end());
+    compactedHours = precipitationHours.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Aggregator
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+std::string stationName(uint32_t station)
+{
+    std::string result(4, ' ');
+    for (auto i = 4u; i; i--, station >>= 8)
+        result[i - 1] = static_cast<char>(station & 0xFF);
+    return result;
+}
+
+nlohmann::json momentsJson(const Moments &moments)
+{
+    nlohmann::json j{{"count", moments.count}};
+    if (!moments.count)
+        return j;
+    j["min"] = util::formatDecimals(moments.min, 1);
+    j["max"] = util::formatDecimals(moments.max, 1);
+    j["mean"] = util::formatDecimals(moments.mean, 2);
+    j["stddev"] = util::formatDecimals(std::sqrt(moments.variance()), 2);
+    return j;
+}
+
+nlohmann::json percentilesJson(const Histogram &histogram, uint64_t greater = 0)
+{
+    static const float percentiles[] = {10, 25, 50, 75, 90};
+    nlohmann::json j{{"count", histogram.count() + greater}};
+    for (const auto p : percentiles)
+    {
+        const auto name = "p" + std::to_string(static_cast<int>(p));
+        if (const auto v = histogram.percentile(p, greater); v.has_value())
+            j[name] = *v;
+        else
+            j[name] = nullptr;
+    }
+    return j;
+}
+
+} // namespace
+
+void Aggregator::finish(const Encoder &encoder, std::ostream &out)
+{
+    // Stations are ordered by packed location, which is alphabetical order
+    std::map<uint32_t, StationClimate> merged;
+    for (auto &partial : reports.finish())
+    {
+        for (auto &[station, climate] : partial.stations)
+        {
+            auto [m, created] = merged.try_emplace(station);
+            if (created)
+                m->second = std::move(climate);
+            else
+                m->second.merge(climate);
+        }
+        partial.stations.clear();
+    }
+    for (auto &[station, climate] : merged)
+        encoder.write(toJson(station, climate), out);
+}
+
+void Aggregator::aggregate(const ParseResult &parseResult,
+                           const RefDate &refDate,
+                           Partial &partial)
+{
+    const auto &metadata = parseResult.reportMetadata;
+    if (metadata.type != ReportType::METAR ||
+        metadata.isSpeci ||
+        metadata.isNil ||
+        metadata.error != ReportError::NONE)
+    {
+        return;
+    }
+    auto &values = partial.values;
+    values.extract(parseResult, refDate);
+    const auto station = StationFilter::packLocation(values.station);
+    if (!station.has_value())
+        return;
+
+    auto &climate = partial.stations[*station];
+    climate.reports++;
+    if (values.temperature.has_value())
+        climate.temperature.add(*values.temperature);
+    if (values.qnh.has_value())
+        climate.qnh.add(*values.qnh);
+    if (const auto windSpeed = values.windSpeed; windSpeed.has_value())
+    {
+        const auto &bins = StationClimate::windSpeedBins;
+        if (*windSpeed < bins.front())
+        {
+            climate.calm++;
+        }
+        else if (const auto windDirection = values.windDirection; windDirection.has_value())
+        {
+            // Sectors are centered on north, north-northeast, etc
+            const auto sectorWidth = 360.0 / StationClimate::windSectors;
+            const auto sector = static_cast<size_t>((*windDirection + sectorWidth / 2) / sectorWidth)
+                % StationClimate::windSectors;
+            const auto bin = std::upper_bound(bins.begin(), bins.end(), *windSpeed) - bins.begin() - 1;
+            climate.windRose[sector][bin]++;
+        }
+        else if (values.variableWind)
+        {
+            climate.variableWind++;
+        }
+    }
+    if (values.hasWeather(ReportValues::Weather::PRECIPITATION) && values.time.has_value())
+    {
+        climate.precipitationHours.push_back(static_cast<uint32_t>(*values.time / 3600));
+        // Repeated hours are removed when the list doubles in size
+        if (climate.precipitationHours.size() > 2 * climate.compactedHours + 64)
+            climate.compactPrecipitationHours();
+    }
+    if (values.visibility.has_value())
+        climate.visibility.add(*values.visibility);
+    if (values.ceiling.has_value())
+        climate.ceiling.add(*values.ceiling);
+    else if (values.skyReported)
+        climate.noCeiling++;
+}
+
+nlohmann::json Aggregator::toJson(uint32_t station, StationClimate &climate)
+{
+    climate.compactPrecipitationHours();
+    nlohmann::json rose = nlohmann::json::array();
+    for (const auto &sector : climate.windRose)
+        rose.push_back(sector);
+    auto ceiling = percentilesJson(climate.ceiling, climate.noCeiling);
+    ceiling["no_ceiling"] = climate.noCeiling;
+    return nlohmann::json{
+        {"station", stationName(station)},
+        {"reports", climate.reports},
+        {"temperature_c", momentsJson(climate.temperature)},
+        {"qnh_hpa", momentsJson(climate.qnh)},
+        {"wind", {
+            {"calm", climate.calm},
+            {"variable", climate.variableWind},
+            {"speed_bins_kt", StationClimate::windSpeedBins},
+            {"rose", std::move(rose)}}},
+        {"precipitation_hours", climate.precipitationHours.size()},
+        {"ceiling_ft", std::move(ceiling)},
+        {"visibility_m", percentilesJson(climate.visibility)}};
+}
@@ -0,0 +1,612 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "archiveindex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <zlib.h>
+#ifdef METAFJSON_ZSTD
+#include <zstd.h>
+#endif
+
+#include "decompressor.hpp"
+#include "reportkey.hpp"
+#include "reportreader.hpp"
+
+using Block = ArchiveIndex::Block;
+using Entry = ArchiveIndex::Entry;
+
+static_assert(sizeof(ArchiveIndex::Header) == 80, "Index header layout");
+static_assert(sizeof(Block) == 24, "Index block layout");
+static_assert(sizeof(Entry) == 32, "Index entry layout");
+
+namespace
+{
+
+const char magic[8] = {'M', 'E', 'T', 'A', 'F', 'I', 'D', 'X'};
+const uint32_t byteOrder = 0x01020304;
+const size_t inputChunkSize = 64 * 1024;
+
+//////////////////////////////////////////////////////////////////////////////
+// Decompression of the archive while building the index
+//////////////////////////////////////////////////////////////////////////////
+
+// Decompressed archive as stream, recording blocks during decompression
+class IndexingInput : public std::streambuf
+{
+public:
+    explicit IndexingInput(std::istream &archive) : archive(archive) {}
+    virtual ~IndexingInput() {}
+
+    std::vector<Block> blocks;
+    std::string windows;
+    uint64_t compressedSize = 0;
+    // Description of the error which stopped decompression
+    std::string error;
+
+protected:
+    virtual int_type underflow()
+    {
+        try
+        {
+            buffer.clear();
+            while (buffer.empty())
+                if (!decompress())
+                    return traits_type::eof();
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+            return traits_type::eof();
+        }
+        setg(buffer.data(), buffer.data(), buffer.data() + buffer.length());
+        return traits_type::to_int_type(*gptr());
+    }
+    // Append more decompressed data to buffer; return false at the end
+    virtual bool decompress() = 0;
+
+    std::istream &archive;
+    std::string buffer;
+    uint64_t uncompressedSize = 0;
+};
+
+// Restart points are starts of gzip members and ends of deflate blocks
+// every span bytes of output, as in zran.c example from zlib
+class GzipIndexingInput : public IndexingInput
+{
+public:
+    GzipIndexingInput(std::istream &archive, size_t span)
+        : IndexingInput(archive), span(span)
+    {
+        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+            throw(std::runtime_error("Cannot initialise gzip decompression"));
+    }
+    virtual ~GzipIndexingInput() { inflateEnd(&stream); }
+
+protected:
+    virtual bool decompress()
+    {
+        if (!stream.avail_in)
+        {
+            archive.read(input, sizeof(input));
+            if (!archive.gcount())
+            {
+                if (!memberComplete)
+                    throw(std::runtime_error("Truncated gzip archive"));
+                return false;
+            }
+            stream.next_in = reinterpret_cast<Bytef *>(input);
+            stream.avail_in = archive.gcount();
+        }
+        if (memberStart)
+        {
+            blocks.push_back(Block{compressedSize, uncompressedSize, ArchiveIndex::noWindow, 0, {}});
+            lastBlock = uncompressedSize;
+            memberStart = false;
+            memberComplete = false;
+        }
+        // Output goes to the circular window so that the last 32 KiB are
+        // available for a checkpoint
+        if (!stream.avail_out)
+        {
+            stream.next_out = window;
+            stream.avail_out = sizeof(window);
+        }
+        const auto availIn = stream.avail_in;
+        const auto availOut = stream.avail_out;
+        const auto out = stream.next_out;
+        const auto status = inflate(&stream, Z_BLOCK);
+        compressedSize += availIn - stream.avail_in;
+        uncompressedSize += availOut - stream.avail_out;
+        buffer.append(reinterpret_cast<char *>(out), availOut - stream.avail_out);
+        switch (status)
+        {
+        case Z_STREAM_END:
+            // Next member may follow
+            inflateReset(&stream);
+            memberStart = true;
+            memberComplete = true;
+            return true;
+        case Z_OK:
+        case Z_BUF_ERROR:
+            break;
+        default:
+            throw(std::runtime_error("Corrupted gzip archive"));
+        }
+        // End of deflate block which is not the last one
+        const bool blockEnd = (stream.data_type & 128) && !(stream.data_type & 64);
+        if (blockEnd && uncompressedSize - lastBlock >= span)
+            addCheckpoint();
+        return true;
+    }
+
+private:
+    void addCheckpoint()
+    {
+        blocks.push_back(Block{compressedSize,
+                               uncompressedSize,
+                               static_cast<uint32_t>(windows.length() / sizeof(window)),
+                               static_cast<uint8_t>(stream.data_type & 7),
+                               {}});
+        const auto left = stream.avail_out;
+        const auto w = reinterpret_cast<const char *>(window);
+        windows.append(w + sizeof(window) - left, left);
+        windows.append(w, sizeof(window) - left);
+        lastBlock = uncompressedSize;
+    }
+
+    z_stream stream{};
+    size_t span;
+    char input[inputChunkSize];
+    unsigned char window[ArchiveIndex::windowSize];
+    uint64_t lastBlock = 0;
+    bool memberStart = true;
+    bool memberComplete = false;
+};
+
+#ifdef METAFJSON_ZSTD
+// Restart points are starts of zstd frames
+class ZstdIndexingInput : public IndexingInput
+{
+public:
+    explicit ZstdIndexingInput(std::istream &archive)
+        : IndexingInput(archive), stream(ZSTD_createDStream(), &ZSTD_freeDStream)
+    {
+        if (!stream || ZSTD_isError(ZSTD_initDStream(stream.get())))
+            throw(std::runtime_error("Cannot initialise zstd decompression"));
+    }
+
+protected:
+    virtual bool decompress()
+    {
+        if (inBuffer.pos == inBuffer.size && !outputFull)
+        {
+            archive.read(input, sizeof(input));
+            if (!archive.gcount())
+            {
+                // Non-zero status means frame is not complete
+                if (status)
+                    throw(std::runtime_error("Truncated zstd archive"));
+                return false;
+            }
+            inBuffer = ZSTD_inBuffer{input, static_cast<size_t>(archive.gcount()), 0};
+        }
+        if (frameStart)
+        {
+            blocks.push_back(Block{compressedSize,
+                                   uncompressedSize,
+                                   ArchiveIndex::noWindow, 0, {}});
+            frameStart = false;
+        }
+        const auto inPos = inBuffer.pos;
+        char out[inputChunkSize];
+        ZSTD_outBuffer outBuffer{out, sizeof(out), 0};
+        status = ZSTD_decompressStream(stream.get(), &outBuffer, &inBuffer);
+        if (ZSTD_isError(status))
+            throw(std::runtime_error(std::string("Corrupted zstd archive: ") +
+                                     ZSTD_getErrorName(status)));
+        outputFull = outBuffer.pos == outBuffer.size;
+        uncompressedSize += outBuffer.pos;
+        buffer.append(out, outBuffer.pos);
+        compressedSize += inBuffer.pos - inPos;
+        // Frame is complete, next frame may follow
+        if (!status)
+            frameStart = true;
+        return true;
+    }
+
+private:
+    std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> stream;
+    char input[inputChunkSize];
+    ZSTD_inBuffer inBuffer{input, 0, 0};
+    size_t status = 0;
+    bool outputFull = false;
+    bool frameStart = true;
+};
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// Decompression of the archive parts when reading via the index
+//////////////////////////////////////////////////////////////////////////////
+
+class ArchiveReader
+{
+public:
+    explicit ArchiveReader(std::istream &archive) : archive(archive) {}
+    virtual ~ArchiveReader() {}
+    // Restart decompression at the block; window is empty if block does not
+    // require dictionary
+    virtual void seek(const Block &block, std::string_view window) = 0;
+    // Append decompressed data to buffer; return false at the end
+    virtual bool read(std::string &buffer) = 0;
+
+protected:
+    std::istream &archive;
+};
+
+class GzipArchiveReader : public ArchiveReader
+{
+public:
+    explicit GzipArchiveReader(std::istream &archive) : ArchiveReader(archive)
+    {
+        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+            throw(std::runtime_error("Cannot initialise gzip decompression"));
+    }
+    virtual ~GzipArchiveReader() { inflateEnd(&stream); }
+
+    virtual void seek(const Block &block, std::string_view window)
+    {
+        archive.clear();
+        stream.avail_in = 0;
+        if (window.empty())
+        {
+            // Start of gzip member
+            archive.seekg(block.compressedOffset);
+            inflateReset2(&stream, 16 + MAX_WBITS);
+            raw = false;
+            return;
+        }
+        // Checkpoint within deflate stream of a member
+        archive.seekg(block.compressedOffset - (block.bits ? 1 : 0));
+        inflateReset2(&stream, -MAX_WBITS);
+        raw = true;
+        if (block.bits)
+        {
+            const auto c = archive.get();
+            inflatePrime(&stream, block.bits, c >> (8 - block.bits));
+        }
+        inflateSetDictionary(&stream,
+                             reinterpret_cast<const Bytef *>(window.data()),
+                             window.length());
+    }
+
+    virtual bool read(std::string &buffer)
+    {
+        if (!stream.avail_in)
+        {
+            archive.read(input, sizeof(input));
+            if (!archive.gcount())
+                return false;
+            stream.next_in = reinterpret_cast<Bytef *>(input);
+            stream.avail_in = archive.gcount();
+        }
+        char out[inputChunkSize];
+        stream.next_out = reinterpret_cast<Bytef *>(out);
+        stream.avail_out = sizeof(out);
+        const auto status = inflate(&stream, Z_NO_FLUSH);
+        buffer.append(out, sizeof(out) - stream.avail_out);
+        switch (status)
+        {
+        case Z_STREAM_END:
+            // Raw deflate stream started at checkpoint is followed by member
+            // trailer; then next member may follow
+            if (raw)
+                skipInput(8);
+            inflateReset2(&stream, 16 + MAX_WBITS);
+            raw = false;
+            return true;
+        case Z_OK:
+        case Z_BUF_ERROR:
+            return true;
+        default:
+            throw(std::runtime_error("Corrupted gzip archive"));
+        }
+    }
+
+private:
+    void skipInput(size_t size)
+    {
+        const auto skipped = std::min<size_t>(size, stream.avail_in);
+        stream.next_in += skipped;
+        stream.avail_in -= skipped;
+        archive.ignore(size - skipped);
+    }
+
+    z_stream stream{};
+    char input[inputChunkSize];
+    bool raw = false;
+};
+
+#ifdef METAFJSON_ZSTD
+class ZstdArchiveReader : public ArchiveReader
+{
+public:
+    explicit ZstdArchiveReader(std::istream &archive)
+        : ArchiveReader(archive), stream(ZSTD_createDStream(), &ZSTD_freeDStream)
+    {
+        if (!stream)
+            throw(std::runtime_error("Cannot initialise zstd decompression"));
+    }
+
+    virtual void seek(const Block &block, std::string_view window)
+    {
+        (void)window;
+        archive.clear();
+        archive.seekg(block.compressedOffset);
+        ZSTD_DCtx_reset(stream.get(), ZSTD_reset_session_only);
+        inBuffer = ZSTD_inBuffer{input, 0, 0};
+    }
+
+    virtual bool read(std::string &buffer)
+    {
+        if (inBuffer.pos == inBuffer.size)
+        {
+            archive.read(input, sizeof(input));
+            if (!archive.gcount())
+                return false;
+            inBuffer = ZSTD_inBuffer{input, static_cast<size_t>(archive.gcount()), 0};
+        }
+        char out[inputChunkSize];
+        ZSTD_outBuffer outBuffer{out, sizeof(out), 0};
+        const auto status = ZSTD_decompressStream(stream.get(), &outBuffer, &inBuffer);
+        if (ZSTD_isError(status))
+            throw(std::runtime_error(std::string("Corrupted zstd archive: ") +
+                                     ZSTD_getErrorName(status)));
+        buffer.append(out, outBuffer.pos);
+        return true;
+    }
+
+private:
+    std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> stream;
+    char input[inputChunkSize];
+    ZSTD_inBuffer inBuffer{input, 0, 0};
+};
+#endif
+
+bool compareStationTime(const Entry &lhs, const Entry &rhs)
+{
+    if (lhs.station != rhs.station)
+        return lhs.station < rhs.station;
+    return lhs.time < rhs.time;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// ArchiveIndex
+//////////////////////////////////////////////////////////////////////////////
+
+std::string ArchiveIndex::fileName(const std::string &archiveName)
+{
+    return archiveName + ".idx";
+}
+
+void ArchiveIndex::build(std::istream &archive,
+                         std::ostream &index,
+                         Settings::RefDateSource refDateSource,
+                         const RefDate &refDate,
+                         size_t span)
+{
+    if (!span)
+        throw(std::invalid_argument("Index span must not be zero"));
+    const auto format = DecompressedInput::detect(archive);
+    std::unique_ptr<IndexingInput> input;
+    switch (format)
+    {
+    case DecompressedInput::Format::GZIP:
+        input = std::make_unique<GzipIndexingInput>(archive, span);
+        break;
+    case DecompressedInput::Format::ZSTD:
+#ifdef METAFJSON_ZSTD
+        input = std::make_unique<ZstdIndexingInput>(archive);
+        break;
+#else
+        throw(std::runtime_error("Zstd compressed archive is not supported in this build"));
+#endif
+    default:
+        throw(std::invalid_argument("Archive is not gzip or zstd compressed"));
+    }
+
+    std::vector<Entry> entries;
+    std::istream decompressed(input.get());
+    ReportReader reader(decompressed, refDateSource, refDate);
+    for (ReportReader::Report report; reader.next(report);)
+    {
+        const auto key = ReportKey::fromReport(report.text, report.refDate);
+        if (!key.has_value())
+            continue;
+        entries.push_back(Entry{key->station,
+                                0,
+                                key->time,
+                                report.offset,
+                                static_cast<uint32_t>(report.text.length()),
+                                0});
+    }
+    if (!input->error.empty())
+        throw(std::runtime_error(input->error));
+
+    // Entries are read starting from the last block before the entry
+    const auto &blocks = input->blocks;
+    for (auto &e : entries)
+    {
+        const auto next = std::upper_bound(
+            blocks.begin(), blocks.end(), e.offset,
+            [](uint64_t offset, const Block &b) { return offset < b.uncompressedOffset; });
+        e.block = next - blocks.begin() - 1;
+    }
+    std::stable_sort(entries.begin(), entries.end(), compareStationTime);
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrder;
+    header.format = static_cast<uint32_t>(format);
+    header.archiveSize = input->compressedSize;
+    header.blockCount = blocks.size();
+    header.entryCount = entries.size();
+    header.windowCount = input->windows.length() / windowSize;
+    header.blocksOffset = sizeof(Header);
+    header.entriesOffset = header.blocksOffset + blocks.size() * sizeof(Block);
+    header.windowsOffset = header.entriesOffset + entries.size() * sizeof(Entry);
+    index.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    index.write(reinterpret_cast<const char *>(blocks.data()), blocks.size() * sizeof(Block));
+    index.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Entry));
+    index.write(input->windows.data(), input->windows.length());
+    if (!index)
+        throw(std::runtime_error("Cannot write index"));
+}
+
+ArchiveIndex::ArchiveIndex(const std::string &indexFileName) : file(indexFileName)
+{
+    const auto invalid = [&]() {
+        return std::runtime_error(indexFileName + " is not a valid index");
+    };
+    if (file.size() < sizeof(Header))
+        throw(invalid());
+    header = reinterpret_cast<const Header *>(file.data());
+    if (std::memcmp(header->magic, magic, sizeof(magic)) ||
+        header->byteOrder != byteOrder)
+    {
+        throw(invalid());
+    }
+    if (header->version != version)
+        throw(std::runtime_error(indexFileName + " has unsupported index version"));
+    const auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset <= file.size() && count <= (file.size() - offset) / size;
+    };
+    if (!fits(header->blocksOffset, header->blockCount, sizeof(Block)) ||
+        !fits(header->entriesOffset, header->entryCount, sizeof(Entry)) ||
+        !fits(header->windowsOffset, header->windowCount, windowSize))
+    {
+        throw(invalid());
+    }
+    blocks = reinterpret_cast<const Block *>(file.data() + header->blocksOffset);
+    entries = reinterpret_cast<const Entry *>(file.data() + header->entriesOffset);
+    windows = file.data() + header->windowsOffset;
+    for (auto i = 0u; i < header->blockCount; i++)
+    {
+        if (blocks[i].window != noWindow && blocks[i].window >= header->windowCount)
+            throw(invalid());
+    }
+    for (auto i = 0u; i < header->entryCount; i++)
+    {
+        if (entries[i].block >= header->blockCount)
+            throw(invalid());
+    }
+}
+
+std::vector<Entry> ArchiveIndex::select(const std::vector<uint32_t> &stations,
+                                        int64_t from,
+                                        int64_t to) const
+{
+    std::vector<Entry> result;
+    const auto begin = entries;
+    const auto end = entries + header->entryCount;
+    if (stations.empty())
+    {
+        std::copy_if(begin, end, std::back_inserter(result), [&](const Entry &e) {
+            return e.time >= from && e.time <= to;
+        });
+    }
+    for (const auto station : stations)
+    {
+        Entry key{};
+        key.station = station;
+        key.time = from;
+        for (auto e = std::lower_bound(begin, end, key, compareStationTime);
+             e != end && e->station == station && e->time <= to;
+             e++)
+        {
+            result.push_back(*e);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const Entry &lhs, const Entry &rhs) {
+        return lhs.offset < rhs.offset;
+    });
+    return result;
+}
+
+void ArchiveIndex::read(
+    std::istream &archive,
+    const std::vector<Entry> &selected,
+    const std::function<void(const std::string &, const Entry &)> &f) const
+{
+    archive.clear();
+    archive.seekg(0, std::ios::end);
+    if (static_cast<uint64_t>(archive.tellg()) != header->archiveSize)
+        throw(std::runtime_error("Archive does not match the index"));
+
+    std::unique_ptr<ArchiveReader> reader;
+    switch (static_cast<DecompressedInput::Format>(header->format))
+    {
+    case DecompressedInput::Format::GZIP:
+        reader = std::make_unique<GzipArchiveReader>(archive);
+        break;
+#ifdef METAFJSON_ZSTD
+    case DecompressedInput::Format::ZSTD:
+        reader = std::make_unique<ZstdArchiveReader>(archive);
+        break;
+#endif
+    default:
+        throw(std::runtime_error("Archive format is not supported"));
+    }
+
+    // Decompressed data starting at position
+    std::string buffer;
+    uint64_t position = 0;
+    bool started = false;
+    std::string report;
+    for (const auto &entry : selected)
+    {
+        const auto &block = blocks[entry.block];
+        // Restarting is cheaper than decompressing up to the next block
+        if (!started || entry.offset < position ||
+            block.uncompressedOffset > position + buffer.length())
+        {
+            std::string_view window;
+            if (block.window != noWindow)
+                window = std::string_view(windows + block.window * windowSize, windowSize);
+            reader->seek(block, window);
+            buffer.clear();
+            position = block.uncompressedOffset;
+            started = true;
+        }
+        while (true)
+        {
+            // Data before the entry is not kept, so buffer does not grow
+            // when entries are close to each other
+            if (entry.offset > position)
+            {
+                const auto skipped = std::min(entry.offset - position,
+                                              static_cast<uint64_t>(buffer.length()));
+                buffer.erase(0, skipped);
+                position += skipped;
+            }
+            if (position + buffer.length() >= entry.offset + entry.length)
+                break;
+            if (!reader->read(buffer))
+                throw(std::runtime_error("Archive does not match the index"));
+        }
+        report.assign(buffer, entry.offset - position, entry.length);
+        f(report, entry);
+    }
+}
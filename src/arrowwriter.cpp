@@ -0,0 +1,481 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "arrowwriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////////
+// Flatbuffers
+//////////////////////////////////////////////////////////////////////////////
+
+// Append little-endian integer to the buffer (flatbuffers are always
+// little-endian regardless of the host)
+template <typename T>
+void appendLittleEndian(std::string &buffer, T value)
+{
+    const auto v = static_cast<uint64_t>(value);
+    for (auto i = 0u; i < sizeof(T); i++)
+        buffer.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+// Table to be serialised to flatbuffer; fields are identified by their
+// index in the schema (union field occupies two indexes: type and value)
+class FlatTable
+{
+public:
+    template <typename T>
+    FlatTable &scalar(unsigned id, T value)
+    {
+        Field f(id, Field::Kind::SCALAR);
+        appendLittleEndian(f.data, value);
+        fields.push_back(std::move(f));
+        return *this;
+    }
+    FlatTable &table(unsigned id, FlatTable t)
+    {
+        Field f(id, Field::Kind::TABLE);
+        f.tables.push_back(std::move(t));
+        fields.push_back(std::move(f));
+        return *this;
+    }
+    FlatTable &string(unsigned id, std::string_view s)
+    {
+        Field f(id, Field::Kind::STRING);
+        f.data = s;
+        fields.push_back(std::move(f));
+        return *this;
+    }
+    FlatTable &tables(unsigned id, std::vector<FlatTable> t)
+    {
+        Field f(id, Field::Kind::TABLES);
+        f.tables = std::move(t);
+        fields.push_back(std::move(f));
+        return *this;
+    }
+    // Vector of structs with 8-byte alignment, data is already serialised
+    FlatTable &structs(unsigned id, std::string data, size_t count)
+    {
+        Field f(id, Field::Kind::STRUCTS);
+        f.data = std::move(data);
+        f.count = count;
+        fields.push_back(std::move(f));
+        return *this;
+    }
+
+private:
+    friend class FlatBufferWriter;
+    struct Field
+    {
+        enum class Kind
+        {
+            SCALAR,
+            TABLE,
+            STRING,
+            TABLES,
+            STRUCTS
+        };
+        Field(unsigned i, Kind k) : id(i), kind(k) {}
+        // Size of the field within the table
+        size_t inlineSize() const { return kind == Kind::SCALAR ? data.size() : 4; }
+
+        unsigned id;
+        Kind kind;
+        std::string data;
+        size_t count = 0;
+        std::vector<FlatTable> tables;
+    };
+    std::vector<Field> fields;
+};
+
+// Serialises tables front to back: each table is preceded by its vtable and
+// followed by the objects it refers to, so that all offsets point forward
+// as required by flatbuffers
+class FlatBufferWriter
+{
+public:
+    static std::string write(const FlatTable &root)
+    {
+        FlatBufferWriter writer;
+        writer.buffer.resize(sizeof(uint32_t));
+        writer.patchOffset(0, writer.writeTable(root));
+        writer.pad(8);
+        return std::move(writer.buffer);
+    }
+
+private:
+    using Field = FlatTable::Field;
+
+    void pad(size_t alignment)
+    {
+        buffer.resize((buffer.size() + alignment - 1) / alignment * alignment, '\0');
+    }
+    void putUint32(size_t position, uint32_t value)
+    {
+        for (auto i = 0u; i < sizeof(value); i++)
+            buffer[position + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+    void patchOffset(size_t position, size_t target)
+    {
+        putUint32(position, static_cast<uint32_t>(target - position));
+    }
+
+    size_t writeTable(const FlatTable &table)
+    {
+        // Soffset to vtable is followed by fields, larger fields first so
+        // that all fields are aligned by their size
+        std::vector<const Field *> ordered;
+        for (const auto &f : table.fields)
+            ordered.push_back(&f);
+        std::stable_sort(ordered.begin(), ordered.end(), [](auto a, auto b) {
+            return a->inlineSize() > b->inlineSize();
+        });
+        std::vector<std::pair<const Field *, size_t>> layout;
+        size_t tableSize = sizeof(int32_t);
+        unsigned slots = 0;
+        for (const auto f : ordered)
+        {
+            const auto size = f->inlineSize();
+            tableSize = (tableSize + size - 1) / size * size;
+            layout.emplace_back(f, tableSize);
+            tableSize += size;
+            slots = std::max(slots, f->id + 1);
+        }
+
+        pad(2);
+        const auto vtablePosition = buffer.size();
+        std::vector<uint16_t> vtable(slots + 2);
+        vtable[0] = static_cast<uint16_t>(sizeof(uint16_t) * vtable.size());
+        vtable[1] = static_cast<uint16_t>(tableSize);
+        for (const auto &[f, offset] : layout)
+            vtable[f->id + 2] = static_cast<uint16_t>(offset);
+        for (const auto v : vtable)
+            appendLittleEndian(buffer, v);
+
+        pad(8);
+        const auto tablePosition = buffer.size();
+        buffer.resize(tablePosition + tableSize, '\0');
+        putUint32(tablePosition, static_cast<uint32_t>(tablePosition - vtablePosition));
+        for (const auto &[f, offset] : layout)
+        {
+            if (f->kind == Field::Kind::SCALAR)
+                buffer.replace(tablePosition + offset, f->data.size(), f->data);
+        }
+        for (const auto &[f, offset] : layout)
+        {
+            if (f->kind != Field::Kind::SCALAR)
+                patchOffset(tablePosition + offset, writeChild(*f));
+        }
+        return tablePosition;
+    }
+
+    size_t writeChild(const Field &field)
+    {
+        switch (field.kind)
+        {
+        case Field::Kind::TABLE:
+            return writeTable(field.tables.front());
+        case Field::Kind::STRING:
+        {
+            pad(4);
+            const auto position = buffer.size();
+            appendLittleEndian(buffer, static_cast<uint32_t>(field.data.size()));
+            buffer += field.data;
+            buffer.push_back('\0');
+            return position;
+        }
+        case Field::Kind::TABLES:
+        {
+            pad(4);
+            const auto position = buffer.size();
+            appendLittleEndian(buffer, static_cast<uint32_t>(field.tables.size()));
+            const auto offsets = buffer.size();
+            buffer.resize(offsets + sizeof(uint32_t) * field.tables.size(), '\0');
+            for (auto i = 0u; i < field.tables.size(); i++)
+                patchOffset(offsets + sizeof(uint32_t) * i, writeTable(field.tables[i]));
+            return position;
+        }
+        case Field::Kind::STRUCTS:
+        {
+            // Length precedes 8-byte aligned struct data
+            pad(8);
+            buffer.append(sizeof(uint32_t), '\0');
+            const auto position = buffer.size();
+            appendLittleEndian(buffer, static_cast<uint32_t>(field.count));
+            buffer += field.data;
+            return position;
+        }
+        default:
+            throw std::logic_error("Flatbuffer field is not an offset");
+        }
+    }
+
+    std::string buffer;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Arrow IPC messages (see Schema.fbs and Message.fbs in Arrow format
+// specification)
+//////////////////////////////////////////////////////////////////////////////
+
+enum : int16_t
+{
+    METADATA_V5 = 4,
+    ENDIANNESS_LITTLE = 0,
+    ENDIANNESS_BIG = 1,
+    PRECISION_SINGLE = 1,
+    TIME_UNIT_SECOND = 0
+};
+
+enum : uint8_t
+{
+    HEADER_SCHEMA = 1,
+    HEADER_RECORD_BATCH = 3
+};
+
+enum : uint8_t
+{
+    TYPE_INT = 2,
+    TYPE_FLOATING_POINT = 3,
+    TYPE_UTF8 = 5,
+    TYPE_TIMESTAMP = 10,
+    TYPE_LIST = 12
+};
+
+const uint32_t continuationMarker = 0xFFFFFFFF;
+
+bool isLittleEndianHost()
+{
+    const uint16_t value = 1;
+    unsigned char firstByte = 0;
+    std::memcpy(&firstByte, &value, sizeof(firstByte));
+    return firstByte == 1;
+}
+
+FlatTable arrowField(std::string_view name, ArrowWriter::ColumnType type)
+{
+    FlatTable field;
+    field.string(0, name).scalar<uint8_t>(1, true);
+    std::vector<FlatTable> children;
+    switch (type)
+    {
+    case ArrowWriter::ColumnType::STRING:
+        field.scalar<uint8_t>(2, TYPE_UTF8).table(3, FlatTable());
+        break;
+    case ArrowWriter::ColumnType::INT16:
+        field.scalar<uint8_t>(2, TYPE_INT)
+            .table(3, FlatTable().scalar<int32_t>(0, 16).scalar<uint8_t>(1, true));
+        break;
+    case ArrowWriter::ColumnType::FLOAT32:
+        field.scalar<uint8_t>(2, TYPE_FLOATING_POINT)
+            .table(3, FlatTable().scalar<int16_t>(0, PRECISION_SINGLE));
+        break;
+    case ArrowWriter::ColumnType::TIMESTAMP:
+        field.scalar<uint8_t>(2, TYPE_TIMESTAMP)
+            .table(3, FlatTable().scalar<int16_t>(0, TIME_UNIT_SECOND).string(1, "UTC"));
+        break;
+    case ArrowWriter::ColumnType::STRING_LIST:
+        field.scalar<uint8_t>(2, TYPE_LIST).table(3, FlatTable());
+        children.push_back(arrowField("item", ArrowWriter::ColumnType::STRING));
+        break;
+    }
+    field.tables(5, std::move(children));
+    return field;
+}
+
+FlatTable arrowMessage(uint8_t headerType, FlatTable header, int64_t bodyLength)
+{
+    FlatTable message;
+    message.scalar<int16_t>(0, METADATA_V5)
+        .scalar<uint8_t>(1, headerType)
+        .table(2, std::move(header))
+        .scalar<int64_t>(3, bodyLength);
+    return message;
+}
+
+// Encapsulated message: continuation marker, metadata length, metadata
+// padded to 8 bytes, body
+void writeMessage(std::ostream &out, const FlatTable &message, const std::string &body)
+{
+    const auto metadata = FlatBufferWriter::write(message);
+    std::string prefix;
+    appendLittleEndian(prefix, continuationMarker);
+    appendLittleEndian(prefix, static_cast<int32_t>(metadata.size()));
+    out.write(prefix.data(), prefix.size());
+    out.write(metadata.data(), metadata.size());
+    out.write(body.data(), body.size());
+}
+
+template <typename T>
+void appendNative(std::string &buffer, T value)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    buffer.append(bytes, sizeof(T));
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// ArrowWriter
+//////////////////////////////////////////////////////////////////////////////
+
+ArrowWriter::ArrowWriter(std::vector<Column> cols) : columns(std::move(cols))
+{
+    for (const auto &c : columns)
+        builders.emplace_back(c.type);
+}
+
+void ArrowWriter::ColumnBuilder::appendValidity(size_t row, bool valid)
+{
+    if (!(row % 8))
+        validity.push_back('\0');
+    if (valid)
+        validity.back() |= static_cast<char>(1 << (row % 8));
+    else
+        nullCount++;
+}
+
+void ArrowWriter::ColumnBuilder::clear()
+{
+    nullCount = 0;
+    validity.clear();
+    values.clear();
+    offsets.assign(1, 0);
+    itemOffsets.assign(1, 0);
+    itemValues.clear();
+}
+
+void ArrowWriter::appendInt(size_t column, std::optional<int64_t> value)
+{
+    auto &b = builders.at(column);
+    b.appendValidity(rowCount, value.has_value());
+    const auto v = value.value_or(0);
+    if (b.type == ColumnType::INT16)
+        appendNative(b.values, static_cast<int16_t>(v));
+    else
+        appendNative(b.values, static_cast<int64_t>(v));
+}
+
+void ArrowWriter::appendFloat(size_t column, std::optional<float> value)
+{
+    auto &b = builders.at(column);
+    b.appendValidity(rowCount, value.has_value());
+    appendNative(b.values, value.value_or(0.0f));
+}
+
+void ArrowWriter::appendString(size_t column, std::optional<std::string_view> value)
+{
+    auto &b = builders.at(column);
+    b.appendValidity(rowCount, value.has_value());
+    if (value.has_value())
+        b.values += *value;
+    b.offsets.push_back(static_cast<int32_t>(b.values.size()));
+}
+
+void ArrowWriter::appendList(size_t column, const std::vector<std::string> &values)
+{
+    auto &b = builders.at(column);
+    b.appendValidity(rowCount, true);
+    for (const auto &v : values)
+    {
+        b.itemValues += v;
+        b.itemOffsets.push_back(static_cast<int32_t>(b.itemValues.size()));
+    }
+    b.offsets.push_back(static_cast<int32_t>(b.itemOffsets.size() - 1));
+}
+
+void ArrowWriter::writeSchema(std::ostream &out)
+{
+    std::vector<FlatTable> fields;
+    for (const auto &c : columns)
+        fields.push_back(arrowField(c.name, c.type));
+    FlatTable schema;
+    schema.scalar<int16_t>(0, isLittleEndianHost() ? ENDIANNESS_LITTLE : ENDIANNESS_BIG)
+        .tables(1, std::move(fields));
+    writeMessage(out, arrowMessage(HEADER_SCHEMA, std::move(schema), 0), std::string());
+    schemaWritten = true;
+}
+
+void ArrowWriter::writeBatch(std::ostream &out)
+{
+    if (!schemaWritten)
+        writeSchema(out);
+    if (!rowCount)
+        return;
+
+    // Field nodes and buffers are listed in depth-first order of the fields,
+    // each buffer in the body is padded to 8 bytes
+    std::string body, nodes, buffers;
+    size_t nodeCount = 0, bufferCount = 0;
+    auto addNode = [&](size_t length, size_t nulls) {
+        appendLittleEndian(nodes, static_cast<int64_t>(length));
+        appendLittleEndian(nodes, static_cast<int64_t>(nulls));
+        nodeCount++;
+    };
+    auto addBuffer = [&](const void *data, size_t size) {
+        appendLittleEndian(buffers, static_cast<int64_t>(body.size()));
+        appendLittleEndian(buffers, static_cast<int64_t>(size));
+        if (size)
+            body.append(static_cast<const char *>(data), size);
+        body.resize((body.size() + 7) / 8 * 8, '\0');
+        bufferCount++;
+    };
+    for (const auto &b : builders)
+    {
+        addNode(rowCount, b.nullCount);
+        // Validity bitmap may be omitted if there are no nulls
+        addBuffer(b.validity.data(), b.nullCount ? b.validity.size() : 0);
+        switch (b.type)
+        {
+        case ColumnType::STRING:
+            addBuffer(b.offsets.data(), b.offsets.size() * sizeof(int32_t));
+            addBuffer(b.values.data(), b.values.size());
+            break;
+        case ColumnType::INT16:
+        case ColumnType::FLOAT32:
+        case ColumnType::TIMESTAMP:
+            addBuffer(b.values.data(), b.values.size());
+            break;
+        case ColumnType::STRING_LIST:
+            addBuffer(b.offsets.data(), b.offsets.size() * sizeof(int32_t));
+            addNode(b.itemOffsets.size() - 1, 0);
+            addBuffer(nullptr, 0);
+            addBuffer(b.itemOffsets.data(), b.itemOffsets.size() * sizeof(int32_t));
+            addBuffer(b.itemValues.data(), b.itemValues.size());
+            break;
+        }
+    }
+
+    FlatTable recordBatch;
+    recordBatch.scalar<int64_t>(0, rowCount)
+        .structs(1, std::move(nodes), nodeCount)
+        .structs(2, std::move(buffers), bufferCount);
+    writeMessage(out,
+                 arrowMessage(HEADER_RECORD_BATCH, std::move(recordBatch), body.size()),
+                 body);
+
+    for (auto &b : builders)
+        b.clear();
+    rowCount = 0;
+}
+
+void ArrowWriter::finish(std::ostream &out)
+{
+    writeBatch(out);
+    std::string endOfStream;
+    appendLittleEndian(endOfStream, continuationMarker);
+    appendLittleEndian(endOfStream, static_cast<int32_t>(0));
+    out.write(endOfStream.data(), endOfStream.size());
+    out.flush();
+}
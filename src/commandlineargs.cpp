@@ -8,7 +8,9 @@
 
 #include "commandlineargs.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <regex>
 
@@ -16,6 +18,14 @@
 #include "date/date.h"
 
 #include "version.hpp"
+#include "stationfilter.hpp"
+#include "groupfilter.hpp"
+#include "filterexpression.hpp"
+#include "outputformatcsv.hpp"
+#include "utility.hpp"
+#include "compressor.hpp"
+#include "partitionedoutput.hpp"
+#include "eventdetector.hpp"
 
 CommandLineArgs::CommandLineArgs(int argc, char *argv[])
 {
@@ -39,6 +49,35 @@ CommandLineArgs::CommandLineArgs(int argc, char *argv[])
              cxxopts::value<std::string>()->default_value("basic"), 
              "format"
             )
+            ("e, encoding", "Specifies the encoding of data output",
+             cxxopts::value<std::string>()->default_value("json"), 
+             "encoding"
+            )
+            ("compress", "Compress the output; blocks of output are compressed in "
+             "parallel by worker threads",
+             cxxopts::value<std::string>(),
+             "method"
+            )
+            ("compress-level", "Compression level, 1 to 9 for gzip or 1 to 19 for zstd; "
+             "if not specified, default level is used",
+             cxxopts::value<int>(),
+             "level"
+            )
+            ("j, threads", "Number of worker threads; if not specified or 0, number of "
+             "hardware threads is used",
+             cxxopts::value<unsigned>(),
+             "number"
+            )
+            ("columns", "Comma-separated list of columns for csv and tsv output formats; "
+             "supported columns: " + OutputFormatCsv::allColumns(),
+             cxxopts::value<std::string>(),
+             "columns"
+            )
+            ("gust-thresholds", "Comma-separated list of wind gust thresholds in knots for "
+             "events output format; default is 25,35",
+             cxxopts::value<std::string>(),
+             "knots"
+            )
             ("f, refdate", "Specifies the reference date "
             "(i.e. date when this recent report was received) in YYYYMMDD format. "
             "Since month and year are not included in date and time formats used in METAR or TAF, "
@@ -47,12 +86,178 @@ CommandLineArgs::CommandLineArgs(int argc, char *argv[])
              cxxopts::value<std::string>(), 
              "YYYYMMDD"
             )
+            ("refdate-from", "Specifies where the reference date for each report is "
+             "taken from, see below. The reference date specified with --refdate is used "
+             "for the reports where no reference date is available.",
+             cxxopts::value<std::string>()->default_value("fixed"),
+             "source"
+            )
+            ("i, input", "Read reports from the specified file rather than from standard "
+             "input; gzip or zstd compressed files are detected automatically. May be "
+             "specified more than once.",
+             cxxopts::value<std::vector<std::string>>(),
+             "file"
+            )
+            ("s, station", "Only process reports from the specified stations; "
+             "comma-separated list of ICAO locations. May be specified more than once.",
+             cxxopts::value<std::vector<std::string>>(),
+             "list"
+            )
+            ("station-file", "Only process reports from the stations listed in the file "
+             "(ICAO locations separated by whitespace or commas, # starts a comment). "
+             "May be specified more than once.",
+             cxxopts::value<std::vector<std::string>>(),
+             "file"
+            )
+            ("g, groups", "Only include the specified kinds of groups in the output; "
+             "comma-separated list of group names as in JSON output, e.g. "
+             "wind,visibility,cloud",
+             cxxopts::value<std::string>(),
+             "list"
+            )
+            ("where", "Only output reports matching the expression, e.g. "
+             "\"wind_speed > 25 kt or visibility < 1600 m or weather contains TS\", "
+             "see below.",
+             cxxopts::value<std::string>(),
+             "expression"
+            )
+            ("compact", 
+             "Omit values which are not reported from the groups rather than output "
+             "them as null. Only used with basic output format.")
+            ("tuples", 
+             "Serialise each group as an array of values rather than an object; the order "
+             "of values for each group is specified by schema record which is written once "
+             "before the first report. Only used with basic output format.")
             ("w, wrap", 
              "Wrap JSON output into additional layer of JSON to keep certain data, such as "
              "station ICAO code at the beginning of the JSON output and allow easier "
              "sorting and filtering of report batches.")
             ("r, raw", 
              "Add raw report strings to the output.")
+            ("validate",
+             "Only parse reports without converting them to JSON and print statistics "
+             "of report types, errors, groups and stations at the end.")
+            ("failed-lines",
+             "When used with --validate, list line numbers of the reports with errors.")
+            ("build-index",
+             "Only build the index of each gzip or zstd compressed input file, which is "
+             "written to the file with the same name and .idx extension added.")
+            ("use-index",
+             "Read only the reports selected with --station, --station-file, --time-from "
+             "and --time-to using the index of each compressed input file.")
+            ("time-from", "When used with --use-index, only process reports with "
+             "report time not earlier than specified.",
+             cxxopts::value<std::string>(),
+             "YYYYMMDD[HHMM]"
+            )
+            ("time-to", "When used with --use-index, only process reports with "
+             "report time not later than specified (whole day if time is not specified).",
+             cxxopts::value<std::string>(),
+             "YYYYMMDD[HHMM]"
+            )
+            ("output-index", "Write index of the output to the specified file; the index "
+             "allows metafjson-query to read the records of particular stations and time "
+             "range from the output file. Only used with basic output format.",
+             cxxopts::value<std::string>(),
+             "file"
+            )
+            ("emit-parsed", "In addition to the output, write parsed reports to the "
+             "specified file, so that they can be serialised again with different "
+             "settings using --from-parsed.",
+             cxxopts::value<std::string>(),
+             "file"
+            )
+            ("from-parsed", "Read parsed reports from the file written with "
+             "--emit-parsed rather than read and parse input files.",
+             cxxopts::value<std::string>(),
+             "file"
+            )
+            ("also-output", "In addition to the standard output, write the same reports "
+             "to the specified file with its own output, datetime and units format and "
+             "raw strings option, see below. Each report is parsed only once. May be "
+             "specified more than once.",
+             cxxopts::value<std::vector<std::string>>(),
+             "file[,option...]"
+            )
+            ("cache-dir", "Keep the output of converted reports in the cache in the "
+             "specified directory, so that the reports converted with the same settings "
+             "by previous runs are not parsed again. Only used with basic output format.",
+             cxxopts::value<std::string>(),
+             "dir"
+            )
+            ("cache-size", "Size limit of the conversion cache in megabytes; when the "
+             "limit is reached, least recently used reports are removed from the cache. "
+             "Default is 1024.",
+             cxxopts::value<uint64_t>(),
+             "MB"
+            )
+            ("cache-stats", 
+             "Print statistics of the conversion cache to standard error at the end.")
+            ("sort", "Sort the output records by the specified keys; only station,time "
+             "is supported. Only used with basic output format.",
+             cxxopts::value<std::string>(),
+             "keys"
+            )
+            ("sort-memory", "Memory used to sort the output in megabytes; records which "
+             "do not fit are sorted in temporary files. Default is 1024.",
+             cxxopts::value<uint64_t>(),
+             "MB"
+            )
+            ("partition-by", "Write the output records to partition files rather than "
+             "standard output; comma-separated list of partition keys type, date and "
+             "station-hash:N, see below. Only used with basic output format.",
+             cxxopts::value<std::string>(),
+             "keys"
+            )
+            ("partition-path", "Template of the partition file paths, e.g. "
+             "lake/date={date}/type={type}.json, see below.",
+             cxxopts::value<std::string>(),
+             "template"
+            )
+            ("partition-open-files", "Maximum number of partition files open at the same "
+             "time. Default is 64.",
+             cxxopts::value<size_t>(),
+             "number"
+            )
+            ("dedup", 
+             "Remove repeated reports of the same station, report type and report time "
+             "and replace reports by their corrections (COR), see below.")
+            ("dedup-memory", "Memory used to find repeated reports in megabytes; only "
+             "the repeats which are far apart are not removed if the limit is reached. "
+             "Default is 256.",
+             cxxopts::value<uint64_t>(),
+             "MB"
+            )
+            ("latest", 
+             "Only convert the newest report of each station and report type (METAR, "
+             "including SPECI, or TAF), see below.")
+            ("latest-interval", "When used with --latest, write the newest reports "
+             "updated since the previous interval every specified number of seconds "
+             "rather than only at the end.",
+             cxxopts::value<unsigned>(),
+             "seconds"
+            )
+            ("delta", 
+             "Serialise the first report of each station and report type in full and "
+             "each next report as delta from the previous one, see below. Only used with "
+             "basic output format without --tuples.")
+            ("aggregate", 
+             "Rather than convert the reports, write per-station climatology aggregated "
+             "from METAR reports, see below.")
+            ("sketch", 
+             "Rather than convert the reports, write approximate summary of all reports: "
+             "number of distinct stations, quantiles of visibility, ceiling, wind speed "
+             "and temperature and the most frequent weather phenomena, see below.")
+            ("sketch-save", "When used with --sketch, also save the sketches to the "
+             "specified file, so that they can be merged with the sketches of other runs.",
+             cxxopts::value<std::string>(),
+             "file"
+            )
+            ("sketch-merge", "When used with --sketch, merge the sketches saved with "
+             "--sketch-save by previous runs. May be specified more than once.",
+             cxxopts::value<std::vector<std::string>>(),
+             "file"
+            )
             ;
         auto result = options.parse(argc, argv);
 
@@ -84,6 +289,76 @@ CommandLineArgs::CommandLineArgs(int argc, char *argv[])
         if (result.count("datetime"))
             setDateTimeFormat(getDateTimeFormat(result["datetime"].as<std::string>()));
 
+        if (result.count("encoding") > 1)
+            throw(std::runtime_error("Duplicate parameter --encoding or -e"));
+        if (result.count("encoding"))
+            setEncoding(getEncoding(result["encoding"].as<std::string>()));
+
+        if (result.count("also-output"))
+        {
+            std::vector<OutputSpec> specs;
+            for (const auto &spec : result["also-output"].as<std::vector<std::string>>())
+                specs.push_back(getOutputSpec(spec));
+            setAdditionalOutputs(std::move(specs));
+        }
+        // Checks option which only applies to some output formats against 
+        // the formats of main and additional outputs
+        auto anyOutputFormat = [&](std::initializer_list<OutputFormat> formats) {
+            auto matches = [&](OutputFormat f) {
+                return std::find(formats.begin(), formats.end(), f) != formats.end();
+            };
+            if (matches(outputFormat())) return true;
+            for (const auto &spec : additionalOutputs())
+                if (matches(spec.outputFormat)) return true;
+            return false;
+        };
+        if (encoding() != Encoding::JSON && 
+            anyOutputFormat({OutputFormat::ARROW, OutputFormat::CSV, OutputFormat::TSV}))
+        {
+            throw(std::runtime_error("Encoding cannot be specified for arrow, csv or tsv output format"));
+        }
+
+        if (result.count("compress") > 1)
+            throw(std::runtime_error("Duplicate parameter --compress"));
+        if (result.count("compress"))
+            setCompression(getCompression(result["compress"].as<std::string>()));
+
+        if (result.count("compress-level") > 1)
+            throw(std::runtime_error("Duplicate parameter --compress-level"));
+        if (result.count("compress-level"))
+        {
+            if (compression() == Compression::NONE)
+                throw(std::runtime_error("Compression level requires --compress"));
+            setCompressionLevel(result["compress-level"].as<int>());
+            // Throws if level is out of range for the compression
+            util::makeCompressor(*this);
+        }
+
+        if (result.count("threads") > 1)
+            throw(std::runtime_error("Duplicate parameter --threads or -j"));
+        if (result.count("threads"))
+            setThreads(result["threads"].as<unsigned>());
+
+        if (result.count("columns") > 1)
+            throw(std::runtime_error("Duplicate parameter --columns"));
+        if (result.count("columns"))
+        {
+            if (!anyOutputFormat({OutputFormat::CSV, OutputFormat::TSV}))
+                throw(std::runtime_error("Columns can only be specified for csv or tsv output format"));
+            const auto columnList = result["columns"].as<std::string>();
+            OutputFormatCsv::checkColumns(columnList);
+            setColumns(columnList);
+        }
+
+        if (result.count("gust-thresholds") > 1)
+            throw(std::runtime_error("Duplicate parameter --gust-thresholds"));
+        if (result.count("gust-thresholds"))
+        {
+            if (!anyOutputFormat({OutputFormat::EVENTS}))
+                throw(std::runtime_error("Gust thresholds can only be specified for events output format"));
+            setGustThresholds(getGustThresholds(result["gust-thresholds"].as<std::string>()));
+        }
+
         if (result.count("refdate") > 1)
             throw(std::runtime_error("Duplicate parameter --refdate or -f"));
         if (result.count("refdate"))
@@ -91,8 +366,302 @@ CommandLineArgs::CommandLineArgs(int argc, char *argv[])
         else
             Settings::setRefDate();
 
+        if (result.count("refdate-from") > 1)
+            throw(std::runtime_error("Duplicate parameter --refdate-from"));
+        if (result.count("refdate-from"))
+            setRefDateSource(getRefDateSource(result["refdate-from"].as<std::string>()));
+
+        if (result.count("input"))
+            setInputFiles(result["input"].as<std::vector<std::string>>());
+        if (refDateSource() == RefDateSource::FILENAME && inputFiles().empty())
+            throw(std::runtime_error("Reference date from file name requires --input"));
+
+        if (result.count("station"))
+        {
+            const auto stationLists = result["station"].as<std::vector<std::string>>();
+            StationFilter filter;
+            for (const auto &list : stationLists)
+                filter.addStations(std::string_view(list));
+            setStations(stationLists);
+        }
+        if (result.count("station-file"))
+            setStationFiles(result["station-file"].as<std::vector<std::string>>());
+
+        if (result.count("groups") > 1)
+            throw(std::runtime_error("Duplicate parameter --groups or -g"));
+        if (result.count("groups"))
+        {
+            const auto groupList = result["groups"].as<std::string>();
+            GroupFilter filter(groupList);
+            setGroups(groupList);
+        }
+
+        if (result.count("where") > 1)
+            throw(std::runtime_error("Duplicate parameter --where"));
+        if (result.count("where"))
+        {
+            const auto expression = result["where"].as<std::string>();
+            FilterExpression filter(expression);
+            setFilter(expression);
+        }
+
+        if (result.count("compact"))
+        {
+            if (!anyOutputFormat({OutputFormat::BASIC}))
+                throw(std::runtime_error("Compact can only be used with basic output format"));
+            setCompact();
+        }
+        if (result.count("tuples"))
+        {
+            if (!anyOutputFormat({OutputFormat::BASIC}))
+                throw(std::runtime_error("Tuples can only be used with basic output format"));
+            setTupleGroups();
+        }
         if (result.count("wrap")) setWrapJson();
         if (result.count("raw")) setRawStrings();
+        if (result.count("validate")) setValidate();
+        if (result.count("failed-lines") && !result.count("validate"))
+            throw(std::runtime_error("Failed lines require --validate"));
+        if (result.count("failed-lines")) setListFailedLines();
+
+        if (result.count("build-index") && result.count("use-index"))
+            throw(std::runtime_error("Index cannot be both built and used"));
+        if ((result.count("build-index") || result.count("use-index")) && inputFiles().empty())
+            throw(std::runtime_error("Index requires --input"));
+        if (result.count("build-index") && compression() != Compression::NONE)
+            throw(std::runtime_error("Compression cannot be used with --build-index"));
+        if (result.count("build-index")) setBuildIndex();
+        if (result.count("use-index")) setUseIndex();
+
+        if (result.count("time-from") > 1)
+            throw(std::runtime_error("Duplicate parameter --time-from"));
+        if (result.count("time-to") > 1)
+            throw(std::runtime_error("Duplicate parameter --time-to"));
+        if ((result.count("time-from") || result.count("time-to")) && !useIndex())
+            throw(std::runtime_error("Time range requires --use-index"));
+        if (result.count("output-index") > 1)
+            throw(std::runtime_error("Duplicate parameter --output-index"));
+        if (result.count("output-index"))
+        {
+            if (outputFormat() != OutputFormat::BASIC || tupleGroups())
+                throw(std::runtime_error("Output index can only be used with basic output format without --tuples"));
+            if (compression() != Compression::NONE)
+                throw(std::runtime_error("Output index cannot be used with --compress"));
+            if (validate() || buildIndex())
+                throw(std::runtime_error("Output index requires output"));
+            setOutputIndex(result["output-index"].as<std::string>());
+        }
+
+        if (result.count("emit-parsed") > 1)
+            throw(std::runtime_error("Duplicate parameter --emit-parsed"));
+        if (result.count("from-parsed") > 1)
+            throw(std::runtime_error("Duplicate parameter --from-parsed"));
+        if ((result.count("emit-parsed") || result.count("from-parsed")) && 
+            (validate() || buildIndex()))
+        {
+            throw(std::runtime_error("Parsed reports cannot be used with --validate or --build-index"));
+        }
+        if (result.count("emit-parsed") && result.count("from-parsed"))
+            throw(std::runtime_error("Parsed reports cannot be both written and read"));
+        if (result.count("from-parsed") && !inputFiles().empty())
+            throw(std::runtime_error("Input files cannot be used with --from-parsed"));
+        if (!additionalOutputs().empty() && (validate() || buildIndex()))
+            throw(std::runtime_error("Additional outputs cannot be used with --validate or --build-index"));
+
+        if (result.count("cache-dir") > 1)
+            throw(std::runtime_error("Duplicate parameter --cache-dir"));
+        if (result.count("cache-size") > 1)
+            throw(std::runtime_error("Duplicate parameter --cache-size"));
+        if ((result.count("cache-size") || result.count("cache-stats")) && !result.count("cache-dir"))
+            throw(std::runtime_error("Cache size and statistics require --cache-dir"));
+        if (result.count("cache-dir"))
+        {
+            // Cached output is written without parsing the report
+            if (outputFormat() != OutputFormat::BASIC || tupleGroups())
+                throw(std::runtime_error("Cache can only be used with basic output format without --tuples"));
+            if (validate() || buildIndex())
+                throw(std::runtime_error("Cache requires output"));
+            if (result.count("emit-parsed") || result.count("from-parsed") || 
+                !additionalOutputs().empty())
+            {
+                throw(std::runtime_error("Cache cannot be used with parsed reports or additional outputs"));
+            }
+            setCacheDir(result["cache-dir"].as<std::string>());
+        }
+        if (result.count("cache-size"))
+        {
+            const auto size = result["cache-size"].as<uint64_t>();
+            if (!size)
+                throw(std::runtime_error("Cache size must be greater than zero"));
+            setCacheSize(size);
+        }
+        if (result.count("cache-stats")) setCacheStats();
+
+        if (result.count("sort") > 1)
+            throw(std::runtime_error("Duplicate parameter --sort"));
+        if (result.count("sort-memory") > 1)
+            throw(std::runtime_error("Duplicate parameter --sort-memory"));
+        if (result.count("sort-memory") && !result.count("sort"))
+            throw(std::runtime_error("Sort memory requires --sort"));
+        if (result.count("sort"))
+        {
+            const auto keys = result["sort"].as<std::string>();
+            if (keys != "station,time")
+                throw(std::runtime_error("Sort keys " + keys + " are not supported"));
+            // Records are sorted by the key of the report text
+            if (outputFormat() != OutputFormat::BASIC || tupleGroups())
+                throw(std::runtime_error("Sort can only be used with basic output format without --tuples"));
+            if (validate() || buildIndex())
+                throw(std::runtime_error("Sort requires output"));
+            if (!additionalOutputs().empty())
+                throw(std::runtime_error("Sort cannot be used with additional outputs"));
+            setSortOutput();
+        }
+        if (result.count("sort-memory"))
+        {
+            const auto memory = result["sort-memory"].as<uint64_t>();
+            if (!memory)
+                throw(std::runtime_error("Sort memory must be greater than zero"));
+            setSortMemory(memory);
+        }
+
+        if (result.count("partition-by") > 1)
+            throw(std::runtime_error("Duplicate parameter --partition-by"));
+        if (result.count("partition-path") > 1)
+            throw(std::runtime_error("Duplicate parameter --partition-path"));
+        if (result.count("partition-open-files") > 1)
+            throw(std::runtime_error("Duplicate parameter --partition-open-files"));
+        if (result.count("partition-by") != result.count("partition-path"))
+            throw(std::runtime_error("Partitioned output requires both --partition-by and --partition-path"));
+        if (result.count("partition-open-files") && !result.count("partition-by"))
+            throw(std::runtime_error("Number of open files requires --partition-by"));
+        if (result.count("partition-by"))
+        {
+            const auto keys = result["partition-by"].as<std::string>();
+            const auto path = result["partition-path"].as<std::string>();
+            // Throws if keys or path template are not valid
+            (void)Partitioning(keys, path);
+            if (outputFormat() != OutputFormat::BASIC || tupleGroups())
+                throw(std::runtime_error("Partitioned output can only be used with basic output format without --tuples"));
+            if (validate() || buildIndex())
+                throw(std::runtime_error("Partitioned output requires output"));
+            if (!outputIndex().empty() || sortOutput() || !cacheDir().empty())
+                throw(std::runtime_error("Partitioned output cannot be used with --output-index, --sort or --cache-dir"));
+            setPartitioning(keys, path);
+        }
+        if (result.count("partition-open-files"))
+        {
+            const auto files = result["partition-open-files"].as<size_t>();
+            if (!files)
+                throw(std::runtime_error("Number of open files must be greater than zero"));
+            setPartitionOpenFiles(files);
+        }
+
+        if (result.count("dedup-memory") > 1)
+            throw(std::runtime_error("Duplicate parameter --dedup-memory"));
+        if (result.count("dedup-memory") && !result.count("dedup"))
+            throw(std::runtime_error("Dedup memory requires --dedup"));
+        if (result.count("dedup"))
+        {
+            // Reports are removed before they are parsed
+            if (buildIndex() || result.count("from-parsed"))
+                throw(std::runtime_error("Dedup cannot be used with --build-index or --from-parsed"));
+            setDedup();
+        }
+        if (result.count("dedup-memory"))
+        {
+            const auto memory = result["dedup-memory"].as<uint64_t>();
+            if (!memory)
+                throw(std::runtime_error("Dedup memory must be greater than zero"));
+            setDedupMemory(memory);
+        }
+
+        if (result.count("latest-interval") > 1)
+            throw(std::runtime_error("Duplicate parameter --latest-interval"));
+        if (result.count("latest-interval") && !result.count("latest"))
+            throw(std::runtime_error("Interval requires --latest"));
+        if (result.count("latest"))
+        {
+            if (validate() || buildIndex() || result.count("from-parsed"))
+                throw(std::runtime_error("Newest reports cannot be used with --validate, --build-index or --from-parsed"));
+            if (dedup())
+                throw(std::runtime_error("Newest reports cannot be used with --dedup"));
+            setLatest();
+        }
+        if (result.count("latest-interval"))
+            setLatestInterval(result["latest-interval"].as<unsigned>());
+
+        if (result.count("delta"))
+        {
+            // Changed fields are keyed by name, so groups cannot be arrays
+            if (outputFormat() != OutputFormat::BASIC || tupleGroups())
+                throw(std::runtime_error("Delta can only be used with basic output format without --tuples"));
+            if (validate() || buildIndex())
+                throw(std::runtime_error("Delta requires output"));
+            // Delta depends on the order of reports and on the previous reports
+            if (sortOutput() || !partitionBy().empty() || !cacheDir().empty())
+                throw(std::runtime_error("Delta cannot be used with --sort, --partition-by or --cache-dir"));
+            setDelta();
+        }
+
+        if (result.count("aggregate"))
+        {
+            // Aggregated records are written instead of the converted reports
+            if (outputFormat() != OutputFormat::BASIC || tupleGroups() || delta())
+                throw(std::runtime_error("Aggregate cannot be used with --output, --tuples or --delta"));
+            if (validate() || buildIndex() || latest())
+                throw(std::runtime_error("Aggregate cannot be used with --validate, --build-index or --latest"));
+            if (sortOutput() || !partitionBy().empty() || !cacheDir().empty() || !outputIndex().empty())
+                throw(std::runtime_error("Aggregate cannot be used with --sort, --partition-by, --cache-dir or --output-index"));
+            if (result.count("emit-parsed") || result.count("from-parsed") || 
+                !additionalOutputs().empty())
+            {
+                throw(std::runtime_error("Aggregate cannot be used with parsed reports or additional outputs"));
+            }
+            setAggregate();
+        }
+
+        if (result.count("sketch-save") > 1)
+            throw(std::runtime_error("Duplicate parameter --sketch-save"));
+        if ((result.count("sketch-save") || result.count("sketch-merge")) && 
+            !result.count("sketch"))
+        {
+            throw(std::runtime_error("Saving or merging sketches requires --sketch"));
+        }
+        if (result.count("sketch"))
+        {
+            // Summary is written instead of the converted reports
+            if (outputFormat() != OutputFormat::BASIC || tupleGroups() || delta())
+                throw(std::runtime_error("Sketch cannot be used with --output, --tuples or --delta"));
+            if (validate() || buildIndex() || latest() || aggregate())
+                throw(std::runtime_error("Sketch cannot be used with --validate, --build-index, --latest or --aggregate"));
+            if (sortOutput() || !partitionBy().empty() || !cacheDir().empty() || !outputIndex().empty())
+                throw(std::runtime_error("Sketch cannot be used with --sort, --partition-by, --cache-dir or --output-index"));
+            if (result.count("emit-parsed") || result.count("from-parsed") || 
+                !additionalOutputs().empty())
+            {
+                throw(std::runtime_error("Sketch cannot be used with parsed reports or additional outputs"));
+            }
+            setSketch();
+        }
+        if (result.count("sketch-save"))
+            setSketchSave(result["sketch-save"].as<std::string>());
+        if (result.count("sketch-merge"))
+            setSketchMerge(result["sketch-merge"].as<std::vector<std::string>>());
+
+        if (result.count("emit-parsed"))
+            setEmitParsed(result["emit-parsed"].as<std::string>());
+        if (result.count("from-parsed"))
+            setFromParsed(result["from-parsed"].as<std::string>());
+
+        if (result.count("time-from") || result.count("time-to"))
+        {
+            setTimeRange(
+                result.count("time-from") ? 
+                    getTime(result["time-from"].as<std::string>(), false) : timeFrom(),
+                result.count("time-to") ? 
+                    getTime(result["time-to"].as<std::string>(), true) : timeTo());
+        }
 
         setStatus(Status::CONTINUE);
     }
@@ -133,6 +702,19 @@ void CommandLineArgs::displayHelp(std::string commandLineArgsHelp)
 //    std::cout << "              forecast." << std::endl;
 //    std::cout << " h or hourly: similar to 'simple' except hourly forecast is produces instead of" << std::endl;
 //    std::cout << "              trends." << std::endl;
+    std::cout << " a or arrow: Apache Arrow IPC stream with one row per report and columns station," << std::endl;
+    std::cout << "             time, type, wind_dir, wind_kt, gust_kt, vis_m, ceiling_ft, temp_c," << std::endl;
+    std::cout << "             dewpt_c, qnh_hpa, clouds and weather." << std::endl;
+    std::cout << " csv: comma-separated values with one row per report; the columns are" << std::endl;
+    std::cout << "      selected with --columns option, by default all columns listed for" << std::endl;
+    std::cout << "      arrow format are included." << std::endl;
+    std::cout << " tsv: same as csv but tab-separated." << std::endl;
+    std::cout << " events: significant changes between consecutive METAR and SPECI of the same" << std::endl;
+    std::cout << "         station with one record per change: flight category transitions," << std::endl;
+    std::cout << "         wind gust reaching or dropping below the thresholds specified with" << std::endl;
+    std::cout << "         --gust-thresholds, and onset or cessation of TS, FZRA or SN. The first" << std::endl;
+    std::cout << "         report of each station and reports older than the previous one of" << std::endl;
+    std::cout << "         the same station produce no records; TAF are not used." << std::endl;
     std::cout << std::endl;
 
     std::cout << "The date and time output formats (specified with --datetime option):" << std::endl;
@@ -152,6 +734,155 @@ void CommandLineArgs::displayHelp(std::string commandLineArgsHelp)
     std::cout << " a or all: include values in all supported measurement units." << std::endl;
     std::cout << std::endl;
 
+    std::cout << "The data output encodings (specified with --encoding option):" << std::endl;
+    std::cout << " j or json: text JSON, one report per line." << std::endl;
+    std::cout << " c or cbor: CBOR, each report is preceded by its length in bytes (32-bit" << std::endl;
+    std::cout << "            big-endian unsigned integer)." << std::endl;
+    std::cout << " m or msgpack: MessagePack, each report is preceded by its length in bytes" << std::endl;
+    std::cout << "               (32-bit big-endian unsigned integer)." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "The output compression methods (specified with --compress option):" << std::endl;
+    std::cout << " gzip: multi-member gzip, each member holds a block of output." << std::endl;
+    std::cout << " zstd: multi-frame zstd, each frame holds a block of output (only if" << std::endl;
+    std::cout << "       the program is built with zstd support)." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "The reference date sources (specified with --refdate-from option):" << std::endl;
+    std::cout << " fixed: use the date specified with --refdate (or today) for all reports." << std::endl;
+    std::cout << " t or timestamp: use timestamp line in format YYYY/MM/DD HH:MM preceding the" << std::endl;
+    std::cout << "                 reports (as in files distributed by NOAA)." << std::endl;
+    std::cout << " n or filename: use date in format YYYYMMDD, YYYY-MM-DD or YYYY_MM_DD included" << std::endl;
+    std::cout << "                in the input file name (requires --input)." << std::endl;
+    std::cout << " c or column: use date in format YYYYMMDD, YYYY-MM-DD or YYYY/MM/DD specified" << std::endl;
+    std::cout << "              in an extra tab-separated column before each report." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Large compressed archives are indexed once with --build-index, for example:" << std::endl;
+    std::cout << "metafjson --build-index -i metar-2020.txt.gz --refdate-from column" << std::endl;
+    std::cout << "Then reports of particular stations and time range are read with --use-index" << std::endl;
+    std::cout << "decompressing only the parts of the archive which contain them:" << std::endl;
+    std::cout << "metafjson --use-index -i metar-2020.txt.gz -s EGLL --time-from 20200301" << std::endl;
+    std::cout << "The index must be rebuilt if the archive is changed." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Converted output is indexed with --output-index, for example:" << std::endl;
+    std::cout << "metafjson -i metar.txt --output-index metar.json.idx > metar.json" << std::endl;
+    std::cout << "Then the records are read with metafjson-query, for example:" << std::endl;
+    std::cout << "metafjson-query -i metar.json -x metar.json.idx -s EGLL --time-from 20200301" << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Reports parsed once may be serialised many times with different settings:" << std::endl;
+    std::cout << "metafjson -i metar.txt --emit-parsed metar.parsed > metar.json" << std::endl;
+    std::cout << "metafjson --from-parsed metar.parsed -u all -d unix > metar-all-units.json" << std::endl;
+    std::cout << "The file written by --emit-parsed can only be read by metafjson built with" << std::endl;
+    std::cout << "the same version of metaf library." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Several outputs are written from the same parsed reports with --also-output," << std::endl;
+    std::cout << "for example:" << std::endl;
+    std::cout << "metafjson -i metar.txt --also-output metar-unix.json,d=unix,u=all \\" << std::endl;
+    std::cout << "    --also-output metar-raw.json,raw > metar.json" << std::endl;
+    std::cout << "Options of additional output (unspecified options are basic, other settings" << std::endl;
+    std::cout << "are the same as for the standard output):" << std::endl;
+    std::cout << " o=format or output=format: data output format." << std::endl;
+    std::cout << " d=format or datetime=format: date and time format." << std::endl;
+    std::cout << " u=format or units=format: measurement units." << std::endl;
+    std::cout << " r or raw: add raw report strings to the output." << std::endl;
+    std::cout << "Additional outputs are serialised by worker threads and compressed if" << std::endl;
+    std::cout << "--compress is specified." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Repeated conversions of overlapping inputs are sped up with --cache-dir," << std::endl;
+    std::cout << "for example:" << std::endl;
+    std::cout << "metafjson -i metar.txt --refdate-from timestamp --cache-dir ~/.metafjson" << std::endl;
+    std::cout << "Reports are found in the cache by report text, reference date and the" << std::endl;
+    std::cout << "settings which affect the output. Only one program may use the cache" << std::endl;
+    std::cout << "directory at a time." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Output records are sorted by station and report time with --sort, e.g.:" << std::endl;
+    std::cout << "metafjson -i metar-*.txt.gz --sort station,time --sort-memory 512 > metar.json" << std::endl;
+    std::cout << "Records which do not fit into --sort-memory are sorted in temporary files" << std::endl;
+    std::cout << "created in the directory specified by TMPDIR (or /tmp). Records of the same" << std::endl;
+    std::cout << "station and time keep the input order; records of the reports without" << std::endl;
+    std::cout << "station or time are written last." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Output records are written to partition files with --partition-by and" << std::endl;
+    std::cout << "--partition-path, for example:" << std::endl;
+    std::cout << "metafjson -i metar.txt --partition-by date,type \\" << std::endl;
+    std::cout << "    --partition-path \"lake/date={date}/type={type}.json\"" << std::endl;
+    std::cout << "Partition keys and placeholders of the path template:" << std::endl;
+    std::cout << " type: {type} is report type, metar, speci or taf." << std::endl;
+    std::cout << " date: {date} is report date in YYYY-MM-DD format." << std::endl;
+    std::cout << " station-hash:N: {hash} is 0 to N-1, hash of the station ICAO location." << std::endl;
+    std::cout << "If the value cannot be determined from the report, unknown is used." << std::endl;
+    std::cout << "Partition files are overwritten and their directories are created as needed." << std::endl;
+    std::cout << "Records are buffered for each partition and written by worker threads, and" << std::endl;
+    std::cout << "compressed if --compress is specified." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Re-transmitted reports are removed with --dedup: a report is removed if a" << std::endl;
+    std::cout << "previous report has the same station, report type, report time and groups" << std::endl;
+    std::cout << "(separators and terminating = are ignored). A correction (COR) replaces the" << std::endl;
+    std::cout << "report of the same station, type and time if it follows within 10000 reports;" << std::endl;
+    std::cout << "the reports are written with this delay." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Only the newest METAR or SPECI and the newest TAF of each station are" << std::endl;
+    std::cout << "converted with --latest. For a continuous feed, reports updated since the" << std::endl;
+    std::cout << "previous interval are written periodically, for example:" << std::endl;
+    std::cout << "tail -f feed.txt | metafjson --latest --latest-interval 60" << std::endl;
+    std::cout << "The interval is checked when a report is read. A report replaces the one of" << std::endl;
+    std::cout << "the same station and type if its report time is the same or later." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "With --delta, each report after the first one of the same station and report" << std::endl;
+    std::cout << "type only includes the changes from the previous report, for example:" << std::endl;
+    std::cout << "{\"report\":{\"type\":\"metar\"},\"delta\":{\"location\":\"EGYP\",\"removed\":[]," << std::endl;
+    std::cout << "\"added\":[{\"index\":5,\"group\":{\"group\":\"weather\",...}}],\"changed\":" << std::endl;
+    std::cout << "[{\"index\":2,\"fields\":{\"report_time\":{...}}}]}}" << std::endl;
+    std::cout << "Report fields which changed are included and removed ones are null. Groups" << std::endl;
+    std::cout << "at the removed indices of the previous report are deleted, then added groups" << std::endl;
+    std::cout << "are inserted at their indices to obtain the groups of this report; changed" << std::endl;
+    std::cout << "groups (indices in this report) include the fields which changed, removed" << std::endl;
+    std::cout << "fields are null. Additional outputs (--also-output) are written in full." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "With --aggregate, one record is written per station with the climatology of" << std::endl;
+    std::cout << "the observed conditions of its METAR reports (SPECI and TAF are not used):" << std::endl;
+    std::cout << "count, min, max, mean and standard deviation of temperature and QNH, wind rose" << std::endl;
+    std::cout << "of 16 direction sectors and speed bins, number of hours with precipitation," << std::endl;
+    std::cout << "and 10th, 25th, 50th, 75th and 90th percentiles of ceiling and visibility." << std::endl;
+    std::cout << "Ceiling percentile is null if ceiling is unlimited. Reports are aggregated by" << std::endl;
+    std::cout << "worker threads; --dedup may be used to remove repeated reports first." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "With --sketch, a single record summarising all reports is written:" << std::endl;
+    std::cout << "{\"reports\":120000,\"stations\":812,\"visibility_m\":{\"count\":...," << std::endl;
+    std::cout << "\"min\":0,\"p5\":...,\"p99\":...,\"max\":10000},...,\"weather\":[{\"weather\":" << std::endl;
+    std::cout << "\"RA\",\"count\":9000},...]}" << std::endl;
+    std::cout << "Values are estimated with fixed-size sketches, so huge archives are summarised" << std::endl;
+    std::cout << "in bounded memory: distinct stations are counted with HyperLogLog (about 1%" << std::endl;
+    std::cout << "error), quantiles are estimated with t-digest and weather phenomena counts" << std::endl;
+    std::cout << "with count-min sketch (counts are never underestimated). Stations are counted" << std::endl;
+    std::cout << "from all reports, other values from METAR reports only. Sketches saved with" << std::endl;
+    std::cout << "--sketch-save are merged with --sketch-merge, for example to combine the" << std::endl;
+    std::cout << "partial results of different archives; use empty input (e.g. < /dev/null) to" << std::endl;
+    std::cout << "only merge the saved sketches." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "The filter expressions (specified with --where option) compare fields with" << std::endl;
+    std::cout << "values using <, <=, >, >=, = or != and combine comparisons with and, or, not" << std::endl;
+    std::cout << "and parentheses. Fields and default units:" << std::endl;
+    std::cout << " wind_speed, gust_speed (kt, also mps, kmh, mph); wind_direction (deg);" << std::endl;
+    std::cout << " visibility (m, also km, sm, ft); ceiling, cloud_height (ft, also m);" << std::endl;
+    std::cout << " temperature, dew_point (c, also f); pressure (hpa, also inhg, mmhg)." << std::endl;
+    std::cout << "Weather phenomena are checked with 'weather contains CODE', e.g. TS or +FZRA;" << std::endl;
+    std::cout << "weather in vicinity or recent weather only matches if named, e.g. VCTS, RETS." << std::endl;
+    std::cout << std::endl;
+
     std::cout << "Please refer to https://gitlab.com/nnaumenko/metafjson/ for documentation, " << std::endl;
     std::cout << "more examples, and JSON output specification." << std::endl;
 }
@@ -162,9 +893,47 @@ CommandLineArgs::OutputFormat CommandLineArgs::getOutputFormat(std::string forma
     if (format == "collated" || format == "c") return OutputFormat::COLLATED;
     if (format == "simple" || format == "s") return OutputFormat::SIMPLE; 
     if (format == "hourly" || format == "h") return OutputFormat::HOURLY; 
+    if (format == "arrow" || format == "a") return OutputFormat::ARROW; 
+    if (format == "csv") return OutputFormat::CSV; 
+    if (format == "tsv") return OutputFormat::TSV; 
+    if (format == "events") return OutputFormat::EVENTS; 
     throw (std::runtime_error("Output data format " + format + " is not recognised"));
 }
 
+CommandLineArgs::OutputSpec CommandLineArgs::getOutputSpec(std::string spec)
+{
+    OutputSpec result;
+    std::stringstream ss(spec);
+    std::getline(ss, result.file, ',');
+    if (result.file.empty())
+        throw(std::runtime_error("File name must be specified for additional output " + spec));
+    for (std::string option; std::getline(ss, option, ','); )
+    {
+        const auto separator = option.find('=');
+        const auto name = option.substr(0, separator);
+        const auto value = separator == std::string::npos ? 
+            std::string() : option.substr(separator + 1);
+        if (name == "raw" || name == "r")
+        {
+            if (separator != std::string::npos)
+                throw(std::runtime_error("Option raw of additional output has no value"));
+            result.includeRawStrings = true;
+            continue;
+        }
+        if (separator == std::string::npos)
+            throw(std::runtime_error("Option " + name + " of additional output requires value"));
+        if (name == "output" || name == "o")
+            result.outputFormat = getOutputFormat(value);
+        else if (name == "datetime" || name == "d")
+            result.dateTimeFormat = getDateTimeFormat(value);
+        else if (name == "units" || name == "u")
+            result.unitFormat = getUnitFormat(value);
+        else
+            throw(std::runtime_error("Option " + name + " of additional output is not recognised"));
+    }
+    return result;
+}
+
 CommandLineArgs::DateTimeFormat CommandLineArgs::getDateTimeFormat(std::string format)
 {
     if (format == "basic" || format == "b") return DateTimeFormat::BASIC; 
@@ -180,6 +949,53 @@ CommandLineArgs::UnitFormat CommandLineArgs::getUnitFormat(std::string format)
     throw (std::runtime_error("Unit format " + format + " is not recognised"));
 }
 
+CommandLineArgs::Encoding CommandLineArgs::getEncoding(std::string encoding)
+{
+    if (encoding == "json" || encoding == "j") return Encoding::JSON;
+    if (encoding == "cbor" || encoding == "c") return Encoding::CBOR;
+    if (encoding == "msgpack" || encoding == "m") return Encoding::MSGPACK;
+    throw (std::runtime_error("Output encoding " + encoding + " is not recognised"));
+}
+
+CommandLineArgs::Compression CommandLineArgs::getCompression(std::string compression)
+{
+    if (compression == "gzip") return Compression::GZIP;
+#ifdef METAFJSON_ZSTD
+    if (compression == "zstd") return Compression::ZSTD;
+#else
+    if (compression == "zstd")
+        throw (std::runtime_error("Compression zstd is not supported in this build"));
+#endif
+    throw (std::runtime_error("Compression " + compression + " is not recognised"));
+}
+
+CommandLineArgs::RefDateSource CommandLineArgs::getRefDateSource(std::string source)
+{
+    if (source == "fixed" || source == "f") return RefDateSource::FIXED;
+    if (source == "timestamp" || source == "t") return RefDateSource::TIMESTAMP;
+    if (source == "filename" || source == "n") return RefDateSource::FILENAME;
+    if (source == "column" || source == "c") return RefDateSource::COLUMN;
+    throw (std::runtime_error("Reference date source " + source + " is not recognised"));
+}
+
+std::vector<unsigned> CommandLineArgs::getGustThresholds(std::string thresholds)
+{
+    static const std::regex threshold("[1-9][0-9]{0,2}");
+    std::vector<unsigned> result;
+    std::stringstream ss(thresholds);
+    for (std::string t; std::getline(ss, t, ','); )
+    {
+        if (!std::regex_match(t, threshold))
+            throw(std::runtime_error("Gust threshold " + t + " is not valid"));
+        result.push_back(std::stoul(t));
+    }
+    if (result.empty())
+        throw(std::runtime_error("Gust thresholds must be specified"));
+    // Throws if there are too many thresholds
+    (void)EventDetector(result);
+    return result;
+}
+
 void CommandLineArgs::setRefDate(std::string yyyymmdd)
 {
     static const std::regex dateTimeRegex("(\\d\\d\\d\\d)(\\d\\d)(\\d\\d)");
@@ -194,3 +1010,11 @@ void CommandLineArgs::setRefDate(std::string yyyymmdd)
     );
     //TODO: check validity of day and month (4-digit year is always valid)
 }
+
+int64_t CommandLineArgs::getTime(std::string yyyymmddhhmm, bool endOfDay)
+{
+    const auto time = RefDate::unixTimeFromString(yyyymmddhhmm, endOfDay);
+    if (!time.has_value())
+        throw (std::runtime_error("Date and time " + yyyymmddhhmm + " is not recognised"));
+    return *time;
+}
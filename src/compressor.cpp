@@ -0,0 +1,235 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "compressor.hpp"
+
+#include <stdexcept>
+
+#include <zlib.h>
+#ifdef METAFJSON_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+
+void appendUint32le(std::string &out, uint32_t value)
+{
+    for (auto i = 0u; i < 4; i++)
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// CompressorGzip
+//////////////////////////////////////////////////////////////////////////////
+
+CompressorGzip::CompressorGzip(int level) : level(level)
+{
+    if (level && (level < minLevel || level > maxLevel))
+        throw(std::invalid_argument("Gzip compression level must be 1 to 9"));
+}
+
+void CompressorGzip::compress(std::string_view block, std::string &out) const
+{
+    static const char header[] = {
+        '\x1F', '\x8B', // Magic
+        8,              // Compression method: deflate
+        4,              // Flags: FEXTRA
+        0, 0, 0, 0,     // Modification time not available
+        0,              // Extra flags
+        '\xFF',         // OS unknown
+        8, 0,           // Length of extra field
+        'M', 'J'        // Subfield id; followed by subfield length and data
+    };
+    const auto memberBegin = out.length();
+    out.append(header, sizeof(header));
+    out.push_back(4);
+    out.push_back(0);
+    appendUint32le(out, 0); // Member size is written when known
+
+    z_stream stream{};
+    if (deflateInit2(&stream,
+                     level ? level : Z_DEFAULT_COMPRESSION,
+                     Z_DEFLATED,
+                     -MAX_WBITS, // Raw deflate, header is written above
+                     8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        throw(std::runtime_error("Cannot initialise gzip compression"));
+    }
+    const auto dataBegin = out.length();
+    out.resize(dataBegin + deflateBound(&stream, block.length()));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(block.data()));
+    stream.avail_in = block.length();
+    stream.next_out = reinterpret_cast<Bytef *>(out.data() + dataBegin);
+    stream.avail_out = out.length() - dataBegin;
+    const auto status = deflate(&stream, Z_FINISH);
+    out.resize(dataBegin + stream.total_out);
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END)
+        throw(std::runtime_error("Gzip compression failed"));
+
+    appendUint32le(out, crc32(0,
+                              reinterpret_cast<const Bytef *>(block.data()),
+                              block.length()));
+    appendUint32le(out, static_cast<uint32_t>(block.length()));
+
+    const auto size = static_cast<uint32_t>(out.length() - memberBegin);
+    for (auto i = 0u; i < 4; i++)
+    {
+        out[memberBegin + memberSizeOffset + i] =
+            static_cast<char>((size >> (i * 8)) & 0xFF);
+    }
+}
+
+std::optional<uint32_t> CompressorGzip::memberSize(std::string_view header)
+{
+    if (header.length() < headerSize)
+        return std::optional<uint32_t>();
+    static const std::string_view expected("\x1F\x8B\x08\x04", 4);
+    if (header.substr(0, expected.length()) != expected)
+        return std::optional<uint32_t>();
+    if (header.substr(10, 6) != std::string_view("\x08\x00MJ\x04\x00", 6))
+        return std::optional<uint32_t>();
+    uint32_t size = 0;
+    for (auto i = 0u; i < 4; i++)
+    {
+        const auto b = static_cast<unsigned char>(header[memberSizeOffset + i]);
+        size |= static_cast<uint32_t>(b) << (i * 8);
+    }
+    return size;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// CompressorZstd
+//////////////////////////////////////////////////////////////////////////////
+
+#ifdef METAFJSON_ZSTD
+CompressorZstd::CompressorZstd(int level) : level(level)
+{
+    if (level && (level < minLevel || level > maxLevel))
+        throw(std::invalid_argument("Zstd compression level must be 1 to 19"));
+}
+
+void CompressorZstd::compress(std::string_view block, std::string &out) const
+{
+    const auto frameBegin = out.length();
+    out.resize(frameBegin + ZSTD_compressBound(block.length()));
+    const auto size = ZSTD_compress(out.data() + frameBegin,
+                                    out.length() - frameBegin,
+                                    block.data(),
+                                    block.length(),
+                                    level ? level : ZSTD_CLEVEL_DEFAULT);
+    if (ZSTD_isError(size))
+        throw(std::runtime_error(std::string("Zstd compression failed: ") +
+                                 ZSTD_getErrorName(size)));
+    out.resize(frameBegin + size);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// CompressedOutput
+//////////////////////////////////////////////////////////////////////////////
+
+CompressedOutput::CompressedOutput(std::ostream &sink,
+                                   std::unique_ptr<const Compressor> compressor,
+                                   size_t threads,
+                                   size_t blockSize)
+    : sink(sink),
+      compressor(std::move(compressor)),
+      blockSize(blockSize),
+      pool(threads)
+{
+    if (!this->compressor)
+        throw(std::runtime_error("compressor is null when creating CompressedOutput"));
+    if (!blockSize)
+        throw(std::invalid_argument("Block size must not be zero"));
+    maxPending = pool.size() * 2;
+    block.resize(blockSize);
+    setp(block.data(), block.data() + block.length());
+}
+
+CompressedOutput::~CompressedOutput()
+{
+    try
+    {
+        finish();
+    }
+    catch (...)
+    {
+    }
+}
+
+void CompressedOutput::finish()
+{
+    if (finished)
+        return;
+    finished = true;
+    // Empty output still needs one member or frame to be a valid file
+    if (pptr() != pbase() || !blockSubmitted)
+        submitBlock();
+    setp(nullptr, nullptr);
+    writeBlocks(0);
+    sink.flush();
+}
+
+CompressedOutput::int_type CompressedOutput::overflow(int_type c)
+{
+    if (finished)
+        return traits_type::eof();
+    submitBlock();
+    writeBlocks(maxPending);
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int CompressedOutput::sync()
+{
+    while (!pending.empty() &&
+           pending.front().wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready)
+    {
+        const auto compressed = pending.front().get();
+        pending.pop_front();
+        sink.write(compressed.data(), compressed.length());
+    }
+    sink.flush();
+    return sink ? 0 : -1;
+}
+
+void CompressedOutput::submitBlock()
+{
+    block.resize(pptr() - pbase());
+    pending.push_back(pool.submit(
+        [c = compressor.get(), b = std::move(block)]() {
+            std::string compressed;
+            c->compress(b, compressed);
+            return compressed;
+        }));
+    blockSubmitted = true;
+    block = std::string(blockSize, '\0');
+    setp(block.data(), block.data() + block.length());
+}
+
+void CompressedOutput::writeBlocks(size_t keepPending)
+{
+    // Blocks are written in order of submission, waiting for compression if
+    // needed; get() rethrows exception which occurred during compression
+    while (pending.size() > keepPending)
+    {
+        const auto compressed = pending.front().get();
+        pending.pop_front();
+        sink.write(compressed.data(), compressed.length());
+    }
+}
@@ -0,0 +1,491 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "conversioncache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "metaf.hpp"
+#include "utility.hpp"
+#include "version.hpp"
+
+using Header = ConversionCache::Header;
+using Record = ConversionCache::Record;
+using IndexHeader = ConversionCache::IndexHeader;
+using Slot = ConversionCache::Slot;
+
+static_assert(sizeof(Header) == 16, "Cache data header layout");
+static_assert(sizeof(Record) == 32, "Cache record layout");
+static_assert(sizeof(IndexHeader) == 48, "Cache index header layout");
+static_assert(sizeof(Slot) == 32, "Cache index slot layout");
+
+static const char dataMagic[8] = {'M', 'E', 'T', 'A', 'F', 'C', 'C', 'H'};
+static const char indexMagic[8] = {'M', 'E', 'T', 'A', 'F', 'C', 'I', 'X'};
+static const uint32_t byteOrder = 0x01020304;
+static const size_t recordAlignment = 8;
+static const uint64_t minSlots = 1024;
+
+static const char dataFileName[] = "/conversion.cache";
+static const char indexFileName[] = "/conversion.cache.idx";
+static const char compactFileName[] = "/conversion.cache.tmp";
+static const char lockFileName[] = "/conversion.cache.lock";
+
+static uint64_t padded(uint64_t size)
+{
+    return (size + recordAlignment - 1) / recordAlignment * recordAlignment;
+}
+
+// CRC-32 of the hashes, the date and the text and output following the
+// record
+static uint32_t checksum(const Record &r, std::string_view payload)
+{
+    auto crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(&r.reportHash), sizeof(r.reportHash));
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(&r.settingsHash), sizeof(r.settingsHash));
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(&r.refDate), sizeof(r.refDate));
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(payload.data()), payload.length());
+    return crc;
+}
+
+// Initial slot of the key in the index; FNV-1a hashes are mixed so that
+// the low bits of the slot number depend on all bits of the hashes
+static uint64_t slotNumber(uint64_t reportHash, uint64_t settingsHash, uint64_t slotCount)
+{
+    auto h = reportHash ^ (settingsHash * 0x9e3779b97f4a7c15ull);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h & (slotCount - 1);
+}
+
+// Read length bytes at offset; returns false if file is too short
+static bool readAt(int fd, uint64_t offset, void *data, size_t length)
+{
+    for (size_t done = 0; done < length;)
+    {
+        const auto result = pread(fd, static_cast<char *>(data) + done, length - done, offset + done);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        done += result;
+    }
+    return true;
+}
+
+static void writeAt(int fd, uint64_t offset, const void *data, size_t length)
+{
+    for (size_t done = 0; done < length;)
+    {
+        const auto result =
+            pwrite(fd, static_cast<const char *>(data) + done, length - done, offset + done);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            throw(std::runtime_error("Cannot write conversion cache"));
+        done += result;
+    }
+}
+
+static uint64_t fileSize(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        throw(std::runtime_error("Cannot get size of conversion cache"));
+    return st.st_size;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ConversionCache
+//////////////////////////////////////////////////////////////////////////////
+
+ConversionCache::ConversionCache(const std::string &directory,
+                                 std::string_view settings,
+                                 uint64_t maxSize)
+    : directory(directory), maxSize(maxSize)
+{
+    // Output also depends on the versions of the program and metaf
+    const auto versions = std::to_string(Version::major) + '.' +
+                          std::to_string(Version::minor) + '.' +
+                          std::to_string(Version::patch) + ' ' +
+                          std::to_string(metaf::Version::major) + '.' +
+                          std::to_string(metaf::Version::minor) + '.' +
+                          std::to_string(metaf::Version::patch);
+    settingsHash = util::hash(settings, util::hash(versions));
+
+    if (mkdir(directory.c_str(), 0755) < 0 && errno != EEXIST)
+        throw(std::runtime_error("Cannot create cache directory " + directory));
+    try
+    {
+        lockFd = open((directory + lockFileName).c_str(), O_RDWR | O_CREAT, 0644);
+        if (lockFd < 0)
+            throw(std::runtime_error("Cannot open cache directory " + directory));
+        if (flock(lockFd, LOCK_EX | LOCK_NB) < 0)
+            throw(std::runtime_error("Cache directory " + directory + " is used by another process"));
+
+        dataFd = open((directory + dataFileName).c_str(), O_RDWR | O_CREAT, 0644);
+        if (dataFd < 0)
+            throw(std::runtime_error("Cannot open conversion cache in " + directory));
+        dataSize = fileSize(dataFd);
+        Header header{};
+        if (!dataSize)
+        {
+            std::memcpy(header.magic, dataMagic, sizeof(dataMagic));
+            header.version = version;
+            header.byteOrder = byteOrder;
+            writeAt(dataFd, 0, &header, sizeof(header));
+            dataSize = sizeof(header);
+        }
+        else
+        {
+            if (!readAt(dataFd, 0, &header, sizeof(header)) ||
+                std::memcmp(header.magic, dataMagic, sizeof(dataMagic)) ||
+                header.byteOrder != byteOrder)
+            {
+                throw(std::runtime_error(directory + " does not contain a valid conversion cache"));
+            }
+            if (header.version != version)
+                throw(std::runtime_error(directory + " contains unsupported conversion cache version"));
+        }
+
+        indexFd = open((directory + indexFileName).c_str(), O_RDWR | O_CREAT, 0644);
+        if (indexFd < 0)
+            throw(std::runtime_error("Cannot open conversion cache index in " + directory));
+        IndexHeader ih{};
+        const auto size = fileSize(indexFd);
+        const bool valid = size >= sizeof(ih) &&
+                           readAt(indexFd, 0, &ih, sizeof(ih)) &&
+                           !std::memcmp(ih.magic, indexMagic, sizeof(indexMagic)) &&
+                           ih.version == version &&
+                           ih.byteOrder == byteOrder &&
+                           ih.clean &&
+                           ih.dataSize == dataSize &&
+                           ih.slotCount >= minSlots &&
+                           !(ih.slotCount & (ih.slotCount - 1)) &&
+                           ih.entryCount <= ih.slotCount &&
+                           size == sizeof(ih) + ih.slotCount * sizeof(Slot);
+        if (valid)
+        {
+            mapIndex(ih.slotCount);
+            generation = index->generation + 1;
+        }
+        else
+        {
+            rebuildIndex();
+            generation = 1;
+            stats.rebuilt = true;
+        }
+        // Until the cache is closed index is not trusted by other runs
+        syncIndex(false);
+    }
+    catch (...)
+    {
+        unmapIndex();
+        if (indexFd >= 0) close(indexFd);
+        if (dataFd >= 0) close(dataFd);
+        if (lockFd >= 0) close(lockFd);
+        throw;
+    }
+}
+
+ConversionCache::~ConversionCache()
+{
+    // Data must be written before index is marked as clean
+    if (!fdatasync(dataFd))
+        syncIndex(true);
+    unmapIndex();
+    close(indexFd);
+    close(dataFd);
+    close(lockFd);
+}
+
+uint32_t ConversionCache::packDate(const RefDate &refDate)
+{
+    return static_cast<uint32_t>(refDate.year) * 10000 + refDate.month * 100 + refDate.day;
+}
+
+uint64_t ConversionCache::reportHash(std::string_view report, uint32_t date)
+{
+    char dateBytes[sizeof(date)];
+    std::memcpy(dateBytes, &date, sizeof(date));
+    return util::hash(report, util::hash(std::string_view(dateBytes, sizeof(dateBytes))));
+}
+
+ConversionCache::Statistics ConversionCache::statistics() const
+{
+    auto s = stats;
+    s.entries = index->entryCount;
+    s.size = dataSize;
+    return s;
+}
+
+bool ConversionCache::find(std::string_view report, const RefDate &refDate, std::string &output)
+{
+    const auto date = packDate(refDate);
+    const auto slot = findSlot(reportHash(report, date));
+    if (slot && readRecord(*slot, buffer))
+    {
+        Record r;
+        std::memcpy(&r, buffer.data(), sizeof(r));
+        const auto text = std::string_view(buffer).substr(sizeof(r), r.textLength);
+        if (r.refDate == date && text == report)
+        {
+            output.append(buffer, sizeof(r) + r.textLength, r.outputLength);
+            slot->generation = generation;
+            stats.hits++;
+            return true;
+        }
+    }
+    stats.misses++;
+    return false;
+}
+
+void ConversionCache::add(std::string_view report, const RefDate &refDate, std::string_view output)
+{
+    Record r{};
+    r.refDate = packDate(refDate);
+    r.reportHash = reportHash(report, r.refDate);
+    r.settingsHash = settingsHash;
+    r.textLength = report.length();
+    r.outputLength = output.length();
+    const auto length = padded(sizeof(r) + report.length() + output.length());
+    // Entry which does not fit into compacted cache is not added
+    if (sizeof(Header) + length > maxSize / 2)
+        return;
+    if (dataSize + length > maxSize)
+        compact(maxSize / 2 - length);
+
+    buffer.assign(sizeof(r), '\0');
+    buffer.append(report);
+    buffer.append(output);
+    r.checksum = checksum(r, std::string_view(buffer).substr(sizeof(r)));
+    buffer.resize(length);
+    std::memcpy(buffer.data(), &r, sizeof(r));
+
+    writeAt(dataFd, dataSize, buffer.data(), buffer.length());
+    insert(Slot{r.reportHash, r.settingsHash, dataSize, static_cast<uint32_t>(length), generation});
+    dataSize += length;
+    stats.added++;
+}
+
+Slot *ConversionCache::findSlot(uint64_t rHash)
+{
+    const auto mask = index->slotCount - 1;
+    for (auto i = slotNumber(rHash, settingsHash, index->slotCount);; i = (i + 1) & mask)
+    {
+        auto &slot = slots[i];
+        if (!slot.length)
+            return nullptr;
+        if (slot.reportHash == rHash && slot.settingsHash == settingsHash)
+            return &slot;
+    }
+}
+
+// Read the record and check that it matches the slot
+bool ConversionCache::readRecord(const Slot &slot, std::string &record) const
+{
+    record.resize(slot.length);
+    if (slot.length < sizeof(Record) || !readAt(dataFd, slot.offset, record.data(), slot.length))
+        return false;
+    Record r;
+    std::memcpy(&r, record.data(), sizeof(r));
+    return r.reportHash == slot.reportHash &&
+           r.settingsHash == slot.settingsHash &&
+           padded(sizeof(r) + uint64_t(r.textLength) + r.outputLength) == slot.length &&
+           checksum(r, std::string_view(record).substr(sizeof(r), r.textLength + r.outputLength)) ==
+               r.checksum;
+}
+
+// Map index with slotCount slots; if index file does not have this size it
+// is recreated empty
+void ConversionCache::mapIndex(uint64_t slotCount)
+{
+    unmapIndex();
+    const auto size = sizeof(IndexHeader) + slotCount * sizeof(Slot);
+    const bool empty = fileSize(indexFd) != size;
+    if (empty && (ftruncate(indexFd, 0) < 0 || ftruncate(indexFd, size) < 0))
+        throw(std::runtime_error("Cannot resize conversion cache index"));
+    const auto address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+    if (address == MAP_FAILED)
+        throw(std::runtime_error("Cannot map conversion cache index"));
+    indexSize = size;
+    index = static_cast<IndexHeader *>(address);
+    slots = reinterpret_cast<Slot *>(index + 1);
+    if (empty)
+    {
+        std::memcpy(index->magic, indexMagic, sizeof(indexMagic));
+        index->version = version;
+        index->byteOrder = byteOrder;
+        index->slotCount = slotCount;
+        index->generation = generation;
+    }
+}
+
+void ConversionCache::unmapIndex()
+{
+    if (index)
+        munmap(index, indexSize);
+    index = nullptr;
+    slots = nullptr;
+    indexSize = 0;
+}
+
+// Rebuild index from data file; data file is truncated after the last valid
+// record, e.g. record which was being written when program was terminated
+void ConversionCache::rebuildIndex()
+{
+    if (ftruncate(indexFd, 0) < 0)
+        throw(std::runtime_error("Cannot resize conversion cache index"));
+    mapIndex(minSlots);
+    auto offset = static_cast<uint64_t>(sizeof(Header));
+    std::string payload;
+    while (offset + sizeof(Record) <= dataSize)
+    {
+        Record r;
+        if (!readAt(dataFd, offset, &r, sizeof(r)))
+            break;
+        const auto length = padded(sizeof(r) + uint64_t(r.textLength) + r.outputLength);
+        if (offset + length > dataSize)
+            break;
+        payload.resize(r.textLength + r.outputLength);
+        if (!readAt(dataFd, offset + sizeof(r), payload.data(), payload.length()) ||
+            checksum(r, payload) != r.checksum)
+        {
+            break;
+        }
+        insert(Slot{r.reportHash, r.settingsHash, offset, static_cast<uint32_t>(length), 0});
+        offset += length;
+    }
+    if (offset != dataSize)
+    {
+        if (ftruncate(dataFd, offset) < 0)
+            throw(std::runtime_error("Cannot truncate conversion cache"));
+        dataSize = offset;
+    }
+}
+
+// Add entry to the index; entry with the same key is replaced
+void ConversionCache::insert(const Slot &slot)
+{
+    if ((index->entryCount + 1) * 2 > index->slotCount)
+        grow();
+    const auto mask = index->slotCount - 1;
+    for (auto i = slotNumber(slot.reportHash, slot.settingsHash, index->slotCount);; i = (i + 1) & mask)
+    {
+        auto &s = slots[i];
+        if (!s.length)
+        {
+            s = slot;
+            index->entryCount++;
+            return;
+        }
+        if (s.reportHash == slot.reportHash && s.settingsHash == slot.settingsHash)
+        {
+            s = slot;
+            return;
+        }
+    }
+}
+
+// Double the number of slots to keep load factor below 1/2
+void ConversionCache::grow()
+{
+    std::vector<Slot> entries;
+    entries.reserve(index->entryCount);
+    std::copy_if(slots, slots + index->slotCount, std::back_inserter(entries),
+                 [](const Slot &s) { return s.length != 0; });
+    const auto slotCount = index->slotCount * 2;
+    mapIndex(slotCount);
+    for (const auto &e : entries)
+        insert(e);
+}
+
+// Rewrite data file keeping the most recently used entries up to target
+// size; entries used in the same run are kept newest first
+void ConversionCache::compact(uint64_t targetSize)
+{
+    std::vector<Slot> entries;
+    entries.reserve(index->entryCount);
+    std::copy_if(slots, slots + index->slotCount, std::back_inserter(entries),
+                 [](const Slot &s) { return s.length != 0; });
+    std::sort(entries.begin(), entries.end(), [](const Slot &a, const Slot &b) {
+        if (a.generation != b.generation)
+            return a.generation > b.generation;
+        return a.offset > b.offset;
+    });
+    auto size = static_cast<uint64_t>(sizeof(Header));
+    size_t keep = 0;
+    while (keep < entries.size() && size + entries[keep].length <= targetSize)
+        size += entries[keep++].length;
+    entries.resize(keep);
+    // Entries keep their order in the data file
+    std::sort(entries.begin(), entries.end(), [](const Slot &a, const Slot &b) {
+        return a.offset < b.offset;
+    });
+
+    // Data file is replaced only after it is completely written; if program
+    // is terminated before index is updated, index is rebuilt
+    const auto compactName = directory + compactFileName;
+    const auto fd = open(compactName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw(std::runtime_error("Cannot compact conversion cache"));
+    try
+    {
+        Header header;
+        if (!readAt(dataFd, 0, &header, sizeof(header)))
+            throw(std::runtime_error("Cannot read conversion cache"));
+        writeAt(fd, 0, &header, sizeof(header));
+        auto offset = static_cast<uint64_t>(sizeof(header));
+        for (auto &e : entries)
+        {
+            buffer.resize(e.length);
+            if (!readAt(dataFd, e.offset, buffer.data(), e.length))
+                throw(std::runtime_error("Cannot read conversion cache"));
+            writeAt(fd, offset, buffer.data(), e.length);
+            e.offset = offset;
+            offset += e.length;
+        }
+        if (fsync(fd) < 0 || rename(compactName.c_str(), (directory + dataFileName).c_str()) < 0)
+            throw(std::runtime_error("Cannot compact conversion cache"));
+        close(dataFd);
+        dataFd = fd;
+        dataSize = offset;
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+
+    const auto slotCount = index->slotCount;
+    if (ftruncate(indexFd, 0) < 0)
+        throw(std::runtime_error("Cannot resize conversion cache index"));
+    mapIndex(slotCount);
+    for (const auto &e : entries)
+        insert(e);
+    stats.compactions++;
+}
+
+void ConversionCache::syncIndex(bool clean)
+{
+    index->dataSize = dataSize;
+    index->generation = generation;
+    index->clean = clean;
+    msync(index, indexSize, MS_SYNC);
+}
@@ -120,24 +120,25 @@ time_t DateTimeFormat::DateTime::toUnixTime()
     return (s.time_since_epoch().count());
 }
 
-nlohmann::json DateTimeFormat::format(const metaf::MetafTime &time,
-                      const DateTime & reportTime,
-                      bool forecast) const
+void DateTimeFormat::write(ValueWriter &writer,
+                           const metaf::MetafTime &time,
+                           const DateTime & reportTime,
+                           bool forecast) const
 {
     DateTime dt (reportTime, time, forecast);
-    return format(dt);
+    write(writer, dt);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 // DateTimeFormatBasic
 //////////////////////////////////////////////////////////////////////////////
 
-nlohmann::json DateTimeFormatBasic::format(const DateTime &dateTime) const
+void DateTimeFormatBasic::write(ValueWriter &writer, const DateTime &dateTime) const
 {
-    nlohmann::json j;
+    writer.beginObject();
     if (const auto d = dateTime.metafTime->day(); d.has_value())
-        j["day"] = *d;
-    j["hour"] = dateTime.metafTime->hour();
-    j["minute"] = dateTime.metafTime->minute();
-    return j;
+        writer.member("day", *d);
+    writer.member("hour", dateTime.metafTime->hour());
+    writer.member("minute", dateTime.metafTime->minute());
+    writer.endObject();
 }
@@ -0,0 +1,421 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "decompressor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <zlib.h>
+#ifdef METAFJSON_ZSTD
+#include <zstd.h>
+#endif
+
+#include "compressor.hpp"
+
+namespace
+{
+
+const size_t inputChunkSize = 64 * 1024;
+const size_t outputChunkSize = 256 * 1024;
+
+// Owns zlib stream initialised for gzip decompression
+struct GzipStream
+{
+    GzipStream()
+    {
+        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+            throw(std::runtime_error("Cannot initialise gzip decompression"));
+    }
+    ~GzipStream() { inflateEnd(&stream); }
+    GzipStream(const GzipStream &) = delete;
+    GzipStream &operator=(const GzipStream &) = delete;
+
+    z_stream stream{};
+};
+
+// Gzip input is read in windows; members which end within the window are
+// decompressed in parallel
+const size_t windowSize = 4 * 1024 * 1024;
+// If no member ends within this size, the rest of the input is decompressed
+// sequentially (e.g. single-member gzip file)
+const size_t maxBufferedSize = 64 * 1024 * 1024;
+// Header (10 bytes), empty deflate block (2 bytes) and trailer (8 bytes)
+const size_t minMemberSize = 20;
+// Maximum compression ratio of deflate
+const size_t maxDeflateRatio = 1032;
+
+// Member header may begin at the position: magic bytes, deflate method and
+// no reserved flags
+bool isMemberHeader(std::string_view in, size_t pos)
+{
+    return pos + 4 <= in.length() &&
+           in[pos] == '\x1F' &&
+           in[pos + 1] == '\x8B' &&
+           in[pos + 2] == '\x08' &&
+           !(static_cast<unsigned char>(in[pos + 3]) & 0xE0);
+}
+
+// Positions where gzip members may begin after the member which begins at
+// the start of input; if member size is known from its header (see
+// CompressorGzip::memberSize()), next member is expected at its end,
+// otherwise member header bytes are searched. Positions are verified when
+// members are inflated.
+std::vector<size_t> memberBoundaries(std::string_view in)
+{
+    std::vector<size_t> result;
+    size_t begin = 0;
+    while (true)
+    {
+        auto pos = begin + minMemberSize;
+        if (const auto size = CompressorGzip::memberSize(in.substr(begin));
+            size.has_value() && *size >= minMemberSize)
+        {
+            pos = begin + *size;
+        }
+        while (pos < in.length() && !isMemberHeader(in, pos))
+        {
+            const auto next = static_cast<const char *>(
+                std::memchr(in.data() + pos + 1, '\x1F', in.length() - pos - 1));
+            pos = next ? next - in.data() : in.length();
+        }
+        if (pos >= in.length())
+            return result;
+        result.push_back(pos);
+        begin = pos;
+    }
+}
+
+// Inflate gzip member which must occupy the whole input, including the
+// verification of CRC and size; empty optional if the input is not exactly
+// one valid member (e.g. input boundary is not an actual member boundary)
+std::optional<std::string> inflateMember(std::string_view member)
+{
+    if (member.length() < minMemberSize)
+        return std::optional<std::string>();
+    // Uncompressed size from trailer is only used to limit initial output
+    // size, since the member is not verified yet
+    const auto trailer = reinterpret_cast<const unsigned char *>(
+        member.data() + member.length() - 4);
+    const auto size = static_cast<uint32_t>(trailer[0]) |
+                      static_cast<uint32_t>(trailer[1]) << 8 |
+                      static_cast<uint32_t>(trailer[2]) << 16 |
+                      static_cast<uint32_t>(trailer[3]) << 24;
+    std::string result(
+        std::min({static_cast<size_t>(size), member.length() * maxDeflateRatio, windowSize}),
+        '\0');
+    GzipStream gz;
+    auto &stream = gz.stream;
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(member.data()));
+    stream.avail_in = member.length();
+    while (true)
+    {
+        stream.next_out = reinterpret_cast<Bytef *>(result.data() + stream.total_out);
+        stream.avail_out = result.length() - stream.total_out;
+        const auto status = inflate(&stream, Z_FINISH);
+        if (status == Z_STREAM_END)
+            break;
+        // More output space is needed only if the output is full
+        if (status != Z_BUF_ERROR || stream.avail_out)
+            return std::optional<std::string>();
+        result.resize(std::max(result.length() * 2, outputChunkSize));
+    }
+    if (stream.avail_in)
+        return std::optional<std::string>();
+    result.resize(stream.total_out);
+    return result;
+}
+
+} // namespace
+
+DecompressedInput::Format DecompressedInput::detect(std::istream &in)
+{
+    const auto pos = in.tellg();
+    unsigned char magic[4] = {};
+    in.read(reinterpret_cast<char *>(magic), sizeof(magic));
+    const auto count = in.gcount();
+    in.clear();
+    in.seekg(pos);
+    if (count >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+        return Format::GZIP;
+    if (count == 4 && magic[0] == 0x28 && magic[1] == 0xB5 &&
+        magic[2] == 0x2F && magic[3] == 0xFD)
+        return Format::ZSTD;
+    return Format::NONE;
+}
+
+DecompressedInput::DecompressedInput(std::istream &source,
+                                     Format format,
+                                     size_t threads)
+    : source(source), format(format), pool(threads)
+{
+    switch (format)
+    {
+    case Format::NONE:
+        throw(std::invalid_argument("Input is not compressed"));
+    case Format::GZIP:
+        break;
+    case Format::ZSTD:
+#ifndef METAFJSON_ZSTD
+        throw(std::runtime_error("Zstd compressed input is not supported in this build"));
+#endif
+        break;
+    }
+    maxChunks = pool.size() * 2;
+    decompressor = std::thread([this]() { decompress(); });
+}
+
+DecompressedInput::~DecompressedInput()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    decompressor.join();
+}
+
+DecompressedInput::int_type DecompressedInput::underflow()
+{
+    while (gptr() == egptr())
+    {
+        if (!errorMessage.empty())
+            return traits_type::eof();
+        std::future<std::string> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return !chunks.empty() || finished; });
+            if (chunks.empty())
+                return traits_type::eof();
+            chunk = std::move(chunks.front());
+            chunks.pop_front();
+        }
+        changed.notify_all();
+        try
+        {
+            current = chunk.get();
+        }
+        catch (const std::exception &e)
+        {
+            errorMessage = e.what();
+            current.clear();
+        }
+        setg(current.data(), current.data(), current.data() + current.length());
+    }
+    return traits_type::to_int_type(*gptr());
+}
+
+void DecompressedInput::decompress()
+{
+    try
+    {
+        switch (format)
+        {
+        case Format::GZIP:
+            decompressGzipMembers();
+            break;
+        case Format::ZSTD:
+            decompressZstd();
+            break;
+        default:
+            break;
+        }
+    }
+    catch (...)
+    {
+        // Error is reported when the reader reaches it
+        std::promise<std::string> error;
+        error.set_exception(std::current_exception());
+        push(error.get_future());
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    changed.notify_all();
+}
+
+void DecompressedInput::decompressGzipMembers()
+{
+    // Input begins with a member; unless the member is verified, no other
+    // member boundaries are known
+    std::string in;
+    while (true)
+    {
+        const auto begin = in.length();
+        read(in, windowSize);
+        const bool last = in.length() - begin < windowSize;
+        if (in.empty())
+            return;
+        // Shared with the worker threads inflating members
+        const auto window = std::make_shared<const std::string>(std::move(in));
+        const std::string_view view(*window);
+        std::vector<size_t> boundaries{0};
+        for (const auto b : memberBoundaries(view))
+            boundaries.push_back(b);
+        if (last)
+            boundaries.push_back(view.length());
+        std::vector<std::future<std::optional<std::string>>> members;
+        for (auto i = 1u; i < boundaries.size(); i++)
+        {
+            const auto member = view.substr(boundaries[i - 1],
+                                            boundaries[i] - boundaries[i - 1]);
+            members.push_back(pool.submit(
+                [window, member]() { return inflateMember(member); }));
+        }
+
+        // Members which do not begin at the end of previous member are
+        // discarded; if boundary at member end is not an actual member
+        // boundary, member is inflated again up to one of next boundaries
+        size_t done = 0;
+        for (auto i = 0u; i < members.size(); i++)
+        {
+            auto member = members[i].get();
+            if (boundaries[i] != done)
+                continue;
+            auto end = i + 1;
+            while (!member.has_value() && ++end < boundaries.size())
+                member = inflateMember(view.substr(done, boundaries[end] - done));
+            if (!member.has_value())
+                break;
+            if (!push(std::move(*member)))
+                return;
+            done = boundaries[end];
+        }
+
+        in.assign(view.substr(done));
+        if (last || in.length() >= maxBufferedSize)
+        {
+            // Rest of the input is corrupted or truncated, or has members
+            // too large to be located
+            if (!in.empty())
+                decompressGzip(std::move(in));
+            return;
+        }
+    }
+}
+
+void DecompressedInput::decompressGzip(std::string prefix)
+{
+    GzipStream gz;
+    auto &stream = gz.stream;
+    std::string in = std::move(prefix);
+    stream.next_in = reinterpret_cast<Bytef *>(in.data());
+    stream.avail_in = in.length();
+    bool outputFull = false;
+    bool memberComplete = false;
+    while (true)
+    {
+        // Inflate may hold more output even if no input is left
+        if (!stream.avail_in && !outputFull)
+        {
+            in.clear();
+            if (!read(in, inputChunkSize))
+                break;
+            stream.next_in = reinterpret_cast<Bytef *>(in.data());
+            stream.avail_in = in.length();
+        }
+        std::string out(outputChunkSize, '\0');
+        stream.next_out = reinterpret_cast<Bytef *>(out.data());
+        stream.avail_out = out.length();
+        const auto status = inflate(&stream, Z_NO_FLUSH);
+        outputFull = !stream.avail_out;
+        out.resize(out.length() - stream.avail_out);
+        if (!out.empty() && !push(std::move(out)))
+            return;
+        switch (status)
+        {
+        case Z_STREAM_END:
+            // Next member may follow
+            memberComplete = true;
+            outputFull = false;
+            inflateReset(&stream);
+            break;
+        case Z_OK:
+            memberComplete = false;
+            break;
+        case Z_BUF_ERROR:
+            break;
+        default:
+            throw(std::runtime_error("Corrupted gzip input"));
+        }
+    }
+    if (!memberComplete)
+        throw(std::runtime_error("Truncated gzip input"));
+}
+
+void DecompressedInput::decompressZstd()
+{
+#ifdef METAFJSON_ZSTD
+    std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> stream(
+        ZSTD_createDStream(), &ZSTD_freeDStream);
+    if (!stream || ZSTD_isError(ZSTD_initDStream(stream.get())))
+        throw(std::runtime_error("Cannot initialise zstd decompression"));
+    std::string in;
+    ZSTD_inBuffer input{in.data(), 0, 0};
+    bool outputFull = false;
+    size_t status = 0;
+    while (true)
+    {
+        if (input.pos == input.size && !outputFull)
+        {
+            in.clear();
+            if (!read(in, ZSTD_DStreamInSize()))
+                break;
+            input = ZSTD_inBuffer{in.data(), in.length(), 0};
+        }
+        std::string out(outputChunkSize, '\0');
+        ZSTD_outBuffer output{out.data(), out.length(), 0};
+        status = ZSTD_decompressStream(stream.get(), &output, &input);
+        if (ZSTD_isError(status))
+            throw(std::runtime_error(std::string("Corrupted zstd input: ") +
+                                     ZSTD_getErrorName(status)));
+        outputFull = output.pos == output.size;
+        out.resize(output.pos);
+        if (!out.empty() && !push(std::move(out)))
+            return;
+    }
+    // Non-zero status means frame is not complete
+    if (status)
+        throw(std::runtime_error("Truncated zstd input"));
+#endif
+}
+
+bool DecompressedInput::read(std::string &buffer, size_t size)
+{
+    const auto begin = buffer.length();
+    buffer.resize(begin + size);
+    source.read(buffer.data() + begin, size);
+    buffer.resize(begin + source.gcount());
+    return buffer.length() > begin;
+}
+
+bool DecompressedInput::push(std::future<std::string> chunk)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return stopping || chunks.size() < maxChunks; });
+        if (stopping)
+            return false;
+        chunks.push_back(std::move(chunk));
+    }
+    changed.notify_all();
+    return true;
+}
+
+bool DecompressedInput::push(std::string chunk)
+{
+    std::promise<std::string> ready;
+    ready.set_value(std::move(chunk));
+    return push(ready.get_future());
+}
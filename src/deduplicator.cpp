@@ -0,0 +1,182 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "deduplicator.hpp"
+
+#include <algorithm>
+
+#include "reportkey.hpp"
+#include "utility.hpp"
+
+// Correction is only recognised among the first groups of the report, e.g.
+// METAR COR EGYP 041250Z or METAR EGYP 041250Z COR
+static const size_t correctionGroups = 4;
+static const unsigned minSlotBits = 10;
+
+enum class Type : uint8_t
+{
+    METAR,
+    SPECI,
+    TAF
+};
+
+static bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+template <typename T>
+static uint64_t hashValue(const T &value, uint64_t h)
+{
+    return util::hash(
+        std::string_view(reinterpret_cast<const char *>(&value), sizeof(value)), h);
+}
+
+Deduplicator::Deduplicator(size_t memoryLimit, size_t delay) : delay(delay)
+{
+    // Both generations fit into the memory limit
+    slotBits = minSlotBits;
+    while ((sizeof(uint64_t) << (slotBits + 2)) <= memoryLimit)
+        slotBits++;
+    current.resize(size_t(1) << slotBits);
+}
+
+void Deduplicator::add(const std::string &report,
+                       const RefDate &refDate,
+                       size_t lineNumber,
+                       const Output &output)
+{
+    stats.reports++;
+    const auto key = ReportKey::fromReport(report, refDate);
+    if (!key.has_value())
+    {
+        delayed.push_back(Delayed{0, report, refDate, lineNumber, false});
+        while (delayed.size() > delay)
+            passOn(output);
+        return;
+    }
+
+    // Groups are hashed regardless of the separators between them and of
+    // the terminating '=' and COR
+    auto type = Type::METAR;
+    auto correction = false;
+    auto content = util::hash(std::string_view());
+    std::string_view text(report);
+    for (size_t i = 0; !text.empty(); i++)
+    {
+        const auto begin = std::find_if_not(text.begin(), text.end(), isSeparator);
+        text.remove_prefix(begin - text.begin());
+        const auto end = std::find_if(text.begin(), text.end(), isSeparator);
+        auto group = text.substr(0, end - text.begin());
+        text.remove_prefix(group.length());
+        if (!group.empty() && group.back() == '=')
+            group.remove_suffix(1);
+        if (group.empty())
+            continue;
+        if (!i && group == "SPECI")
+            type = Type::SPECI;
+        if (!i && group == "TAF")
+            type = Type::TAF;
+        if (i < correctionGroups && group == "COR")
+        {
+            correction = true;
+            continue;
+        }
+        content = hashValue(group.length(), util::hash(group, content));
+    }
+    auto identity = hashValue(type, hashValue(key->time, hashValue(key->station,
+        util::hash(std::string_view()))));
+    if (!identity)
+        identity = 1;
+    auto fingerprint = hashValue(content, identity);
+    if (!fingerprint)
+        fingerprint = 1;
+
+    if (!insert(fingerprint))
+    {
+        stats.duplicates++;
+        return;
+    }
+    if (const auto d = delayedIdentities.find(identity); d != delayedIdentities.end())
+    {
+        auto &previousReport = delayed.at(d->second - delayedFirst);
+        if (correction)
+        {
+            previousReport.report = report;
+            previousReport.refDate = refDate;
+            previousReport.lineNumber = lineNumber;
+            previousReport.correction = true;
+            stats.corrections++;
+            return;
+        }
+        if (previousReport.correction)
+        {
+            // Original report follows its correction
+            stats.corrections++;
+            return;
+        }
+    }
+    delayedIdentities[identity] = delayedFirst + delayed.size();
+    delayed.push_back(Delayed{identity, report, refDate, lineNumber, correction});
+    while (delayed.size() > delay)
+        passOn(output);
+}
+
+void Deduplicator::finish(const Output &output)
+{
+    while (!delayed.empty())
+        passOn(output);
+}
+
+// Add fingerprint to the current generation unless it is already present
+// in either generation; returns false if fingerprint is present
+bool Deduplicator::insert(uint64_t fingerprint)
+{
+    const auto mask = (uint64_t(1) << slotBits) - 1;
+    // Fibonacci hashing spreads the fingerprints over the table
+    const auto start = (fingerprint * 0x9e3779b97f4a7c15ull) >> (64 - slotBits);
+    if (!previous.empty())
+    {
+        for (auto i = start; previous[i]; i = (i + 1) & mask)
+        {
+            if (previous[i] == fingerprint)
+                return false;
+        }
+    }
+    auto i = start;
+    for (; current[i]; i = (i + 1) & mask)
+    {
+        if (current[i] == fingerprint)
+            return false;
+    }
+    current[i] = fingerprint;
+    // Table is half full: the previous generation is discarded
+    if (++currentCount >= current.size() / 2)
+    {
+        previous.swap(current);
+        current.assign(previous.size(), 0);
+        currentCount = 0;
+    }
+    return true;
+}
+
+void Deduplicator::passOn(const Output &output)
+{
+    const auto &d = delayed.front();
+    output(d.report, d.refDate, d.lineNumber);
+    if (d.identity)
+    {
+        if (const auto i = delayedIdentities.find(d.identity);
+            i != delayedIdentities.end() && i->second == delayedFirst)
+        {
+            delayedIdentities.erase(i);
+        }
+    }
+    delayed.pop_front();
+    delayedFirst++;
+}
@@ -0,0 +1,76 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "encoder.hpp"
+
+#include <cstdint>
+
+#include "nlohmann/json.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+// Encoder
+//////////////////////////////////////////////////////////////////////////////
+
+void Encoder::write(const nlohmann::json &j, std::ostream &out) const
+{
+    begin().json(j);
+    end(out);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// EncoderJson
+//////////////////////////////////////////////////////////////////////////////
+
+EncoderJson::EncoderJson()
+    : document(std::make_unique<nlohmann::json>()),
+      writer(*document)
+{
+}
+
+EncoderJson::~EncoderJson()
+{
+}
+
+ValueWriter &EncoderJson::begin() const
+{
+    writer.clear();
+    return writer;
+}
+
+void EncoderJson::end(std::ostream &out) const
+{
+    write(*document, out);
+}
+
+void EncoderJson::write(const nlohmann::json &j, std::ostream &out) const
+{
+    out << j << "\n"; //not std::endl because it does std::flush as well
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// EncoderBinary
+//////////////////////////////////////////////////////////////////////////////
+
+ValueWriter &EncoderBinary::begin() const
+{
+    writer().clear();
+    return writer();
+}
+
+void EncoderBinary::end(std::ostream &out) const
+{
+    const auto &buffer = writer().data();
+    const auto length = static_cast<uint32_t>(buffer.length());
+    const char lengthBytes[] = {
+        static_cast<char>((length >> 24) & 0xFF),
+        static_cast<char>((length >> 16) & 0xFF),
+        static_cast<char>((length >> 8) & 0xFF),
+        static_cast<char>(length & 0xFF)};
+    out.write(lengthBytes, sizeof(lengthBytes));
+    out.write(buffer.data(), buffer.length());
+}
@@ -0,0 +1,167 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "eventdetector.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "metaf.hpp"
+
+#include "stationfilter.hpp"
+
+using namespace metaf;
+
+namespace
+{
+
+const float metersPerStatuteMile = 1609.344;
+
+// Flags of the tracked weather phenomena in the report
+uint8_t trackedWeather(const ReportValues &values)
+{
+    uint8_t result = 0;
+    if (values.hasWeather(ReportValues::Weather::THUNDERSTORM))
+        result |= static_cast<uint8_t>(EventDetector::Weather::TS);
+    if (values.hasWeather(ReportValues::Weather::FREEZING_RAIN))
+        result |= static_cast<uint8_t>(EventDetector::Weather::FZRA);
+    if (values.hasWeather(ReportValues::Weather::SNOW))
+        result |= static_cast<uint8_t>(EventDetector::Weather::SN);
+    return result;
+}
+
+} // namespace
+
+EventDetector::EventDetector(std::vector<unsigned> gustThresholds)
+    : thresholds(std::move(gustThresholds))
+{
+    std::sort(thresholds.begin(), thresholds.end());
+    thresholds.erase(std::unique(thresholds.begin(), thresholds.end()),
+                     thresholds.end());
+    if (thresholds.size() > maxGustThresholds)
+        throw std::invalid_argument("Too many gust thresholds");
+}
+
+EventDetector::FlightCategory EventDetector::flightCategory(const ReportValues &values)
+{
+    // Flight category cannot be determined without visibility; if no
+    // ceiling is reported, ceiling is unlimited
+    if (!values.visibility.has_value())
+        return FlightCategory::UNKNOWN;
+    const auto miles = *values.visibility / metersPerStatuteMile;
+    const auto ceiling = values.ceiling;
+    if (miles < 1 || (ceiling.has_value() && *ceiling < 500))
+        return FlightCategory::LIFR;
+    if (miles < 3 || (ceiling.has_value() && *ceiling < 1000))
+        return FlightCategory::IFR;
+    if (miles <= 5 || (ceiling.has_value() && *ceiling <= 3000))
+        return FlightCategory::MVFR;
+    return FlightCategory::VFR;
+}
+
+int8_t EventDetector::gustLevel(std::optional<float> gust) const
+{
+    if (!gust.has_value())
+        return 0;
+    const auto reached = std::upper_bound(
+        thresholds.begin(), thresholds.end(), *gust,
+        [](float g, unsigned threshold) { return g < threshold; });
+    return static_cast<int8_t>(reached - thresholds.begin());
+}
+
+bool EventDetector::detect(const ParseResult &parseResult,
+                           const RefDate &refDate,
+                           Result &result)
+{
+    result.station.clear();
+    result.events.clear();
+
+    const auto &metadata = parseResult.reportMetadata;
+    if (metadata.type != ReportType::METAR ||
+        metadata.error != ReportError::NONE ||
+        metadata.isNil ||
+        !metadata.reportTime.has_value())
+    {
+        return false;
+    }
+    values.extract(parseResult, refDate);
+    result.station = values.station;
+    const auto station = StationFilter::packLocation(result.station);
+    if (!station.has_value())
+        return false;
+    const auto time = *values.time;
+
+    auto [s, created] = stations.try_emplace(*station);
+    auto &state = s->second;
+    if (!created && time < state.time)
+        return false;
+    state.time = time;
+
+    if (const auto category = flightCategory(values);
+        category != FlightCategory::UNKNOWN)
+    {
+        if (state.category != FlightCategory::UNKNOWN && state.category != category)
+        {
+            Event event;
+            event.type = Event::Type::FLIGHT_CATEGORY;
+            event.from = state.category;
+            event.to = category;
+            result.events.push_back(event);
+        }
+        state.category = category;
+    }
+
+    if (values.windSpeed.has_value())
+    {
+        const auto level = gustLevel(values.gustSpeed);
+        if (state.gustLevel >= 0)
+        {
+            // Thresholds reached are reported in ascending order, thresholds
+            // no longer reached in descending order
+            for (auto i = state.gustLevel; i < level; i++)
+            {
+                Event event;
+                event.type = Event::Type::GUST_ABOVE;
+                event.threshold = thresholds[i];
+                event.gust = values.gustSpeed;
+                result.events.push_back(event);
+            }
+            for (auto i = state.gustLevel; i > level; i--)
+            {
+                Event event;
+                event.type = Event::Type::GUST_BELOW;
+                event.threshold = thresholds[i - 1];
+                event.gust = values.gustSpeed;
+                result.events.push_back(event);
+            }
+        }
+        state.gustLevel = level;
+    }
+
+    if (!values.hasWeather(ReportValues::Weather::NOT_REPORTED))
+    {
+        const auto weather = trackedWeather(values);
+        if (state.weatherKnown)
+        {
+            for (const auto w : {Weather::TS, Weather::FZRA, Weather::SN})
+            {
+                const auto flag = static_cast<uint8_t>(w);
+                if ((state.weather & flag) == (weather & flag))
+                    continue;
+                Event event;
+                event.type = (weather & flag) ? Event::Type::ONSET
+                                              : Event::Type::CESSATION;
+                event.weather = w;
+                result.events.push_back(event);
+            }
+        }
+        state.weather = weather;
+        state.weatherKnown = true;
+    }
+    return true;
+}
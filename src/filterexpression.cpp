@@ -0,0 +1,666 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "filterexpression.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "metaf.hpp"
+
+#include "reportvalues.hpp"
+#include "utility.hpp"
+
+using namespace metaf;
+
+class FilterExpression::Node
+{
+public:
+    virtual ~Node() {}
+    virtual bool evaluate(const ParseResult &result) const = 0;
+};
+
+namespace
+{
+
+using NodePtr = std::unique_ptr<const FilterExpression::Node>;
+
+//////////////////////////////////////////////////////////////////////////////
+// Logical operations
+//////////////////////////////////////////////////////////////////////////////
+
+class OrNode : public FilterExpression::Node
+{
+public:
+    OrNode(NodePtr l, NodePtr r) : left(std::move(l)), right(std::move(r)) {}
+    bool evaluate(const ParseResult &result) const
+    {
+        return left->evaluate(result) || right->evaluate(result);
+    }
+
+private:
+    NodePtr left;
+    NodePtr right;
+};
+
+class AndNode : public FilterExpression::Node
+{
+public:
+    AndNode(NodePtr l, NodePtr r) : left(std::move(l)), right(std::move(r)) {}
+    bool evaluate(const ParseResult &result) const
+    {
+        return left->evaluate(result) && right->evaluate(result);
+    }
+
+private:
+    NodePtr left;
+    NodePtr right;
+};
+
+class NotNode : public FilterExpression::Node
+{
+public:
+    NotNode(NodePtr o) : operand(std::move(o)) {}
+    bool evaluate(const ParseResult &result) const
+    {
+        return !operand->evaluate(result);
+    }
+
+private:
+    NodePtr operand;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Comparison of numeric values
+//////////////////////////////////////////////////////////////////////////////
+
+// Values are compared in knots (speed), degrees (direction), meters
+// (distance and height), degrees Celsius (temperature) and hectopascal
+// (pressure)
+enum class Dimension
+{
+    SPEED,
+    DIRECTION,
+    DISTANCE,
+    TEMPERATURE,
+    PRESSURE
+};
+
+enum class Field
+{
+    WIND_SPEED,
+    GUST_SPEED,
+    WIND_DIRECTION,
+    VISIBILITY,
+    CEILING,
+    CLOUD_HEIGHT,
+    TEMPERATURE,
+    DEW_POINT,
+    PRESSURE
+};
+
+struct FieldInfo
+{
+    std::string_view name;
+    Field field;
+    Dimension dimension;
+    std::string_view defaultUnit;
+};
+
+const FieldInfo fields[] = {
+    {"wind_speed", Field::WIND_SPEED, Dimension::SPEED, "kt"},
+    {"gust_speed", Field::GUST_SPEED, Dimension::SPEED, "kt"},
+    {"wind_direction", Field::WIND_DIRECTION, Dimension::DIRECTION, "deg"},
+    {"visibility", Field::VISIBILITY, Dimension::DISTANCE, "m"},
+    {"ceiling", Field::CEILING, Dimension::DISTANCE, "ft"},
+    {"cloud_height", Field::CLOUD_HEIGHT, Dimension::DISTANCE, "ft"},
+    {"temperature", Field::TEMPERATURE, Dimension::TEMPERATURE, "c"},
+    {"dew_point", Field::DEW_POINT, Dimension::TEMPERATURE, "c"},
+    {"pressure", Field::PRESSURE, Dimension::PRESSURE, "hpa"},
+    {"qnh", Field::PRESSURE, Dimension::PRESSURE, "hpa"}};
+
+struct UnitInfo
+{
+    std::string_view name;
+    Dimension dimension;
+    double scale; // value in units used for comparison = value * scale + offset
+    double offset;
+};
+
+const UnitInfo units[] = {
+    {"kt", Dimension::SPEED, 1.0, 0.0},
+    {"mps", Dimension::SPEED, 1.943844, 0.0},
+    {"kmh", Dimension::SPEED, 0.539957, 0.0},
+    {"mph", Dimension::SPEED, 0.868976, 0.0},
+    {"deg", Dimension::DIRECTION, 1.0, 0.0},
+    {"m", Dimension::DISTANCE, 1.0, 0.0},
+    {"km", Dimension::DISTANCE, 1000.0, 0.0},
+    {"sm", Dimension::DISTANCE, 1609.344, 0.0},
+    {"ft", Dimension::DISTANCE, 0.3048, 0.0},
+    {"c", Dimension::TEMPERATURE, 1.0, 0.0},
+    {"f", Dimension::TEMPERATURE, 5.0 / 9.0, -32.0 * 5.0 / 9.0},
+    {"hpa", Dimension::PRESSURE, 1.0, 0.0},
+    {"mb", Dimension::PRESSURE, 1.0, 0.0},
+    {"inhg", Dimension::PRESSURE, 33.863886, 0.0},
+    {"mmhg", Dimension::PRESSURE, 1.333224, 0.0}};
+
+enum class Operator
+{
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL
+};
+
+// Value of the field in this group converted to units used for comparison
+std::optional<float> fieldValue(const Group &group, Field field)
+{
+    switch (field)
+    {
+    case Field::WIND_SPEED:
+        if (const auto g = std::get_if<WindGroup>(&group); g && ReportValues::isSurfaceWind(*g))
+            return g->windSpeed().toUnit(Speed::Unit::KNOTS);
+        break;
+    case Field::GUST_SPEED:
+        if (const auto g = std::get_if<WindGroup>(&group); g && ReportValues::isSurfaceWind(*g))
+            return g->gustSpeed().toUnit(Speed::Unit::KNOTS);
+        break;
+    case Field::WIND_DIRECTION:
+        if (const auto g = std::get_if<WindGroup>(&group); g && ReportValues::isSurfaceWind(*g))
+        {
+            if (const auto d = g->direction().degrees(); d.has_value())
+                return *d;
+        }
+        break;
+    case Field::VISIBILITY:
+        if (const auto g = std::get_if<VisibilityGroup>(&group))
+            return ReportValues::prevailingVisibility(*g);
+        if (const auto g = std::get_if<KeywordGroup>(&group))
+            return ReportValues::prevailingVisibility(*g);
+        break;
+    case Field::CEILING:
+        if (const auto g = std::get_if<CloudGroup>(&group); g && ReportValues::isCeiling(*g))
+        {
+            if (g->type() == CloudGroup::Type::VERTICAL_VISIBILITY)
+                return g->verticalVisibility().toUnit(Distance::Unit::METERS);
+            return g->height().toUnit(Distance::Unit::METERS);
+        }
+        break;
+    case Field::CLOUD_HEIGHT:
+        if (const auto g = std::get_if<CloudGroup>(&group);
+            g && g->type() == CloudGroup::Type::CLOUD_LAYER)
+        {
+            return g->height().toUnit(Distance::Unit::METERS);
+        }
+        break;
+    case Field::TEMPERATURE:
+        if (const auto g = std::get_if<TemperatureGroup>(&group))
+            return g->airTemperature().toUnit(Temperature::Unit::C);
+        break;
+    case Field::DEW_POINT:
+        if (const auto g = std::get_if<TemperatureGroup>(&group))
+            return g->dewPoint().toUnit(Temperature::Unit::C);
+        break;
+    case Field::PRESSURE:
+        if (const auto g = std::get_if<PressureGroup>(&group);
+            g && g->type() == PressureGroup::Type::OBSERVED_QNH)
+        {
+            return g->atmosphericPressure().toUnit(Pressure::Unit::HECTOPASCAL);
+        }
+        break;
+    }
+    return std::optional<float>();
+}
+
+class ComparisonNode : public FilterExpression::Node
+{
+public:
+    ComparisonNode(Field f, Operator o, double v) : field(f), op(o), value(v) {}
+    bool evaluate(const ParseResult &result) const
+    {
+        // Ceiling is the lowest of the cloud layers and is compared once
+        if (field == Field::CEILING)
+        {
+            std::optional<float> ceiling;
+            for (const auto &groupInfo : result.groups)
+            {
+                const auto v = fieldValue(groupInfo.group, field);
+                if (v.has_value() && (!ceiling.has_value() || *v < *ceiling))
+                    ceiling = v;
+            }
+            return ceiling.has_value() && compare(*ceiling);
+        }
+        for (const auto &groupInfo : result.groups)
+        {
+            if (const auto v = fieldValue(groupInfo.group, field);
+                v.has_value() && compare(*v))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    bool compare(double v) const
+    {
+        // Allow for rounding errors after unit conversion
+        static const double tolerance = 0.01;
+        switch (op)
+        {
+        case Operator::LESS:
+            return v < value - tolerance;
+        case Operator::LESS_EQUAL:
+            return v < value + tolerance;
+        case Operator::GREATER:
+            return v > value + tolerance;
+        case Operator::GREATER_EQUAL:
+            return v > value - tolerance;
+        case Operator::EQUAL:
+            return std::fabs(v - value) < tolerance;
+        case Operator::NOT_EQUAL:
+            return std::fabs(v - value) >= tolerance;
+        }
+        return false;
+    }
+
+    Field field;
+    Operator op;
+    double value;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Weather phenomena
+//////////////////////////////////////////////////////////////////////////////
+
+class WeatherNode : public FilterExpression::Node
+{
+public:
+    WeatherNode(std::optional<WeatherPhenomena::Qualifier> q,
+                std::optional<WeatherPhenomena::Descriptor> d,
+                std::vector<Weather> w)
+        : qualifier(q), descriptor(d), weather(std::move(w))
+    {
+    }
+    bool evaluate(const ParseResult &result) const
+    {
+        for (const auto &groupInfo : result.groups)
+        {
+            const auto g = std::get_if<WeatherGroup>(&groupInfo.group);
+            if (!g)
+                continue;
+            // Recent weather is only checked if the expression names it
+            const auto type = (qualifier == WeatherPhenomena::Qualifier::RECENT)
+                                  ? WeatherGroup::Type::RECENT
+                                  : WeatherGroup::Type::CURRENT;
+            if (g->type() != type)
+                continue;
+            for (const auto &p : g->weatherPhenomena())
+                if (matches(p))
+                    return true;
+        }
+        return false;
+    }
+
+private:
+    bool matches(const WeatherPhenomena &phenomena) const
+    {
+        if (qualifier.has_value() && phenomena.qualifier() != *qualifier)
+            return false;
+        // Weather in vicinity or recent weather is not weather at the station
+        if (!qualifier.has_value() &&
+            (phenomena.qualifier() == WeatherPhenomena::Qualifier::VICINITY ||
+             phenomena.qualifier() == WeatherPhenomena::Qualifier::RECENT))
+        {
+            return false;
+        }
+        if (descriptor.has_value() && phenomena.descriptor() != *descriptor)
+            return false;
+        const auto phenomenaWeather = phenomena.weather();
+        for (const auto w : weather)
+        {
+            if (std::find(phenomenaWeather.begin(), phenomenaWeather.end(), w) ==
+                phenomenaWeather.end())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::optional<WeatherPhenomena::Qualifier> qualifier;
+    std::optional<WeatherPhenomena::Descriptor> descriptor;
+    std::vector<Weather> weather;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Expression parser
+//////////////////////////////////////////////////////////////////////////////
+
+struct Token
+{
+    enum class Type
+    {
+        END,
+        IDENTIFIER,
+        NUMBER,
+        SYMBOL
+    };
+    Type type = Type::END;
+    std::string text;
+    double number = 0.0;
+    size_t position = 0;
+};
+
+class ExpressionParser
+{
+public:
+    ExpressionParser(std::string_view expression);
+    NodePtr parse();
+
+private:
+    NodePtr parseExpression();
+    NodePtr parseTerm();
+    NodePtr parseFactor();
+    NodePtr parseCondition();
+    NodePtr parseWeather();
+
+    const Token &peek() const { return tokens[current]; }
+    const Token &next() { return tokens[current < tokens.size() - 1 ? current++ : current]; }
+    bool accept(std::string_view text);
+    [[noreturn]] void error(const std::string &message, const Token &token) const;
+
+    std::vector<Token> tokens;
+    size_t current = 0;
+};
+
+ExpressionParser::ExpressionParser(std::string_view expression)
+{
+    static const std::string_view symbols[] = {
+        "<=", ">=", "==", "!=", "&&", "||", "<", ">", "=", "!", "(", ")", "+", "-"};
+    size_t pos = 0;
+    while (pos < expression.length())
+    {
+        const auto c = static_cast<unsigned char>(expression[pos]);
+        if (std::isspace(c))
+        {
+            pos++;
+            continue;
+        }
+        Token token;
+        token.position = pos;
+        if (std::isalpha(c) || c == '_')
+        {
+            const auto begin = pos;
+            while (pos < expression.length() &&
+                   (std::isalnum(static_cast<unsigned char>(expression[pos])) ||
+                    expression[pos] == '_'))
+            {
+                pos++;
+            }
+            token.type = Token::Type::IDENTIFIER;
+            token.text = expression.substr(begin, pos - begin);
+        }
+        else if (std::isdigit(c) || c == '.')
+        {
+            const std::string s(expression.substr(pos));
+            char *end = nullptr;
+            token.type = Token::Type::NUMBER;
+            token.number = std::strtod(s.c_str(), &end);
+            if (end == s.c_str())
+                error("Invalid number", token);
+            token.text = s.substr(0, end - s.c_str());
+            pos += token.text.length();
+        }
+        else
+        {
+            const auto symbol = std::find_if(
+                std::begin(symbols),
+                std::end(symbols),
+                [&](std::string_view sym) { return expression.substr(pos, sym.length()) == sym; });
+            if (symbol == std::end(symbols))
+                error("Unexpected character", token);
+            token.type = Token::Type::SYMBOL;
+            token.text = *symbol;
+            pos += symbol->length();
+        }
+        tokens.push_back(std::move(token));
+    }
+    Token end;
+    end.position = expression.length();
+    tokens.push_back(std::move(end));
+}
+
+void ExpressionParser::error(const std::string &message, const Token &token) const
+{
+    throw std::invalid_argument(
+        message + " at position " + std::to_string(token.position + 1) + " in filter expression");
+}
+
+bool ExpressionParser::accept(std::string_view text)
+{
+    const auto &t = peek();
+    if (t.type == Token::Type::NUMBER || t.type == Token::Type::END)
+        return false;
+    if (util::toLower(t.text) != text)
+        return false;
+    next();
+    return true;
+}
+
+NodePtr ExpressionParser::parse()
+{
+    auto result = parseExpression();
+    if (peek().type != Token::Type::END)
+        error("Unexpected " + peek().text, peek());
+    return result;
+}
+
+NodePtr ExpressionParser::parseExpression()
+{
+    auto left = parseTerm();
+    while (accept("or") || accept("||"))
+        left = std::make_unique<OrNode>(std::move(left), parseTerm());
+    return left;
+}
+
+NodePtr ExpressionParser::parseTerm()
+{
+    auto left = parseFactor();
+    while (accept("and") || accept("&&"))
+        left = std::make_unique<AndNode>(std::move(left), parseFactor());
+    return left;
+}
+
+NodePtr ExpressionParser::parseFactor()
+{
+    if (accept("not") || accept("!"))
+        return std::make_unique<NotNode>(parseFactor());
+    if (accept("("))
+    {
+        auto result = parseExpression();
+        if (!accept(")"))
+            error("Expected )", peek());
+        return result;
+    }
+    return parseCondition();
+}
+
+NodePtr ExpressionParser::parseCondition()
+{
+    const auto fieldToken = next();
+    if (fieldToken.type != Token::Type::IDENTIFIER)
+        error("Expected field name", fieldToken);
+    auto name = util::toLower(fieldToken.text);
+    if (name == "weather")
+        return parseWeather();
+
+    auto findField = [](std::string_view n) {
+        return std::find_if(std::begin(fields),
+                            std::end(fields),
+                            [n](const FieldInfo &f) { return f.name == n; });
+    };
+    auto field = findField(name);
+    // Field name may consist of two words, e.g. "wind speed"
+    if (field == std::end(fields) && peek().type == Token::Type::IDENTIFIER)
+    {
+        field = findField(name + "_" + util::toLower(peek().text));
+        if (field != std::end(fields))
+            next();
+    }
+    if (field == std::end(fields))
+        error("Unknown field " + fieldToken.text, fieldToken);
+
+    static const std::pair<std::string_view, Operator> operators[] = {
+        {"<", Operator::LESS},
+        {"<=", Operator::LESS_EQUAL},
+        {">", Operator::GREATER},
+        {">=", Operator::GREATER_EQUAL},
+        {"=", Operator::EQUAL},
+        {"==", Operator::EQUAL},
+        {"!=", Operator::NOT_EQUAL}};
+    const auto opToken = next();
+    const auto op = std::find_if(
+        std::begin(operators),
+        std::end(operators),
+        [&](const auto &o) { return opToken.type == Token::Type::SYMBOL && o.first == opToken.text; });
+    if (op == std::end(operators))
+        error("Expected comparison operator", opToken);
+
+    const bool negative = accept("-");
+    const auto valueToken = next();
+    if (valueToken.type != Token::Type::NUMBER)
+        error("Expected number", valueToken);
+    const auto value = negative ? -valueToken.number : valueToken.number;
+
+    auto unitName = std::string(field->defaultUnit);
+    if (peek().type == Token::Type::IDENTIFIER)
+    {
+        // Identifier after number is a unit unless it is a logical operator
+        const auto s = util::toLower(peek().text);
+        if (s != "and" && s != "or" && s != "not")
+            unitName = util::toLower(next().text);
+    }
+    const auto unit = std::find_if(std::begin(units),
+                                   std::end(units),
+                                   [&](const UnitInfo &u) { return u.name == unitName; });
+    if (unit == std::end(units) || unit->dimension != field->dimension)
+        error("Unit " + unitName + " is not valid for " + std::string(field->name), valueToken);
+
+    return std::make_unique<ComparisonNode>(
+        field->field, op->second, value * unit->scale + unit->offset);
+}
+
+NodePtr ExpressionParser::parseWeather()
+{
+    if (!accept("contains"))
+        error("Expected contains", peek());
+
+    std::optional<WeatherPhenomena::Qualifier> qualifier;
+    if (accept("+"))
+        qualifier = WeatherPhenomena::Qualifier::HEAVY;
+    else if (accept("-"))
+        qualifier = WeatherPhenomena::Qualifier::LIGHT;
+
+    const auto codeToken = next();
+    if (codeToken.type != Token::Type::IDENTIFIER || codeToken.text.length() % 2)
+        error("Expected weather phenomena code", codeToken);
+
+    static const std::pair<std::string_view, WeatherPhenomena::Descriptor> descriptors[] = {
+        {"MI", WeatherPhenomena::Descriptor::SHALLOW},
+        {"PR", WeatherPhenomena::Descriptor::PARTIAL},
+        {"BC", WeatherPhenomena::Descriptor::PATCHES},
+        {"DR", WeatherPhenomena::Descriptor::LOW_DRIFTING},
+        {"BL", WeatherPhenomena::Descriptor::BLOWING},
+        {"SH", WeatherPhenomena::Descriptor::SHOWERS},
+        {"TS", WeatherPhenomena::Descriptor::THUNDERSTORM},
+        {"FZ", WeatherPhenomena::Descriptor::FREEZING}};
+    static const std::pair<std::string_view, Weather> weatherCodes[] = {
+        {"DZ", Weather::DRIZZLE},
+        {"RA", Weather::RAIN},
+        {"SN", Weather::SNOW},
+        {"SG", Weather::SNOW_GRAINS},
+        {"IC", Weather::ICE_CRYSTALS},
+        {"PL", Weather::ICE_PELLETS},
+        {"GR", Weather::HAIL},
+        {"GS", Weather::SMALL_HAIL},
+        {"UP", Weather::UNDETERMINED},
+        {"BR", Weather::MIST},
+        {"FG", Weather::FOG},
+        {"FU", Weather::SMOKE},
+        {"VA", Weather::VOLCANIC_ASH},
+        {"DU", Weather::DUST},
+        {"SA", Weather::SAND},
+        {"HZ", Weather::HAZE},
+        {"PY", Weather::SPRAY},
+        {"PO", Weather::DUST_WHIRLS},
+        {"SQ", Weather::SQUALLS},
+        {"FC", Weather::FUNNEL_CLOUD},
+        {"SS", Weather::SANDSTORM},
+        {"DS", Weather::DUSTSTORM}};
+
+    std::optional<WeatherPhenomena::Descriptor> descriptor;
+    std::vector<Weather> weather;
+    std::string code = codeToken.text;
+    std::transform(code.begin(), code.end(), code.begin(), [](unsigned char c) {
+        return static_cast<char>(std::toupper(c));
+    });
+    for (auto i = 0u; i < code.length(); i += 2)
+    {
+        const auto s = std::string_view(code).substr(i, 2);
+        if (s == "VC" && !i && !qualifier.has_value())
+        {
+            qualifier = WeatherPhenomena::Qualifier::VICINITY;
+            continue;
+        }
+        if (s == "RE" && !i && !qualifier.has_value())
+        {
+            qualifier = WeatherPhenomena::Qualifier::RECENT;
+            continue;
+        }
+        const auto d = std::find_if(std::begin(descriptors),
+                                    std::end(descriptors),
+                                    [s](const auto &e) { return e.first == s; });
+        if (d != std::end(descriptors) && !descriptor.has_value() && weather.empty())
+        {
+            descriptor = d->second;
+            continue;
+        }
+        const auto w = std::find_if(std::begin(weatherCodes),
+                                    std::end(weatherCodes),
+                                    [s](const auto &e) { return e.first == s; });
+        if (w == std::end(weatherCodes))
+            error("Weather phenomena " + codeToken.text + " is not recognised", codeToken);
+        weather.push_back(w->second);
+    }
+    return std::make_unique<WeatherNode>(qualifier, descriptor, std::move(weather));
+}
+
+} // namespace
+
+FilterExpression::FilterExpression(std::string_view expression)
+    : root(ExpressionParser(expression).parse())
+{
+}
+
+FilterExpression::~FilterExpression()
+{
+}
+
+bool FilterExpression::matches(const ParseResult &result) const
+{
+    return root->evaluate(result);
+}
@@ -0,0 +1,120 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "groupfilter.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <variant>
+
+#include "metaf.hpp"
+
+#include "utility.hpp"
+
+namespace
+{
+
+// Index of type T in std::variant V
+template <typename T, typename V>
+struct VariantIndex;
+
+template <typename T, typename... Ts>
+struct VariantIndex<T, std::variant<Ts...>>
+{
+    static constexpr size_t index()
+    {
+        constexpr bool matches[] = {std::is_same_v<T, Ts>...};
+        for (auto i = 0u; i < sizeof...(Ts); i++)
+            if (matches[i])
+                return i;
+        return sizeof...(Ts);
+    }
+};
+
+template <typename T>
+constexpr size_t kind = VariantIndex<T, metaf::Group>::index();
+
+struct GroupName
+{
+    size_t kind;
+    std::string_view name;
+};
+
+// Group names are the same as "group" values in JSON output
+constexpr GroupName groupNames[] = {
+    {kind<metaf::KeywordGroup>, "keyword"},
+    {kind<metaf::LocationGroup>, "icao_location"},
+    {kind<metaf::ReportTimeGroup>, "report_time"},
+    {kind<metaf::TrendGroup>, "trend"},
+    {kind<metaf::WindGroup>, "wind"},
+    {kind<metaf::VisibilityGroup>, "visibility"},
+    {kind<metaf::CloudGroup>, "cloud"},
+    {kind<metaf::WeatherGroup>, "weather"},
+    {kind<metaf::TemperatureGroup>, "temperature"},
+    {kind<metaf::PressureGroup>, "pressure"},
+    {kind<metaf::RunwayStateGroup>, "runway_state"},
+    {kind<metaf::SeaSurfaceGroup>, "sea_surface"},
+    {kind<metaf::MinMaxTemperatureGroup>, "min_max_temperature"},
+    {kind<metaf::PrecipitationGroup>, "precipitation"},
+    {kind<metaf::LayerForecastGroup>, "layer_forecast"},
+    {kind<metaf::PressureTendencyGroup>, "pressure_tendency"},
+    {kind<metaf::CloudTypesGroup>, "cloud_types"},
+    {kind<metaf::LowMidHighCloudGroup>, "low_mid_high_clouds"},
+    {kind<metaf::LightningGroup>, "lightning"},
+    {kind<metaf::VicinityGroup>, "vicinity"},
+    {kind<metaf::MiscGroup>, "misc"},
+    {kind<metaf::UnknownGroup>, "unknown"}};
+
+} // namespace
+
+GroupFilter::GroupFilter(std::string_view list)
+{
+    static_assert(std::variant_size_v<metaf::Group> <= maxGroupKinds,
+                  "Too many group types in metaf::Group");
+    while (!list.empty())
+    {
+        const auto comma = list.find(',');
+        const auto name = list.substr(0, comma);
+        if (!name.empty())
+        {
+            const auto k = groupKind(util::toLower(name));
+            if (!k.has_value())
+                throw std::invalid_argument("Group " + std::string(name) + " is not recognised");
+            groupKinds.set(*k);
+        }
+        if (comma == std::string_view::npos)
+            break;
+        list.remove_prefix(comma + 1);
+    }
+    if (groupKinds.none())
+        throw std::invalid_argument("No groups specified");
+}
+
+std::optional<size_t> GroupFilter::groupKind(std::string_view name)
+{
+    // "location" is accepted as a shorter alias
+    if (name == "location")
+        return kind<metaf::LocationGroup>;
+    const auto it = std::find_if(std::begin(groupNames),
+                                 std::end(groupNames),
+                                 [name](const GroupName &g) { return g.name == name; });
+    if (it == std::end(groupNames))
+        return std::optional<size_t>();
+    return it->kind;
+}
+
+std::string_view GroupFilter::groupName(size_t groupKind)
+{
+    const auto it = std::find_if(std::begin(groupNames),
+                                 std::end(groupNames),
+                                 [groupKind](const GroupName &g) { return g.kind == groupKind; });
+    if (it == std::end(groupNames))
+        return std::string_view();
+    return it->name;
+}
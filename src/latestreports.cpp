@@ -0,0 +1,54 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "latestreports.hpp"
+
+#include <algorithm>
+
+#include "reportkey.hpp"
+
+static bool isTaf(std::string_view report)
+{
+    const auto begin = report.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos)
+        return false;
+    report.remove_prefix(begin);
+    const auto token = report.substr(0, report.find_first_of(" \t\r\n"));
+    return token == "TAF";
+}
+
+bool LatestReports::add(const std::string &report, const RefDate &refDate)
+{
+    const auto key = ReportKey::fromReport(report, refDate);
+    if (!key.has_value())
+        return false;
+    const auto slotKey = (uint64_t(key->station) << 1) | (isTaf(report) ? 1 : 0);
+    auto [slot, created] = slots.try_emplace(slotKey);
+    if (!created && key->time < slot->second.time)
+        return false;
+    auto &s = slot->second;
+    s.time = key->time;
+    s.report = report;
+    s.refDate = refDate;
+    if (!s.updated)
+        updated.push_back(slotKey);
+    s.updated = true;
+    return true;
+}
+
+void LatestReports::flush(const Output &output)
+{
+    std::sort(updated.begin(), updated.end());
+    for (const auto slotKey : updated)
+    {
+        auto &s = slots.at(slotKey);
+        s.updated = false;
+        output(s.report, s.refDate);
+    }
+    updated.clear();
+}
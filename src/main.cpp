@@ -6,10 +6,34 @@
 * of the MIT license. See the LICENSE file for details.
 */
 
+#include <chrono>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include "commandlineargs.hpp"
 #include "utility.hpp"
 #include "outputformat.hpp"
+#include "outputformatbasic.hpp"
+#include "outputformatevents.hpp"
+#include "reportreader.hpp"
+#include "stationfilter.hpp"
+#include "validator.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+#include "archiveindex.hpp"
+#include "outputindex.hpp"
+#include "parsecache.hpp"
+#include "outputfanout.hpp"
+#include "conversioncache.hpp"
+#include "sortedoutput.hpp"
+#include "partitionedoutput.hpp"
+#include "deduplicator.hpp"
+#include "latestreports.hpp"
+#include "aggregator.hpp"
+#include "sketches.hpp"
+#include "encoder.hpp"
+#include "metaf.hpp"
+#include "nlohmann/json.hpp"
 
 int main(int argc, char *argv[])
 {
@@ -21,9 +45,485 @@ int main(int argc, char *argv[])
     }
 
     const auto outputFormat = util::makeOutputFormat(*args);
-    
-    for (std::string report; getline(std::cin, report); ) {
-        outputFormat->toJson(report, std::cout);
+    std::unique_ptr<StationFilter> stationFilter;
+    try {
+        stationFilter = util::makeStationFilter(*args);
     }
-    return 0;
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return(EXIT_FAILURE);
+    }
+
+    // Compressed output is written to stdout by worker threads
+    std::unique_ptr<CompressedOutput> compressedOutput;
+    if (auto compressor = util::makeCompressor(*args); compressor && args->partitionBy().empty())
+        compressedOutput = std::make_unique<CompressedOutput>(
+            std::cout, std::move(compressor), args->threads());
+    // Bytes written are counted to index the output records
+    std::unique_ptr<CountingOutput> countingOutput;
+    std::unique_ptr<OutputIndex::Builder> outputIndex;
+    if (!args->outputIndex().empty()) {
+        countingOutput = std::make_unique<CountingOutput>(std::cout.rdbuf());
+        outputIndex = std::make_unique<OutputIndex::Builder>();
+    }
+    std::ostream output(compressedOutput ? compressedOutput.get() : 
+        countingOutput ? countingOutput.get() : std::cout.rdbuf());
+    // Sorted records are kept until all reports are serialised
+    std::unique_ptr<SortedOutput> sortedOutput;
+    if (args->sortOutput())
+        sortedOutput = std::make_unique<SortedOutput>(args->sortMemory() * 1024 * 1024, args->threads());
+    std::ostream sortedRecord(sortedOutput.get());
+    auto sortFailed = false;
+    // Records are written to partition files rather than stdout
+    std::unique_ptr<Partitioning> partitioning;
+    std::unique_ptr<PartitionedOutput> partitionedOutput;
+    if (!args->partitionBy().empty()) {
+        partitioning = std::make_unique<Partitioning>(args->partitionBy(), args->partitionPath());
+        partitionedOutput = std::make_unique<PartitionedOutput>(
+            util::makeCompressor(*args), args->partitionOpenFiles(), args->threads());
+    }
+    std::ostream partitionRecord(partitionedOutput.get());
+    // Parsed reports are cached in addition to the output
+    std::ofstream parsedFile;
+    std::unique_ptr<ParseCache::Writer> parsedOutput;
+    if (!args->emitParsed().empty()) {
+        parsedFile.open(args->emitParsed(), std::ios::binary);
+        if (!parsedFile) {
+            std::cerr << "Cannot open parse cache file " << args->emitParsed() << std::endl;
+            return(EXIT_FAILURE);
+        }
+        parsedOutput = std::make_unique<ParseCache::Writer>(parsedFile);
+    }
+    // Additional outputs are serialised from the same parsed reports by 
+    // worker threads
+    std::vector<std::unique_ptr<OutputFile>> outputFiles;
+    std::unique_ptr<OutputFanOut> fanOut;
+    if (!args->additionalOutputs().empty()) {
+        try {
+            fanOut = std::make_unique<OutputFanOut>(args->threads());
+            for (const auto &spec : args->additionalOutputs()) {
+                const auto settings = args->forOutput(spec);
+                outputFiles.push_back(std::make_unique<OutputFile>(
+                    spec.file, util::makeCompressor(settings), args->threads()));
+                if (settings.outputFormat() == Settings::OutputFormat::EVENTS)
+                    fanOut->addOutput(std::make_unique<OutputFormatEvents::Detector>(
+                        util::makeOutputFormatEvents(settings)), *outputFiles.back());
+                else
+                    fanOut->addOutput(util::makeOutputFormat(settings), *outputFiles.back());
+            }
+        }
+        catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return(EXIT_FAILURE);
+        }
+    }
+    // Output of converted reports is kept in the cache shared by the runs
+    std::unique_ptr<ConversionCache> cache;
+    if (!args->cacheDir().empty()) {
+        try {
+            cache = std::make_unique<ConversionCache>(args->cacheDir(), 
+                util::conversionSettings(*args), args->cacheSize() * 1024 * 1024);
+        }
+        catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return(EXIT_FAILURE);
+        }
+    }
+    auto printCacheStats = [&]() {
+        const auto stats = cache->statistics();
+        const auto lookups = stats.hits + stats.misses;
+        std::cerr << "Conversion cache: " << stats.hits << " hits, " << stats.misses << " misses";
+        if (lookups) std::cerr << " (" << stats.hits * 100 / lookups << "% hit rate)";
+        std::cerr << ", " << stats.added << " added, " << stats.entries << " entries, ";
+        std::cerr << stats.size << " bytes, " << stats.compactions << " compactions";
+        if (stats.rebuilt) std::cerr << ", index rebuilt";
+        std::cerr << std::endl;
+    };
+
+    // Reports are aggregated by worker threads rather than converted
+    std::unique_ptr<Aggregator> aggregator;
+    if (args->aggregate())
+        aggregator = std::make_unique<Aggregator>(args->threads());
+    auto aggregateFailed = false;
+    // Reports are summarised with sketches by worker threads rather than converted
+    std::unique_ptr<Sketcher> sketcher;
+    if (args->sketch())
+        sketcher = std::make_unique<Sketcher>(args->threads());
+    auto sketchFailed = false;
+    // Reports serialised as delta depend on the previous report of the station;
+    // additional outputs are serialised in full
+    std::unique_ptr<OutputFormatBasic::Delta> delta;
+    if (args->delta())
+        delta = std::make_unique<OutputFormatBasic::Delta>(util::makeOutputFormatBasic(*args));
+    // Events depend on the previous reports of the station
+    std::unique_ptr<OutputFormatEvents::Detector> events;
+    if (args->outputFormat() == Settings::OutputFormat::EVENTS)
+        events = std::make_unique<OutputFormatEvents::Detector>(util::makeOutputFormatEvents(*args));
+
+    // Write aggregated, summarised or sorted records and the output held back by the format
+    auto finishFormat = [&]() {
+        if (sketcher) {
+            try {
+                auto sketches = sketcher->finish();
+                for (const auto &file : args->sketchMerge()) {
+                    std::ifstream in(file, std::ios::binary);
+                    if (!in) throw(std::runtime_error("Cannot open sketch file " + file));
+                    ReportSketches saved;
+                    saved.read(in);
+                    sketches.merge(saved);
+                }
+                if (!args->sketchSave().empty()) {
+                    std::ofstream out(args->sketchSave(), std::ios::binary);
+                    sketches.write(out);
+                    out.close();
+                    if (!out) throw(std::runtime_error("Cannot write sketch file " + args->sketchSave()));
+                }
+                util::makeEncoder(*args)->write(sketches.toJson(), output);
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Cannot summarise reports: " << e.what() << std::endl;
+                sketchFailed = true;
+            }
+            return;
+        }
+        if (aggregator) {
+            try {
+                aggregator->finish(*util::makeEncoder(*args), output);
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Cannot aggregate reports: " << e.what() << std::endl;
+                aggregateFailed = true;
+            }
+            return;
+        }
+        if (sortedOutput && !sortFailed) {
+            try {
+                sortedOutput->finish([&](const std::optional<ReportKey> &key, std::string_view record) {
+                    if (outputIndex && key.has_value())
+                        outputIndex->add(*key, countingOutput->count(), record.length());
+                    output.write(record.data(), record.length());
+                });
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Cannot sort output: " << e.what() << std::endl;
+                sortFailed = true;
+            }
+        }
+        outputFormat->finish(output);
+    };
+    auto finishOutput = [&]() {
+        output.flush();
+        if (compressedOutput) compressedOutput->finish();
+        if (cache && args->cacheStats()) printCacheStats();
+        auto ok = !sortFailed && !aggregateFailed && !sketchFailed;
+        if (partitionedOutput && !partitionedOutput->finish()) {
+            for (const auto &file : partitionedOutput->failedFiles())
+                std::cerr << "Cannot write partition file " << file << std::endl;
+            ok = false;
+        }
+        if (fanOut) {
+            fanOut->finish();
+            for (const auto &file : outputFiles) {
+                if (!file->finish()) {
+                    std::cerr << "Cannot write output file " << file->name() << std::endl;
+                    ok = false;
+                }
+            }
+        }
+        if (parsedOutput) {
+            parsedOutput->finish();
+            if (!parsedFile) {
+                std::cerr << "Cannot write parse cache file " << args->emitParsed() << std::endl;
+                ok = false;
+            }
+        }
+        if (!outputIndex) return ok;
+        std::ofstream index(args->outputIndex(), std::ios::binary);
+        try {
+            outputIndex->write(index, countingOutput->count());
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Cannot write output index " << args->outputIndex() << ": " 
+                      << e.what() << std::endl;
+            return false;
+        }
+        return ok;
+    };
+
+    std::unique_ptr<Validator> validator;
+    // Repeated reports are removed before they are converted
+    std::unique_ptr<Deduplicator> deduplicator;
+    if (args->dedup())
+        deduplicator = std::make_unique<Deduplicator>(args->dedupMemory() * 1024 * 1024);
+    // Only the newest reports are kept and converted
+    std::unique_ptr<LatestReports> latestReports;
+    if (args->latest())
+        latestReports = std::make_unique<LatestReports>();
+    auto latestWritten = std::chrono::steady_clock::now();
+    if (args->validate())
+        validator = std::make_unique<Validator>(args->listFailedLines());
+
+    // Key of the parsed report, or of the raw report if it was not parsed
+    // (cached output is written without parsing the report)
+    auto reportKey = [](const std::string &text,
+                        const RefDate &refDate,
+                        const metaf::ParseResult *parseResult) {
+        if (parseResult) return ReportKey::fromParseResult(*parseResult, refDate);
+        return ReportKey::fromReport(text, refDate);
+    };
+    // Serialise report with f and index the output record, or keep the record
+    // to be sorted
+    auto writeReport = [&](const std::string &text,
+                           const RefDate &refDate,
+                           const metaf::ParseResult *parseResult,
+                           auto f) {
+        if (sortedOutput) {
+            if (sortFailed) return;
+            try {
+                f(sortedRecord);
+                sortedOutput->endRecord(reportKey(text, refDate, parseResult));
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Cannot sort output: " << e.what() << std::endl;
+                sortFailed = true;
+            }
+            return;
+        }
+        if (!outputIndex) {
+            f(output);
+            return;
+        }
+        // Reports which are filtered out do not produce output records
+        const auto offset = countingOutput->count();
+        f(output);
+        const auto length = countingOutput->count() - offset;
+        if (!length) return;
+        if (const auto key = reportKey(text, refDate, parseResult); key.has_value())
+            outputIndex->add(*key, offset, length);
+    };
+    // Partition of the record is found from the parsed report
+    auto writePartition = [&](const std::string &text,
+                              const RefDate &refDate,
+                              const metaf::ParseResult &parseResult) {
+        outputFormat->toJson(parseResult, refDate, partitionRecord);
+        partitionedOutput->endRecord(partitioning->path(text, parseResult, refDate));
+    };
+    // Cached output is written without parsing the report; output of other
+    // reports is added to the cache unless an exception occurred
+    std::string cachedOutput;
+    std::ostringstream convertedOutput;
+    auto convertCached = [&](const std::string &text, const RefDate &refDate, std::ostream &out) {
+        auto written = false;
+        try {
+            cachedOutput.clear();
+            if (cache->find(text, refDate, cachedOutput)) {
+                out.write(cachedOutput.data(), cachedOutput.length());
+                return;
+            }
+            convertedOutput.str(std::string());
+            const auto result = outputFormat->toJson(text, refDate, convertedOutput);
+            const auto converted = convertedOutput.str();
+            out.write(converted.data(), converted.length());
+            written = true;
+            if (result != OutputFormat::Result::EXCEPTION)
+                cache->add(text, refDate, converted);
+        }
+        catch (const std::exception &e) {
+            // Conversion continues without cache
+            std::cerr << "Conversion cache error: " << e.what() << std::endl;
+            if (args->cacheStats()) printCacheStats();
+            cache.reset();
+            if (!written) outputFormat->toJson(text, refDate, out);
+        }
+    };
+    auto convert = [&](const std::string &text, const RefDate &refDate, std::ostream &out) {
+        if (delta) delta->toJson(text, refDate, out);
+        else if (events) events->toJson(text, refDate, out);
+        else outputFormat->toJson(text, refDate, out);
+    };
+    auto convertParsed = [&](const metaf::ParseResult &parseResult, 
+                             const RefDate &refDate, 
+                             std::ostream &out) {
+        if (delta) delta->toJson(parseResult, refDate, out);
+        else if (events) events->toJson(parseResult, refDate, out);
+        else outputFormat->toJson(parseResult, refDate, out);
+    };
+    auto convertReport = [&](const std::string &text, const RefDate &refDate, size_t lineNumber) {
+        if (validator) {
+            validator->validate(text, lineNumber);
+            return;
+        }
+        if (aggregator) {
+            aggregator->add(text, refDate);
+            return;
+        }
+        if (sketcher) {
+            sketcher->add(text, refDate);
+            return;
+        }
+        if (cache) {
+            writeReport(text, refDate, nullptr, [&](std::ostream &out) { convertCached(text, refDate, out); });
+            return;
+        }
+        // Sorted and indexed records are keyed by the parsed report
+        if (!parsedOutput && !fanOut && !partitioning && !sortedOutput && !outputIndex) {
+            writeReport(text, refDate, nullptr, [&](std::ostream &out) { convert(text, refDate, out); });
+            return;
+        }
+        // Report is parsed once for all outputs
+        try {
+            auto parseResult = metaf::Parser::parse(text);
+            if (parsedOutput) parsedOutput->add(text, refDate, parseResult);
+            if (partitioning) writePartition(text, refDate, parseResult);
+            else writeReport(text, refDate, &parseResult, [&](std::ostream &out) {
+                convertParsed(parseResult, refDate, out);
+            });
+            if (fanOut) fanOut->add(text, refDate, std::move(parseResult));
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Exception " << e.what();
+            std::cerr << " occurred when parsing the following report:" << std::endl;
+            std::cerr << text << std::endl;
+        }
+    };
+    auto writeLatest = [&]() {
+        latestReports->flush([&](const std::string &text, const RefDate &refDate) {
+            convertReport(text, refDate, 0);
+        });
+    };
+    auto keepLatest = [&](const std::string &text, const RefDate &refDate) {
+        latestReports->add(text, refDate);
+        if (!args->latestInterval()) return;
+        const auto now = std::chrono::steady_clock::now();
+        if (now - latestWritten < std::chrono::seconds(args->latestInterval())) return;
+        writeLatest();
+        output.flush();
+        latestWritten = now;
+    };
+    auto processReport = [&](const std::string &text, const RefDate &refDate, size_t lineNumber) {
+        // Reject reports from other stations before parsing
+        if (!stationFilter->matches(text)) return;
+        if (deduplicator) deduplicator->add(text, refDate, lineNumber, convertReport);
+        else if (latestReports) keepLatest(text, refDate);
+        else convertReport(text, refDate, lineNumber);
+    };
+    auto processParsed = [&](const std::string &text, 
+                             const RefDate &refDate, 
+                             const metaf::ParseResult &parseResult) {
+        if (!stationFilter->matches(text)) return;
+        if (partitioning) writePartition(text, refDate, parseResult);
+        else writeReport(text, refDate, &parseResult, [&](std::ostream &out) {
+            convertParsed(parseResult, refDate, out);
+        });
+        if (fanOut) fanOut->add(text, refDate, parseResult);
+    };
+    auto process = [&](std::istream &input, const RefDate &refDate) {
+        ReportReader reader(input, args->refDateSource(), refDate);
+        for (ReportReader::Report report; reader.next(report); )
+            processReport(report.text, report.refDate, report.lineNumber);
+    };
+    // Only the reports selected via index are decompressed; reference date
+    // is the date of the report time stored in the index
+    auto processIndexed = [&](std::istream &input, const std::string &fileName) {
+        const ArchiveIndex index(ArchiveIndex::fileName(fileName));
+        const auto selected = 
+            index.select(stationFilter->packedStations(), args->timeFrom(), args->timeTo());
+        index.read(input, selected, [&](const std::string &text, const ArchiveIndex::Entry &e) {
+            processReport(text, RefDate::fromUnixTime(e.time), 0);
+        });
+    };
+
+    // Output which precedes all reports (e.g. schema) is written before any
+    // report is converted
+    if (!validator && !aggregator && !sketcher && !args->buildIndex())
+        outputFormat->start(output);
+
+    if (!args->fromParsed().empty()) {
+        auto status = EXIT_SUCCESS;
+        try {
+            const ParseCache cache(args->fromParsed());
+            cache.read(processParsed);
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Cannot read parse cache file " << args->fromParsed() << ": " 
+                      << e.what() << std::endl;
+            status = EXIT_FAILURE;
+        }
+        finishFormat();
+        if (!finishOutput()) status = EXIT_FAILURE;
+        return status;
+    }
+    if (args->inputFiles().empty()) {
+        process(std::cin, args->refDate());
+        if (deduplicator) deduplicator->finish(convertReport);
+        if (latestReports) writeLatest();
+        if (validator) validator->printSummary(output);
+        else finishFormat();
+        return finishOutput() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    auto status = EXIT_SUCCESS;
+    for (const auto &fileName : args->inputFiles()) {
+        if (validator) validator->setInputName(fileName);
+        std::ifstream input(fileName, std::ios::binary);
+        if (!input) {
+            std::cerr << "Cannot open input file " << fileName << std::endl;
+            status = EXIT_FAILURE;
+            continue;
+        }
+        auto refDate = args->refDate();
+        if (args->refDateSource() == CommandLineArgs::RefDateSource::FILENAME) {
+            if (const auto d = RefDate::fromFileName(fileName); d.has_value())
+                refDate = *d;
+            else
+                std::cerr << "No date found in file name " << fileName
+                          << ", using default reference date" << std::endl;
+        }
+        if (args->buildIndex()) {
+            try {
+                std::ofstream index(ArchiveIndex::fileName(fileName), std::ios::binary);
+                ArchiveIndex::build(input, index, args->refDateSource(), refDate);
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Cannot index input file " << fileName << ": " << e.what() << std::endl;
+                status = EXIT_FAILURE;
+            }
+            continue;
+        }
+        if (args->useIndex()) {
+            try {
+                processIndexed(input, fileName);
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Cannot read input file " << fileName << ": " << e.what() << std::endl;
+                status = EXIT_FAILURE;
+            }
+            continue;
+        }
+        const auto format = DecompressedInput::detect(input);
+        if (format == DecompressedInput::Format::NONE) {
+            process(input, refDate);
+            continue;
+        }
+        try {
+            DecompressedInput decompressed(input, format, args->threads());
+            std::istream decompressedInput(&decompressed);
+            process(decompressedInput, refDate);
+            if (!decompressed.error().empty()) {
+                std::cerr << "Cannot decompress input file " << fileName << ": "
+                          << decompressed.error() << std::endl;
+                status = EXIT_FAILURE;
+            }
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Cannot read input file " << fileName << ": " << e.what() << std::endl;
+            status = EXIT_FAILURE;
+        }
+    }
+    if (args->buildIndex()) return status;
+    if (deduplicator) deduplicator->finish(convertReport);
+    if (latestReports) writeLatest();
+    if (validator) validator->printSummary(output);
+    else finishFormat();
+    if (!finishOutput()) status = EXIT_FAILURE;
+    return status;
 }
@@ -0,0 +1,48 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "mappedfile.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &fileName)
+{
+    const auto fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw(std::runtime_error("Cannot open file " + fileName));
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        throw(std::runtime_error("Cannot get size of file " + fileName));
+    }
+    length = st.st_size;
+    // Empty file cannot be mapped
+    if (length)
+    {
+        address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            close(fd);
+            throw(std::runtime_error("Cannot map file " + fileName));
+        }
+    }
+    // Mapping remains valid after file is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (length)
+        munmap(address, length);
+}
@@ -0,0 +1,123 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "outputfanout.hpp"
+
+#include <stdexcept>
+
+//////////////////////////////////////////////////////////////////////////////
+// OutputFanOut
+//////////////////////////////////////////////////////////////////////////////
+
+OutputFanOut::OutputFanOut(size_t threads, size_t batchSize)
+    : batchSize(batchSize ? batchSize : 1), pool(threads)
+{
+    batch.reserve(this->batchSize);
+    submitted.reserve(this->batchSize);
+}
+
+OutputFanOut::~OutputFanOut()
+{
+    for (auto &o : outputs)
+        if (o.done.valid())
+            o.done.wait();
+}
+
+void OutputFanOut::addOutput(std::unique_ptr<const OutputFormat> format, std::ostream &out)
+{
+    if (!batch.empty() || !submitted.empty())
+        throw(std::logic_error("Outputs must be added before reports"));
+    format->start(out);
+    outputs.push_back(Output{std::move(format), nullptr, &out, std::future<void>()});
+}
+
+void OutputFanOut::addOutput(std::unique_ptr<OutputFormatEvents::Detector> events,
+                             std::ostream &out)
+{
+    if (!batch.empty() || !submitted.empty())
+        throw(std::logic_error("Outputs must be added before reports"));
+    events->outputFormat().start(out);
+    outputs.push_back(Output{nullptr, std::move(events), &out, std::future<void>()});
+}
+
+void OutputFanOut::add(std::string report, const RefDate &refDate, metaf::ParseResult parseResult)
+{
+    batch.push_back(Parsed{std::move(report), refDate, std::move(parseResult)});
+    if (batch.size() >= batchSize)
+        submitBatch();
+}
+
+void OutputFanOut::finish()
+{
+    submitBatch();
+    wait();
+    for (auto &o : outputs)
+    {
+        if (o.events)
+            o.events->outputFormat().finish(*o.out);
+        else
+            o.format->finish(*o.out);
+    }
+}
+
+// Wait until each output has serialised the submitted batch; exceptions
+// thrown by workers are rethrown here
+void OutputFanOut::wait()
+{
+    for (auto &o : outputs)
+        if (o.done.valid())
+            o.done.get();
+}
+
+void OutputFanOut::submitBatch()
+{
+    wait();
+    submitted.swap(batch);
+    batch.clear();
+    if (submitted.empty())
+        return;
+    // Each output is serialised by one task at a time, so output formats
+    // which keep state between reports need no locking
+    for (auto &o : outputs)
+    {
+        o.done = pool.submit([&o, this]() {
+            for (const auto &p : submitted)
+            {
+                if (o.events)
+                    o.events->toJson(p.parseResult, p.refDate, *o.out);
+                else
+                    o.format->toJson(p.parseResult, p.refDate, *o.out);
+            }
+        });
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// OutputFile
+//////////////////////////////////////////////////////////////////////////////
+
+OutputFile::OutputFile(const std::string &fileName,
+                       std::unique_ptr<const Compressor> compressor,
+                       size_t threads)
+    : std::ostream(nullptr), fileName(fileName), file(fileName, std::ios::binary)
+{
+    if (!file)
+        throw(std::runtime_error("Cannot open output file " + fileName));
+    if (compressor)
+        compressed = std::make_unique<CompressedOutput>(file, std::move(compressor), threads);
+    rdbuf(compressed ? static_cast<std::streambuf *>(compressed.get()) : file.rdbuf());
+}
+
+bool OutputFile::finish()
+{
+    flush();
+    if (compressed)
+        compressed->finish();
+    file.flush();
+    return !fail() && file.good();
+}
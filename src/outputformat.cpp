@@ -20,12 +20,20 @@ static_assert(metaf::Version::major >= 4, "Metaf version 4.0.0 or later is requi
 
 OutputFormat::Result OutputFormat::toJson(const std::string &report,
                                           std::ostream &out) const
+{
+    return toJson(report, referenceDate, out);
+}
+
+OutputFormat::Result OutputFormat::toJson(const std::string &report,
+                                          const RefDate &refDate,
+                                          std::ostream &out) const
 {
     try
     {
         const auto parseResult = metaf::Parser::parse(report);
-        const auto j = toJson(parseResult);
-        out << j << "\n"; //not std::endl because it does std::flush as well
+        if (!matchesFilter(parseResult))
+            return Result::FILTERED;
+        serialise(parseResult, refDate, out);
         return Result::OK;
     }
     catch (const std::exception &e)
@@ -35,4 +43,40 @@ OutputFormat::Result OutputFormat::toJson(const std::string &report,
         std::cerr << report << std::endl;
         return Result::EXCEPTION;
     }
-}
\ No newline at end of file
+}
+
+OutputFormat::Result OutputFormat::toJson(const metaf::ParseResult &parseResult,
+                                          const RefDate &refDate,
+                                          std::ostream &out) const
+{
+    try
+    {
+        if (!matchesFilter(parseResult))
+            return Result::FILTERED;
+        serialise(parseResult, refDate, out);
+        return Result::OK;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception " << e.what();
+        std::cerr << " occurred when serialising parsed report" << std::endl;
+        return Result::EXCEPTION;
+    }
+}
+
+void OutputFormat::serialise(const metaf::ParseResult &parseResult,
+                             const RefDate &refDate,
+                             std::ostream &out) const
+{
+    writeReport(parseResult, refDate, encoder->begin());
+    encoder->end(out);
+}
+
+void OutputFormat::writeReport(const metaf::ParseResult &parseResult,
+                               const RefDate &refDate,
+                               ValueWriter &writer) const
+{
+    (void)parseResult;
+    (void)refDate;
+    writer.writeNull();
+}
@@ -0,0 +1,109 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "outputformatarrow.hpp"
+
+namespace
+{
+
+enum Column : size_t
+{
+    STATION,
+    TIME,
+    TYPE,
+    WIND_DIR,
+    WIND_KT,
+    GUST_KT,
+    VIS_M,
+    CEILING_FT,
+    TEMP_C,
+    DEWPT_C,
+    QNH_HPA,
+    CLOUDS,
+    WEATHER
+};
+
+// Same order as in enum Column
+std::vector<ArrowWriter::Column> columns()
+{
+    using Type = ArrowWriter::ColumnType;
+    return {
+        {"station", Type::STRING},
+        {"time", Type::TIMESTAMP},
+        {"type", Type::STRING},
+        {"wind_dir", Type::INT16},
+        {"wind_kt", Type::FLOAT32},
+        {"gust_kt", Type::FLOAT32},
+        {"vis_m", Type::FLOAT32},
+        {"ceiling_ft", Type::FLOAT32},
+        {"temp_c", Type::FLOAT32},
+        {"dewpt_c", Type::FLOAT32},
+        {"qnh_hpa", Type::FLOAT32},
+        {"clouds", Type::STRING_LIST},
+        {"weather", Type::STRING_LIST}};
+}
+
+std::optional<std::string_view> nonEmpty(std::string_view s)
+{
+    if (s.empty())
+        return std::optional<std::string_view>();
+    return s;
+}
+
+} // namespace
+
+OutputFormatArrow::OutputFormatArrow(std::unique_ptr<DateTimeFormat> dtFormat,
+                                     std::unique_ptr<ValueFormat> valFormat,
+                                     int refYear,
+                                     unsigned refMonth,
+                                     unsigned refDay,
+                                     std::unique_ptr<const FilterExpression> filter,
+                                     size_t rowsPerBatch)
+    : OutputFormat(std::move(dtFormat),
+                   std::move(valFormat),
+                   false,
+                   refYear,
+                   refMonth,
+                   refDay,
+                   GroupFilter(),
+                   std::move(filter)),
+      batchSize(rowsPerBatch ? rowsPerBatch : defaultBatchSize),
+      writer(columns())
+{
+}
+
+void OutputFormatArrow::serialise(const metaf::ParseResult &parseResult,
+                                  const RefDate &refDate,
+                                  std::ostream &out) const
+{
+    values.extract(parseResult, refDate);
+    writer.appendString(STATION, nonEmpty(values.station));
+    writer.appendInt(TIME, values.time);
+    writer.appendString(TYPE, nonEmpty(ReportValues::typeName(values.type)));
+    std::optional<int64_t> windDirection;
+    if (values.windDirection.has_value())
+        windDirection = *values.windDirection;
+    writer.appendInt(WIND_DIR, windDirection);
+    writer.appendFloat(WIND_KT, values.windSpeed);
+    writer.appendFloat(GUST_KT, values.gustSpeed);
+    writer.appendFloat(VIS_M, values.visibility);
+    writer.appendFloat(CEILING_FT, values.ceiling);
+    writer.appendFloat(TEMP_C, values.temperature);
+    writer.appendFloat(DEWPT_C, values.dewPoint);
+    writer.appendFloat(QNH_HPA, values.qnh);
+    writer.appendList(CLOUDS, values.clouds);
+    writer.appendList(WEATHER, values.weather);
+    writer.endRow();
+    if (writer.rows() >= batchSize)
+        writer.writeBatch(out);
+}
+
+void OutputFormatArrow::finish(std::ostream &out) const
+{
+    writer.finish(out);
+}
@@ -8,6 +8,10 @@
 
 #include "outputformatbasic.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
 #include "nlohmann/json.hpp"
 #include "magic_enum.hpp"
 #include "metaf.hpp"
@@ -17,431 +21,605 @@
 
 using namespace metaf;
 
+//////////////////////////////////////////////////////////////////////////////
+// Group layout
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Fields of each group kind in the order they are written by the
+// visitXxxGroup methods below; when groups are serialised as tuples, each
+// value is written at the position of its field (see tupleSchema())
+constexpr std::string_view keywordFields[] = {
+    "type", "not_valid", "raw_string"};
+constexpr std::string_view locationFields[] = {
+    "location", "not_valid", "raw_string"};
+constexpr std::string_view reportTimeFields[] = {
+    "report_time", "not_valid", "raw_string"};
+constexpr std::string_view trendFields[] = {
+    "type", "probability_percent", "time_from", "time_until", "time_at",
+    "not_valid", "raw_string"};
+constexpr std::string_view windFields[] = {
+    "type", "direction", "wind_speed", "gust_speed", "variable_direction_sector",
+    "height", "runway", "begin_time", "occurrence_time", "not_valid", "raw_string"};
+constexpr std::string_view visibilityFields[] = {
+    "type", "visibility", "min_visibility", "max_visibility", "rvr", "min_rvr",
+    "max_rvr", "direction", "runway", "trend", "sector_directions",
+    "not_valid", "raw_string"};
+constexpr std::string_view cloudFields[] = {
+    "type", "amount", "height", "min_height", "max_height", "vertical_visibility",
+    "convective_type", "direction", "runway", "obscuration", "clr", "skc", "ncd",
+    "nsc", "not_valid", "raw_string"};
+constexpr std::string_view weatherFields[] = {
+    "type", "weather_phenomena", "not_valid", "raw_string"};
+constexpr std::string_view temperatureFields[] = {
+    "type", "air_temperature", "dew_point", "not_valid", "raw_string"};
+constexpr std::string_view pressureFields[] = {
+    "type", "pressure_qnh", "pressure_qfe", "not_valid", "raw_string"};
+constexpr std::string_view runwayStateFields[] = {
+    "type", "runway", "deposits", "contamination_extent", "deposit_depth",
+    "surface_friction", "not_valid", "raw_string"};
+constexpr std::string_view seaSurfaceFields[] = {
+    "temperature", "waves", "not_valid", "raw_string"};
+constexpr std::string_view minMaxTemperatureFields[] = {
+    "type", "min_time", "max_time", "min_temperature", "max_temperature",
+    "not_valid", "raw_string"};
+constexpr std::string_view precipitationFields[] = {
+    "type", "total", "last_hour_increase", "not_valid", "raw_string"};
+constexpr std::string_view layerForecastFields[] = {
+    "type", "base_height", "top_height", "not_valid", "raw_string"};
+constexpr std::string_view pressureTendencyFields[] = {
+    "type", "trend", "difference", "not_valid", "raw_string"};
+constexpr std::string_view cloudTypesFields[] = {
+    "cloud_types", "not_valid", "raw_string"};
+constexpr std::string_view lowMidHighCloudFields[] = {
+    "low_layer", "mid_layer", "high_layer", "not_valid", "raw_string"};
+constexpr std::string_view lightningFields[] = {
+    "frequency", "distance", "cloud_to_ground", "in_cloud", "cloud_to_cloud",
+    "cloud_to_air", "unknown_lightning_type", "directions", "not_valid",
+    "raw_string"};
+constexpr std::string_view vicinityFields[] = {
+    "type", "distance", "directions", "moving_direction", "not_valid",
+    "raw_string"};
+constexpr std::string_view miscFields[] = {
+    "type", "minutes", "correction_number", "ft", "density_altitude_misg", "in",
+    "not_valid", "raw_string"};
+constexpr std::string_view unknownFields[] = {
+    "not_valid", "raw_string"};
+
+struct GroupLayout
+{
+    std::string_view group; // Same as "group" value in JSON output
+    const std::string_view *fields;
+    size_t size;
+};
+
+template <size_t N>
+constexpr GroupLayout layout(std::string_view group, const std::string_view (&fields)[N])
+{
+    return GroupLayout{group, fields, N};
+}
+
+constexpr auto keywordLayout = layout("keyword", keywordFields);
+constexpr auto locationLayout = layout("icao_location", locationFields);
+constexpr auto reportTimeLayout = layout("report_time", reportTimeFields);
+constexpr auto trendLayout = layout("trend", trendFields);
+constexpr auto windLayout = layout("wind", windFields);
+constexpr auto visibilityLayout = layout("visibility", visibilityFields);
+constexpr auto cloudLayout = layout("cloud", cloudFields);
+constexpr auto weatherLayout = layout("weather", weatherFields);
+constexpr auto temperatureLayout = layout("temperature", temperatureFields);
+constexpr auto pressureLayout = layout("pressure", pressureFields);
+constexpr auto runwayStateLayout = layout("runway_state", runwayStateFields);
+constexpr auto seaSurfaceLayout = layout("sea_surface", seaSurfaceFields);
+constexpr auto minMaxTemperatureLayout = layout("min_max_temperature", minMaxTemperatureFields);
+constexpr auto precipitationLayout = layout("precipitation", precipitationFields);
+constexpr auto layerForecastLayout = layout("layer_forecast", layerForecastFields);
+constexpr auto pressureTendencyLayout = layout("pressure_tendency", pressureTendencyFields);
+constexpr auto cloudTypesLayout = layout("cloud_types", cloudTypesFields);
+constexpr auto lowMidHighCloudLayout = layout("low_mid_high_clouds", lowMidHighCloudFields);
+constexpr auto lightningLayout = layout("lightning", lightningFields);
+constexpr auto vicinityLayout = layout("vicinity", vicinityFields);
+constexpr auto miscLayout = layout("misc", miscFields);
+constexpr auto unknownLayout = layout("unknown", unknownFields);
+
+// Layouts of all group kinds
+constexpr GroupLayout groupLayouts[] = {
+    keywordLayout,
+    locationLayout,
+    reportTimeLayout,
+    trendLayout,
+    windLayout,
+    visibilityLayout,
+    cloudLayout,
+    weatherLayout,
+    temperatureLayout,
+    pressureLayout,
+    runwayStateLayout,
+    seaSurfaceLayout,
+    minMaxTemperatureLayout,
+    precipitationLayout,
+    layerForecastLayout,
+    pressureTendencyLayout,
+    cloudTypesLayout,
+    lowMidHighCloudLayout,
+    lightningLayout,
+    vicinityLayout,
+    miscLayout,
+    unknownLayout};
+
+} // namespace
+
 class OutputFormatBasic::MetafVisitorBasic : public MetafVisitor
 {
 public:
     MetafVisitorBasic(const metaf::ParseResult &result,
+                      ValueWriter &writer,
                       const DateTimeFormat *dtFormat,
                       const ValueFormat *valFormat,
                       bool rawStrings,
-                      int refYear,
-                      unsigned refMonth,
-                      unsigned refDay)
-        : MetafVisitor(result, dtFormat, valFormat, rawStrings, refYear, refMonth, refDay) {}
+                      const RefDate &refDate,
+                      bool omitNotReported,
+                      bool tuples)
+        : MetafVisitor(result, writer, dtFormat, valFormat, rawStrings, refDate,
+                       omitNotReported),
+          tuples(tuples) {}
 
 protected:
-    nlohmann::json visitKeywordGroup(const KeywordGroup &group,
+    void visitKeywordGroup(const KeywordGroup &group,
+                           ReportPart reportPart,
+                           const std::string &rawString);
+    void visitLocationGroup(const LocationGroup &group,
+                            ReportPart reportPart,
+                            const std::string &rawString);
+    void visitReportTimeGroup(const ReportTimeGroup &group,
+                              ReportPart reportPart,
+                              const std::string &rawString);
+    void visitTrendGroup(const TrendGroup &group,
+                         ReportPart reportPart,
+                         const std::string &rawString);
+    void visitWindGroup(const WindGroup &group,
+                        ReportPart reportPart,
+                        const std::string &rawString);
+    void visitVisibilityGroup(const VisibilityGroup &group,
+                              ReportPart reportPart,
+                              const std::string &rawString);
+    void visitCloudGroup(const CloudGroup &group,
+                         ReportPart reportPart,
+                         const std::string &rawString);
+    void visitWeatherGroup(const WeatherGroup &group,
+                           ReportPart reportPart,
+                           const std::string &rawString);
+    void visitTemperatureGroup(const TemperatureGroup &group,
+                               ReportPart reportPart,
+                               const std::string &rawString);
+    void visitPressureGroup(const PressureGroup &group,
+                            ReportPart reportPart,
+                            const std::string &rawString);
+    void visitRunwayStateGroup(const RunwayStateGroup &group,
+                               ReportPart reportPart,
+                               const std::string &rawString);
+    void visitSeaSurfaceGroup(const SeaSurfaceGroup &group,
+                              ReportPart reportPart,
+                              const std::string &rawString);
+    void visitMinMaxTemperatureGroup(const MinMaxTemperatureGroup &group,
                                      ReportPart reportPart,
                                      const std::string &rawString);
-    nlohmann::json visitLocationGroup(const LocationGroup &group,
-                                      ReportPart reportPart,
-                                      const std::string &rawString);
-    nlohmann::json visitReportTimeGroup(const ReportTimeGroup &group,
-                                        ReportPart reportPart,
-                                        const std::string &rawString);
-    nlohmann::json visitTrendGroup(const TrendGroup &group,
-                                   ReportPart reportPart,
-                                   const std::string &rawString);
-    nlohmann::json visitWindGroup(const WindGroup &group,
-                                  ReportPart reportPart,
-                                  const std::string &rawString);
-    nlohmann::json visitVisibilityGroup(const VisibilityGroup &group,
-                                        ReportPart reportPart,
-                                        const std::string &rawString);
-    nlohmann::json visitCloudGroup(const CloudGroup &group,
+    void visitPrecipitationGroup(const PrecipitationGroup &group,
+                                 ReportPart reportPart,
+                                 const std::string &rawString);
+    void visitLayerForecastGroup(const LayerForecastGroup &group,
+                                 ReportPart reportPart,
+                                 const std::string &rawString);
+    void visitPressureTendencyGroup(const PressureTendencyGroup &group,
+                                    ReportPart reportPart,
+                                    const std::string &rawString);
+    void visitCloudTypesGroup(const CloudTypesGroup &group,
+                              ReportPart reportPart,
+                              const std::string &rawString);
+    void visitLowMidHighCloudGroup(const LowMidHighCloudGroup &group,
                                    ReportPart reportPart,
                                    const std::string &rawString);
-    nlohmann::json visitWeatherGroup(const WeatherGroup &group,
-                                     ReportPart reportPart,
-                                     const std::string &rawString);
-    nlohmann::json visitTemperatureGroup(const TemperatureGroup &group,
-                                         ReportPart reportPart,
-                                         const std::string &rawString);
-    nlohmann::json visitPressureGroup(const PressureGroup &group,
-                                      ReportPart reportPart,
-                                      const std::string &rawString);
-    nlohmann::json visitRunwayStateGroup(const RunwayStateGroup &group,
-                                         ReportPart reportPart,
-                                         const std::string &rawString);
-    nlohmann::json visitSeaSurfaceGroup(const SeaSurfaceGroup &group,
-                                        ReportPart reportPart,
-                                        const std::string &rawString);
-    nlohmann::json visitMinMaxTemperatureGroup(const MinMaxTemperatureGroup &group,
-                                               ReportPart reportPart,
-                                               const std::string &rawString);
-    nlohmann::json visitPrecipitationGroup(const PrecipitationGroup &group,
-                                           ReportPart reportPart,
-                                           const std::string &rawString);
-    nlohmann::json visitLayerForecastGroup(const LayerForecastGroup &group,
-                                           ReportPart reportPart,
-                                           const std::string &rawString);
-    nlohmann::json visitPressureTendencyGroup(const PressureTendencyGroup &group,
-                                              ReportPart reportPart,
-                                              const std::string &rawString);
-    nlohmann::json visitCloudTypesGroup(const CloudTypesGroup &group,
-                                        ReportPart reportPart,
-                                        const std::string &rawString);
-    nlohmann::json visitLowMidHighCloudGroup(const LowMidHighCloudGroup &group,
-                                             ReportPart reportPart,
-                                             const std::string &rawString);
-    nlohmann::json visitLightningGroup(const LightningGroup &group,
-                                       ReportPart reportPart,
-                                       const std::string &rawString);
-    nlohmann::json visitVicinityGroup(const VicinityGroup &group,
-                                      ReportPart reportPart,
-                                      const std::string &rawString);
-    nlohmann::json visitMiscGroup(const MiscGroup &group,
-                                  ReportPart reportPart,
-                                  const std::string &rawString);
-    nlohmann::json visitUnknownGroup(const UnknownGroup &group,
-                                     ReportPart reportPart,
-                                     const std::string &rawString);
+    void visitLightningGroup(const LightningGroup &group,
+                             ReportPart reportPart,
+                             const std::string &rawString);
+    void visitVicinityGroup(const VicinityGroup &group,
+                            ReportPart reportPart,
+                            const std::string &rawString);
+    void visitMiscGroup(const MiscGroup &group,
+                        ReportPart reportPart,
+                        const std::string &rawString);
+    void visitUnknownGroup(const UnknownGroup &group,
+                           ReportPart reportPart,
+                           const std::string &rawString);
+
+    // In tuple mode values are written at the positions of their fields in
+    // the group layout; values of the fields skipped are null, trailing
+    // nulls are omitted; throws std::logic_error if field is not in the
+    // layout or is written out of order
+    virtual void field(std::string_view name)
+    {
+        if (!tuples || nested)
+        {
+            writer.key(name);
+            return;
+        }
+        while (nextField < layout->size && layout->fields[nextField] != name)
+        {
+            writer.writeNull();
+            nextField++;
+        }
+        if (nextField == layout->size)
+        {
+            throw std::logic_error("Field " + std::string(name) +
+                                   " is not in the layout of group " +
+                                   std::string(layout->group));
+        }
+        nextField++;
+    }
+
+private:
+    // Group name is the first value of the group object or tuple
+    void beginGroup(const GroupLayout &groupLayout)
+    {
+        layout = &groupLayout;
+        nextField = 0;
+        if (tuples)
+        {
+            writer.beginArray();
+            writer.value(groupLayout.group);
+            return;
+        }
+        writer.beginObject();
+        writer.member("group", groupLayout.group);
+    }
+    // Validity and raw string are the last values of the group
+    void endGroup(bool valid, const std::string &rawString)
+    {
+        if (!valid)
+            setField("not_valid", true);
+        if (includeRawStrings)
+            setField("raw_string", rawString);
+        if (tuples)
+            writer.endArray();
+        else
+            writer.endObject();
+    }
+    // Objects nested in the group values (e.g. each of weather phenomena)
+    // are always written with keys
+    void beginNested()
+    {
+        writer.beginObject();
+        nested++;
+    }
+    void endNested()
+    {
+        writer.endObject();
+        nested--;
+    }
+    template <typename T>
+    void setField(std::string_view name, const T &value)
+    {
+        field(name);
+        writer.value(value);
+    }
+    template <typename E>
+    void setEnum(std::string_view name, E value)
+    {
+        setField(name, util::toLower(magic_enum::enum_name(value)));
+    }
+    template <typename T>
+    void setOptional(const char *name, const std::optional<T> &value)
+    {
+        if (!value.has_value())
+            return;
+        field(name);
+        valueFormat->write(writer, *value);
+    }
+    void setOptionalTime(const char *name, const std::optional<metaf::MetafTime> &time)
+    {
+        if (time.has_value())
+            setTime(name, *time);
+    }
+    void setDirections(const char *name, const std::vector<metaf::Direction> &directions)
+    {
+        if (directions.empty())
+            return;
+        field(name);
+        valueFormat->write(writer, directions);
+    }
+
+    bool tuples = false;
+    const GroupLayout *layout = nullptr;
+    size_t nextField = 0;
+    unsigned nested = 0;
 };
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitKeywordGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitKeywordGroup(
     const KeywordGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "keyword"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    beginGroup(keywordLayout);
+    setEnum("type", group.type());
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitLocationGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitLocationGroup(
     const LocationGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "icao_location"},
-        {"location", group.toString()}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    beginGroup(locationLayout);
+    setField("location", group.toString());
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitReportTimeGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitReportTimeGroup(
     const ReportTimeGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "report_time"},
-        {"report_time", dateTimeFormat->format(reportDateTime)}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    beginGroup(reportTimeLayout);
+    field("report_time");
+    dateTimeFormat->write(writer, reportDateTime);
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitTrendGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitTrendGroup(
     const TrendGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "trend"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(trendLayout);
+    setEnum("type", group.type());
     switch (group.probability())
     {
     case metaf::TrendGroup::Probability::NONE:
         break;
     case metaf::TrendGroup::Probability::PROB_30:
-        j["probability_percent"] = 30;
+        setField("probability_percent", 30);
         break;
     case metaf::TrendGroup::Probability::PROB_40:
-        j["probability_percent"] = 40;
+        setField("probability_percent", 40);
         break;
     }
-    if (const auto t = group.timeFrom(); t.has_value())
-        j["time_from"] = dateTimeFormat->format(*t, reportDateTime);
-    if (const auto t = group.timeUntil(); t.has_value())
-        j["time_until"] = dateTimeFormat->format(*t, reportDateTime);
-    if (const auto t = group.timeAt(); t.has_value())
-        j["time_at"] = dateTimeFormat->format(*t, reportDateTime);
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    setOptionalTime("time_from", group.timeFrom());
+    setOptionalTime("time_until", group.timeUntil());
+    setOptionalTime("time_at", group.timeAt());
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitWindGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitWindGroup(
     const WindGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "wind"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(windLayout);
+    setEnum("type", group.type());
     switch (group.type())
     {
     case metaf::WindGroup::Type::SURFACE_WIND:
-        j["direction"] = valueFormat->format(group.direction(), true);
-        j["wind_speed"] = valueFormat->format(group.windSpeed(), true);
-        j["gust_speed"] = valueFormat->format(group.gustSpeed());
+        setValue("direction", group.direction(), true);
+        setValue("wind_speed", group.windSpeed(), true);
+        setValue("gust_speed", group.gustSpeed());
         break;
     case metaf::WindGroup::Type::SURFACE_WIND_CALM:
         break;
     case metaf::WindGroup::Type::VARIABLE_WIND_SECTOR:
-        j["variable_direction_sector"] =
-            valueFormat->format(group.varSectorBegin(), group.varSectorEnd());
+        setSector("variable_direction_sector", group.varSectorBegin(), group.varSectorEnd());
         break;
     case metaf::WindGroup::Type::SURFACE_WIND_WITH_VARIABLE_SECTOR:
-        j["direction"] = valueFormat->format(group.direction(), true);
-        j["wind_speed"] = valueFormat->format(group.windSpeed(), true);
-        j["gust_speed"] = valueFormat->format(group.gustSpeed());
-        j["variable_direction_sector"] =
-            valueFormat->format(group.varSectorBegin(), group.varSectorEnd());
+        setValue("direction", group.direction(), true);
+        setValue("wind_speed", group.windSpeed(), true);
+        setValue("gust_speed", group.gustSpeed());
+        setSector("variable_direction_sector", group.varSectorBegin(), group.varSectorEnd());
         break;
     case metaf::WindGroup::Type::WIND_SHEAR:
-        j["direction"] = valueFormat->format(group.direction(), true);
-        j["wind_speed"] = valueFormat->format(group.windSpeed(), true);
-        j["gust_speed"] = valueFormat->format(group.gustSpeed());
-        j["height"] = valueFormat->format(group.height(), true);
+        setValue("direction", group.direction(), true);
+        setValue("wind_speed", group.windSpeed(), true);
+        setValue("gust_speed", group.gustSpeed());
+        setValue("height", group.height(), true);
         break;
     case metaf::WindGroup::Type::WIND_SHEAR_IN_LOWER_LAYERS:
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
+        setOptional("runway", group.runway());
         break;
     case metaf::WindGroup::Type::WIND_SHIFT:
     case metaf::WindGroup::Type::WIND_SHIFT_FROPA:
-        if (const auto t = group.eventTime(); t.has_value())
-            j["begin_time"] = dateTimeFormat->format(*t, reportDateTime);
+        setOptionalTime("begin_time", group.eventTime());
         break;
     case metaf::WindGroup::Type::PEAK_WIND:
-        j["direction"] = valueFormat->format(group.direction(), true);
-        j["wind_speed"] = valueFormat->format(group.windSpeed(), true);
-        if (const auto t = group.eventTime(); t.has_value())
-            j["occurrence_time"] = dateTimeFormat->format(*t, reportDateTime);
+        setValue("direction", group.direction(), true);
+        setValue("wind_speed", group.windSpeed(), true);
+        setOptionalTime("occurrence_time", group.eventTime());
         break;
     case metaf::WindGroup::Type::WSCONDS:
     case metaf::WindGroup::Type::WND_MISG:
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitVisibilityGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitVisibilityGroup(
     const VisibilityGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "visibility"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(visibilityLayout);
+    setEnum("type", group.type());
     switch (group.type())
     {
     case metaf::VisibilityGroup::Type::PREVAILING:
     case metaf::VisibilityGroup::Type::SURFACE:
     case metaf::VisibilityGroup::Type::TOWER:
-        j["visibility"] = valueFormat->format(group.visibility(), false, true);
+        setValue("visibility", group.visibility(), false, true);
         break;
     case metaf::VisibilityGroup::Type::PREVAILING_NDV:
     case metaf::VisibilityGroup::Type::DIRECTIONAL:
-        j["visibility"] = valueFormat->format(group.visibility(), false, true);
-        if (const auto d = group.direction(); d.has_value())
-            j["direction"] = valueFormat->format(*d);
+        setValue("visibility", group.visibility(), false, true);
+        setOptional("direction", group.direction());
         break;
     case metaf::VisibilityGroup::Type::RUNWAY:
-        j["visibility"] = valueFormat->format(group.visibility(), false, true);
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
+        setValue("visibility", group.visibility(), false, true);
+        setOptional("runway", group.runway());
         break;
     case metaf::VisibilityGroup::Type::RVR:
-        j["rvr"] = valueFormat->format(group.visibility(), true, true);
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
-        j["trend"] = util::toLower(magic_enum::enum_name(group.trend()));
+        setValue("rvr", group.visibility(), true, true);
+        setOptional("runway", group.runway());
+        setEnum("trend", group.trend());
         break;
     case metaf::VisibilityGroup::Type::SECTOR:
-        j["visibility"] = valueFormat->format(group.visibility(), false, true);
-        j["sector_directions"] = valueFormat->format(group.sectorDirections());
+        setValue("visibility", group.visibility(), false, true);
+        field("sector_directions");
+        valueFormat->write(writer, group.sectorDirections());
         break;
     case metaf::VisibilityGroup::Type::VARIABLE_PREVAILING:
-        j["min_visibility"] = valueFormat->format(group.minVisibility(), false, true);
-        j["max_visibility"] = valueFormat->format(group.minVisibility(), false, true);
+        setValue("min_visibility", group.minVisibility(), false, true);
+        setValue("max_visibility", group.minVisibility(), false, true);
         break;
     case metaf::VisibilityGroup::Type::VARIABLE_DIRECTIONAL:
-        j["min_visibility"] = valueFormat->format(group.minVisibility(), false, true);
-        j["max_visibility"] = valueFormat->format(group.minVisibility(), false, true);
-        if (const auto d = group.direction(); d.has_value())
-            j["direction"] = valueFormat->format(*d);
+        setValue("min_visibility", group.minVisibility(), false, true);
+        setValue("max_visibility", group.minVisibility(), false, true);
+        setOptional("direction", group.direction());
         break;
     case metaf::VisibilityGroup::Type::VARIABLE_RUNWAY:
-        j["min_visibility"] = valueFormat->format(group.minVisibility(), false, true);
-        j["max_visibility"] = valueFormat->format(group.minVisibility(), false, true);
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
+        setValue("min_visibility", group.minVisibility(), false, true);
+        setValue("max_visibility", group.minVisibility(), false, true);
+        setOptional("runway", group.runway());
         break;
     case metaf::VisibilityGroup::Type::VARIABLE_RVR:
-        j["min_rvr"] = valueFormat->format(group.minVisibility(), true, true);
-        j["max_rvr"] = valueFormat->format(group.minVisibility(), true, true);
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
-        j["trend"] = util::toLower(magic_enum::enum_name(group.trend()));
+        setValue("min_rvr", group.minVisibility(), true, true);
+        setValue("max_rvr", group.minVisibility(), true, true);
+        setOptional("runway", group.runway());
+        setEnum("trend", group.trend());
         break;
     case metaf::VisibilityGroup::Type::VARIABLE_SECTOR:
-        j["min_visibility"] = valueFormat->format(group.minVisibility(), false, true);
-        j["max_visibility"] = valueFormat->format(group.minVisibility(), false, true);
-        j["sector_directions"] = valueFormat->format(group.sectorDirections());
+        setValue("min_visibility", group.minVisibility(), false, true);
+        setValue("max_visibility", group.minVisibility(), false, true);
+        field("sector_directions");
+        valueFormat->write(writer, group.sectorDirections());
         break;
     case metaf::VisibilityGroup::Type::VIS_MISG:
     case metaf::VisibilityGroup::Type::RVR_MISG:
     case metaf::VisibilityGroup::Type::RVRNO:
         break;
     case metaf::VisibilityGroup::Type::VISNO:
-        if (const auto d = group.direction(); d.has_value())
-            j["direction"] = valueFormat->format(*d);
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
+        setOptional("direction", group.direction());
+        setOptional("runway", group.runway());
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitCloudGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitCloudGroup(
     const CloudGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "cloud"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(cloudLayout);
+    setEnum("type", group.type());
     switch (group.type())
     {
     case metaf::CloudGroup::Type::NO_CLOUDS:
         switch (group.amount())
         {
         case metaf::CloudGroup::Amount::NONE_CLR:
-            j["clr"] = true;
+            setField("clr", true);
             break;
         case metaf::CloudGroup::Amount::NONE_SKC:
-            j["skc"] = true;
+            setField("skc", true);
             break;
         case metaf::CloudGroup::Amount::NCD:
-            j["ncd"] = true;
+            setField("ncd", true);
             break;
         case metaf::CloudGroup::Amount::NSC:
-            j["nsc"] = true;
+            setField("nsc", true);
             break;
         default:
-            j["amount"] = util::toLower(magic_enum::enum_name(group.amount()));
+            setEnum("amount", group.amount());
             break;
         }
         break;
     case metaf::CloudGroup::Type::CLOUD_LAYER:
-        j["amount"] = util::toLower(magic_enum::enum_name(group.amount()));
-        j["height"] = valueFormat->format(group.height(), true, true);
+        setEnum("amount", group.amount());
+        setValue("height", group.height(), true, true);
         if (const auto ct = group.convectiveType();
             ct != metaf::CloudGroup::ConvectiveType::NONE)
         {
-            j["convective_type"] =
-                util::toLower(magic_enum::enum_name(group.convectiveType()));
+            setEnum("convective_type", ct);
         }
         break;
     case metaf::CloudGroup::Type::VERTICAL_VISIBILITY:
-        j["amount"] = util::toLower(magic_enum::enum_name(group.amount()));
-        j["vertical_visibility"] = valueFormat->format(group.verticalVisibility(), true, true);
+        setEnum("amount", group.amount());
+        setValue("vertical_visibility", group.verticalVisibility(), true, true);
         break;
     case metaf::CloudGroup::Type::CEILING:
-        j["height"] = valueFormat->format(group.height(), true, true);
-        if (const auto d = group.direction(); d.has_value())
-            j["direction"] = valueFormat->format(*d);
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
+        setValue("height", group.height(), true, true);
+        setOptional("direction", group.direction());
+        setOptional("runway", group.runway());
         break;
     case metaf::CloudGroup::Type::VARIABLE_CEILING:
-        j["min_height"] = valueFormat->format(group.minHeight(), true, true);
-        j["max_height"] = valueFormat->format(group.maxHeight(), true, true);
-        if (const auto d = group.direction(); d.has_value())
-            j["direction"] = valueFormat->format(*d);
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
+        setValue("min_height", group.minHeight(), true, true);
+        setValue("max_height", group.maxHeight(), true, true);
+        setOptional("direction", group.direction());
+        setOptional("runway", group.runway());
         break;
     case metaf::CloudGroup::Type::CHINO:
-        if (const auto d = group.direction(); d.has_value())
-            j["direction"] = valueFormat->format(*d);
-        if (const auto r = group.runway(); r.has_value())
-            j["runway"] = valueFormat->format(*r);
+        setOptional("direction", group.direction());
+        setOptional("runway", group.runway());
         break;
     case metaf::CloudGroup::Type::CLD_MISG:
         break;
     case metaf::CloudGroup::Type::OBSCURATION:
-        j["amount"] = util::toLower(magic_enum::enum_name(group.amount()));
+        setEnum("amount", group.amount());
         if (const auto ct = group.cloudType(); ct.has_value())
-            j["obscuration"] = util::toLower(magic_enum::enum_name(ct->type()));;
+            setEnum("obscuration", ct->type());
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitWeatherGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitWeatherGroup(
     const WeatherGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "weather"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(weatherLayout);
+    setEnum("type", group.type());
     switch (group.type())
     {
     case metaf::WeatherGroup::Type::CURRENT:
     case metaf::WeatherGroup::Type::RECENT:
     case metaf::WeatherGroup::Type::EVENT:
-        j["weather_phenomena"] = nlohmann::json::array();
+        field("weather_phenomena");
+        writer.beginArray();
         for (const auto w : group.weatherPhenomena())
         {
-            nlohmann::json jweather{
-                {"qualifier", util::toLower(magic_enum::enum_name(w.qualifier()))},
-                {"descriptor", util::toLower(magic_enum::enum_name(w.descriptor()))},
-            };
-            jweather["weather"] = nlohmann::json::array();
+            beginNested();
+            setEnum("qualifier", w.qualifier());
+            setEnum("descriptor", w.descriptor());
+            field("weather");
+            writer.beginArray();
             for (const auto &ww : w.weather())
-            {
-                jweather["weather"].push_back(ww);
-            }
+                writer.value(static_cast<std::underlying_type_t<metaf::Weather>>(ww));
+            writer.endArray();
             if (const auto e = w.event(); e != metaf::WeatherPhenomena::Event::NONE)
-                jweather["event_type"] = util::toLower(magic_enum::enum_name(e));
-            if (const auto t = w.time(); t.has_value())
-                jweather["occurrence_time"] = dateTimeFormat->format(*t, reportDateTime);
+                setEnum("event_type", e);
+            setOptionalTime("occurrence_time", w.time());
             if (!w.isValid())
-                jweather["not_valid"] = true;
-            j["weather_phenomena"].push_back(std::move(jweather));
+                setField("not_valid", true);
+            endNested();
         }
+        writer.endArray();
         break;
     case metaf::WeatherGroup::Type::NSW:
     case metaf::WeatherGroup::Type::PWINO:
@@ -450,354 +628,271 @@ nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitWeatherGroup(
     case metaf::WeatherGroup::Type::TS_LTNG_TEMPO_UNAVBL:
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitTemperatureGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitTemperatureGroup(
     const TemperatureGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "temperature"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(temperatureLayout);
+    setEnum("type", group.type());
     switch (group.type())
     {
     case metaf::TemperatureGroup::Type::TEMPERATURE_AND_DEW_POINT:
-        j["air_temperature"] = valueFormat->format(group.airTemperature(), true);
-        j["dew_point"] = valueFormat->format(group.dewPoint(), true);
+        setValue("air_temperature", group.airTemperature(), true);
+        setValue("dew_point", group.dewPoint(), true);
         break;
     case metaf::TemperatureGroup::Type::T_MISG:
     case metaf::TemperatureGroup::Type::TD_MISG:
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitPressureGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitPressureGroup(
     const PressureGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "pressure"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(pressureLayout);
+    setEnum("type", group.type());
     switch (group.type())
     {
     case metaf::PressureGroup::Type::OBSERVED_QNH:
     case metaf::PressureGroup::Type::FORECAST_LOWEST_QNH:
-        j["pressure_qnh"] = valueFormat->format(group.atmosphericPressure(), true);
+        setValue("pressure_qnh", group.atmosphericPressure(), true);
         break;
     case metaf::PressureGroup::Type::OBSERVED_QFE:
-        j["pressure_qfe"] = valueFormat->format(group.atmosphericPressure(), true);
+        setValue("pressure_qfe", group.atmosphericPressure(), true);
         break;
     case metaf::PressureGroup::Type::SLPNO:
     case metaf::PressureGroup::Type::PRES_MISG:
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitRunwayStateGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitRunwayStateGroup(
     const RunwayStateGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "runway_state"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    j["runway"] = valueFormat->format(group.runway());
+    beginGroup(runwayStateLayout);
+    setEnum("type", group.type());
+    field("runway");
+    valueFormat->write(writer, group.runway());
     switch (group.type())
     {
     case metaf::RunwayStateGroup::Type::RUNWAY_STATE:
-        j["deposits"] = util::toLower(magic_enum::enum_name(group.deposits()));
-        j["contamination_extent"] =
-            util::toLower(magic_enum::enum_name(group.contaminationExtent()));
-        j["deposit_depth"] = valueFormat->format(group.depositDepth());
-        j["surface_friction"] = valueFormat->format(group.surfaceFriction());
+        setEnum("deposits", group.deposits());
+        setEnum("contamination_extent", group.contaminationExtent());
+        setValue("deposit_depth", group.depositDepth());
+        setValue("surface_friction", group.surfaceFriction());
         break;
     case metaf::RunwayStateGroup::Type::RUNWAY_NOT_OPERATIONAL:
-        j["deposits"] = util::toLower(magic_enum::enum_name(group.deposits()));
-        j["contamination_extent"] =
-            util::toLower(magic_enum::enum_name(group.contaminationExtent()));
-        j["surface_friction"] = valueFormat->format(group.surfaceFriction());
+        setEnum("deposits", group.deposits());
+        setEnum("contamination_extent", group.contaminationExtent());
+        setValue("surface_friction", group.surfaceFriction());
         break;
     case metaf::RunwayStateGroup::Type::RUNWAY_CLRD:
-        j["surface_friction"] = valueFormat->format(group.surfaceFriction());
+        setValue("surface_friction", group.surfaceFriction());
         break;
     case metaf::RunwayStateGroup::Type::AERODROME_SNOCLO:
     case metaf::RunwayStateGroup::Type::RUNWAY_SNOCLO:
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitSeaSurfaceGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitSeaSurfaceGroup(
     const SeaSurfaceGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "sea_surface"},
-        {"temperature", valueFormat->format(group.surfaceTemperature(), true)},
-        {"waves", valueFormat->format(group.surfaceTemperature(), true)}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
-}
-
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitMinMaxTemperatureGroup(
+    beginGroup(seaSurfaceLayout);
+    setValue("temperature", group.surfaceTemperature(), true);
+    setValue("waves", group.surfaceTemperature(), true);
+    endGroup(group.isValid(), rawString);
+}
+
+void OutputFormatBasic::MetafVisitorBasic::visitMinMaxTemperatureGroup(
     const MinMaxTemperatureGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "min_max_temperature"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(minMaxTemperatureLayout);
+    setEnum("type", group.type());
     switch (group.type())
     {
     case metaf::MinMaxTemperatureGroup::Type::FORECAST:
-        if (const auto t = group.minimumTime(); t.has_value())
-        {
-            j["min_time"] = dateTimeFormat->format(*t, reportDateTime);
-        }
-        if (const auto t = group.maximumTime(); t.has_value())
-        {
-            j["max_time"] = dateTimeFormat->format(*t, reportDateTime);
-        }
+        setOptionalTime("min_time", group.minimumTime());
+        setOptionalTime("max_time", group.maximumTime());
     case metaf::MinMaxTemperatureGroup::Type::OBSERVED_24_HOURLY:
     case metaf::MinMaxTemperatureGroup::Type::OBSERVED_6_HOURLY:
-        j["min_temperature"] = valueFormat->format(group.minimum());
-        j["max_temperature"] = valueFormat->format(group.minimum());
+        setValue("min_temperature", group.minimum());
+        setValue("max_temperature", group.minimum());
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitPrecipitationGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitPrecipitationGroup(
     const PrecipitationGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "precipitation"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))},
-        {"total", valueFormat->format(group.total(), true)}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(precipitationLayout);
+    setEnum("type", group.type());
+    setValue("total", group.total(), true);
     if (group.type() == metaf::PrecipitationGroup::Type::SNOW_INCREASING_RAPIDLY)
-        j["last_hour_increase"] = valueFormat->format(group.total());
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+        setValue("last_hour_increase", group.total());
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitLayerForecastGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitLayerForecastGroup(
     const LayerForecastGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "layer_forecast"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))},
-        {"base_height", valueFormat->format(group.baseHeight(), true)},
-        {"top_height", valueFormat->format(group.topHeight(), true)}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
-}
-
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitPressureTendencyGroup(
+    beginGroup(layerForecastLayout);
+    setEnum("type", group.type());
+    setValue("base_height", group.baseHeight(), true);
+    setValue("top_height", group.topHeight(), true);
+    endGroup(group.isValid(), rawString);
+}
+
+void OutputFormatBasic::MetafVisitorBasic::visitPressureTendencyGroup(
     const PressureTendencyGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "pressure_tendency"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))},
-        {"trend", util::toLower(magic_enum::enum_name(group.trend(group.type())))},
-        {"difference", valueFormat->format(group.difference(), true)}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
-}
-
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitCloudTypesGroup(
+    beginGroup(pressureTendencyLayout);
+    setEnum("type", group.type());
+    setEnum("trend", group.trend(group.type()));
+    setValue("difference", group.difference(), true);
+    endGroup(group.isValid(), rawString);
+}
+
+void OutputFormatBasic::MetafVisitorBasic::visitCloudTypesGroup(
     const CloudTypesGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "cloud_types"}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    j["cloud_types"] = nlohmann::json::array();
+    beginGroup(cloudTypesLayout);
+    field("cloud_types");
+    writer.beginArray();
     for (const auto &ct : group.cloudTypes())
     {
-        nlohmann::json jcloud{
-            {"type", util::toLower(magic_enum::enum_name(ct.type()))},
-            {"height", valueFormat->format(ct.height(), true)}};
+        beginNested();
+        setEnum("type", ct.type());
+        setValue("height", ct.height(), true);
         if (ct.okta())
-            jcloud["okta"] = ct.okta();
-        jcloud["cloud_types"].push_back(std::move(jcloud));
+            setField("okta", ct.okta());
+        endNested();
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    writer.endArray();
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitLowMidHighCloudGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitLowMidHighCloudGroup(
     const LowMidHighCloudGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "low_mid_high_clouds"},
-        {"low_layer", util::toLower(magic_enum::enum_name(group.lowLayer()))},
-        {"mid_layer", util::toLower(magic_enum::enum_name(group.midLayer()))},
-        {"high_layer", util::toLower(magic_enum::enum_name(group.highLayer()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
-}
-
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitLightningGroup(
+    beginGroup(lowMidHighCloudLayout);
+    setEnum("low_layer", group.lowLayer());
+    setEnum("mid_layer", group.midLayer());
+    setEnum("high_layer", group.highLayer());
+    endGroup(group.isValid(), rawString);
+}
+
+void OutputFormatBasic::MetafVisitorBasic::visitLightningGroup(
     const LightningGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "lightning"},
-        {"frequency", util::toLower(magic_enum::enum_name(group.frequency()))},
-        {"distance", valueFormat->format(group.distance())}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(lightningLayout);
+    setEnum("frequency", group.frequency());
+    setValue("distance", group.distance());
     if (group.isCloudGround())
-        j["cloud_to_ground"] = true;
+        setField("cloud_to_ground", true);
     if (group.isInCloud())
-        j["in_cloud"] = true;
+        setField("in_cloud", true);
     if (group.isCloudCloud())
-        j["cloud_to_cloud"] = true;
+        setField("cloud_to_cloud", true);
     if (group.isCloudAir())
-        j["cloud_to_air"] = true;
+        setField("cloud_to_air", true);
     if (group.isUnknownType())
-        j["unknown_lightning_type"] = true;
-    if (const auto dirs = group.directions(); dirs.size())
-    {
-        j["directions"] = nlohmann::json::array();
-        for (const auto &d : dirs)
-        {
-            j["directions"].push_back(valueFormat->format(d));
-        }
-    }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+        setField("unknown_lightning_type", true);
+    setDirections("directions", group.directions());
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitVicinityGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitVicinityGroup(
     const VicinityGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "vicinity"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))},
-        {"distance", valueFormat->format(group.distance())}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (const auto dirs = group.directions(); dirs.size())
-    {
-        j["directions"] = nlohmann::json::array();
-        for (const auto &d : dirs)
-        {
-            j["directions"].push_back(valueFormat->format(d));
-        }
-    }
+    beginGroup(vicinityLayout);
+    setEnum("type", group.type());
+    setValue("distance", group.distance());
+    setDirections("directions", group.directions());
     if (const auto d = group.movingDirection(); d.isReported())
     {
-        j["moving_direction"] = valueFormat->format(d);
+        field("moving_direction");
+        valueFormat->write(writer, d);
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitMiscGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitMiscGroup(
     const MiscGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{
-        {"group", "misc"},
-        {"type", util::toLower(magic_enum::enum_name(group.type()))}};
-    if (!group.isValid())
-        j["not_valid"] = true;
+    beginGroup(miscLayout);
+    setEnum("type", group.type());
     switch (group.type())
     {
     case metaf::MiscGroup::Type::SUNSHINE_DURATION_MINUTES:
         if (const auto v = group.data(); v.has_value())
         {
-            j["minutes"] = std::round(*v);
+            setField("minutes", std::round(*v));
         }
     case metaf::MiscGroup::Type::CORRECTED_WEATHER_OBSERVATION:
         if (const auto v = group.data(); v.has_value())
         {
-            j["correction_number"] = std::round(*v);
+            setField("correction_number", std::round(*v));
         }
     case metaf::MiscGroup::Type::DENSITY_ALTITUDE:
         if (const auto v = group.data(); v.has_value())
         {
-            j["ft"] = std::round(*v);
+            setField("ft", std::round(*v));
         }
         else
         {
-            j["density_altitude_misg"] = true;
+            setField("density_altitude_misg", true);
         }
         break;
     case metaf::MiscGroup::Type::HAILSTONE_SIZE:
         if (const auto v = group.data(); v.has_value())
         {
-            j["in"] = util::formatDecimals(*v, 2);
+            setField("in", util::formatDecimals(*v, 2));
         }
         break;
     case metaf::MiscGroup::Type::COLOUR_CODE_BLUE:
@@ -817,55 +912,395 @@ nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitMiscGroup(
     case metaf::MiscGroup::Type::FROIN:
         break;
     }
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::MetafVisitorBasic::visitUnknownGroup(
+void OutputFormatBasic::MetafVisitorBasic::visitUnknownGroup(
     const UnknownGroup &group,
     ReportPart reportPart,
     const std::string &rawString)
 {
     (void)reportPart;
-    nlohmann::json j{{"group", "unknown"}};
-    if (!group.isValid())
-        j["not_valid"] = true;
-    if (includeRawStrings)
-        j["raw_string"] = rawString;
-    return j;
+    beginGroup(unknownLayout);
+    endGroup(group.isValid(), rawString);
 }
 
-nlohmann::json OutputFormatBasic::toJson(const metaf::ParseResult &parseResult) const
+//////////////////////////////////////////////////////////////////////////////
+// OutputFormatBasic
+//////////////////////////////////////////////////////////////////////////////
+
+OutputFormatBasic::OutputFormatBasic(std::unique_ptr<DateTimeFormat> dtFormat,
+                                     std::unique_ptr<ValueFormat> valFormat,
+                                     bool rawStrings,
+                                     int refYear,
+                                     unsigned refMonth,
+                                     unsigned refDay,
+                                     GroupFilter groups,
+                                     std::unique_ptr<const FilterExpression> filter,
+                                     std::unique_ptr<const Encoder> enc,
+                                     bool tuples,
+                                     bool compact)
+    : OutputFormat(std::move(dtFormat),
+                   std::move(valFormat),
+                   rawStrings,
+                   refYear,
+                   refMonth,
+                   refDay,
+                   std::move(groups),
+                   std::move(filter),
+                   std::move(enc)),
+      tupleGroups(tuples),
+      compact(compact)
 {
-    nlohmann::json output;
-    output["report"]["type"] =
-        util::toLower(magic_enum::enum_name(parseResult.reportMetadata.type));
-    if (parseResult.reportMetadata.error != metaf::ReportError::NONE)
-        output["report"]["error"] =
-            util::toLower(magic_enum::enum_name(parseResult.reportMetadata.error));
+}
+
+OutputFormatBasic::~OutputFormatBasic()
+{
+}
+
+nlohmann::json OutputFormatBasic::tupleSchema()
+{
+    nlohmann::json schema = nlohmann::json::object();
+    for (const auto &l : groupLayouts)
+    {
+        auto &fields = schema[std::string(l.group)];
+        fields = nlohmann::json::array();
+        for (auto i = 0u; i < l.size; i++)
+            fields.push_back(l.fields[i]);
+    }
+    return nlohmann::json{{"schema", std::move(schema)}};
+}
 
-    output["groups"] = nlohmann::json::array();
+void OutputFormatBasic::start(std::ostream &out) const
+{
+    if (tupleGroups)
+        getEncoder().write(tupleSchema(), out);
+}
+
+void OutputFormatBasic::writeReport(const metaf::ParseResult &parseResult,
+                                    const RefDate &refDate,
+                                    ValueWriter &writer) const
+{
+    writer.beginObject();
+    writer.key("report");
+    writeReportInfo(parseResult, writer);
+
+    writer.key("groups");
+    writer.beginArray();
     MetafVisitorBasic visitor(
         parseResult,
+        writer,
         dateTimeFormat.get(),
         valueFormat.get(),
         getIncludeRawStrings(),
-        getReferenceYear(),
-        getReferenceMonth(),
-        getReferenceDay());
-    std::string rawReportStr;
+        refDate,
+        compact,
+        tupleGroups);
     for (const auto &groupInfo : parseResult.groups)
     {
-        auto groupOutput = visitor.visit(groupInfo);
-        output["groups"].push_back(groupOutput);
-        if (getIncludeRawStrings())
+        // Skip excluded groups before any formatting is done
+        if (!getGroupFilter().includes(groupInfo.group.index()))
+            continue;
+        visitor.visit(groupInfo);
+    }
+    writer.endArray();
+    writer.endObject();
+}
+
+void OutputFormatBasic::writeReportInfo(const metaf::ParseResult &parseResult,
+                                        ValueWriter &writer) const
+{
+    writer.beginObject();
+    writer.member("type",
+        util::toLower(magic_enum::enum_name(parseResult.reportMetadata.type)));
+    if (parseResult.reportMetadata.error != metaf::ReportError::NONE)
+        writer.member("error",
+            util::toLower(magic_enum::enum_name(parseResult.reportMetadata.error)));
+    if (getIncludeRawStrings())
+    {
+        std::string rawReportStr;
+        for (const auto &groupInfo : parseResult.groups)
         {
             rawReportStr += metaf::groupDelimiterChar;
             rawReportStr += groupInfo.rawString;
         }
+        writer.member("raw_string", rawReportStr);
+    }
+    writer.endObject();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// OutputFormatBasic::Delta
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Number of groups looked ahead to find the pair of a group
+const size_t pairLookahead = 4;
+
+} // namespace
+
+OutputFormatBasic::Delta::Delta(std::unique_ptr<const OutputFormatBasic> format)
+    : format(std::move(format))
+{
+    if (!this->format)
+        throw(std::runtime_error("format is null when creating Delta"));
+}
+
+OutputFormatBasic::Delta::~Delta()
+{
+}
+
+OutputFormat::Result OutputFormatBasic::Delta::toJson(const std::string &report,
+                                                      const RefDate &refDate,
+                                                      std::ostream &out)
+{
+    try
+    {
+        const auto parseResult = metaf::Parser::parse(report);
+        if (!format->matchesFilter(parseResult))
+            return Result::FILTERED;
+        serialise(parseResult, refDate, out);
+        return Result::OK;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception " << e.what();
+        std::cerr << " occurred when parsing or serialising the following report:" << std::endl;
+        std::cerr << report << std::endl;
+        return Result::EXCEPTION;
+    }
+}
+
+OutputFormat::Result OutputFormatBasic::Delta::toJson(const metaf::ParseResult &parseResult,
+                                                      const RefDate &refDate,
+                                                      std::ostream &out)
+{
+    try
+    {
+        if (!format->matchesFilter(parseResult))
+            return Result::FILTERED;
+        serialise(parseResult, refDate, out);
+        return Result::OK;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception " << e.what();
+        std::cerr << " occurred when serialising parsed report" << std::endl;
+        return Result::EXCEPTION;
+    }
+}
+
+void OutputFormatBasic::Delta::serialise(const metaf::ParseResult &parseResult,
+                                         const RefDate &refDate,
+                                         std::ostream &out)
+{
+    std::string location;
+    for (const auto &groupInfo : parseResult.groups)
+    {
+        if (groupInfo.reportPart != ReportPart::HEADER)
+            continue;
+        if (const auto g = std::get_if<LocationGroup>(&groupInfo.group))
+        {
+            location = g->toString();
+            break;
+        }
+    }
+    // Report without location is always serialised in full
+    if (location.empty())
+    {
+        format->serialise(parseResult, refDate, out);
+        return;
+    }
+    record(parseResult, refDate);
+    const auto [p, first] = previousReports.try_emplace(
+        std::make_pair(std::move(location), parseResult.reportMetadata.type));
+    auto &previous = p->second;
+    if (first)
+    {
+        format->serialise(parseResult, refDate, out);
+        std::swap(previous, current);
+        return;
+    }
+
+    auto &writer = format->getEncoder().begin();
+    writer.beginObject();
+    writer.key("report");
+    writer.beginObject();
+    writer.member("type",
+        util::toLower(magic_enum::enum_name(parseResult.reportMetadata.type)));
+    if (compare(previous, previous.info, current.info))
+        writeChanges(writer);
+    writer.endObject();
+
+    pairGroups(previous);
+    writer.key("delta");
+    writer.beginObject();
+    writer.member("location", p->first.first);
+    writer.key("removed");
+    writer.beginArray();
+    for (const auto i : removedGroups)
+        writer.value(i);
+    writer.endArray();
+    writer.key("added");
+    writer.beginArray();
+    MetafVisitorBasic visitor(
+        parseResult,
+        writer,
+        format->dateTimeFormat.get(),
+        format->valueFormat.get(),
+        format->getIncludeRawStrings(),
+        refDate,
+        format->compact,
+        format->tupleGroups);
+    for (const auto i : addedGroups)
+    {
+        writer.beginObject();
+        writer.member("index", i);
+        writer.key("group");
+        visitor.visit(*current.groups[i].info);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.key("changed");
+    writer.beginArray();
+    for (const auto &[i, j] : pairedGroups)
+    {
+        if (!compare(previous, previous.groups[i].value, current.groups[j].value))
+            continue;
+        writer.beginObject();
+        writer.member("index", j);
+        writer.key("fields");
+        writer.beginObject();
+        writeChanges(writer);
+        writer.endObject();
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    writer.endObject();
+    format->getEncoder().end(out);
+    std::swap(previous, current);
+}
+
+void OutputFormatBasic::Delta::record(const metaf::ParseResult &parseResult,
+                                      const RefDate &refDate)
+{
+    auto &values = current.values;
+    values.clear();
+    current.groups.clear();
+    format->writeReportInfo(parseResult, values);
+    current.info = ValueRecorder::Range{0, values.position()};
+    // Groups are recorded as objects so that fields are found by name
+    MetafVisitorBasic visitor(
+        parseResult,
+        values,
+        format->dateTimeFormat.get(),
+        format->valueFormat.get(),
+        format->getIncludeRawStrings(),
+        refDate,
+        format->compact,
+        false);
+    for (const auto &groupInfo : parseResult.groups)
+    {
+        if (!format->getGroupFilter().includes(groupInfo.group.index()))
+            continue;
+        const auto begin = values.position();
+        visitor.visit(groupInfo);
+        current.groups.push_back(Group{groupInfo.group.index(),
+                                       groupInfo.reportPart,
+                                       &groupInfo,
+                                       ValueRecorder::Range{begin, values.position()}});
+    }
+}
+
+void OutputFormatBasic::Delta::pairGroups(const Report &previous)
+{
+    removedGroups.clear();
+    addedGroups.clear();
+    pairedGroups.clear();
+    const auto &prev = previous.groups;
+    const auto &curr = current.groups;
+    auto pairable = [](const Group &g1, const Group &g2) {
+        return g1.kind == g2.kind && g1.reportPart == g2.reportPart;
+    };
+    // Index of the first group within lookahead which can be paired with
+    // the group, or end index if none
+    auto find = [&](const std::vector<Group> &groups, size_t begin, const Group &group) {
+        const auto end = std::min(begin + pairLookahead, groups.size());
+        for (auto i = begin; i < end; i++)
+        {
+            if (pairable(groups[i], group))
+                return i;
+        }
+        return groups.size();
+    };
+    size_t i = 0, j = 0;
+    while (i < prev.size() || j < curr.size())
+    {
+        if (i < prev.size() && j < curr.size() && pairable(prev[i], curr[j]))
+        {
+            pairedGroups.emplace_back(i++, j++);
+            continue;
+        }
+        // Groups before the nearest pair are removed or added
+        const auto pi = j < curr.size() ? find(prev, i, curr[j]) : prev.size();
+        const auto cj = i < prev.size() ? find(curr, j, prev[i]) : curr.size();
+        if (pi < prev.size() && (cj == curr.size() || pi - i <= cj - j))
+        {
+            while (i < pi)
+                removedGroups.push_back(i++);
+            continue;
+        }
+        if (cj < curr.size())
+        {
+            while (j < cj)
+                addedGroups.push_back(j++);
+            continue;
+        }
+        if (i < prev.size())
+            removedGroups.push_back(i++);
+        if (j < curr.size())
+            addedGroups.push_back(j++);
+    }
+}
+
+bool OutputFormatBasic::Delta::compare(const Report &previous,
+                                       ValueRecorder::Range previousObject,
+                                       ValueRecorder::Range currentObject)
+{
+    changes.clear();
+    previous.values.members(previousObject, previousMembers);
+    current.values.members(currentObject, currentMembers);
+    for (const auto &c : currentMembers)
+    {
+        const auto p = std::find_if(previousMembers.begin(), previousMembers.end(),
+            [&](const ValueRecorder::Member &m) { return m.key == c.key; });
+        if (p == previousMembers.end() ||
+            !previous.values.equal(p->value, current.values, c.value))
+        {
+            changes.push_back(Change{c.key, c.value});
+        }
+    }
+    for (const auto &p : previousMembers)
+    {
+        const auto c = std::find_if(currentMembers.begin(), currentMembers.end(),
+            [&](const ValueRecorder::Member &m) { return m.key == p.key; });
+        if (c == currentMembers.end())
+            changes.push_back(Change{p.key, ValueRecorder::Range{}});
+    }
+    return !changes.empty();
+}
+
+void OutputFormatBasic::Delta::writeChanges(ValueWriter &writer) const
+{
+    for (const auto &c : changes)
+    {
+        writer.key(c.key);
+        if (c.value.begin == c.value.end)
+            writer.writeNull();
+        else
+            current.values.replay(c.value, writer);
     }
-    if (getIncludeRawStrings())
-        output["report"]["raw_string"] = rawReportStr;
-    return output;
 }
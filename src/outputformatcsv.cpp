@@ -0,0 +1,209 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "outputformatcsv.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "date/date.h"
+
+#include "utility.hpp"
+
+namespace
+{
+
+void appendNumber(std::optional<float> value, std::string &result)
+{
+    if (!value.has_value())
+        return;
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%g", *value);
+    result += buffer;
+}
+
+void appendList(const std::vector<std::string> &values, std::string &result)
+{
+    for (auto i = 0u; i < values.size(); i++)
+    {
+        if (i)
+            result.push_back(' ');
+        result += values[i];
+    }
+}
+
+// ISO 8601 date and time, e.g. 2020-06-04T12:50Z
+void appendTime(std::optional<int64_t> time, std::string &result)
+{
+    if (!time.has_value())
+        return;
+    static const int64_t secondsPerDay = 24 * 60 * 60;
+    auto days = *time / secondsPerDay;
+    auto seconds = *time % secondsPerDay;
+    if (seconds < 0)
+    {
+        days--;
+        seconds += secondsPerDay;
+    }
+    const date::year_month_day ymd{date::sys_days{date::days{days}}};
+    char buffer[32];
+    std::snprintf(buffer,
+                  sizeof(buffer),
+                  "%04d-%02u-%02uT%02u:%02uZ",
+                  static_cast<int>(ymd.year()),
+                  static_cast<unsigned>(ymd.month()),
+                  static_cast<unsigned>(ymd.day()),
+                  static_cast<unsigned>(seconds / 3600),
+                  static_cast<unsigned>(seconds % 3600 / 60));
+    result += buffer;
+}
+
+struct ColumnInfo
+{
+    std::string_view name;
+    void (*extract)(const ReportValues &values, std::string &result);
+};
+
+// Column names are the same as in Arrow output
+const ColumnInfo columnInfo[] = {
+    {"station", [](const ReportValues &v, std::string &r) { r += v.station; }},
+    {"time", [](const ReportValues &v, std::string &r) { appendTime(v.time, r); }},
+    {"type", [](const ReportValues &v, std::string &r) { r += ReportValues::typeName(v.type); }},
+    {"wind_dir", [](const ReportValues &v, std::string &r) {
+         if (v.windDirection.has_value())
+             r += std::to_string(*v.windDirection);
+     }},
+    {"wind_kt", [](const ReportValues &v, std::string &r) { appendNumber(v.windSpeed, r); }},
+    {"gust_kt", [](const ReportValues &v, std::string &r) { appendNumber(v.gustSpeed, r); }},
+    {"vis_m", [](const ReportValues &v, std::string &r) { appendNumber(v.visibility, r); }},
+    {"ceiling_ft", [](const ReportValues &v, std::string &r) { appendNumber(v.ceiling, r); }},
+    {"temp_c", [](const ReportValues &v, std::string &r) { appendNumber(v.temperature, r); }},
+    {"dewpt_c", [](const ReportValues &v, std::string &r) { appendNumber(v.dewPoint, r); }},
+    {"qnh_hpa", [](const ReportValues &v, std::string &r) { appendNumber(v.qnh, r); }},
+    {"clouds", [](const ReportValues &v, std::string &r) { appendList(v.clouds, r); }},
+    {"weather", [](const ReportValues &v, std::string &r) { appendList(v.weather, r); }}};
+
+} // namespace
+
+OutputFormatCsv::OutputFormatCsv(std::unique_ptr<DateTimeFormat> dtFormat,
+                                 std::unique_ptr<ValueFormat> valFormat,
+                                 int refYear,
+                                 unsigned refMonth,
+                                 unsigned refDay,
+                                 std::unique_ptr<const FilterExpression> filter,
+                                 std::string_view columns,
+                                 char separator)
+    : OutputFormat(std::move(dtFormat),
+                   std::move(valFormat),
+                   false,
+                   refYear,
+                   refMonth,
+                   refDay,
+                   GroupFilter(),
+                   std::move(filter)),
+      columnList(resolveColumns(columns)),
+      delimiter(separator),
+      quotedChars{separator, '"', '\r', '\n'}
+{
+}
+
+std::vector<OutputFormatCsv::Column> OutputFormatCsv::resolveColumns(std::string_view list)
+{
+    std::vector<Column> result;
+    if (list.empty())
+    {
+        for (const auto &c : columnInfo)
+            result.push_back(Column{c.name, c.extract});
+        return result;
+    }
+    while (!list.empty())
+    {
+        const auto comma = list.find(',');
+        const auto name = util::toLower(list.substr(0, comma));
+        if (!name.empty())
+        {
+            const auto it = std::find_if(std::begin(columnInfo),
+                                         std::end(columnInfo),
+                                         [&name](const ColumnInfo &c) { return c.name == name; });
+            if (it == std::end(columnInfo))
+                throw std::invalid_argument("Column " + name + " is not recognised");
+            result.push_back(Column{it->name, it->extract});
+        }
+        if (comma == std::string_view::npos)
+            break;
+        list.remove_prefix(comma + 1);
+    }
+    if (result.empty())
+        throw std::invalid_argument("No columns specified");
+    return result;
+}
+
+void OutputFormatCsv::checkColumns(std::string_view columns)
+{
+    resolveColumns(columns);
+}
+
+std::string OutputFormatCsv::allColumns()
+{
+    std::string result;
+    for (const auto &c : columnInfo)
+    {
+        if (!result.empty())
+            result.push_back(',');
+        result += c.name;
+    }
+    return result;
+}
+
+void OutputFormatCsv::appendField(std::string_view f) const
+{
+    // Fields with delimiters, quotes or line breaks are quoted (RFC 4180)
+    if (f.find_first_of(quotedChars) == std::string_view::npos)
+    {
+        row += f;
+        return;
+    }
+    row.push_back('"');
+    for (const auto c : f)
+    {
+        if (c == '"')
+            row.push_back('"');
+        row.push_back(c);
+    }
+    row.push_back('"');
+}
+
+void OutputFormatCsv::start(std::ostream &out) const
+{
+    row.clear();
+    for (auto i = 0u; i < columnList.size(); i++)
+    {
+        if (i)
+            row.push_back(delimiter);
+        appendField(columnList[i].name);
+    }
+    out << row << "\n";
+}
+
+void OutputFormatCsv::serialise(const metaf::ParseResult &parseResult,
+                                const RefDate &refDate,
+                                std::ostream &out) const
+{
+    values.extract(parseResult, refDate);
+    row.clear();
+    for (auto i = 0u; i < columnList.size(); i++)
+    {
+        if (i)
+            row.push_back(delimiter);
+        field.clear();
+        columnList[i].extract(values, field);
+        appendField(field);
+    }
+    out << row << "\n";
+}
@@ -0,0 +1,143 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "outputformatevents.hpp"
+
+#include <stdexcept>
+
+#include "nlohmann/json.hpp"
+#include "metaf.hpp"
+#include "magic_enum.hpp"
+
+#include "utility.hpp"
+
+OutputFormatEvents::OutputFormatEvents(std::unique_ptr<DateTimeFormat> dtFormat,
+                                       std::unique_ptr<ValueFormat> valFormat,
+                                       int refYear,
+                                       unsigned refMonth,
+                                       unsigned refDay,
+                                       std::unique_ptr<const FilterExpression> filter,
+                                       std::unique_ptr<const Encoder> enc,
+                                       std::vector<unsigned> gustThresholds)
+    : OutputFormat(std::move(dtFormat),
+                   std::move(valFormat),
+                   false,
+                   refYear,
+                   refMonth,
+                   refDay,
+                   GroupFilter(),
+                   std::move(filter),
+                   std::move(enc)),
+      thresholds(std::move(gustThresholds))
+{
+}
+
+void OutputFormatEvents::serialise(const metaf::ParseResult &parseResult,
+                                   const RefDate &refDate,
+                                   std::ostream &out) const
+{
+    (void)parseResult;
+    (void)refDate;
+    (void)out;
+    throw(std::runtime_error("Events are only serialised by OutputFormatEvents::Detector"));
+}
+
+void OutputFormatEvents::writeEvents(const metaf::ParseResult &parseResult,
+                                     const RefDate &refDate,
+                                     const EventDetector::Result &result,
+                                     std::ostream &out) const
+{
+    if (result.events.empty())
+        return;
+    // Report time is present in all reports which were not skipped
+    const auto reportTime = dateTimeFormat->format(DateTimeFormat::DateTime(
+        *parseResult.reportMetadata.reportTime,
+        refDate.year,
+        refDate.month,
+        refDate.day));
+    using Type = EventDetector::Event::Type;
+    for (const auto &event : result.events)
+    {
+        nlohmann::json j{
+            {"station", result.station},
+            {"report_time", reportTime},
+            {"event", util::toLower(magic_enum::enum_name(event.type))}};
+        switch (event.type)
+        {
+        case Type::FLIGHT_CATEGORY:
+            j["from"] = std::string(magic_enum::enum_name(event.from));
+            j["to"] = std::string(magic_enum::enum_name(event.to));
+            break;
+        case Type::GUST_ABOVE:
+        case Type::GUST_BELOW:
+            j["threshold"] = event.threshold;
+            if (event.gust.has_value())
+                j["gust"] = *event.gust;
+            break;
+        case Type::ONSET:
+        case Type::CESSATION:
+            j["weather"] = std::string(magic_enum::enum_name(event.weather));
+            break;
+        }
+        getEncoder().write(j, out);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// OutputFormatEvents::Detector
+//////////////////////////////////////////////////////////////////////////////
+
+OutputFormatEvents::Detector::Detector(std::unique_ptr<const OutputFormatEvents> format)
+    : format(std::move(format)),
+      detector(this->format ? this->format->gustThresholds() : std::vector<unsigned>())
+{
+    if (!this->format)
+        throw(std::runtime_error("format is null when creating Detector"));
+}
+
+OutputFormat::Result OutputFormatEvents::Detector::toJson(const std::string &report,
+                                                          const RefDate &refDate,
+                                                          std::ostream &out)
+{
+    try
+    {
+        const auto parseResult = metaf::Parser::parse(report);
+        if (!format->matchesFilter(parseResult))
+            return Result::FILTERED;
+        if (detector.detect(parseResult, refDate, result))
+            format->writeEvents(parseResult, refDate, result, out);
+        return Result::OK;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception " << e.what();
+        std::cerr << " occurred when parsing or serialising the following report:" << std::endl;
+        std::cerr << report << std::endl;
+        return Result::EXCEPTION;
+    }
+}
+
+OutputFormat::Result OutputFormatEvents::Detector::toJson(const metaf::ParseResult &parseResult,
+                                                          const RefDate &refDate,
+                                                          std::ostream &out)
+{
+    try
+    {
+        if (!format->matchesFilter(parseResult))
+            return Result::FILTERED;
+        if (detector.detect(parseResult, refDate, result))
+            format->writeEvents(parseResult, refDate, result, out);
+        return Result::OK;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception " << e.what();
+        std::cerr << " occurred when serialising parsed report" << std::endl;
+        return Result::EXCEPTION;
+    }
+}
@@ -0,0 +1,164 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "outputindex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using Entry = OutputIndex::Entry;
+using Station = OutputIndex::Station;
+
+static_assert(sizeof(OutputIndex::Header) == 56, "Index header layout");
+static_assert(sizeof(Station) == 24, "Index station layout");
+static_assert(sizeof(Entry) == 24, "Index entry layout");
+
+static const char magic[8] = {'M', 'E', 'T', 'A', 'F', 'O', 'I', 'X'};
+static const uint32_t byteOrder = 0x01020304;
+
+//////////////////////////////////////////////////////////////////////////////
+// OutputIndex::Builder
+//////////////////////////////////////////////////////////////////////////////
+
+void OutputIndex::Builder::add(const ReportKey &key, uint64_t offset, uint32_t length)
+{
+    entries.push_back(Entry{key.station, length, key.time, offset});
+}
+
+void OutputIndex::Builder::write(std::ostream &index, uint64_t outputSize)
+{
+    std::sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs) {
+        if (lhs.station != rhs.station)
+            return lhs.station < rhs.station;
+        if (lhs.time != rhs.time)
+            return lhs.time < rhs.time;
+        return lhs.offset < rhs.offset;
+    });
+    std::vector<Station> stations;
+    for (auto i = 0u; i < entries.size(); i++)
+    {
+        if (stations.empty() || stations.back().station != entries[i].station)
+            stations.push_back(Station{entries[i].station, 0, i, 0});
+        stations.back().count++;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrder;
+    header.outputSize = outputSize;
+    header.stationCount = stations.size();
+    header.entryCount = entries.size();
+    header.stationsOffset = sizeof(Header);
+    header.entriesOffset = header.stationsOffset + stations.size() * sizeof(Station);
+    index.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    index.write(reinterpret_cast<const char *>(stations.data()),
+                stations.size() * sizeof(Station));
+    index.write(reinterpret_cast<const char *>(entries.data()),
+                entries.size() * sizeof(Entry));
+    if (!index)
+        throw(std::runtime_error("Cannot write index"));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// OutputIndex
+//////////////////////////////////////////////////////////////////////////////
+
+OutputIndex::OutputIndex(const std::string &indexFileName) : file(indexFileName)
+{
+    const auto invalid = [&]() {
+        return std::runtime_error(indexFileName + " is not a valid index");
+    };
+    if (file.size() < sizeof(Header))
+        throw(invalid());
+    header = reinterpret_cast<const Header *>(file.data());
+    if (std::memcmp(header->magic, magic, sizeof(magic)) ||
+        header->byteOrder != byteOrder)
+    {
+        throw(invalid());
+    }
+    if (header->version != version)
+        throw(std::runtime_error(indexFileName + " has unsupported index version"));
+    const auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset <= file.size() && count <= (file.size() - offset) / size;
+    };
+    if (!fits(header->stationsOffset, header->stationCount, sizeof(Station)) ||
+        !fits(header->entriesOffset, header->entryCount, sizeof(Entry)))
+    {
+        throw(invalid());
+    }
+    stations = reinterpret_cast<const Station *>(file.data() + header->stationsOffset);
+    entries = reinterpret_cast<const Entry *>(file.data() + header->entriesOffset);
+    for (auto s = stationsBegin(); s != stationsEnd(); s++)
+    {
+        if (s->first > header->entryCount || s->count > header->entryCount - s->first)
+            throw(invalid());
+    }
+}
+
+std::pair<const Entry *, const Entry *> OutputIndex::find(uint32_t station,
+                                                          int64_t from,
+                                                          int64_t to) const
+{
+    const auto s = std::lower_bound(
+        stationsBegin(), stationsEnd(), station,
+        [](const Station &st, uint32_t value) { return st.station < value; });
+    if (s == stationsEnd() || s->station != station)
+        return std::make_pair(entries, entries);
+    const auto begin = entries + s->first;
+    const auto end = begin + s->count;
+    return std::make_pair(
+        std::lower_bound(begin, end, from,
+                         [](const Entry &e, int64_t time) { return e.time < time; }),
+        std::upper_bound(begin, end, to,
+                         [](int64_t time, const Entry &e) { return time < e.time; }));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// CountingOutput
+//////////////////////////////////////////////////////////////////////////////
+
+CountingOutput::CountingOutput(std::streambuf *sink, size_t bufferSize)
+    : sink(sink), buffer(bufferSize ? bufferSize : 1, '\0')
+{
+    setp(buffer.data(), buffer.data() + buffer.length());
+}
+
+CountingOutput::~CountingOutput()
+{
+    passBuffer();
+}
+
+bool CountingOutput::passBuffer()
+{
+    const auto length = pptr() - pbase();
+    const auto passed = length ? sink->sputn(pbase(), length) : 0;
+    written += passed;
+    setp(buffer.data(), buffer.data() + buffer.length());
+    return passed == length;
+}
+
+CountingOutput::int_type CountingOutput::overflow(int_type c)
+{
+    if (!passBuffer())
+        return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int CountingOutput::sync()
+{
+    if (!passBuffer())
+        return -1;
+    return sink->pubsync();
+}
@@ -0,0 +1,236 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "parsecache.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "metaf.hpp"
+#include "magic_enum.hpp"
+
+using Header = ParseCache::Header;
+using Record = ParseCache::Record;
+using Group = ParseCache::Group;
+
+static_assert(sizeof(Header) == 32, "Cache header layout");
+static_assert(sizeof(Record) == 24, "Cache record layout");
+static_assert(sizeof(Group) == 8, "Cache group layout");
+
+static const char magic[8] = {'M', 'E', 'T', 'A', 'F', 'P', 'R', 'S'};
+static const uint32_t byteOrder = 0x01020304;
+static const uint32_t metafVersion = metaf::Version::major * 1000 + metaf::Version::minor;
+static const uint32_t groupKinds = std::variant_size_v<metaf::Group>;
+static const size_t recordAlignment = 8;
+
+// Parse the first token of the group as the group type with index kind
+template <size_t I = 0>
+static std::optional<metaf::Group> parseGroup(size_t kind,
+                                              const std::string &token,
+                                              metaf::ReportPart reportPart,
+                                              const metaf::ReportMetadata &metadata)
+{
+    if constexpr (I < std::variant_size_v<metaf::Group>)
+    {
+        if (kind != I)
+            return parseGroup<I + 1>(kind, token, reportPart, metadata);
+        using GroupType = std::variant_alternative_t<I, metaf::Group>;
+        if (const auto group = GroupType::parse(token, reportPart, metadata); group.has_value())
+            return metaf::Group(*group);
+    }
+    return std::optional<metaf::Group>();
+}
+
+// Restore the group from its raw string; the tokens following the first
+// one must be appended to the group
+static std::optional<metaf::Group> restoreGroup(size_t kind,
+                                                std::string_view rawString,
+                                                metaf::ReportPart reportPart,
+                                                const metaf::ReportMetadata &metadata)
+{
+    const auto tokenEnd = std::min(rawString.find(metaf::groupDelimiterChar), rawString.length());
+    auto group = parseGroup(kind, std::string(rawString.substr(0, tokenEnd)), reportPart, metadata);
+    rawString.remove_prefix(std::min(tokenEnd + 1, rawString.length()));
+    while (group.has_value() && !rawString.empty())
+    {
+        const auto end = std::min(rawString.find(metaf::groupDelimiterChar), rawString.length());
+        const auto token = std::string(rawString.substr(0, end));
+        const auto result = std::visit(
+            [&](auto &g) { return g.append(token, reportPart, metadata); }, *group);
+        if (result != metaf::AppendResult::APPENDED)
+            return std::optional<metaf::Group>();
+        rawString.remove_prefix(std::min(end + 1, rawString.length()));
+    }
+    return group;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ParseCache::Writer
+//////////////////////////////////////////////////////////////////////////////
+
+ParseCache::Writer::Writer(std::ostream &out) : output(out), start(out.tellp())
+{
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrder;
+    header.metafVersion = metafVersion;
+    header.groupKinds = groupKinds;
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void ParseCache::Writer::add(const std::string &report,
+                             const RefDate &refDate,
+                             const metaf::ParseResult &parseResult)
+{
+    const auto &metadata = parseResult.reportMetadata;
+    if (parseResult.groups.size() > std::numeric_limits<uint16_t>::max())
+        throw(std::runtime_error("Too many groups in report to cache"));
+    Record r{};
+    r.textLength = report.length();
+    r.refYear = refDate.year;
+    r.refMonth = refDate.month;
+    r.refDay = refDate.day;
+    r.type = static_cast<uint8_t>(metadata.type);
+    r.error = static_cast<uint8_t>(metadata.error);
+    r.flags = (metadata.isSpeci ? SPECI : 0) |
+              (metadata.isNil ? NIL : 0) |
+              (metadata.isCancelled ? CANCELLED : 0) |
+              (metadata.isAmended ? AMENDED : 0) |
+              (metadata.isCorrectional ? CORRECTIONAL : 0) |
+              (metadata.isAutomated ? AUTOMATED : 0);
+    r.groupCount = parseResult.groups.size();
+
+    record.assign(sizeof(Record), '\0');
+    for (const auto &groupInfo : parseResult.groups)
+    {
+        Group g{};
+        g.kind = groupInfo.group.index();
+        g.reportPart = static_cast<uint8_t>(groupInfo.reportPart);
+        g.length = groupInfo.rawString.length();
+        record.append(reinterpret_cast<const char *>(&g), sizeof(g));
+    }
+    record.append(report);
+    for (const auto &groupInfo : parseResult.groups)
+        record.append(groupInfo.rawString);
+    record.resize((record.length() + recordAlignment - 1) / recordAlignment * recordAlignment);
+    r.size = record.length();
+    std::memcpy(record.data(), &r, sizeof(r));
+    output.write(record.data(), record.length());
+    count++;
+}
+
+void ParseCache::Writer::finish()
+{
+    output.flush();
+    if (start == std::streampos(-1))
+        return;
+    const auto end = output.tellp();
+    output.seekp(start + static_cast<std::streamoff>(offsetof(Header, reportCount)));
+    output.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    output.seekp(end);
+    output.flush();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ParseCache
+//////////////////////////////////////////////////////////////////////////////
+
+ParseCache::ParseCache(const std::string &fileName) : file(fileName), name(fileName)
+{
+    if (file.size() < sizeof(Header))
+        throw(std::runtime_error(fileName + " is not a valid parse cache"));
+    const auto header = reinterpret_cast<const Header *>(file.data());
+    if (std::memcmp(header->magic, magic, sizeof(magic)) ||
+        header->byteOrder != byteOrder)
+    {
+        throw(std::runtime_error(fileName + " is not a valid parse cache"));
+    }
+    if (header->version != version)
+        throw(std::runtime_error(fileName + " has unsupported parse cache version"));
+    if (header->metafVersion != metafVersion || header->groupKinds != groupKinds)
+        throw(std::runtime_error(fileName + " was written by a different version of metaf"));
+}
+
+void ParseCache::read(
+    const std::function<void(const std::string &report,
+                             const RefDate &refDate,
+                             const metaf::ParseResult &parseResult)> &f) const
+{
+    const auto corrupted = [&]() {
+        return std::runtime_error(name + " is corrupted");
+    };
+    std::string report;
+    metaf::ParseResult result;
+    for (auto position = sizeof(Header); position < file.size();)
+    {
+        const auto p = file.data() + position;
+        const auto left = file.size() - position;
+        if (left < sizeof(Record))
+            throw(corrupted());
+        const auto &r = *reinterpret_cast<const Record *>(p);
+        const auto groupsSize = r.groupCount * sizeof(Group);
+        if (r.size > left ||
+            r.size % recordAlignment ||
+            r.size < sizeof(Record) + groupsSize ||
+            r.textLength > r.size - sizeof(Record) - groupsSize ||
+            r.type >= magic_enum::enum_count<metaf::ReportType>() ||
+            r.error >= magic_enum::enum_count<metaf::ReportError>())
+        {
+            throw(corrupted());
+        }
+        const auto groups = reinterpret_cast<const Group *>(p + sizeof(Record));
+        const auto text = p + sizeof(Record) + groupsSize;
+        auto rawStrings = std::string_view(text + r.textLength,
+                                           r.size - sizeof(Record) - groupsSize - r.textLength);
+        report.assign(text, r.textLength);
+        const RefDate refDate(r.refYear, r.refMonth, r.refDay);
+
+        result.reportMetadata = metaf::ReportMetadata();
+        auto &metadata = result.reportMetadata;
+        metadata.type = static_cast<metaf::ReportType>(r.type);
+        metadata.error = static_cast<metaf::ReportError>(r.error);
+        metadata.isSpeci = r.flags & SPECI;
+        metadata.isNil = r.flags & NIL;
+        metadata.isCancelled = r.flags & CANCELLED;
+        metadata.isAmended = r.flags & AMENDED;
+        metadata.isCorrectional = r.flags & CORRECTIONAL;
+        metadata.isAutomated = r.flags & AUTOMATED;
+        result.groups.clear();
+        bool restored = true;
+        for (auto i = 0u; i < r.groupCount && restored; i++)
+        {
+            if (groups[i].length > rawStrings.length() ||
+                groups[i].reportPart >= magic_enum::enum_count<metaf::ReportPart>())
+            {
+                throw(corrupted());
+            }
+            const auto rawString = rawStrings.substr(0, groups[i].length);
+            rawStrings.remove_prefix(groups[i].length);
+            const auto reportPart = static_cast<metaf::ReportPart>(groups[i].reportPart);
+            auto group = restoreGroup(groups[i].kind, rawString, reportPart, metadata);
+            if (!group.has_value())
+            {
+                restored = false;
+                break;
+            }
+            if (const auto rt = std::get_if<metaf::ReportTimeGroup>(&*group))
+                metadata.reportTime = rt->time();
+            result.groups.emplace_back(std::move(*group), reportPart, std::string(rawString));
+        }
+        if (!restored)
+        {
+            result = metaf::Parser::parse(report);
+            reparsed++;
+        }
+        f(report, refDate, result);
+        position += r.size;
+    }
+}
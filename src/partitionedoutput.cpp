@@ -0,0 +1,340 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "partitionedoutput.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include "metaf.hpp"
+
+#include "datetimeformat.hpp"
+#include "stationfilter.hpp"
+#include "utility.hpp"
+
+static const char unknownValue[] = "unknown";
+static const char stationHashKey[] = "station-hash:";
+
+// Create the directories of the file path which do not exist; if directory
+// cannot be created, the file cannot be opened
+static void makeDirectories(const std::string &path)
+{
+    for (auto i = path.find('/', 1); i != std::string::npos; i = path.find('/', i + 1))
+        mkdir(path.substr(0, i).c_str(), 0755);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Partitioning::Partitioning(std::string_view keys, std::string_view pathTemplate)
+{
+    std::vector<Key> partitionKeys;
+    while (!keys.empty())
+    {
+        const auto key = keys.substr(0, keys.find(','));
+        keys.remove_prefix(std::min(key.length() + 1, keys.length()));
+        auto k = Key::NONE;
+        if (key == "type")
+            k = Key::TYPE;
+        if (key == "date")
+            k = Key::DATE;
+        if (key.substr(0, sizeof(stationHashKey) - 1) == stationHashKey)
+        {
+            const auto n = std::string(key.substr(sizeof(stationHashKey) - 1));
+            size_t end = 0;
+            unsigned long hashes = 0;
+            try
+            {
+                hashes = std::stoul(n, &end);
+            }
+            catch (const std::exception &)
+            {
+            }
+            if (!hashes || end != n.length() || hashes > UINT32_MAX)
+                throw(std::invalid_argument("Invalid number of station hashes " + n));
+            stationHashes = hashes;
+            k = Key::HASH;
+        }
+        if (k == Key::NONE)
+            throw(std::invalid_argument("Partition key " + std::string(key) + " is not supported"));
+        if (std::find(partitionKeys.begin(), partitionKeys.end(), k) != partitionKeys.end())
+            throw(std::invalid_argument("Duplicate partition key " + std::string(key)));
+        partitionKeys.push_back(k);
+    }
+    if (partitionKeys.empty())
+        throw(std::invalid_argument("No partition keys specified"));
+
+    std::vector<Key> placeholders;
+    std::string text;
+    while (!pathTemplate.empty())
+    {
+        const auto begin = pathTemplate.find('{');
+        text += pathTemplate.substr(0, begin);
+        if (begin == std::string_view::npos)
+            break;
+        const auto end = pathTemplate.find('}', begin);
+        if (end == std::string_view::npos)
+            throw(std::invalid_argument("Placeholder is not closed in partition path"));
+        const auto name = pathTemplate.substr(begin + 1, end - begin - 1);
+        auto k = Key::NONE;
+        if (name == "type")
+            k = Key::TYPE;
+        if (name == "date")
+            k = Key::DATE;
+        if (name == "hash")
+            k = Key::HASH;
+        if (std::find(partitionKeys.begin(), partitionKeys.end(), k) == partitionKeys.end())
+        {
+            throw(std::invalid_argument("Placeholder {" + std::string(name) +
+                                        "} does not match partition keys"));
+        }
+        segments.push_back(Segment{std::move(text), k});
+        placeholders.push_back(k);
+        text.clear();
+        pathTemplate.remove_prefix(end + 1);
+    }
+    segments.push_back(Segment{std::move(text), Key::NONE});
+    for (const auto k : partitionKeys)
+    {
+        if (std::find(placeholders.begin(), placeholders.end(), k) == placeholders.end())
+            throw(std::invalid_argument("Partition path does not include all partition keys"));
+    }
+}
+
+std::string Partitioning::path(std::string_view report,
+                               const metaf::ParseResult &parseResult,
+                               const RefDate &refDate) const
+{
+    const auto &metadata = parseResult.reportMetadata;
+    std::string result;
+    for (const auto &s : segments)
+    {
+        result += s.text;
+        switch (s.key)
+        {
+        case Key::NONE:
+            break;
+        case Key::TYPE:
+            if (metadata.type == metaf::ReportType::METAR)
+                result += metadata.isSpeci ? "speci" : "metar";
+            else if (metadata.type == metaf::ReportType::TAF)
+                result += "taf";
+            else
+                result += unknownValue;
+            break;
+        case Key::DATE:
+            if (const auto rt = metadata.reportTime; rt.has_value())
+            {
+                const DateTimeFormat::DateTime dt(*rt, refDate.year, refDate.month, refDate.day);
+                char date[sizeof("YYYY-MM-DD")];
+                std::snprintf(date, sizeof(date), "%04d-%02u-%02u", dt.year, dt.month, dt.day);
+                result += date;
+            }
+            else
+                result += unknownValue;
+            break;
+        case Key::HASH:
+            if (const auto location = StationFilter::findLocation(report); !location.empty())
+                result += std::to_string(util::hash(location) % stationHashes);
+            else
+                result += unknownValue;
+            break;
+        }
+    }
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+PartitionedOutput::PartitionedOutput(std::unique_ptr<const Compressor> compressor,
+                                     size_t maxOpenFiles,
+                                     size_t threads,
+                                     size_t bufferSize,
+                                     size_t memoryLimit)
+    : compressor(std::move(compressor)),
+      maxOpenFiles(std::max(maxOpenFiles, size_t(1))),
+      bufferSize(bufferSize),
+      memoryLimit(memoryLimit),
+      pool(threads)
+{
+}
+
+PartitionedOutput::~PartitionedOutput()
+{
+    wait();
+    while (!openFiles.empty())
+        close(*openFiles.front());
+}
+
+PartitionedOutput::int_type PartitionedOutput::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+        return traits_type::not_eof(c);
+    record.push_back(traits_type::to_char_type(c));
+    return c;
+}
+
+std::streamsize PartitionedOutput::xsputn(const char *s, std::streamsize n)
+{
+    record.append(s, n);
+    return n;
+}
+
+void PartitionedOutput::endRecord(const std::string &path)
+{
+    if (record.empty())
+        return;
+    auto &p = partitions[path];
+    if (p.path.empty())
+        p.path = path;
+    p.buffer += record;
+    buffered += record.length();
+    record.clear();
+    if (p.buffer.length() >= bufferSize && !p.full)
+    {
+        p.full = true;
+        fullPartitions.push_back(&p);
+    }
+    if (buffered >= memoryLimit)
+        writeBuffers(true);
+    else if (fullPartitions.size() >= pool.size())
+        writeBuffers(false);
+}
+
+bool PartitionedOutput::finish()
+{
+    writeBuffers(true);
+    wait();
+    while (!openFiles.empty())
+        close(*openFiles.front());
+    return failedFiles().empty();
+}
+
+std::vector<std::string> PartitionedOutput::failedFiles() const
+{
+    std::vector<std::string> result;
+    for (const auto &p : partitions)
+    {
+        if (p.second.failed)
+            result.push_back(p.first);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// Submit buffers of the full partitions or of all partitions to the workers;
+// no more files are opened at once than allowed, so the buffers are
+// submitted in several steps if needed
+void PartitionedOutput::writeBuffers(bool all)
+{
+    std::vector<Partition *> batch;
+    if (all)
+    {
+        for (auto &p : partitions)
+        {
+            if (!p.second.buffer.empty())
+                batch.push_back(&p.second);
+        }
+    }
+    else
+    {
+        batch = fullPartitions;
+    }
+    for (const auto p : fullPartitions)
+        p->full = false;
+    fullPartitions.clear();
+
+    for (size_t i = 0; i < batch.size(); i += maxOpenFiles)
+    {
+        // Files written by workers may be closed only when writing is complete
+        wait();
+        const auto end = std::min(i + maxOpenFiles, batch.size());
+        for (auto j = i; j < end; j++)
+        {
+            auto &p = *batch[j];
+            buffered -= p.buffer.length();
+            if (!p.failed)
+                open(p);
+            if (p.failed)
+            {
+                p.buffer.clear();
+                continue;
+            }
+            submitted.push_back(Write{&p, std::move(p.buffer)});
+            p.buffer.clear();
+        }
+        for (auto &w : submitted)
+        {
+            pending.push_back(pool.submit([this, &w]() {
+                try
+                {
+                    std::string compressed;
+                    std::string_view data = w.data;
+                    if (compressor)
+                    {
+                        compressor->compress(data, compressed);
+                        data = compressed;
+                    }
+                    if (std::fwrite(data.data(), 1, data.length(), w.partition->file) !=
+                        data.length())
+                    {
+                        w.partition->failed = true;
+                    }
+                }
+                catch (const std::exception &)
+                {
+                    w.partition->failed = true;
+                }
+            }));
+        }
+    }
+}
+
+void PartitionedOutput::wait()
+{
+    for (auto &p : pending)
+        p.get();
+    pending.clear();
+    submitted.clear();
+}
+
+// Open the partition file if it is not open yet and make it the most
+// recently used one; the least recently used file is closed if too many
+// files are open
+void PartitionedOutput::open(Partition &partition)
+{
+    if (partition.file)
+    {
+        openFiles.splice(openFiles.begin(), openFiles, partition.openPosition);
+        return;
+    }
+    if (openFiles.size() >= maxOpenFiles)
+        close(*openFiles.back());
+    if (!partition.created)
+        makeDirectories(partition.path);
+    partition.file = std::fopen(partition.path.c_str(), partition.created ? "ab" : "wb");
+    if (!partition.file)
+    {
+        partition.failed = true;
+        return;
+    }
+    partition.created = true;
+    openFiles.push_front(&partition);
+    partition.openPosition = openFiles.begin();
+    maxOpenFilesReached = std::max(maxOpenFilesReached, openFiles.size());
+}
+
+void PartitionedOutput::close(Partition &partition)
+{
+    if (std::fclose(partition.file))
+        partition.failed = true;
+    partition.file = nullptr;
+    openFiles.erase(partition.openPosition);
+}
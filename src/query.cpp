@@ -0,0 +1,190 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+// metafjson-query: read the records of particular stations and time range
+// from the output of metafjson using the index written with --output-index
+
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cxxopts.hpp"
+
+#include "version.hpp"
+#include "outputindex.hpp"
+#include "refdate.hpp"
+#include "stationfilter.hpp"
+
+// Output file read by offsets
+class RecordFile
+{
+public:
+    explicit RecordFile(const std::string &fileName)
+    {
+        fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw(std::runtime_error("Cannot open file " + fileName));
+    }
+    ~RecordFile() { close(fd); }
+    RecordFile(const RecordFile &) = delete;
+    RecordFile &operator=(const RecordFile &) = delete;
+
+    uint64_t size() const
+    {
+        struct stat st;
+        if (fstat(fd, &st) < 0)
+            throw(std::runtime_error("Cannot get size of output file"));
+        return st.st_size;
+    }
+    // Read length bytes at offset and append them to buffer
+    void read(uint64_t offset, size_t length, std::string &buffer) const
+    {
+        const auto start = buffer.length();
+        buffer.resize(start + length);
+        for (size_t done = 0; done < length;)
+        {
+            const auto result = pread(fd, &buffer[start + done], length - done, offset + done);
+            if (result <= 0)
+                throw(std::runtime_error("Cannot read output file"));
+            done += result;
+        }
+    }
+
+private:
+    int fd = -1;
+};
+
+// Write records of entries from..to; adjacent records are read at once
+static void writeRecords(const RecordFile &file,
+                         const OutputIndex::Entry *begin,
+                         const OutputIndex::Entry *end,
+                         std::ostream &out)
+{
+    static const size_t maxReadSize = 1024 * 1024;
+    std::string buffer;
+    while (begin != end)
+    {
+        auto last = begin + 1;
+        auto length = static_cast<uint64_t>(begin->length);
+        while (last != end &&
+               last->offset == begin->offset + length &&
+               length + last->length <= maxReadSize)
+        {
+            length += last->length;
+            last++;
+        }
+        buffer.clear();
+        file.read(begin->offset, length, buffer);
+        out.write(buffer.data(), buffer.length());
+        begin = last;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        cxxopts::Options options("metafjson-query",
+                                 "Read records of the stations and time range from the "
+                                 "output of metafjson using the index written with "
+                                 "--output-index");
+        options.add_options()
+            ("v, version", "Display version")
+            ("h, help", "Display help")
+            ("i, input", "Output file of metafjson",
+             cxxopts::value<std::string>(),
+             "file"
+            )
+            ("x, index", "Index of the output file",
+             cxxopts::value<std::string>(),
+             "file"
+            )
+            ("s, station", "Only read records of the specified stations; "
+             "comma-separated list of ICAO locations. May be specified more than once. "
+             "If not specified, records of all stations are read.",
+             cxxopts::value<std::vector<std::string>>(),
+             "list"
+            )
+            ("time-from", "Only read records with report time not earlier than specified.",
+             cxxopts::value<std::string>(),
+             "YYYYMMDD[HHMM]"
+            )
+            ("time-to", "Only read records with report time not later than specified "
+             "(whole day if time is not specified).",
+             cxxopts::value<std::string>(),
+             "YYYYMMDD[HHMM]"
+            )
+            ;
+        auto result = options.parse(argc, argv);
+
+        if (result.count("version"))
+        {
+            std::cout << "Version: ";
+            std::cout << Version::major << '.' << Version::minor << '.' << Version::patch;
+            std::cout << std::endl << std::endl;
+            return EXIT_SUCCESS;
+        }
+        if (result.count("help"))
+        {
+            std::cout << options.help({""}) << std::endl;
+            std::cout << "Records are written to standard output ordered by station and "
+                         "report time." << std::endl;
+            return EXIT_SUCCESS;
+        }
+        if (!result.count("input") || !result.count("index"))
+            throw(std::runtime_error("Both --input and --index must be specified"));
+
+        StationFilter stations;
+        if (result.count("station"))
+        {
+            for (const auto &list : result["station"].as<std::vector<std::string>>())
+                stations.addStations(std::string_view(list));
+        }
+        auto getTime = [&](const char *option, int64_t defaultTime, bool endOfDay) {
+            if (!result.count(option))
+                return defaultTime;
+            const auto s = result[option].as<std::string>();
+            const auto time = RefDate::unixTimeFromString(s, endOfDay);
+            if (!time.has_value())
+                throw(std::runtime_error("Date and time " + s + " is not recognised"));
+            return *time;
+        };
+        const auto from = getTime("time-from", std::numeric_limits<int64_t>::min(), false);
+        const auto to = getTime("time-to", std::numeric_limits<int64_t>::max(), true);
+
+        const OutputIndex index(result["index"].as<std::string>());
+        const RecordFile file(result["input"].as<std::string>());
+        if (file.size() != index.outputSize())
+            throw(std::runtime_error("Output file does not match the index"));
+
+        std::vector<uint32_t> selected = stations.packedStations();
+        if (selected.empty())
+        {
+            for (auto s = index.stationsBegin(); s != index.stationsEnd(); s++)
+                selected.push_back(s->station);
+        }
+        for (const auto station : selected)
+        {
+            const auto entries = index.find(station, from, to);
+            writeRecords(file, entries.first, entries.second, std::cout);
+        }
+        std::cout.flush();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "refdate.hpp"
+
+#include <cctype>
+
+#include "date/date.h"
+
+static bool isDigit(char c)
+{
+    return std::isdigit(static_cast<unsigned char>(c));
+}
+
+// Converts fixed number of digits to a number, returns false if non-digit
+// character is encountered
+static bool digitsToNumber(std::string_view s, size_t count, unsigned &result)
+{
+    if (s.length() < count)
+        return false;
+    result = 0;
+    for (auto i = 0u; i < count; i++)
+    {
+        if (!isDigit(s[i]))
+            return false;
+        result = result * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+size_t RefDate::parseDate(std::string_view s, RefDate &date, char separator)
+{
+    static const size_t yearDigits = 4, monthDigits = 2, dayDigits = 2;
+    const size_t separatorLength = separator ? 1 : 0;
+    const size_t length = yearDigits + monthDigits + dayDigits + 2 * separatorLength;
+    if (s.length() < length)
+        return 0;
+    if (separator &&
+        (s[yearDigits] != separator ||
+         s[yearDigits + monthDigits + separatorLength] != separator))
+    {
+        return 0;
+    }
+    unsigned y = 0, m = 0, d = 0;
+    if (!digitsToNumber(s, yearDigits, y) ||
+        !digitsToNumber(s.substr(yearDigits + separatorLength), monthDigits, m) ||
+        !digitsToNumber(s.substr(length - dayDigits), dayDigits, d))
+    {
+        return 0;
+    }
+    // Check that date is valid, e.g. reject 20190231
+    const auto ymd = date::year_month_day(
+        date::year{static_cast<int>(y)}, date::month{m}, date::day{d});
+    if (!ymd.ok())
+        return 0;
+    date = RefDate(static_cast<int>(y), m, d);
+    return length;
+}
+
+std::optional<RefDate> RefDate::fromString(std::string_view s)
+{
+    for (const auto separator : {'\0', '-', '/'})
+    {
+        RefDate date;
+        const auto length = parseDate(s, date, separator);
+        if (!length)
+            continue;
+        // Date may be followed by time, e.g. 2020-06-04T12:00 or 20200604 1200
+        if (length == s.length() ||
+            s[length] == 'T' ||
+            std::isspace(static_cast<unsigned char>(s[length])))
+        {
+            return date;
+        }
+    }
+    return std::optional<RefDate>();
+}
+
+std::optional<RefDate> RefDate::fromTimestampLine(std::string_view s)
+{
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    static const size_t timestampLength = 16; // YYYY/MM/DD HH:MM
+    if (s.length() != timestampLength)
+        return std::optional<RefDate>();
+    RefDate date;
+    const auto dateLength = parseDate(s, date, '/');
+    if (!dateLength || s[dateLength] != ' ' || s[dateLength + 3] != ':')
+        return std::optional<RefDate>();
+    unsigned hour = 0, minute = 0;
+    if (!digitsToNumber(s.substr(dateLength + 1), 2, hour) ||
+        !digitsToNumber(s.substr(dateLength + 4), 2, minute) ||
+        hour > 23 ||
+        minute > 59)
+    {
+        return std::optional<RefDate>();
+    }
+    return date;
+}
+
+std::optional<RefDate> RefDate::fromFileName(std::string_view path)
+{
+    if (const auto pos = path.find_last_of("/\\"); pos != std::string_view::npos)
+        path.remove_prefix(pos + 1);
+    for (auto i = 0u; i < path.length(); i++)
+    {
+        // Date must not be a part of a longer number
+        if (!isDigit(path[i]) || (i && isDigit(path[i - 1])))
+            continue;
+        const auto s = path.substr(i);
+        for (const auto separator : {'\0', '-', '_'})
+        {
+            RefDate date;
+            const auto length = parseDate(s, date, separator);
+            if (length && (length == s.length() || !isDigit(s[length])))
+                return date;
+        }
+    }
+    return std::optional<RefDate>();
+}
+
+RefDate RefDate::fromUnixTime(int64_t time)
+{
+    using namespace std::chrono;
+    const date::year_month_day ymd(
+        date::floor<date::days>(date::sys_seconds(seconds(time))));
+    return RefDate(static_cast<int>(ymd.year()),
+                   static_cast<unsigned>(ymd.month()),
+                   static_cast<unsigned>(ymd.day()));
+}
+
+std::optional<int64_t> RefDate::unixTimeFromString(std::string_view s, bool endOfDay)
+{
+    static const size_t dateLength = 8, timeLength = 4; // YYYYMMDD, HHMM
+    static const int64_t secondsPerMinute = 60, secondsPerHour = 3600, secondsPerDay = 86400;
+    RefDate date;
+    if (parseDate(s, date, '\0') != dateLength ||
+        (s.length() != dateLength && s.length() != dateLength + timeLength))
+    {
+        return std::optional<int64_t>();
+    }
+    const date::sys_days days = date::year_month_day(
+        date::year{date.year}, date::month{date.month}, date::day{date.day});
+    const int64_t result = days.time_since_epoch().count() * secondsPerDay;
+    if (s.length() == dateLength)
+        return endOfDay ? result + secondsPerDay - 1 : result;
+    unsigned hour = 0, minute = 0;
+    if (!digitsToNumber(s.substr(dateLength), 2, hour) ||
+        !digitsToNumber(s.substr(dateLength + 2), 2, minute) ||
+        hour > 23 ||
+        minute > 59)
+    {
+        return std::optional<int64_t>();
+    }
+    return result + hour * secondsPerHour + minute * secondsPerMinute;
+}
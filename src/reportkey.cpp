@@ -0,0 +1,69 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "reportkey.hpp"
+
+#include <string>
+
+#include "metaf.hpp"
+
+#include "datetimeformat.hpp"
+#include "stationfilter.hpp"
+
+std::optional<ReportKey> ReportKey::fromReport(std::string_view report,
+                                               const RefDate &refDate)
+{
+    const auto location = StationFilter::findLocation(report);
+    const auto station = StationFilter::packLocation(location);
+    if (!station.has_value())
+        return std::optional<ReportKey>();
+    // Report time group follows the location
+    report.remove_prefix(location.data() + location.length() - report.data());
+    while (!report.empty() && report.front() == ' ')
+        report.remove_prefix(1);
+    const auto token = report.substr(0, report.find(' '));
+    static const size_t tokenLength = 7; // DDHHMMZ
+    if (token.length() != tokenLength || token.back() != 'Z')
+        return std::optional<ReportKey>();
+    const auto time = metaf::MetafTime::fromStringDDHHMM(
+        std::string(token.substr(0, tokenLength - 1)));
+    if (!time.has_value() || !time->day().has_value())
+        return std::optional<ReportKey>();
+    ReportKey key;
+    key.station = *station;
+    key.time = DateTimeFormat::DateTime(
+                   *time, refDate.year, refDate.month, refDate.day)
+                   .toUnixTime();
+    return key;
+}
+
+std::optional<ReportKey> ReportKey::fromParseResult(const metaf::ParseResult &parseResult,
+                                                    const RefDate &refDate)
+{
+    const auto &time = parseResult.reportMetadata.reportTime;
+    if (!time.has_value() || !time->day().has_value())
+        return std::optional<ReportKey>();
+    for (const auto &groupInfo : parseResult.groups)
+    {
+        if (groupInfo.reportPart != metaf::ReportPart::HEADER)
+            continue;
+        const auto location = std::get_if<metaf::LocationGroup>(&groupInfo.group);
+        if (!location)
+            continue;
+        const auto station = StationFilter::packLocation(location->toString());
+        if (!station.has_value())
+            return std::optional<ReportKey>();
+        ReportKey key;
+        key.station = *station;
+        key.time = DateTimeFormat::DateTime(
+                       *time, refDate.year, refDate.month, refDate.day)
+                       .toUnixTime();
+        return key;
+    }
+    return std::optional<ReportKey>();
+}
@@ -0,0 +1,60 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "reportreader.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+static bool isBlank(const std::string &s)
+{
+    return std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isspace(c); });
+}
+
+bool ReportReader::next(Report &report)
+{
+    while (std::getline(input, report.text))
+    {
+        lineCount++;
+        report.lineNumber = lineCount;
+        report.offset = inputOffset;
+        inputOffset += report.text.length() + 1; // Including newline
+        report.refDate = currentRefDate;
+        switch (refDateSource)
+        {
+        case Settings::RefDateSource::FIXED:
+        case Settings::RefDateSource::FILENAME:
+            break;
+        case Settings::RefDateSource::TIMESTAMP:
+            // Timestamp line sets reference date for the following reports
+            if (const auto d = RefDate::fromTimestampLine(report.text); d.has_value())
+            {
+                currentRefDate = *d;
+                continue;
+            }
+            // NOAA files separate timestamp-report pairs with blank lines
+            if (isBlank(report.text))
+                continue;
+            break;
+        case Settings::RefDateSource::COLUMN:
+            // Reference date is in the first tab-separated column; if it 
+            // cannot be recognised, previous reference date is used
+            if (const auto tab = report.text.find('\t'); tab != std::string::npos)
+            {
+                const auto column = std::string_view(report.text).substr(0, tab);
+                if (const auto d = RefDate::fromString(column); d.has_value())
+                    report.refDate = currentRefDate = *d;
+                report.text.erase(0, tab + 1);
+                report.offset += tab + 1;
+            }
+            break;
+        }
+        return true;
+    }
+    return false;
+}
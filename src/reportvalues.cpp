@@ -0,0 +1,292 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "reportvalues.hpp"
+
+#include <algorithm>
+
+#include "metaf.hpp"
+
+#include "datetimeformat.hpp"
+
+using namespace metaf;
+
+namespace
+{
+
+// Visibility 10 km or more, no cloud below 5000 ft
+const float cavokVisibility = 10000;
+
+bool isPrecipitation(const WeatherPhenomena &phenomena)
+{
+    using Descriptor = WeatherPhenomena::Descriptor;
+    for (const auto w : phenomena.weather())
+    {
+        switch (w)
+        {
+        case Weather::SNOW:
+            // Blowing or drifting snow is not precipitation
+            if (phenomena.descriptor() == Descriptor::LOW_DRIFTING ||
+                phenomena.descriptor() == Descriptor::BLOWING)
+            {
+                break;
+            }
+            return true;
+        case Weather::DRIZZLE:
+        case Weather::RAIN:
+        case Weather::SNOW_GRAINS:
+        case Weather::ICE_CRYSTALS:
+        case Weather::ICE_PELLETS:
+        case Weather::HAIL:
+        case Weather::SMALL_HAIL:
+        case Weather::UNDETERMINED:
+            return true;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+// Weather flags of a single phenomena; recent weather and weather in
+// vicinity are not included
+uint8_t phenomenaFlags(const WeatherPhenomena &phenomena)
+{
+    using Flag = ReportValues::Weather;
+    using Qualifier = WeatherPhenomena::Qualifier;
+    using Descriptor = WeatherPhenomena::Descriptor;
+    const auto weather = phenomena.weather();
+    // Phenomena is not reported, e.g. // in automated reports
+    if (phenomena.descriptor() == Descriptor::NONE &&
+        std::all_of(weather.begin(), weather.end(), [](metaf::Weather w) {
+            return w == metaf::Weather::NOT_REPORTED;
+        }))
+    {
+        return static_cast<uint8_t>(Flag::NOT_REPORTED);
+    }
+    if (phenomena.qualifier() == Qualifier::RECENT ||
+        phenomena.qualifier() == Qualifier::VICINITY)
+    {
+        return 0;
+    }
+    uint8_t result = 0;
+    if (phenomena.descriptor() == Descriptor::THUNDERSTORM)
+        result |= static_cast<uint8_t>(Flag::THUNDERSTORM);
+    for (const auto w : weather)
+    {
+        if (w == metaf::Weather::RAIN && phenomena.descriptor() == Descriptor::FREEZING)
+            result |= static_cast<uint8_t>(Flag::FREEZING_RAIN);
+        if (w == metaf::Weather::SNOW &&
+            phenomena.descriptor() != Descriptor::LOW_DRIFTING &&
+            phenomena.descriptor() != Descriptor::BLOWING)
+        {
+            result |= static_cast<uint8_t>(Flag::SNOW);
+        }
+    }
+    if (isPrecipitation(phenomena))
+        result |= static_cast<uint8_t>(Flag::PRECIPITATION);
+    return result;
+}
+
+} // namespace
+
+bool ReportValues::isSurfaceWind(const WindGroup &group)
+{
+    return group.type() == WindGroup::Type::SURFACE_WIND ||
+           group.type() == WindGroup::Type::SURFACE_WIND_CALM ||
+           group.type() == WindGroup::Type::SURFACE_WIND_WITH_VARIABLE_SECTOR;
+}
+
+bool ReportValues::isCeiling(const CloudGroup &group)
+{
+    if (group.type() == CloudGroup::Type::VERTICAL_VISIBILITY)
+        return true;
+    if (group.type() != CloudGroup::Type::CLOUD_LAYER)
+        return false;
+    return group.amount() == CloudGroup::Amount::BROKEN ||
+           group.amount() == CloudGroup::Amount::OVERCAST ||
+           group.amount() == CloudGroup::Amount::VARIABLE_BROKEN_OVERCAST;
+}
+
+std::optional<float> ReportValues::prevailingVisibility(const VisibilityGroup &group)
+{
+    switch (group.type())
+    {
+    case VisibilityGroup::Type::PREVAILING:
+    case VisibilityGroup::Type::PREVAILING_NDV:
+        return group.visibility().toUnit(Distance::Unit::METERS);
+    case VisibilityGroup::Type::VARIABLE_PREVAILING:
+        return group.minVisibility().toUnit(Distance::Unit::METERS);
+    default:
+        return std::optional<float>();
+    }
+}
+
+std::optional<float> ReportValues::prevailingVisibility(const KeywordGroup &group)
+{
+    if (group.type() != KeywordGroup::Type::CAVOK)
+        return std::optional<float>();
+    return cavokVisibility;
+}
+
+std::optional<float> ReportValues::ceilingHeight(const CloudGroup &group)
+{
+    if (!isCeiling(group))
+        return std::optional<float>();
+    if (group.type() == CloudGroup::Type::VERTICAL_VISIBILITY)
+        return group.verticalVisibility().toUnit(Distance::Unit::FEET);
+    return group.height().toUnit(Distance::Unit::FEET);
+}
+
+void ReportValues::clear()
+{
+    station.clear();
+    time.reset();
+    type = Type::UNKNOWN;
+    windDirection.reset();
+    windSpeed.reset();
+    gustSpeed.reset();
+    variableWind = false;
+    visibility.reset();
+    ceiling.reset();
+    skyReported = false;
+    temperature.reset();
+    dewPoint.reset();
+    qnh.reset();
+    clouds.clear();
+    weather.clear();
+    weatherFlags = 0;
+}
+
+void ReportValues::extract(const ParseResult &result, const RefDate &refDate)
+{
+    clear();
+
+    const auto &metadata = result.reportMetadata;
+    switch (metadata.type)
+    {
+    case ReportType::METAR:
+        type = metadata.isSpeci ? Type::SPECI : Type::METAR;
+        break;
+    case ReportType::TAF:
+        type = Type::TAF;
+        break;
+    default:
+        break;
+    }
+    if (const auto rt = metadata.reportTime; rt.has_value())
+    {
+        auto dt = DateTimeFormat::DateTime(
+            *rt, refDate.year, refDate.month, refDate.day);
+        time = dt.toUnixTime();
+    }
+
+    for (const auto &groupInfo : result.groups)
+    {
+        const auto &group = groupInfo.group;
+        if (groupInfo.reportPart == ReportPart::HEADER)
+        {
+            if (const auto g = std::get_if<LocationGroup>(&group);
+                g && station.empty())
+            {
+                station = g->toString();
+            }
+            continue;
+        }
+        if (groupInfo.reportPart != ReportPart::METAR &&
+            groupInfo.reportPart != ReportPart::TAF)
+        {
+            continue;
+        }
+        // Trends follow observed or prevailing conditions
+        if (std::holds_alternative<TrendGroup>(group))
+            break;
+
+        if (const auto g = std::get_if<WindGroup>(&group))
+        {
+            if (isSurfaceWind(*g) && !windSpeed.has_value())
+            {
+                windSpeed = g->windSpeed().toUnit(Speed::Unit::KNOTS);
+                gustSpeed = g->gustSpeed().toUnit(Speed::Unit::KNOTS);
+                if (const auto d = g->direction().degrees(); d.has_value())
+                    windDirection = *d;
+                variableWind = g->direction().type() == Direction::Type::VARIABLE;
+            }
+            continue;
+        }
+        if (const auto g = std::get_if<VisibilityGroup>(&group))
+        {
+            if (!visibility.has_value())
+                visibility = prevailingVisibility(*g);
+            continue;
+        }
+        if (const auto g = std::get_if<KeywordGroup>(&group))
+        {
+            if (g->type() == KeywordGroup::Type::CAVOK)
+            {
+                if (!visibility.has_value())
+                    visibility = prevailingVisibility(*g);
+                skyReported = true;
+            }
+            continue;
+        }
+        if (const auto g = std::get_if<CloudGroup>(&group))
+        {
+            clouds.push_back(groupInfo.rawString);
+            if (g->type() == CloudGroup::Type::NO_CLOUDS ||
+                g->type() == CloudGroup::Type::VERTICAL_VISIBILITY ||
+                g->type() == CloudGroup::Type::CLOUD_LAYER)
+            {
+                skyReported = true;
+            }
+            const auto height = ceilingHeight(*g);
+            if (height.has_value() && (!ceiling.has_value() || *height < *ceiling))
+                ceiling = height;
+            continue;
+        }
+        if (const auto g = std::get_if<WeatherGroup>(&group))
+        {
+            if (g->type() != WeatherGroup::Type::CURRENT)
+                continue;
+            weather.push_back(groupInfo.rawString);
+            for (const auto &phenomena : g->weatherPhenomena())
+                weatherFlags |= phenomenaFlags(phenomena);
+            continue;
+        }
+        if (const auto g = std::get_if<TemperatureGroup>(&group))
+        {
+            if (!temperature.has_value() && !dewPoint.has_value())
+            {
+                temperature = g->airTemperature().toUnit(Temperature::Unit::C);
+                dewPoint = g->dewPoint().toUnit(Temperature::Unit::C);
+            }
+            continue;
+        }
+        if (const auto g = std::get_if<PressureGroup>(&group))
+        {
+            if (g->type() == PressureGroup::Type::OBSERVED_QNH && !qnh.has_value())
+                qnh = g->atmosphericPressure().toUnit(Pressure::Unit::HECTOPASCAL);
+            continue;
+        }
+    }
+}
+
+std::string_view ReportValues::typeName(Type type)
+{
+    switch (type)
+    {
+    case Type::METAR:
+        return "METAR";
+    case Type::SPECI:
+        return "SPECI";
+    case Type::TAF:
+        return "TAF";
+    default:
+        return std::string_view();
+    }
+}
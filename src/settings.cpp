@@ -29,4 +29,15 @@ void Settings::setRefDate()
         (unsigned)year_month_day{floor<days>(now)}.month(),
         (unsigned)year_month_day{floor<days>(now)}.day()
     );
-}
\ No newline at end of file
+}
+
+Settings Settings::forOutput(const OutputSpec &spec) const
+{
+    auto settings = *this;
+    settings.setOutputFormat(spec.outputFormat);
+    settings.setDateTimeFormat(spec.dateTimeFormat);
+    settings.setUnitFormat(spec.unitFormat);
+    settings.setRawStrings(spec.includeRawStrings);
+    settings.setAdditionalOutputs({});
+    return settings;
+}
@@ -0,0 +1,545 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "sketches.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "nlohmann/json.hpp"
+#include "metaf.hpp"
+
+#include "utility.hpp"
+
+static const char magic[8] = {'M', 'E', 'T', 'A', 'F', 'S', 'K', 'T'};
+static const uint32_t version = 1;
+static const uint32_t byteOrder = 0x01020304;
+
+namespace
+{
+
+const double pi = std::acos(-1.0);
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+};
+
+std::runtime_error invalid()
+{
+    return std::runtime_error("Input is not a valid sketch file");
+}
+
+template <typename T>
+void put(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+void putVector(std::ostream &out, const std::vector<T> &values)
+{
+    put(out, static_cast<uint64_t>(values.size()));
+    out.write(reinterpret_cast<const char *>(values.data()),
+              values.size() * sizeof(T));
+}
+
+template <typename T>
+T get(std::istream &in)
+{
+    T value;
+    if (!in.read(reinterpret_cast<char *>(&value), sizeof(value)))
+        throw(invalid());
+    return value;
+}
+
+// Maximum size guards against allocating memory for a corrupt size
+template <typename T>
+void getVector(std::istream &in, std::vector<T> &values, uint64_t maxSize)
+{
+    const auto size = get<uint64_t>(in);
+    if (size > maxSize)
+        throw(invalid());
+    values.resize(size);
+    if (!in.read(reinterpret_cast<char *>(values.data()), size * sizeof(T)))
+        throw(invalid());
+}
+
+// Hash of the string with the bits mixed (splitmix64 finalizer), since
+// sketches use the high bits and FNV-1a mixes them poorly for short strings
+uint64_t mixedHash(std::string_view s)
+{
+    auto h = util::hash(s);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+// Weather phenomena without intensity, e.g. "TSRA" for "+TSRA"
+std::string_view weatherKey(std::string_view weather)
+{
+    if (!weather.empty() && (weather.front() == '+' || weather.front() == '-'))
+        weather.remove_prefix(1);
+    return weather;
+}
+
+nlohmann::json quantilesJson(const TDigest &digest)
+{
+    if (!digest.count())
+        return nullptr;
+    auto result = nlohmann::json::object();
+    result["count"] = digest.count();
+    result["min"] = digest.min();
+    for (const auto p : {5, 10, 25, 50, 75, 90, 95, 99})
+        result["p" + std::to_string(p)] = *digest.quantile(p / 100.0);
+    result["max"] = digest.max();
+    return result;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// HyperLogLog
+//////////////////////////////////////////////////////////////////////////////
+
+HyperLogLog::HyperLogLog(unsigned precision) : precision(precision)
+{
+    if (precision < 4 || precision > 18)
+        throw std::invalid_argument("HyperLogLog precision must be 4 to 18");
+    registers.resize(size_t(1) << precision);
+}
+
+void HyperLogLog::add(uint64_t hash)
+{
+    // High bits select the register; the register keeps the maximum
+    // position of the first set bit in the remaining bits
+    const auto index = hash >> (64 - precision);
+    auto bits = (hash << precision) | (uint64_t(1) << (precision - 1));
+    uint8_t rank = 1;
+    while (!(bits & (uint64_t(1) << 63)))
+    {
+        bits <<= 1;
+        rank++;
+    }
+    registers[index] = std::max(registers[index], rank);
+}
+
+void HyperLogLog::merge(const HyperLogLog &other)
+{
+    if (other.precision != precision)
+        throw std::invalid_argument("HyperLogLog precisions are different");
+    for (auto i = 0u; i < registers.size(); i++)
+        registers[i] = std::max(registers[i], other.registers[i]);
+}
+
+double HyperLogLog::estimate() const
+{
+    const double m = registers.size();
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (const auto r : registers)
+    {
+        sum += std::ldexp(1.0, -r);
+        if (!r)
+            zeros++;
+    }
+    const auto alpha = 0.7213 / (1.0 + 1.079 / m);
+    const auto estimate = alpha * m * m / sum;
+    // Linear counting is more accurate while many registers are empty
+    if (estimate <= 2.5 * m && zeros)
+        return m * std::log(m / zeros);
+    return estimate;
+}
+
+void HyperLogLog::write(std::ostream &out) const
+{
+    put(out, static_cast<uint32_t>(precision));
+    putVector(out, registers);
+}
+
+void HyperLogLog::read(std::istream &in)
+{
+    const auto p = get<uint32_t>(in);
+    if (p < 4 || p > 18)
+        throw(invalid());
+    precision = p;
+    getVector(in, registers, size_t(1) << p);
+    if (registers.size() != size_t(1) << p)
+        throw(invalid());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// TDigest
+//////////////////////////////////////////////////////////////////////////////
+
+TDigest::TDigest(double compression) : compression(compression)
+{
+    if (!(compression >= 10.0))
+        throw std::invalid_argument("t-digest compression must be at least 10");
+}
+
+void TDigest::add(double value, double weight)
+{
+    if (std::isnan(value) || !(weight > 0.0))
+        return;
+    if (totalWeight == 0.0)
+        minValue = maxValue = value;
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+    totalWeight += weight;
+    buffer.push_back(Centroid{value, weight});
+    if (buffer.size() >= 5 * static_cast<size_t>(compression))
+        compress();
+}
+
+void TDigest::merge(const TDigest &other)
+{
+    if (other.compression != compression)
+        throw std::invalid_argument("t-digest compressions are different");
+    if (other.totalWeight == 0.0)
+        return;
+    if (totalWeight == 0.0)
+    {
+        minValue = other.minValue;
+        maxValue = other.maxValue;
+    }
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+    totalWeight += other.totalWeight;
+    buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+    buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+    compress();
+}
+
+void TDigest::compress() const
+{
+    if (buffer.empty())
+        return;
+    buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+    std::sort(buffer.begin(), buffer.end(), [](const Centroid &lhs, const Centroid &rhs) {
+        return lhs.mean < rhs.mean;
+    });
+    // Adjacent centroids are merged while the merged centroid spans at most
+    // one unit of the scale k(q) = compression / 2pi * asin(2q - 1)
+    const auto k = [this](double q) {
+        return compression / (2 * pi) * std::asin(std::clamp(2 * q - 1, -1.0, 1.0));
+    };
+    centroids.clear();
+    auto current = buffer.front();
+    double before = 0.0;
+    for (auto i = 1u; i < buffer.size(); i++)
+    {
+        const auto &c = buffer[i];
+        const auto merged = current.weight + c.weight;
+        if (k((before + merged) / totalWeight) - k(before / totalWeight) <= 1.0)
+        {
+            current.mean += (c.mean - current.mean) * c.weight / merged;
+            current.weight = merged;
+            continue;
+        }
+        before += current.weight;
+        centroids.push_back(current);
+        current = c;
+    }
+    centroids.push_back(current);
+    buffer.clear();
+}
+
+std::optional<double> TDigest::quantile(double q) const
+{
+    if (totalWeight == 0.0)
+        return std::optional<double>();
+    compress();
+    q = std::clamp(q, 0.0, 1.0);
+    if (centroids.size() == 1)
+        return centroids.front().mean;
+    // Each centroid is centered at its mean; values are interpolated between
+    // the centers of adjacent centroids and towards minimum and maximum at
+    // the ends
+    const auto target = q * totalWeight;
+    const auto &first = centroids.front();
+    if (target < first.weight / 2)
+        return minValue + (first.mean - minValue) * target / (first.weight / 2);
+    auto cumulative = first.weight / 2;
+    for (auto i = 0u; i + 1 < centroids.size(); i++)
+    {
+        const auto &lhs = centroids[i];
+        const auto &rhs = centroids[i + 1];
+        const auto span = (lhs.weight + rhs.weight) / 2;
+        if (target < cumulative + span)
+            return lhs.mean + (rhs.mean - lhs.mean) * (target - cumulative) / span;
+        cumulative += span;
+    }
+    const auto &last = centroids.back();
+    const auto rest = std::min((target - cumulative) / (last.weight / 2), 1.0);
+    return last.mean + (maxValue - last.mean) * rest;
+}
+
+void TDigest::write(std::ostream &out) const
+{
+    compress();
+    put(out, compression);
+    put(out, totalWeight);
+    put(out, minValue);
+    put(out, maxValue);
+    putVector(out, centroids);
+}
+
+void TDigest::read(std::istream &in)
+{
+    compression = get<double>(in);
+    totalWeight = get<double>(in);
+    minValue = get<double>(in);
+    maxValue = get<double>(in);
+    if (!(compression >= 10.0) || !(totalWeight >= 0.0))
+        throw(invalid());
+    // Merging keeps fewer than compression centroids; unmerged digests may
+    // hold more before compress()
+    getVector(in, centroids, 10 * static_cast<uint64_t>(compression));
+    buffer.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// CountMinSketch
+//////////////////////////////////////////////////////////////////////////////
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth)
+    : width(width), depth(depth), counters(width * depth)
+{
+    if (!width || !depth)
+        throw std::invalid_argument("Count-min sketch width and depth must be non-zero");
+}
+
+size_t CountMinSketch::index(uint64_t hash, size_t row) const
+{
+    // Row hashes are derived from the two halves of the hash (double
+    // hashing)
+    const auto h1 = hash & 0xffffffff;
+    const auto h2 = (hash >> 32) | 1;
+    return row * width + (h1 + row * h2) % width;
+}
+
+void CountMinSketch::add(uint64_t hash, uint64_t count)
+{
+    for (auto row = 0u; row < depth; row++)
+        counters[index(hash, row)] += count;
+}
+
+uint64_t CountMinSketch::estimate(uint64_t hash) const
+{
+    auto result = counters[index(hash, 0)];
+    for (auto row = 1u; row < depth; row++)
+        result = std::min(result, counters[index(hash, row)]);
+    return result;
+}
+
+void CountMinSketch::merge(const CountMinSketch &other)
+{
+    if (other.width != width || other.depth != depth)
+        throw std::invalid_argument("Count-min sketch dimensions are different");
+    for (auto i = 0u; i < counters.size(); i++)
+        counters[i] += other.counters[i];
+}
+
+void CountMinSketch::write(std::ostream &out) const
+{
+    put(out, static_cast<uint64_t>(width));
+    put(out, static_cast<uint64_t>(depth));
+    putVector(out, counters);
+}
+
+void CountMinSketch::read(std::istream &in)
+{
+    const auto w = get<uint64_t>(in);
+    const auto d = get<uint64_t>(in);
+    if (!w || !d || w > (1u << 24) || d > 64)
+        throw(invalid());
+    width = w;
+    depth = d;
+    getVector(in, counters, w * d);
+    if (counters.size() != w * d)
+        throw(invalid());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ReportSketches
+//////////////////////////////////////////////////////////////////////////////
+
+void ReportSketches::add(const metaf::ParseResult &parseResult, const RefDate &refDate)
+{
+    const auto &metadata = parseResult.reportMetadata;
+    if (metadata.error != metaf::ReportError::NONE)
+        return;
+    values.extract(parseResult, refDate);
+    reports++;
+    if (!values.station.empty())
+        stations.add(mixedHash(values.station));
+    if (values.type != ReportValues::Type::METAR || metadata.isNil)
+        return;
+    if (values.visibility.has_value())
+        visibility.add(*values.visibility);
+    if (values.ceiling.has_value())
+        ceiling.add(*values.ceiling);
+    if (values.windSpeed.has_value())
+        windSpeed.add(*values.windSpeed);
+    if (values.temperature.has_value())
+        temperature.add(*values.temperature);
+    for (const auto &w : values.weather)
+        addWeather(weatherKey(w));
+}
+
+void ReportSketches::addWeather(std::string_view w, uint64_t count)
+{
+    const auto hash = mixedHash(w);
+    weather.add(hash, count);
+    if (std::find(topWeather.begin(), topWeather.end(), w) != topWeather.end())
+        return;
+    if (topWeather.size() < weatherCandidates)
+    {
+        topWeather.emplace_back(w);
+        return;
+    }
+    auto least = topWeather.begin();
+    auto leastCount = weather.estimate(mixedHash(*least));
+    for (auto i = std::next(topWeather.begin()); i != topWeather.end(); i++)
+    {
+        if (const auto c = weather.estimate(mixedHash(*i)); c < leastCount)
+        {
+            least = i;
+            leastCount = c;
+        }
+    }
+    if (weather.estimate(hash) > leastCount)
+        least->assign(w);
+}
+
+void ReportSketches::merge(const ReportSketches &other)
+{
+    reports += other.reports;
+    stations.merge(other.stations);
+    visibility.merge(other.visibility);
+    ceiling.merge(other.ceiling);
+    windSpeed.merge(other.windSpeed);
+    temperature.merge(other.temperature);
+    weather.merge(other.weather);
+    // Candidates of both sketches are ranked by the merged counts
+    for (const auto &w : other.topWeather)
+        addWeather(w, 0);
+}
+
+nlohmann::json ReportSketches::toJson() const
+{
+    auto top = topWeather;
+    std::vector<uint64_t> counts(top.size());
+    for (auto i = 0u; i < top.size(); i++)
+        counts[i] = weather.estimate(mixedHash(top[i]));
+    std::vector<size_t> order(top.size());
+    for (auto i = 0u; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        if (counts[lhs] != counts[rhs])
+            return counts[lhs] > counts[rhs];
+        return top[lhs] < top[rhs];
+    });
+    auto weatherJson = nlohmann::json::array();
+    for (const auto i : order)
+        weatherJson.push_back({{"weather", top[i]}, {"count", counts[i]}});
+
+    auto result = nlohmann::json::object();
+    result["reports"] = reports;
+    result["stations"] = static_cast<uint64_t>(std::llround(stations.estimate()));
+    result["visibility_m"] = quantilesJson(visibility);
+    result["ceiling_ft"] = quantilesJson(ceiling);
+    result["wind_speed_kt"] = quantilesJson(windSpeed);
+    result["temperature_c"] = quantilesJson(temperature);
+    result["weather"] = std::move(weatherJson);
+    return result;
+}
+
+void ReportSketches::write(std::ostream &out) const
+{
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrder;
+    put(out, header);
+    put(out, reports);
+    stations.write(out);
+    visibility.write(out);
+    ceiling.write(out);
+    windSpeed.write(out);
+    temperature.write(out);
+    weather.write(out);
+    put(out, static_cast<uint32_t>(topWeather.size()));
+    for (const auto &w : topWeather)
+    {
+        put(out, static_cast<uint32_t>(w.size()));
+        out.write(w.data(), w.size());
+    }
+    if (!out)
+        throw(std::runtime_error("Cannot write sketches"));
+}
+
+void ReportSketches::read(std::istream &in)
+{
+    const auto header = get<Header>(in);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) ||
+        header.byteOrder != byteOrder)
+    {
+        throw(invalid());
+    }
+    if (header.version != version)
+        throw(std::runtime_error("Input has unsupported sketch version"));
+    reports = get<uint64_t>(in);
+    stations.read(in);
+    visibility.read(in);
+    ceiling.read(in);
+    windSpeed.read(in);
+    temperature.read(in);
+    weather.read(in);
+    const auto candidates = get<uint32_t>(in);
+    if (candidates > weatherCandidates)
+        throw(invalid());
+    topWeather.resize(candidates);
+    for (auto &w : topWeather)
+    {
+        const auto size = get<uint32_t>(in);
+        if (size > 64)
+            throw(invalid());
+        w.resize(size);
+        if (!in.read(w.data(), size))
+            throw(invalid());
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Sketcher
+//////////////////////////////////////////////////////////////////////////////
+
+Sketcher::Sketcher(size_t threads, size_t batchSize)
+    : reports(
+          [](const metaf::ParseResult &parseResult,
+             const RefDate &refDate,
+             ReportSketches &sketches) { sketches.add(parseResult, refDate); },
+          threads,
+          batchSize)
+{
+}
+
+ReportSketches Sketcher::finish()
+{
+    auto &partials = reports.finish();
+    ReportSketches result;
+    for (const auto &p : partials)
+        result.merge(p);
+    return result;
+}
@@ -0,0 +1,214 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "sortedoutput.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+
+#include <unistd.h>
+
+// Station of the records without key, greater than any packed location
+static const uint64_t noStation = uint64_t(1) << 32;
+// Entries are not sorted by worker threads in smaller chunks
+static const size_t minChunkSize = 16 * 1024;
+static const size_t runBufferSize = 1024 * 1024;
+
+template <typename T>
+static bool before(const T &a, const T &b)
+{
+    return std::tie(a.station, a.time, a.sequence) < std::tie(b.station, b.time, b.sequence);
+}
+
+template <typename T>
+static std::optional<ReportKey> keyOf(const T &e)
+{
+    if (e.station == noStation)
+        return std::optional<ReportKey>();
+    return ReportKey{static_cast<uint32_t>(e.station), e.time};
+}
+
+SortedOutput::SortedOutput(size_t memoryLimit, size_t threads)
+    : memoryLimit(memoryLimit), pool(threads)
+{
+}
+
+SortedOutput::~SortedOutput()
+{
+    for (const auto run : runs)
+        std::fclose(run);
+}
+
+SortedOutput::int_type SortedOutput::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+        return traits_type::not_eof(c);
+    records.push_back(traits_type::to_char_type(c));
+    return c;
+}
+
+std::streamsize SortedOutput::xsputn(const char *s, std::streamsize n)
+{
+    records.append(s, n);
+    return n;
+}
+
+void SortedOutput::endRecord(const std::optional<ReportKey> &key)
+{
+    const auto length = records.length() - recordStart;
+    if (!length)
+        return;
+    entries.push_back(Entry{key.has_value() ? key->station : noStation,
+                            key.has_value() ? key->time : 0,
+                            sequence++,
+                            recordStart,
+                            length});
+    recordStart = records.length();
+    if (records.length() + entries.size() * sizeof(Entry) >= memoryLimit)
+        writeRun();
+}
+
+void SortedOutput::finish(const std::function<void(const std::optional<ReportKey> &key,
+                                                   std::string_view record)> &f)
+{
+    if (runs.empty())
+    {
+        sortEntries();
+        for (const auto &e : entries)
+            f(keyOf(e), std::string_view(records).substr(e.offset, e.length));
+    }
+    else
+    {
+        if (!entries.empty())
+            writeRun();
+        mergeRuns(f);
+    }
+    entries.clear();
+    records.clear();
+    recordStart = 0;
+}
+
+// Sort chunks of entries by worker threads, then merge the sorted chunks
+// pairwise; merges of the same level also run in parallel
+void SortedOutput::sortEntries()
+{
+    const auto chunks = std::min(pool.size(), entries.size() / minChunkSize);
+    if (chunks <= 1)
+    {
+        std::sort(entries.begin(), entries.end(), before<Entry>);
+        return;
+    }
+    std::vector<size_t> bounds;
+    for (auto i = 0u; i <= chunks; i++)
+        bounds.push_back(entries.size() * i / chunks);
+    const auto begin = entries.begin();
+    std::vector<std::future<void>> done;
+    for (auto i = 0u; i < chunks; i++)
+    {
+        done.push_back(pool.submit([&, i]() {
+            std::sort(begin + bounds[i], begin + bounds[i + 1], before<Entry>);
+        }));
+    }
+    for (auto &d : done)
+        d.get();
+    for (size_t width = 1; width < chunks; width *= 2)
+    {
+        done.clear();
+        for (size_t i = 0; i + width < chunks; i += 2 * width)
+        {
+            const auto first = bounds[i];
+            const auto middle = bounds[i + width];
+            const auto last = bounds[std::min(i + 2 * width, chunks)];
+            done.push_back(pool.submit([=]() {
+                std::inplace_merge(begin + first, begin + middle, begin + last, before<Entry>);
+            }));
+        }
+        for (auto &d : done)
+            d.get();
+    }
+}
+
+// Write sorted records to a new temporary file; each record is preceded by
+// its entry
+void SortedOutput::writeRun()
+{
+    sortEntries();
+    const char *tmpdir = std::getenv("TMPDIR");
+    const std::string directory = tmpdir && *tmpdir ? tmpdir : "/tmp";
+    auto fileName = directory + "/metafjson-sort-XXXXXX";
+    const auto fd = mkstemp(fileName.data());
+    if (fd < 0)
+        throw(std::runtime_error("Cannot create temporary file in " + directory));
+    // File is removed when closed
+    unlink(fileName.c_str());
+    const auto run = fdopen(fd, "w+b");
+    if (!run)
+    {
+        close(fd);
+        throw(std::runtime_error("Cannot create temporary file in " + directory));
+    }
+    runs.push_back(run);
+    std::setvbuf(run, nullptr, _IOFBF, runBufferSize);
+    for (const auto &e : entries)
+    {
+        std::fwrite(&e, sizeof(e), 1, run);
+        std::fwrite(records.data() + e.offset, 1, e.length, run);
+    }
+    if (std::fflush(run) || std::ferror(run))
+        throw(std::runtime_error("Cannot write temporary file in " + directory));
+    entries.clear();
+    records.clear();
+    recordStart = 0;
+}
+
+// K-way merge of the runs
+void SortedOutput::mergeRuns(const std::function<void(const std::optional<ReportKey> &,
+                                                      std::string_view)> &f)
+{
+    struct Source
+    {
+        Entry entry;
+        std::string record;
+    };
+    std::vector<Source> sources(runs.size());
+    auto next = [&](size_t i) {
+        auto &s = sources[i];
+        if (std::fread(&s.entry, sizeof(s.entry), 1, runs[i]) != 1)
+        {
+            if (std::ferror(runs[i]))
+                throw(std::runtime_error("Cannot read temporary file"));
+            return false;
+        }
+        s.record.resize(s.entry.length);
+        if (std::fread(s.record.data(), 1, s.entry.length, runs[i]) != s.entry.length)
+            throw(std::runtime_error("Cannot read temporary file"));
+        return true;
+    };
+    auto after = [&](size_t a, size_t b) {
+        return before(sources[b].entry, sources[a].entry);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heap(after);
+    for (auto i = 0u; i < runs.size(); i++)
+    {
+        std::fseek(runs[i], 0, SEEK_SET);
+        if (next(i))
+            heap.push(i);
+    }
+    while (!heap.empty())
+    {
+        const auto i = heap.top();
+        heap.pop();
+        f(keyOf(sources[i].entry), sources[i].record);
+        if (next(i))
+            heap.push(i);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "stationfilter.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+static bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',';
+}
+
+void StationFilter::addStation(std::string_view station)
+{
+    const auto packed = packLocation(station);
+    if (!packed.has_value())
+        throw std::invalid_argument("Station " + std::string(station) + " is not a valid ICAO location");
+    const auto pos = std::lower_bound(stations.begin(), stations.end(), *packed);
+    if (pos == stations.end() || *pos != *packed)
+        stations.insert(pos, *packed);
+}
+
+void StationFilter::addStations(std::string_view list)
+{
+    while (!list.empty())
+    {
+        const auto separator = std::find_if(list.begin(), list.end(), isSeparator);
+        const auto length = static_cast<size_t>(separator - list.begin());
+        if (length)
+            addStation(list.substr(0, length));
+        list.remove_prefix(std::min(length + 1, list.length()));
+    }
+}
+
+void StationFilter::addStations(std::istream &in)
+{
+    for (std::string line; std::getline(in, line);)
+    {
+        if (const auto comment = line.find('#'); comment != std::string::npos)
+            line.erase(comment);
+        addStations(std::string_view(line));
+    }
+}
+
+std::optional<uint32_t> StationFilter::packLocation(std::string_view location)
+{
+    static const size_t locationLength = 4;
+    if (location.length() != locationLength)
+        return std::optional<uint32_t>();
+    uint32_t result = 0;
+    for (auto i = 0u; i < locationLength; i++)
+    {
+        auto c = location[i];
+        if (c >= 'a' && c <= 'z')
+            c = c - 'a' + 'A';
+        const bool isLetter = c >= 'A' && c <= 'Z';
+        const bool isDigit = c >= '0' && c <= '9';
+        // ICAO location starts with a letter and may include digits
+        if (!isLetter && (!isDigit || !i))
+            return std::optional<uint32_t>();
+        result = (result << 8) | static_cast<unsigned char>(c);
+    }
+    return result;
+}
+
+std::string_view StationFilter::findLocation(std::string_view report)
+{
+    static const std::string_view skippedKeywords[] = {
+        "METAR", "SPECI", "TAF", "COR", "AMD"};
+    while (!report.empty())
+    {
+        const auto begin = std::find_if_not(report.begin(), report.end(), isSeparator);
+        report.remove_prefix(begin - report.begin());
+        const auto end = std::find_if(report.begin(), report.end(), isSeparator);
+        const auto token = report.substr(0, end - report.begin());
+        if (token.empty())
+            break;
+        if (std::find(std::begin(skippedKeywords), std::end(skippedKeywords), token) ==
+            std::end(skippedKeywords))
+        {
+            return packLocation(token).has_value() ? token : std::string_view();
+        }
+        report.remove_prefix(token.length());
+    }
+    return std::string_view();
+}
+
+bool StationFilter::matches(std::string_view report) const
+{
+    if (stations.empty())
+        return true;
+    const auto packed = packLocation(findLocation(report));
+    if (!packed.has_value())
+        return false;
+    return std::binary_search(stations.begin(), stations.end(), *packed);
+}
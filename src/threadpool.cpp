@@ -0,0 +1,53 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "threadpool.hpp"
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (!threads)
+        threads = hardwareThreads();
+    workers.reserve(threads);
+    for (auto i = 0u; i < threads; i++)
+        workers.emplace_back([this]() { run(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAdded.notify_all();
+    for (auto &w : workers)
+        w.join();
+}
+
+size_t ThreadPool::hardwareThreads()
+{
+    const auto n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+void ThreadPool::run()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAdded.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            // Remaining tasks are completed before stopping
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
@@ -9,12 +9,20 @@
 #include "utility.hpp"
 
 #include <algorithm>
+#include <fstream>
+#include <sstream>
 
 #include "settings.hpp"
 #include "valueformat.hpp"
 #include "datetimeformat.hpp"
 #include "outputformat.hpp"
 #include "outputformatbasic.hpp"
+#include "outputformatarrow.hpp"
+#include "outputformatcsv.hpp"
+#include "outputformatevents.hpp"
+#include "stationfilter.hpp"
+#include "encoder.hpp"
+#include "compressor.hpp"
 
 namespace util
 {
@@ -59,18 +67,72 @@ std::string toLower(std::string s)
 	return (s);
 }
 
+uint64_t hash(std::string_view data, uint64_t h)
+{
+	for (const auto c : data)
+	{
+		h ^= static_cast<unsigned char>(c);
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+std::unique_ptr<OutputFormatBasic> makeOutputFormatBasic(const Settings & settings)
+{
+	return std::make_unique<OutputFormatBasic>(
+		makeDateTimeFormat(settings),
+		makeValueFormat(settings),
+		settings.includeRawStrings(),
+		settings.refDateYear(),
+		settings.refDateMonth(),
+		settings.refDateDay(),
+		settings.groups().empty() ? GroupFilter() : GroupFilter(settings.groups()),
+		settings.filter().empty() ? nullptr : std::make_unique<FilterExpression>(settings.filter()),
+		makeEncoder(settings),
+		settings.tupleGroups(),
+		settings.compact());
+}
+
+std::unique_ptr<OutputFormatEvents> makeOutputFormatEvents(const Settings & settings)
+{
+	return std::make_unique<OutputFormatEvents>(
+		makeDateTimeFormat(settings),
+		makeValueFormat(settings),
+		settings.refDateYear(),
+		settings.refDateMonth(),
+		settings.refDateDay(),
+		settings.filter().empty() ? nullptr : std::make_unique<FilterExpression>(settings.filter()),
+		makeEncoder(settings),
+		settings.gustThresholds());
+}
+
 std::unique_ptr<OutputFormat> makeOutputFormat(const Settings & settings)
 {
 	switch (settings.outputFormat())
 	{
 	case Settings::OutputFormat::BASIC:
-		return std::make_unique<OutputFormatBasic>(
+		return makeOutputFormatBasic(settings);
+	case Settings::OutputFormat::ARROW:
+		return std::make_unique<OutputFormatArrow>(
 			makeDateTimeFormat(settings),
 			makeValueFormat(settings),
-			settings.includeRawStrings(),
 			settings.refDateYear(),
 			settings.refDateMonth(),
-			settings.refDateDay());
+			settings.refDateDay(),
+			settings.filter().empty() ? nullptr : std::make_unique<FilterExpression>(settings.filter()));
+	case Settings::OutputFormat::CSV:
+	case Settings::OutputFormat::TSV:
+		return std::make_unique<OutputFormatCsv>(
+			makeDateTimeFormat(settings),
+			makeValueFormat(settings),
+			settings.refDateYear(),
+			settings.refDateMonth(),
+			settings.refDateDay(),
+			settings.filter().empty() ? nullptr : std::make_unique<FilterExpression>(settings.filter()),
+			settings.columns(),
+			settings.outputFormat() == Settings::OutputFormat::TSV ? '\t' : ',');
+	case Settings::OutputFormat::EVENTS:
+		return makeOutputFormatEvents(settings);
 	default:
 		throw std::runtime_error("Output format not implemented in this version");
 	}
@@ -98,4 +160,68 @@ std::unique_ptr<DateTimeFormat> makeDateTimeFormat(const Settings & settings)
 	}
 }
 
+std::unique_ptr<Encoder> makeEncoder(const Settings & settings)
+{
+	switch (settings.encoding())
+	{
+	case Settings::Encoding::JSON:
+		return std::make_unique<EncoderJson>();
+	case Settings::Encoding::CBOR:
+		return std::make_unique<EncoderCbor>();
+	case Settings::Encoding::MSGPACK:
+		return std::make_unique<EncoderMsgpack>();
+	default:
+		throw std::runtime_error("Encoding not implemented in this version");
+	}
+}
+
+std::unique_ptr<Compressor> makeCompressor(const Settings & settings)
+{
+	switch (settings.compression())
+	{
+	case Settings::Compression::NONE:
+		return nullptr;
+	case Settings::Compression::GZIP:
+		return std::make_unique<CompressorGzip>(settings.compressionLevel());
+#ifdef METAFJSON_ZSTD
+	case Settings::Compression::ZSTD:
+		return std::make_unique<CompressorZstd>(settings.compressionLevel());
+#endif
+	default:
+		throw std::runtime_error("Compression not implemented in this version");
+	}
+}
+
+std::string conversionSettings(const Settings & settings)
+{
+	std::ostringstream s;
+	s << "output=" << static_cast<int>(settings.outputFormat());
+	s << ";datetime=" << static_cast<int>(settings.dateTimeFormat());
+	s << ";units=" << static_cast<int>(settings.unitFormat());
+	s << ";encoding=" << static_cast<int>(settings.encoding());
+	s << ";raw=" << settings.includeRawStrings();
+	s << ";tuples=" << settings.tupleGroups();
+	s << ";compact=" << settings.compact();
+	s << ";wrap=" << settings.wrapJson();
+	// Lengths are included so that separators in the values do not matter
+	s << ";groups=" << settings.groups().length() << ':' << settings.groups();
+	s << ";where=" << settings.filter().length() << ':' << settings.filter();
+	return s.str();
+}
+
+std::unique_ptr<StationFilter> makeStationFilter(const Settings & settings)
+{
+	auto filter = std::make_unique<StationFilter>();
+	for (const auto &list : settings.stations())
+		filter->addStations(std::string_view(list));
+	for (const auto &fileName : settings.stationFiles())
+	{
+		std::ifstream file(fileName);
+		if (!file)
+			throw std::runtime_error("Cannot open station file " + fileName);
+		filter->addStations(file);
+	}
+	return filter;
+}
+
 } // namespace util
\ No newline at end of file
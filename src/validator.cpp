@@ -0,0 +1,123 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "validator.hpp"
+
+#include <variant>
+
+#include "nlohmann/json.hpp"
+#include "magic_enum.hpp"
+#include "metaf.hpp"
+
+#include "utility.hpp"
+#include "groupfilter.hpp"
+
+static_assert(std::variant_size_v<metaf::Group> <= 64,
+              "Too many group types in metaf::Group");
+
+void Validator::validate(const std::string &report, size_t lineNumber)
+{
+    totalReports++;
+    auto addFailedLine = [&]() {
+        failedReports++;
+        if (listLines)
+            failedLines[inputName].push_back(lineNumber);
+    };
+    try
+    {
+        const auto parseResult = metaf::Parser::parse(report);
+        const auto type = static_cast<size_t>(parseResult.reportMetadata.type);
+        const auto error = static_cast<size_t>(parseResult.reportMetadata.error);
+        if (type < maxCounters)
+            reportTypes[type]++;
+        if (error < maxCounters)
+            reportErrors[error]++;
+
+        std::string station;
+        size_t reportUnknownGroups = 0;
+        for (const auto &groupInfo : parseResult.groups)
+        {
+            groupKinds[groupInfo.group.index()]++;
+            if (std::holds_alternative<metaf::UnknownGroup>(groupInfo.group))
+                reportUnknownGroups++;
+            if (const auto l = std::get_if<metaf::LocationGroup>(&groupInfo.group);
+                l && station.empty())
+            {
+                station = l->toString();
+            }
+        }
+        unknownGroups += reportUnknownGroups;
+
+        const bool failed = parseResult.reportMetadata.error != metaf::ReportError::NONE;
+        if (failed)
+            addFailedLine();
+        auto &s = stations[station];
+        s.reports++;
+        s.failed += failed;
+        s.unknownGroups += reportUnknownGroups;
+    }
+    catch (const std::exception &)
+    {
+        exceptions++;
+        addFailedLine();
+    }
+}
+
+nlohmann::json Validator::summary() const
+{
+    nlohmann::json j;
+    j["reports"] = totalReports;
+    j["failed"] = failedReports;
+    j["exceptions"] = exceptions;
+    j["unknown_groups"] = unknownGroups;
+    j["stations"] = stations.size();
+
+    j["report_types"] = nlohmann::json::object();
+    for (const auto t : magic_enum::enum_values<metaf::ReportType>())
+    {
+        const auto i = static_cast<size_t>(t);
+        if (i < maxCounters && reportTypes[i])
+            j["report_types"][util::toLower(magic_enum::enum_name(t))] = reportTypes[i];
+    }
+    j["errors"] = nlohmann::json::object();
+    for (const auto e : magic_enum::enum_values<metaf::ReportError>())
+    {
+        const auto i = static_cast<size_t>(e);
+        if (i < maxCounters && reportErrors[i])
+            j["errors"][util::toLower(magic_enum::enum_name(e))] = reportErrors[i];
+    }
+    j["groups"] = nlohmann::json::object();
+    for (auto i = 0u; i < std::variant_size_v<metaf::Group>; i++)
+    {
+        if (groupKinds[i])
+            j["groups"][std::string(GroupFilter::groupName(i))] = groupKinds[i];
+    }
+    // Only stations with problems are listed to keep summary compact
+    j["failed_stations"] = nlohmann::json::object();
+    for (const auto &[station, stats] : stations)
+    {
+        if (!stats.failed && !stats.unknownGroups)
+            continue;
+        j["failed_stations"][station.empty() ? "unknown" : station] = {
+            {"reports", stats.reports},
+            {"failed", stats.failed},
+            {"unknown_groups", stats.unknownGroups}};
+    }
+    if (listLines)
+    {
+        j["failed_lines"] = nlohmann::json::object();
+        for (const auto &[input, lines] : failedLines)
+            j["failed_lines"][input.empty() ? "stdin" : input] = lines;
+    }
+    return j;
+}
+
+void Validator::printSummary(std::ostream &out) const
+{
+    out << summary().dump(2) << "\n";
+}
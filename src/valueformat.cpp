@@ -20,55 +20,84 @@
 // ValueFormatBasic
 //////////////////////////////////////////////////////////////////////////////
 
-nlohmann::json ValueFormatBasic::format(const metaf::Runway &runway) const
+namespace
 {
+
+void writeNotReported(ValueWriter &writer, bool addNotReported)
+{
+	if (!addNotReported)
+	{
+		writer.writeNull();
+		return;
+	}
+	writer.beginObject();
+	writer.member("not_reported", true);
+	writer.endObject();
+}
+
+} // namespace
+
+void ValueFormatBasic::write(ValueWriter &writer, const metaf::Runway &runway) const
+{
+	writer.beginObject();
 	if (runway.isAllRunways())
-		return nlohmann::json{{"all_runways", true}};
+	{
+		writer.member("all_runways", true);
+		writer.endObject();
+		return;
+	}
 	if (runway.isMessageRepetition())
-		return nlohmann::json{{"msg_repetition", true}};
-	nlohmann::json j;
-	j["number"] = runway.number();
+	{
+		writer.member("msg_repetition", true);
+		writer.endObject();
+		return;
+	}
+	writer.member("number", runway.number());
 	if (runway.designator() != metaf::Runway::Designator::NONE)
-		j["designator"] = util::toLower(magic_enum::enum_name(runway.designator()));
+		writer.member("designator", util::toLower(magic_enum::enum_name(runway.designator())));
     if (!runway.isValid())
-        j["not_valid"] = true;
-	return j;
+        writer.member("not_valid", true);
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::Temperature &temperature,
-										bool addNotReported) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::Temperature &temperature,
+							 bool addNotReported) const
 {
 	if (!temperature.isReported())
 	{
-		if (addNotReported)
-			return nlohmann::json{{"not_reported", true}};
-		return nlohmann::json{};
+		writeNotReported(writer, addNotReported);
+		return;
 	}
 
 	const auto unitStr = util::toLower(magic_enum::enum_name(temperature.unit()));
+	writer.beginObject();
 	if (temperature.isPrecise())
-		return nlohmann::json{{unitStr, util::formatDecimals(*temperature.temperature(), 1)}};
-	nlohmann::json j;
-	j[unitStr] = std::trunc(*temperature.temperature());
+	{
+		writer.member(unitStr, util::formatDecimals(*temperature.temperature(), 1));
+		writer.endObject();
+		return;
+	}
+	writer.member(unitStr, std::trunc(*temperature.temperature()));
 
 	if (const auto tc = temperature.toUnit(metaf::Temperature::Unit::C);
 		tc.has_value() && !tc.value() && temperature.isFreezing())
 	{
-		j["freezing"] = true;
+		writer.member("freezing", true);
 	}
-	return j;
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::Speed &speed,
-										bool addNotReported) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::Speed &speed,
+							 bool addNotReported) const
 {
 	if (!speed.isReported())
 	{
-		if (addNotReported)
-			return nlohmann::json{{"not_reported", true}};
-		return nlohmann::json{};
+		writeNotReported(writer, addNotReported);
+		return;
 	}
-	const std::string unitStr = [u = speed.unit()]() -> std::string {
+	const char *unitStr = [u = speed.unit()]() -> const char * {
 		switch (u)
 		{
 		case metaf::Speed::Unit::KNOTS:
@@ -81,31 +110,43 @@ nlohmann::json ValueFormatBasic::format(const metaf::Speed &speed,
 			return ("mph");
 		}
 	}();
-	return nlohmann::json{{unitStr, std::trunc(*speed.speed())}};
+	writer.beginObject();
+	writer.member(unitStr, std::trunc(*speed.speed()));
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::Distance &distance,
-										bool heightOrRvr,
-										bool addNotReported) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::Distance &distance,
+							 bool heightOrRvr,
+							 bool addNotReported) const
 {
 	if (!distance.isReported())
 	{
-		if (addNotReported)
-			return nlohmann::json{{"not_reported", true}};
-		return nlohmann::json{};
+		writeNotReported(writer, addNotReported);
+		return;
 	}
-	nlohmann::json j;
-	if (distance.modifier() != metaf::Distance::Modifier::NONE)
-		j["modifier"] = util::toLower(magic_enum::enum_name(distance.modifier()));
-
 	auto unit = distance.unit();
 	if (unit == metaf::Distance::Unit::STATUTE_MILES && heightOrRvr)
 		unit = metaf::Distance::Unit::FEET;
+	if (distance.modifier() == metaf::Distance::Modifier::NONE &&
+		distance.isValid() &&
+		!distance.toUnit(unit).has_value())
+	{
+		writer.writeNull();
+		return;
+	}
+
+	writer.beginObject();
+	if (distance.modifier() != metaf::Distance::Modifier::NONE)
+		writer.member("modifier", util::toLower(magic_enum::enum_name(distance.modifier())));
 
     if (!distance.isValid())
-        j["not_valid"] = true;
+        writer.member("not_valid", true);
 	if (!distance.toUnit(unit).has_value())
-		return j;
+	{
+		writer.endObject();
+		return;
+	}
 
 	const auto value = *distance.toUnit(unit);
 	switch (unit)
@@ -113,12 +154,12 @@ nlohmann::json ValueFormatBasic::format(const metaf::Distance &distance,
 	case metaf::Distance::Unit::METERS:
 		static const auto metersPerKm = 1000.0;
 		if (heightOrRvr)
-			j["m"] = static_cast<int>(std::round(value));
+			writer.member("m", static_cast<int>(std::round(value)));
 		else
-			j["km"] = util::formatDecimals(value / metersPerKm, 3);
+			writer.member("km", util::formatDecimals(value / metersPerKm, 3));
 		break;
 	case metaf::Distance::Unit::STATUTE_MILES:
-		j["sm"] = util::formatDecimals(value, 3);
+		writer.member("sm", util::formatDecimals(value, 3));
 
 		if (const auto miles = distance.miles(); miles.has_value())
 		{
@@ -161,84 +202,99 @@ nlohmann::json ValueFormatBasic::format(const metaf::Distance &distance,
 					s += ' ';
 				s += fracStr;
 			}
-			j["sm_fraction"] = s;
+			writer.member("sm_fraction", s);
 		}
 		break;
 	case metaf::Distance::Unit::FEET:
-		j["ft"] = static_cast<int>(std::round(value));
+		writer.member("ft", static_cast<int>(std::round(value)));
 		break;
 	}
-	return j;
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::Direction &direction,
-										bool addNotReported) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::Direction &direction,
+							 bool addNotReported) const
 {
-	nlohmann::json j;
+	if (direction.type() == metaf::Direction::Type::NOT_REPORTED &&
+		!addNotReported &&
+		direction.isValid())
+	{
+		writer.writeNull();
+		return;
+	}
+	writer.beginObject();
 	switch (direction.type())
 	{
 	case metaf::Direction::Type::NOT_REPORTED:
 		if (addNotReported)
-			j["not_reported"] = true;
+			writer.member("not_reported", true);
 		break;
 	case metaf::Direction::Type::VARIABLE:
-		j["variable"] = true;
+		writer.member("variable", true);
 		break;
 	case metaf::Direction::Type::NDV:
-		j["ndv"] = true;
+		writer.member("ndv", true);
 		break;
 	case metaf::Direction::Type::VALUE_DEGREES:
-		j["degrees"] = *direction.degrees();
+		writer.member("degrees", *direction.degrees());
 		break;
 	case metaf::Direction::Type::VALUE_CARDINAL:
-		j["cardinal"] = util::toLower(magic_enum::enum_name(direction.cardinal()));
+		writer.member("cardinal", util::toLower(magic_enum::enum_name(direction.cardinal())));
 		break;
 	case metaf::Direction::Type::OVERHEAD:
-		j["overhead"] = true;
+		writer.member("overhead", true);
 		break;
 	case metaf::Direction::Type::ALQDS:
-		j["alqds"] = true;
+		writer.member("alqds", true);
 		break;
 	case metaf::Direction::Type::UNKNOWN:
-		j["unknown"] = true;
+		writer.member("unknown", true);
 		break;
 	}
     if (!direction.isValid())
-        j["not_valid"] = true;
-	return j;
+        writer.member("not_valid", true);
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::Direction &sectorBegin,
-										const metaf::Direction &sectorEnd) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::Direction &sectorBegin,
+							 const metaf::Direction &sectorEnd) const
 {
-	nlohmann::json j;
+	if (!sectorBegin.degrees().has_value() && !sectorEnd.degrees().has_value())
+	{
+		writer.writeNull();
+		return;
+	}
+	writer.beginObject();
 	if (const auto d = sectorBegin.degrees(); d.has_value())
-		j["begin_degrees"] = *d;
+		writer.member("begin_degrees", *d);
 	if (const auto d = sectorEnd.degrees(); d.has_value())
-		j["end_degrees"] = *d;
-	return j;
+		writer.member("end_degrees", *d);
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const std::vector<metaf::Direction> &directions) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const std::vector<metaf::Direction> &directions) const
 {
-	nlohmann::json j = nlohmann::json::array();
+	writer.beginArray();
 	for (const auto &d : directions)
 	{
-		j.push_back(format(d));
+		write(writer, d);
 	}
-	return j;
+	writer.endArray();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::Pressure &pressure,
-										bool addNotReported) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::Pressure &pressure,
+							 bool addNotReported) const
 {
 	if (!pressure.isReported())
 	{
-		if (addNotReported)
-			return nlohmann::json{{"not_reported", true}};
-		return nlohmann::json{};
+		writeNotReported(writer, addNotReported);
+		return;
 	}
-	const std::string unitStr = [u = pressure.unit()]() -> std::string {
+	const char *unitStr = [u = pressure.unit()]() -> const char * {
 		switch (u)
 		{
 		case metaf::Pressure::Unit::HECTOPASCAL:
@@ -249,19 +305,21 @@ nlohmann::json ValueFormatBasic::format(const metaf::Pressure &pressure,
 			return ("mmhg");
 		}
 	}();
-	return nlohmann::json{{unitStr, util::formatDecimals(*pressure.pressure(), 2)}};
+	writer.beginObject();
+	writer.member(unitStr, util::formatDecimals(*pressure.pressure(), 2));
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::Precipitation &precipitation,
-										bool addNotReported) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::Precipitation &precipitation,
+							 bool addNotReported) const
 {
 	if (!precipitation.isReported())
 	{
-		if (addNotReported)
-			return nlohmann::json{{"not_reported", true}};
-		return nlohmann::json{};
+		writeNotReported(writer, addNotReported);
+		return;
 	}
-	const std::string unitStr = [u = precipitation.unit()]() -> std::string {
+	const char *unitStr = [u = precipitation.unit()]() -> const char * {
 		switch (u)
 		{
 		case metaf::Precipitation::Unit::MM:
@@ -270,38 +328,49 @@ nlohmann::json ValueFormatBasic::format(const metaf::Precipitation &precipitatio
 			return ("in");
 		}
 	}();
-	return nlohmann::json{{unitStr, util::formatDecimals(*precipitation.amount(), 2)}};
+	writer.beginObject();
+	writer.member(unitStr, util::formatDecimals(*precipitation.amount(), 2));
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::SurfaceFriction &surfaceFriction,
-										bool addNotReported) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::SurfaceFriction &surfaceFriction,
+							 bool addNotReported) const
 {
-	nlohmann::json j;
+	if (surfaceFriction.type() == metaf::SurfaceFriction::Type::NOT_REPORTED)
+	{
+		writeNotReported(writer, addNotReported);
+		return;
+	}
+	writer.beginObject();
 	switch (surfaceFriction.type())
 	{
 	case metaf::SurfaceFriction::Type::NOT_REPORTED:
-		if (addNotReported) return nlohmann::json{{"not_reported", true}};
-		return nlohmann::json{};
+		break;
 	case metaf::SurfaceFriction::Type::SURFACE_FRICTION_REPORTED:
-		return nlohmann::json{{"friction_coefficient",
-							   util::formatDecimals(*surfaceFriction.coefficient(), 2)}};
+		writer.member("friction_coefficient",
+					  util::formatDecimals(*surfaceFriction.coefficient(), 2));
+		break;
 	case metaf::SurfaceFriction::Type::BRAKING_ACTION_REPORTED:
-		return nlohmann::json{{"braking_action", util::toLower(magic_enum::enum_name(surfaceFriction.brakingAction()))}};
+		writer.member("braking_action", util::toLower(magic_enum::enum_name(surfaceFriction.brakingAction())));
+		break;
 	case metaf::SurfaceFriction::Type::UNRELIABLE:
-		return nlohmann::json{{"unreliable", true}};
+		writer.member("unreliable", true);
+		break;
 	}
+	writer.endObject();
 }
 
-nlohmann::json ValueFormatBasic::format(const metaf::WaveHeight &waveHeight,
-										bool addNotReported) const
+void ValueFormatBasic::write(ValueWriter &writer,
+							 const metaf::WaveHeight &waveHeight,
+							 bool addNotReported) const
 {
 	if (!waveHeight.isReported())
 	{
-		if (addNotReported)
-			return nlohmann::json{{"not_reported", true}};
-		return nlohmann::json{};
+		writeNotReported(writer, addNotReported);
+		return;
 	}
-	const std::string unitStr = [u = waveHeight.unit()]() -> std::string {
+	const char *unitStr = [u = waveHeight.unit()]() -> const char * {
 		switch (u)
 		{
 		case metaf::WaveHeight::Unit::METERS:
@@ -310,11 +379,15 @@ nlohmann::json ValueFormatBasic::format(const metaf::WaveHeight &waveHeight,
 			return ("ft");
 		}
 	}();
+	writer.beginObject();
 	switch (waveHeight.type())
 	{
 	case metaf::WaveHeight::Type::STATE_OF_SURFACE:
-		return nlohmann::json{{"surface_state", util::toLower(magic_enum::enum_name(waveHeight.stateOfSurface()))}};
+		writer.member("surface_state", util::toLower(magic_enum::enum_name(waveHeight.stateOfSurface())));
+		break;
 	case metaf::WaveHeight::Type::WAVE_HEIGHT:
-		return nlohmann::json{{unitStr, *waveHeight.waveHeight()}};
+		writer.member(unitStr, *waveHeight.waveHeight());
+		break;
 	}
+	writer.endObject();
 }
@@ -0,0 +1,687 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "valuewriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "nlohmann/json.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+// ValueWriter
+//////////////////////////////////////////////////////////////////////////////
+
+void ValueWriter::json(const nlohmann::json &j)
+{
+    switch (j.type())
+    {
+    case nlohmann::json::value_t::object:
+        beginObject();
+        for (const auto &[k, v] : j.items())
+        {
+            key(k);
+            json(v);
+        }
+        endObject();
+        break;
+    case nlohmann::json::value_t::array:
+        beginArray();
+        for (const auto &v : j)
+            json(v);
+        endArray();
+        break;
+    case nlohmann::json::value_t::string:
+        writeString(j.get_ref<const std::string &>());
+        break;
+    case nlohmann::json::value_t::boolean:
+        writeBool(j.get<bool>());
+        break;
+    case nlohmann::json::value_t::number_integer:
+        writeInt(j.get<int64_t>());
+        break;
+    case nlohmann::json::value_t::number_unsigned:
+        writeUint(j.get<uint64_t>());
+        break;
+    case nlohmann::json::value_t::number_float:
+        writeDouble(j.get<double>());
+        break;
+    default:
+        writeNull();
+        break;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// JsonValueWriter
+//////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+nlohmann::json &JsonValueWriter::add(T &&v)
+{
+    if (stack.empty())
+    {
+        *target = std::forward<T>(v);
+        return *target;
+    }
+    auto &parent = *stack.back();
+    if (parent.is_array())
+    {
+        parent.push_back(std::forward<T>(v));
+        return parent.back();
+    }
+    auto &value = parent[currentKey];
+    value = std::forward<T>(v);
+    return value;
+}
+
+void JsonValueWriter::beginObject()
+{
+    stack.push_back(&add(nlohmann::json::object()));
+}
+
+void JsonValueWriter::endObject()
+{
+    stack.pop_back();
+}
+
+void JsonValueWriter::beginArray()
+{
+    stack.push_back(&add(nlohmann::json::array()));
+}
+
+void JsonValueWriter::endArray()
+{
+    stack.pop_back();
+}
+
+void JsonValueWriter::key(std::string_view k)
+{
+    currentKey.assign(k);
+}
+
+void JsonValueWriter::writeNull()
+{
+    add(nullptr);
+}
+
+void JsonValueWriter::writeBool(bool b)
+{
+    add(b);
+}
+
+void JsonValueWriter::writeInt(int64_t i)
+{
+    add(i);
+}
+
+void JsonValueWriter::writeUint(uint64_t u)
+{
+    add(u);
+}
+
+void JsonValueWriter::writeDouble(double d)
+{
+    add(d);
+}
+
+void JsonValueWriter::writeString(std::string_view s)
+{
+    add(std::string(s));
+}
+
+void JsonValueWriter::clear()
+{
+    stack.clear();
+    currentKey.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ValueRecorder
+//////////////////////////////////////////////////////////////////////////////
+
+void ValueRecorder::beginObject()
+{
+    events.push_back(Event{Type::BEGIN_OBJECT});
+}
+
+void ValueRecorder::endObject()
+{
+    events.push_back(Event{Type::END_OBJECT});
+}
+
+void ValueRecorder::beginArray()
+{
+    events.push_back(Event{Type::BEGIN_ARRAY});
+}
+
+void ValueRecorder::endArray()
+{
+    events.push_back(Event{Type::END_ARRAY});
+}
+
+void ValueRecorder::key(std::string_view k)
+{
+    addString(Type::KEY, k);
+}
+
+void ValueRecorder::writeNull()
+{
+    events.push_back(Event{Type::NULL_VALUE});
+}
+
+void ValueRecorder::writeBool(bool b)
+{
+    events.push_back(Event{Type::BOOL, b});
+}
+
+void ValueRecorder::writeInt(int64_t i)
+{
+    events.push_back(Event{Type::INT, static_cast<uint64_t>(i)});
+}
+
+void ValueRecorder::writeUint(uint64_t u)
+{
+    events.push_back(Event{Type::UINT, u});
+}
+
+void ValueRecorder::writeDouble(double d)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    events.push_back(Event{Type::DOUBLE, bits});
+}
+
+void ValueRecorder::writeString(std::string_view s)
+{
+    addString(Type::STRING, s);
+}
+
+void ValueRecorder::addString(Type type, std::string_view s)
+{
+    events.push_back(Event{type, strings.length(), s.length()});
+    strings.append(s);
+}
+
+std::string_view ValueRecorder::string(const Event &e) const
+{
+    return std::string_view(strings).substr(e.value, e.length);
+}
+
+bool ValueRecorder::equal(Range range, const ValueRecorder &other, Range otherRange) const
+{
+    if (range.end - range.begin != otherRange.end - otherRange.begin)
+        return false;
+    for (auto i = range.begin, j = otherRange.begin; i < range.end; i++, j++)
+    {
+        const auto &e = events[i];
+        const auto &o = other.events[j];
+        if (e.type != o.type)
+            return false;
+        if (e.type == Type::KEY || e.type == Type::STRING)
+        {
+            if (string(e) != other.string(o))
+                return false;
+            continue;
+        }
+        if (e.value != o.value)
+            return false;
+    }
+    return true;
+}
+
+void ValueRecorder::replay(Range range, ValueWriter &writer) const
+{
+    for (auto i = range.begin; i < range.end; i++)
+    {
+        const auto &e = events[i];
+        switch (e.type)
+        {
+        case Type::BEGIN_OBJECT:
+            writer.beginObject();
+            break;
+        case Type::END_OBJECT:
+            writer.endObject();
+            break;
+        case Type::BEGIN_ARRAY:
+            writer.beginArray();
+            break;
+        case Type::END_ARRAY:
+            writer.endArray();
+            break;
+        case Type::KEY:
+            writer.key(string(e));
+            break;
+        case Type::NULL_VALUE:
+            writer.writeNull();
+            break;
+        case Type::BOOL:
+            writer.writeBool(e.value);
+            break;
+        case Type::INT:
+            writer.writeInt(static_cast<int64_t>(e.value));
+            break;
+        case Type::UINT:
+            writer.writeUint(e.value);
+            break;
+        case Type::DOUBLE:
+        {
+            double d;
+            std::memcpy(&d, &e.value, sizeof(d));
+            writer.writeDouble(d);
+            break;
+        }
+        case Type::STRING:
+            writer.writeString(string(e));
+            break;
+        }
+    }
+}
+
+void ValueRecorder::members(Range object, std::vector<Member> &result) const
+{
+    result.clear();
+    size_t depth = 0;
+    for (auto i = object.begin; i < object.end; i++)
+    {
+        const auto &e = events[i];
+        if (depth == 1 && e.type == Type::KEY)
+        {
+            result.push_back(Member{string(e), Range{i + 1, i + 1}});
+            continue;
+        }
+        switch (e.type)
+        {
+        case Type::BEGIN_OBJECT:
+        case Type::BEGIN_ARRAY:
+            depth++;
+            break;
+        case Type::END_OBJECT:
+        case Type::END_ARRAY:
+            depth--;
+            break;
+        default:
+            break;
+        }
+        // Value of the member ends when nesting returns to the object level
+        if (depth == 1 && !result.empty())
+            result.back().value.end = i + 1;
+    }
+}
+
+void ValueRecorder::clear()
+{
+    events.clear();
+    strings.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BinaryValueWriter
+//////////////////////////////////////////////////////////////////////////////
+
+void BinaryValueWriter::addValue()
+{
+    if (!stack.empty() && !stack.back().object)
+        stack.back().size++;
+}
+
+void BinaryValueWriter::begin(bool object)
+{
+    addValue();
+    buffer.append(maxHeaderLength, '\0');
+    stack.push_back(Container{object, buffer.length()});
+}
+
+void BinaryValueWriter::end(bool object)
+{
+    if (stack.empty() || stack.back().object != object)
+        throw std::logic_error("Object or array end does not match its begin");
+    const auto container = stack.back();
+    stack.pop_back();
+    header.clear();
+    appendHeader(header, container.object, container.size);
+    if (header.length() > maxHeaderLength)
+        throw std::logic_error("Object or array header is too long");
+    buffer.replace(container.position - header.length(), header.length(), header);
+    if (header.length() < maxHeaderLength)
+        gaps.push_back(Gap{container.position - maxHeaderLength,
+                           maxHeaderLength - header.length()});
+    if (stack.empty())
+        compact();
+}
+
+void BinaryValueWriter::compact()
+{
+    if (gaps.empty())
+        return;
+    // Inner objects and arrays end first, so gaps are not in buffer order
+    std::sort(gaps.begin(), gaps.end(), [](const Gap &a, const Gap &b) {
+        return a.position < b.position;
+    });
+    auto out = gaps.front().position;
+    for (auto i = 0u; i < gaps.size(); i++)
+    {
+        const auto from = gaps[i].position + gaps[i].length;
+        const auto to = (i + 1 < gaps.size()) ? gaps[i + 1].position : buffer.length();
+        std::copy(buffer.begin() + from, buffer.begin() + to, buffer.begin() + out);
+        out += to - from;
+    }
+    buffer.resize(out);
+    gaps.clear();
+}
+
+void BinaryValueWriter::beginObject()
+{
+    begin(true);
+}
+
+void BinaryValueWriter::endObject()
+{
+    end(true);
+}
+
+void BinaryValueWriter::beginArray()
+{
+    begin(false);
+}
+
+void BinaryValueWriter::endArray()
+{
+    end(false);
+}
+
+void BinaryValueWriter::key(std::string_view k)
+{
+    if (!stack.empty() && stack.back().object)
+        stack.back().size++;
+    appendString(buffer, k);
+}
+
+void BinaryValueWriter::writeNull()
+{
+    addValue();
+    appendNull(buffer);
+}
+
+void BinaryValueWriter::writeBool(bool b)
+{
+    addValue();
+    appendBool(buffer, b);
+}
+
+void BinaryValueWriter::writeInt(int64_t i)
+{
+    addValue();
+    appendInt(buffer, i);
+}
+
+void BinaryValueWriter::writeUint(uint64_t u)
+{
+    addValue();
+    appendUint(buffer, u);
+}
+
+void BinaryValueWriter::writeDouble(double d)
+{
+    addValue();
+    appendDouble(buffer, d);
+}
+
+void BinaryValueWriter::writeString(std::string_view s)
+{
+    addValue();
+    appendString(buffer, s);
+}
+
+void BinaryValueWriter::clear()
+{
+    buffer.clear();
+    stack.clear();
+    gaps.clear();
+}
+
+namespace
+{
+
+// Append the lowest bytes of the value, most significant byte first
+void appendBigEndian(std::string &out, uint64_t value, size_t bytes)
+{
+    for (auto i = bytes; i--;)
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+bool isSinglePrecision(double d)
+{
+    return static_cast<double>(static_cast<float>(d)) == d;
+}
+
+uint32_t floatBits(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+uint64_t doubleBits(double d)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// CborWriter
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Major type and argument (value or length) using shortest encoding
+void appendCborHead(std::string &out, uint8_t majorType, uint64_t argument)
+{
+    const auto type = static_cast<uint8_t>(majorType << 5);
+    if (argument < 24)
+    {
+        out.push_back(static_cast<char>(type | argument));
+        return;
+    }
+    if (argument <= 0xFF)
+    {
+        out.push_back(static_cast<char>(type | 24));
+        appendBigEndian(out, argument, 1);
+        return;
+    }
+    if (argument <= 0xFFFF)
+    {
+        out.push_back(static_cast<char>(type | 25));
+        appendBigEndian(out, argument, 2);
+        return;
+    }
+    if (argument <= 0xFFFFFFFF)
+    {
+        out.push_back(static_cast<char>(type | 26));
+        appendBigEndian(out, argument, 4);
+        return;
+    }
+    out.push_back(static_cast<char>(type | 27));
+    appendBigEndian(out, argument, 8);
+}
+
+} // namespace
+
+void CborWriter::appendHeader(std::string &out, bool object, size_t size) const
+{
+    appendCborHead(out, object ? 5 : 4, size);
+}
+
+void CborWriter::appendNull(std::string &out) const
+{
+    out.push_back(static_cast<char>(0xF6));
+}
+
+void CborWriter::appendBool(std::string &out, bool b) const
+{
+    out.push_back(static_cast<char>(b ? 0xF5 : 0xF4));
+}
+
+void CborWriter::appendInt(std::string &out, int64_t i) const
+{
+    if (i >= 0)
+    {
+        appendCborHead(out, 0, static_cast<uint64_t>(i));
+        return;
+    }
+    appendCborHead(out, 1, static_cast<uint64_t>(-(i + 1)));
+}
+
+void CborWriter::appendUint(std::string &out, uint64_t u) const
+{
+    appendCborHead(out, 0, u);
+}
+
+void CborWriter::appendDouble(std::string &out, double d) const
+{
+    if (isSinglePrecision(d))
+    {
+        out.push_back(static_cast<char>(0xFA));
+        appendBigEndian(out, floatBits(static_cast<float>(d)), 4);
+        return;
+    }
+    out.push_back(static_cast<char>(0xFB));
+    appendBigEndian(out, doubleBits(d), 8);
+}
+
+void CborWriter::appendString(std::string &out, std::string_view s) const
+{
+    appendCborHead(out, 3, s.length());
+    out.append(s);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// MsgpackWriter
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Format byte followed by the value or length in the given number of bytes
+void appendMsgpack(std::string &out, uint8_t format, uint64_t value, size_t bytes)
+{
+    out.push_back(static_cast<char>(format));
+    appendBigEndian(out, value, bytes);
+}
+
+} // namespace
+
+void MsgpackWriter::appendHeader(std::string &out, bool object, size_t size) const
+{
+    if (size < 16)
+    {
+        out.push_back(static_cast<char>((object ? 0x80 : 0x90) | size));
+        return;
+    }
+    if (size <= 0xFFFF)
+    {
+        appendMsgpack(out, object ? 0xDE : 0xDC, size, 2);
+        return;
+    }
+    appendMsgpack(out, object ? 0xDF : 0xDD, size, 4);
+}
+
+void MsgpackWriter::appendNull(std::string &out) const
+{
+    out.push_back(static_cast<char>(0xC0));
+}
+
+void MsgpackWriter::appendBool(std::string &out, bool b) const
+{
+    out.push_back(static_cast<char>(b ? 0xC3 : 0xC2));
+}
+
+void MsgpackWriter::appendInt(std::string &out, int64_t i) const
+{
+    if (i >= 0)
+    {
+        appendUint(out, static_cast<uint64_t>(i));
+        return;
+    }
+    const auto bits = static_cast<uint64_t>(i);
+    if (i >= -32)
+    {
+        out.push_back(static_cast<char>(bits & 0xFF)); // Negative fixint
+        return;
+    }
+    if (i >= INT8_MIN)
+    {
+        appendMsgpack(out, 0xD0, bits, 1);
+        return;
+    }
+    if (i >= INT16_MIN)
+    {
+        appendMsgpack(out, 0xD1, bits, 2);
+        return;
+    }
+    if (i >= INT32_MIN)
+    {
+        appendMsgpack(out, 0xD2, bits, 4);
+        return;
+    }
+    appendMsgpack(out, 0xD3, bits, 8);
+}
+
+void MsgpackWriter::appendUint(std::string &out, uint64_t u) const
+{
+    if (u < 128)
+    {
+        out.push_back(static_cast<char>(u)); // Positive fixint
+        return;
+    }
+    if (u <= 0xFF)
+    {
+        appendMsgpack(out, 0xCC, u, 1);
+        return;
+    }
+    if (u <= 0xFFFF)
+    {
+        appendMsgpack(out, 0xCD, u, 2);
+        return;
+    }
+    if (u <= 0xFFFFFFFF)
+    {
+        appendMsgpack(out, 0xCE, u, 4);
+        return;
+    }
+    appendMsgpack(out, 0xCF, u, 8);
+}
+
+void MsgpackWriter::appendDouble(std::string &out, double d) const
+{
+    if (isSinglePrecision(d))
+    {
+        appendMsgpack(out, 0xCA, floatBits(static_cast<float>(d)), 4);
+        return;
+    }
+    appendMsgpack(out, 0xCB, doubleBits(d), 8);
+}
+
+void MsgpackWriter::appendString(std::string &out, std::string_view s) const
+{
+    const auto length = s.length();
+    if (length < 32)
+        out.push_back(static_cast<char>(0xA0 | length));
+    else if (length <= 0xFF)
+        appendMsgpack(out, 0xD9, length, 1);
+    else if (length <= 0xFFFF)
+        appendMsgpack(out, 0xDA, length, 2);
+    else
+        appendMsgpack(out, 0xDB, length, 4);
+    out.append(s);
+}
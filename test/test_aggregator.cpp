@@ -0,0 +1,148 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "nlohmann/json.hpp"
+
+#include "aggregator.hpp"
+
+static const RefDate refDate = RefDate(2020, 6, 4);
+
+static std::vector<nlohmann::json> aggregate(const std::vector<std::string> &reports,
+                                             size_t threads = 2,
+                                             size_t batchSize = 2)
+{
+    Aggregator aggregator(threads, batchSize);
+    for (const auto &r : reports)
+        aggregator.add(r, refDate);
+    std::ostringstream out;
+    aggregator.finish(EncoderJson(), out);
+    std::vector<nlohmann::json> result;
+    std::istringstream in(out.str());
+    for (std::string line; std::getline(in, line); )
+        result.push_back(nlohmann::json::parse(line));
+    return result;
+}
+
+TEST(Moments, add)
+{
+    Moments m;
+    for (const auto v : {2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0})
+        m.add(v);
+    EXPECT_EQ(m.count, 8u);
+    EXPECT_NEAR(m.mean, 5.0, 1e-9);
+    EXPECT_NEAR(m.variance(), 4.0, 1e-9);
+    EXPECT_EQ(m.min, 2.0);
+    EXPECT_EQ(m.max, 9.0);
+}
+
+TEST(Moments, merge)
+{
+    Moments a, b, all;
+    for (auto i = 0; i < 100; i++)
+    {
+        const auto v = (i * 37 % 101) / 10.0 - 3.0;
+        (i % 3 ? a : b).add(v);
+        all.add(v);
+    }
+    Moments empty;
+    a.merge(empty);
+    empty.merge(b);
+    a.merge(empty);
+    EXPECT_EQ(a.count, all.count);
+    EXPECT_NEAR(a.mean, all.mean, 1e-9);
+    EXPECT_NEAR(a.variance(), all.variance(), 1e-9);
+    EXPECT_EQ(a.min, all.min);
+    EXPECT_EQ(a.max, all.max);
+}
+
+TEST(Histogram, percentile)
+{
+    Histogram h(100, 11);
+    EXPECT_FALSE(h.percentile(50).has_value());
+    for (const auto v : {0, 150, 250, 250, 900, 5000})
+        h.add(v);
+    EXPECT_EQ(h.count(), 6u);
+    EXPECT_EQ(h.percentile(10), 0.0);
+    EXPECT_EQ(h.percentile(50), 200.0);
+    EXPECT_EQ(h.percentile(90), 1000.0);
+    // Two more values greater than all bins
+    EXPECT_EQ(h.percentile(50, 2), 200.0);
+    EXPECT_FALSE(h.percentile(90, 2).has_value());
+
+    Histogram other(100, 11);
+    other.add(50);
+    h.merge(other);
+    EXPECT_EQ(h.count(), 7u);
+    EXPECT_EQ(h.percentile(25), 0.0);
+}
+
+TEST(Aggregator, stations)
+{
+    const auto result = aggregate({
+        "METAR EGYP 041250Z 24015KT 9999 FEW030 15/13 Q1009",
+        "METAR EGLL 041250Z 36005KT CAVOK 20/10 Q1015",
+        "METAR EGYP 041320Z 25020G30KT 4000 -RA BKN008 13/12 Q1007",
+        "METAR EGYP 041350Z 00000KT 3000 RA OVC006 11/11 Q1005",
+        "METAR EGYP 041420Z VRB02KT 9999 -RA BKN010 12/11 Q1005",
+        "SPECI EGYP 041335Z 24015KT 0800 +RA OVC002 11/11 Q1005",
+        "TAF EGYP 041100Z 0412/0512 24015KT 9999 BKN008",
+        "GARBAGE"});
+    ASSERT_EQ(result.size(), 2u);
+
+    const auto &egll = result[0];
+    EXPECT_EQ(egll["station"], "EGLL");
+    EXPECT_EQ(egll["reports"], 1);
+    EXPECT_EQ(egll["wind"]["rose"][0][0], 1);
+    EXPECT_EQ(egll["ceiling_ft"]["no_ceiling"], 1);
+    EXPECT_TRUE(egll["ceiling_ft"]["p50"].is_null());
+    EXPECT_EQ(egll["visibility_m"]["p50"], 10000);
+
+    const auto &egyp = result[1];
+    EXPECT_EQ(egyp["station"], "EGYP");
+    EXPECT_EQ(egyp["reports"], 4);
+    EXPECT_EQ(egyp["temperature_c"]["count"], 4);
+    EXPECT_EQ(egyp["temperature_c"]["min"], 11.0);
+    EXPECT_EQ(egyp["temperature_c"]["max"], 15.0);
+    EXPECT_EQ(egyp["temperature_c"]["mean"], 12.75);
+    EXPECT_EQ(egyp["qnh_hpa"]["min"], 1005.0);
+    EXPECT_EQ(egyp["qnh_hpa"]["max"], 1009.0);
+    EXPECT_EQ(egyp["wind"]["calm"], 1);
+    EXPECT_EQ(egyp["wind"]["variable"], 1);
+    // 240 and 250 degrees are in west-southwest sector
+    EXPECT_EQ(egyp["wind"]["rose"][11][2], 1);
+    EXPECT_EQ(egyp["wind"]["rose"][11][3], 1);
+    // Precipitation was reported at 13:20, 13:50 and 14:20
+    EXPECT_EQ(egyp["precipitation_hours"], 2);
+    EXPECT_EQ(egyp["ceiling_ft"]["count"], 4);
+    EXPECT_EQ(egyp["ceiling_ft"]["p25"], 600);
+    EXPECT_EQ(egyp["ceiling_ft"]["p75"], 1000);
+    EXPECT_EQ(egyp["visibility_m"]["p50"], 4000);
+}
+
+TEST(Aggregator, threads)
+{
+    std::vector<std::string> reports;
+    for (auto i = 0; i < 1000; i++)
+    {
+        const auto temperature = std::to_string(10 + i % 10);
+        reports.push_back("METAR EGYP 041250Z 24015KT 9999 FEW030 " + 
+                          temperature + "/05 Q1009");
+        reports.push_back("METAR EGLL 041250Z 24015KT 9999 FEW030 " + 
+                          temperature + "/05 Q1015");
+    }
+    const auto single = aggregate(reports, 1, 1024);
+    const auto parallel = aggregate(reports, 4, 7);
+    ASSERT_EQ(single.size(), 2u);
+    EXPECT_EQ(single, parallel);
+    EXPECT_EQ(parallel[1]["temperature_c"]["count"], 1000);
+    EXPECT_EQ(parallel[1]["temperature_c"]["mean"], 14.5);
+}
@@ -0,0 +1,230 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <zlib.h>
+
+#include "archiveindex.hpp"
+#include "compressor.hpp"
+#include "stationfilter.hpp"
+
+static const char *stations[] = {"EGYP", "EGLL", "UKLL"};
+
+// Reports of three stations every 10 minutes during June 2020
+static std::vector<std::string> testReports(size_t count)
+{
+    std::vector<std::string> result;
+    for (auto i = 0u; i < count; i++)
+    {
+        const auto minutes = i / 3 * 10;
+        char time[8];
+        std::snprintf(time, sizeof(time), "%02u%02u%02uZ",
+                      minutes / 1440 % 30 + 1, minutes / 60 % 24, minutes % 60);
+        result.push_back(std::string("METAR ") + stations[i % 3] + " " + time +
+                         " 24015KT 9999 SCT020 15/10 Q1015 " + std::to_string(i));
+    }
+    return result;
+}
+
+static std::string join(const std::vector<std::string> &reports)
+{
+    std::string result;
+    for (const auto &r : reports)
+        result += r + "\n";
+    return result;
+}
+
+static std::string compressBlocks(const std::string &data,
+                                  std::unique_ptr<Compressor> compressor,
+                                  size_t blockSize)
+{
+    std::ostringstream out;
+    {
+        CompressedOutput compressed(out, std::move(compressor), 2, blockSize);
+        std::ostream(&compressed) << data;
+    }
+    return out.str();
+}
+
+// Single gzip member written by zlib; minimum memory level results in
+// small deflate blocks
+static std::string gzipMember(const std::string &data)
+{
+    z_stream stream{};
+    deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 16 + MAX_WBITS, 1, Z_DEFAULT_STRATEGY);
+    std::string result(deflateBound(&stream, data.length()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = data.length();
+    stream.next_out = reinterpret_cast<Bytef *>(result.data());
+    stream.avail_out = result.length();
+    EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+    result.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result;
+}
+
+class ArchiveIndexTest : public ::testing::Test
+{
+protected:
+    virtual void TearDown()
+    {
+        std::remove(indexFileName.c_str());
+    }
+
+    std::unique_ptr<ArchiveIndex> buildIndex(const std::string &archive, size_t span)
+    {
+        std::istringstream in(archive);
+        {
+            std::ofstream index(indexFileName, std::ios::binary);
+            ArchiveIndex::build(in, index, Settings::RefDateSource::FIXED,
+                                RefDate(2020, 6, 30), span);
+        }
+        return std::make_unique<ArchiveIndex>(indexFileName);
+    }
+
+    static std::vector<std::string> read(const ArchiveIndex &index,
+                                         const std::string &archive,
+                                         const std::vector<ArchiveIndex::Entry> &selected)
+    {
+        std::istringstream in(archive);
+        std::vector<std::string> result;
+        index.read(in, selected, [&](const std::string &text, const ArchiveIndex::Entry &) {
+            result.push_back(text);
+        });
+        return result;
+    }
+
+    const std::string indexFileName = "test_archiveindex.idx";
+};
+
+static uint32_t station(const char *icao)
+{
+    return *StationFilter::packLocation(icao);
+}
+
+static const int64_t june2 = 1591056000; // 2020-06-02 00:00:00
+static const int64_t june3 = 1591142400; // 2020-06-03 00:00:00
+
+// Reports of the station from 2nd June, 00:00 to 2nd June, 23:59
+static std::vector<std::string> expected(const std::vector<std::string> &reports,
+                                         const char *icao)
+{
+    std::vector<std::string> result;
+    for (const auto &r : reports)
+        if (r.find(icao) != std::string::npos && r.find(" 02") != std::string::npos)
+            result.push_back(r);
+    return result;
+}
+
+TEST_F(ArchiveIndexTest, gzipMembers)
+{
+    const auto reports = testReports(10000);
+    const auto archive =
+        compressBlocks(join(reports), std::make_unique<CompressorGzip>(), 16384);
+    const auto index = buildIndex(archive, ArchiveIndex::defaultSpan);
+    EXPECT_EQ(index->entryCount(), reports.size());
+    EXPECT_GT(index->blockCount(), 1u);
+
+    const auto selected = index->select({station("EGLL")}, june2, june3 - 1);
+    EXPECT_EQ(selected.size(), 144u);
+    EXPECT_EQ(read(*index, archive, selected), expected(reports, "EGLL"));
+}
+
+TEST_F(ArchiveIndexTest, gzipCheckpoints)
+{
+    const auto reports = testReports(8000);
+    const auto archive = gzipMember(join(reports));
+    const auto index = buildIndex(archive, 4096);
+    EXPECT_EQ(index->entryCount(), reports.size());
+    EXPECT_GT(index->blockCount(), 10u);
+
+    const auto selected = index->select({station("UKLL"), station("EGYP")}, june2, june3 - 1);
+    EXPECT_EQ(selected.size(), 288u);
+    auto result = read(*index, archive, selected);
+    for (auto &r : expected(reports, "UKLL"))
+        EXPECT_NE(std::find(result.begin(), result.end(), r), result.end());
+    for (auto &r : expected(reports, "EGYP"))
+        EXPECT_NE(std::find(result.begin(), result.end(), r), result.end());
+}
+
+TEST_F(ArchiveIndexTest, allStations)
+{
+    const auto reports = testReports(3000);
+    const auto archive = gzipMember(join(reports));
+    const auto index = buildIndex(archive, 32768);
+    const auto selected = index->select({}, june2, june3 - 1);
+    EXPECT_EQ(selected.size(), 432u);
+    for (auto i = 1u; i < selected.size(); i++)
+        EXPECT_LT(selected[i - 1].offset, selected[i].offset);
+    const auto all = index->select({}, std::numeric_limits<int64_t>::min(),
+                                   std::numeric_limits<int64_t>::max());
+    EXPECT_EQ(read(*index, archive, all), reports);
+}
+
+TEST_F(ArchiveIndexTest, unindexedReports)
+{
+    const auto archive = gzipMember(
+        "METAR EGYP 021250Z 24015KT\n"
+        "\n"
+        "METAR 021250Z\n"
+        "TAF EGYP 0212/0312 24015KT\n"
+        "METAR COR EGLL 021250Z 24015KT\n");
+    const auto index = buildIndex(archive, ArchiveIndex::defaultSpan);
+    EXPECT_EQ(index->entryCount(), 2u);
+    const auto all = index->select({}, june2, june3);
+    EXPECT_EQ(read(*index, archive, all),
+              std::vector<std::string>({"METAR EGYP 021250Z 24015KT",
+                                        "METAR COR EGLL 021250Z 24015KT"}));
+}
+
+TEST_F(ArchiveIndexTest, archiveMismatch)
+{
+    const auto reports = testReports(100);
+    const auto archive = gzipMember(join(reports));
+    const auto index = buildIndex(archive, ArchiveIndex::defaultSpan);
+    const auto all = index->select({}, june2, june3);
+    EXPECT_THROW(read(*index, archive + archive, all), std::runtime_error);
+}
+
+TEST_F(ArchiveIndexTest, notCompressed)
+{
+    EXPECT_THROW(buildIndex("METAR EGYP 021250Z 24015KT\n", 1024), std::invalid_argument);
+}
+
+TEST_F(ArchiveIndexTest, invalidIndex)
+{
+    {
+        std::ofstream index(indexFileName, std::ios::binary);
+        index << "METAR EGYP 021250Z 24015KT\n";
+    }
+    EXPECT_THROW(ArchiveIndex index(indexFileName), std::runtime_error);
+    EXPECT_THROW(ArchiveIndex index("nonexistent.idx"), std::runtime_error);
+}
+
+#ifdef METAFJSON_ZSTD
+TEST_F(ArchiveIndexTest, zstdFrames)
+{
+    const auto reports = testReports(10000);
+    const auto archive =
+        compressBlocks(join(reports), std::make_unique<CompressorZstd>(), 16384);
+    const auto index = buildIndex(archive, ArchiveIndex::defaultSpan);
+    EXPECT_EQ(index->entryCount(), reports.size());
+    EXPECT_GT(index->blockCount(), 1u);
+
+    const auto selected = index->select({station("EGLL")}, june2, june3 - 1);
+    EXPECT_EQ(selected.size(), 144u);
+    EXPECT_EQ(read(*index, archive, selected), expected(reports, "EGLL"));
+}
+#endif
@@ -0,0 +1,136 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "arrowwriter.hpp"
+
+// Minimal reader of the Arrow IPC stream messages to check the metadata
+
+static uint32_t readUint32(const std::string &s, size_t pos)
+{
+    uint32_t result = 0;
+    for (auto i = 0u; i < 4; i++)
+        result |= static_cast<uint32_t>(static_cast<uint8_t>(s.at(pos + i))) << (8 * i);
+    return result;
+}
+
+static uint64_t readUint64(const std::string &s, size_t pos)
+{
+    return readUint32(s, pos) | (static_cast<uint64_t>(readUint32(s, pos + 4)) << 32);
+}
+
+// Position of the table field in flatbuffer or 0 if field is absent
+static size_t fieldPosition(const std::string &fb, size_t table, unsigned id)
+{
+    const auto vtable = table - static_cast<int32_t>(readUint32(fb, table));
+    const auto vtableSize = readUint32(fb, vtable) & 0xFFFF;
+    if (4 + 2 * id >= vtableSize)
+        return 0;
+    const auto offset = readUint32(fb, vtable + 4 + 2 * id) & 0xFFFF;
+    return offset ? table + offset : 0;
+}
+
+static size_t followOffset(const std::string &fb, size_t pos)
+{
+    return pos + readUint32(fb, pos);
+}
+
+struct Message
+{
+    uint8_t headerType = 0;
+    uint64_t rows = 0;
+    uint64_t bodyLength = 0;
+    uint32_t fields = 0;
+};
+
+static std::vector<Message> readMessages(const std::string &stream)
+{
+    std::vector<Message> result;
+    size_t pos = 0;
+    while (true)
+    {
+        EXPECT_EQ(readUint32(stream, pos), 0xFFFFFFFF);
+        const auto length = readUint32(stream, pos + 4);
+        pos += 8;
+        if (!length)
+            break;
+        EXPECT_EQ(length % 8, 0u);
+        const auto fb = stream.substr(pos, length);
+        const auto message = followOffset(fb, 0);
+        Message m;
+        m.headerType = static_cast<uint8_t>(fb.at(fieldPosition(fb, message, 1)));
+        m.bodyLength = readUint64(fb, fieldPosition(fb, message, 3));
+        const auto header = followOffset(fb, fieldPosition(fb, message, 2));
+        if (m.headerType == 1)
+            m.fields = readUint32(fb, followOffset(fb, fieldPosition(fb, header, 1)));
+        if (m.headerType == 3)
+            m.rows = readUint64(fb, fieldPosition(fb, header, 0));
+        result.push_back(m);
+        pos += length + m.bodyLength;
+    }
+    EXPECT_EQ(pos, stream.length());
+    return result;
+}
+
+static const std::vector<ArrowWriter::Column> testColumns = {
+    {"station", ArrowWriter::ColumnType::STRING},
+    {"time", ArrowWriter::ColumnType::TIMESTAMP},
+    {"wind_dir", ArrowWriter::ColumnType::INT16},
+    {"wind_kt", ArrowWriter::ColumnType::FLOAT32},
+    {"clouds", ArrowWriter::ColumnType::STRING_LIST}};
+
+static void appendTestRow(ArrowWriter &writer, size_t i)
+{
+    writer.appendString(0, (i % 3) ? std::optional<std::string_view>("EGYP")
+                                   : std::optional<std::string_view>());
+    writer.appendInt(1, 1591275000 + i * 60);
+    writer.appendInt(2, (i % 2) ? std::optional<int64_t>(240) : std::optional<int64_t>());
+    writer.appendFloat(3, 15.0f);
+    writer.appendList(4, std::vector<std::string>(i % 3, "BKN030"));
+    writer.endRow();
+}
+
+TEST(ArrowWriter, empty)
+{
+    std::ostringstream out;
+    ArrowWriter writer(testColumns);
+    writer.finish(out);
+    const auto messages = readMessages(out.str());
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0].headerType, 1u);
+    EXPECT_EQ(messages[0].fields, testColumns.size());
+    EXPECT_EQ(messages[0].bodyLength, 0u);
+}
+
+TEST(ArrowWriter, batches)
+{
+    std::ostringstream out;
+    ArrowWriter writer(testColumns);
+    for (auto i = 0u; i < 25; i++)
+    {
+        appendTestRow(writer, i);
+        if (writer.rows() == 10)
+            writer.writeBatch(out);
+    }
+    EXPECT_EQ(writer.rows(), 5u);
+    writer.finish(out);
+    EXPECT_EQ(writer.rows(), 0u);
+
+    const auto messages = readMessages(out.str());
+    ASSERT_EQ(messages.size(), 4u);
+    EXPECT_EQ(messages[0].headerType, 1u);
+    EXPECT_EQ(messages[1].headerType, 3u);
+    EXPECT_EQ(messages[1].rows, 10u);
+    EXPECT_EQ(messages[2].rows, 10u);
+    EXPECT_EQ(messages[3].rows, 5u);
+    for (const auto &m : messages)
+        EXPECT_EQ(m.bodyLength % 8, 0u);
+}
@@ -66,14 +66,25 @@ TEST(CommandLineArgs, defaultParameters) {
     EXPECT_EQ(cla.outputFormat(), CommandLineArgs::OutputFormat::BASIC);
     EXPECT_EQ(cla.dateTimeFormat(), CommandLineArgs::DateTimeFormat::BASIC);
     EXPECT_EQ(cla.unitFormat(), CommandLineArgs::UnitFormat::BASIC);
+    EXPECT_EQ(cla.encoding(), CommandLineArgs::Encoding::JSON);
+    EXPECT_EQ(cla.compression(), CommandLineArgs::Compression::NONE);
+    EXPECT_EQ(cla.compressionLevel(), 0);
+    EXPECT_EQ(cla.threads(), 0u);
 
     using namespace date;
     EXPECT_EQ(cla.refDateDay(), (unsigned)year_month_day{floor<days>(now)}.day());
     EXPECT_EQ(cla.refDateMonth(), (unsigned)year_month_day{floor<days>(now)}.month());
     EXPECT_EQ(cla.refDateYear(), (int)year_month_day{floor<days>(now)}.year());
 
+    EXPECT_EQ(cla.refDateSource(), CommandLineArgs::RefDateSource::FIXED);
+    EXPECT_TRUE(cla.inputFiles().empty());
+
     EXPECT_FALSE(cla.wrapJson());
     EXPECT_FALSE(cla.includeRawStrings());
+    EXPECT_FALSE(cla.validate());
+    EXPECT_FALSE(cla.tupleGroups());
+    EXPECT_FALSE(cla.compact());
+    EXPECT_FALSE(cla.listFailedLines());
 }
 
 // output formats
@@ -370,6 +381,287 @@ TEST(CommandLineArgs, unitFormatDuplicate) {
     EXPECT_EQ(cla.unitFormat(), CommandLineArgs::UnitFormat::BASIC);
 }
 
+// Encodings
+
+TEST(CommandLineArgs, encodingCbor) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--encoding=cbor";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.encoding(), CommandLineArgs::Encoding::CBOR);
+}
+
+TEST(CommandLineArgs, encodingMsgpackShort) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "-e";
+    char arg2[] = "m";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.encoding(), CommandLineArgs::Encoding::MSGPACK);
+}
+
+TEST(CommandLineArgs, encodingUnrecognised) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--encoding=other";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+    EXPECT_EQ(cla.encoding(), CommandLineArgs::Encoding::JSON);
+}
+
+TEST(CommandLineArgs, outputArrow) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=arrow";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.outputFormat(), CommandLineArgs::OutputFormat::ARROW);
+}
+
+TEST(CommandLineArgs, outputArrowWithEncoding) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=arrow";
+    char arg2[] = "--encoding=cbor";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, outputCsvColumns) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=csv";
+    char arg2[] = "--columns=station,time,wind_dir,wind_kt,vis_m,ceiling_ft,temp_c,dewpt_c,qnh_hpa";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.outputFormat(), CommandLineArgs::OutputFormat::CSV);
+    EXPECT_EQ(cla.columns(), "station,time,wind_dir,wind_kt,vis_m,ceiling_ft,temp_c,dewpt_c,qnh_hpa");
+}
+
+TEST(CommandLineArgs, outputTsv) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=tsv";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.outputFormat(), CommandLineArgs::OutputFormat::TSV);
+    EXPECT_TRUE(cla.columns().empty());
+}
+
+TEST(CommandLineArgs, columnsUnrecognised) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=csv";
+    char arg2[] = "--columns=station,wind";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, columnsWithoutCsv) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--columns=station";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, outputFormatEvents) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=events";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.outputFormat(), CommandLineArgs::OutputFormat::EVENTS);
+    EXPECT_EQ(cla.gustThresholds(), (std::vector<unsigned>{25, 35}));
+}
+
+TEST(CommandLineArgs, gustThresholds) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=events";
+    char arg2[] = "--gust-thresholds=30,40,50";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.gustThresholds(), (std::vector<unsigned>{30, 40, 50}));
+}
+
+TEST(CommandLineArgs, gustThresholdsNotValid) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=events";
+    char arg2[] = "--gust-thresholds=30,,40";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, gustThresholdsWithoutEvents) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--gust-thresholds=30";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, tuples) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--tuples";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.tupleGroups());
+}
+
+TEST(CommandLineArgs, tuplesWithCsv) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=csv";
+    char arg2[] = "--tuples";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, compact) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--compact";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.compact());
+}
+
+TEST(CommandLineArgs, compactWithArrow) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output=arrow";
+    char arg2[] = "--compact";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Compression
+
+TEST(CommandLineArgs, compressGzip) {
+    const int argn = 4;
+    char arg0[] = "metafjson";
+    char arg1[] = "--compress=gzip";
+    char arg2[] = "--compress-level=9";
+    char arg3[] = "-j4";
+    char * argv[] = {arg0, arg1, arg2, arg3};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.compression(), CommandLineArgs::Compression::GZIP);
+    EXPECT_EQ(cla.compressionLevel(), 9);
+    EXPECT_EQ(cla.threads(), 4u);
+}
+
+TEST(CommandLineArgs, compressLevelOutOfRange) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--compress=gzip";
+    char arg2[] = "--compress-level=10";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, compressLevelWithoutCompress) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--compress-level=5";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, compressZstd) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--compress=zstd";
+    char * argv[] = {arg0, arg1};
+
+#ifdef METAFJSON_ZSTD
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.compression(), CommandLineArgs::Compression::ZSTD);
+#else
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+#endif
+}
+
+TEST(CommandLineArgs, compressUnrecognised) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--compress=xz";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
 // Reference date
 
 TEST(CommandLineArgs, refdateValid) {
@@ -397,32 +689,802 @@ TEST(CommandLineArgs, refdateInvalid) {
     EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
 }
 
-// Flags
-
-TEST(CommandLineArgs, flagsWrapJson) {
+TEST(CommandLineArgs, refdateSourceTimestamp) {
     const int argn = 2;
     char arg0[] = "metafjson";
-    char arg1[] = "--wrap";
+    char arg1[] = "--refdate-from=timestamp";
     char * argv[] = {arg0, arg1};
 
     const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.refDateSource(), CommandLineArgs::RefDateSource::TIMESTAMP);
+}
+
+TEST(CommandLineArgs, refdateSourceColumn) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--refdate-from";
+    char arg2[] = "c";
+    char * argv[] = {arg0, arg1, arg2};
 
+    const auto cla = CommandLineArgs(argn, argv);
     EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.refDateSource(), CommandLineArgs::RefDateSource::COLUMN);
+}
 
-    EXPECT_TRUE(cla.wrapJson());
+TEST(CommandLineArgs, refdateSourceFileName) {
+    const int argn = 4;
+    char arg0[] = "metafjson";
+    char arg1[] = "--refdate-from=filename";
+    char arg2[] = "--input=metar_20200604.txt";
+    char arg3[] = "--input=metar_20200605.txt";
+    char * argv[] = {arg0, arg1, arg2, arg3};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.refDateSource(), CommandLineArgs::RefDateSource::FILENAME);
+    ASSERT_EQ(cla.inputFiles().size(), 2u);
+    EXPECT_EQ(cla.inputFiles()[0], "metar_20200604.txt");
+    EXPECT_EQ(cla.inputFiles()[1], "metar_20200605.txt");
 }
 
-TEST(CommandLineArgs, flagsRaw) {
+TEST(CommandLineArgs, refdateSourceFileNameNoInput) {
     const int argn = 2;
     char arg0[] = "metafjson";
-    char arg1[] = "--raw";
+    char arg1[] = "--refdate-from=filename";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, refdateSourceUnrecognised) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--refdate-from=other";
     char * argv[] = {arg0, arg1};
 
+    testing::internal::CaptureStderr();
     const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+    EXPECT_EQ(cla.refDateSource(), CommandLineArgs::RefDateSource::FIXED);
+}
+
+// Station filter
+
+TEST(CommandLineArgs, stations) {
+    const int argn = 4;
+    char arg0[] = "metafjson";
+    char arg1[] = "--station=EGYP,KJFK";
+    char arg2[] = "-s";
+    char arg3[] = "UKLL";
+    char * argv[] = {arg0, arg1, arg2, arg3};
 
+    const auto cla = CommandLineArgs(argn, argv);
     EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    ASSERT_EQ(cla.stations().size(), 2u);
+    EXPECT_EQ(cla.stations()[0], "EGYP,KJFK");
+    EXPECT_EQ(cla.stations()[1], "UKLL");
+}
 
-    EXPECT_TRUE(cla.includeRawStrings());
+TEST(CommandLineArgs, stationsInvalid) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--station=EGYP,KJF";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, stationFile) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--station-file=stations.txt";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    ASSERT_EQ(cla.stationFiles().size(), 1u);
+    EXPECT_EQ(cla.stationFiles()[0], "stations.txt");
+}
+
+// Group projection
+
+TEST(CommandLineArgs, groups) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--groups=wind,visibility,cloud";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.groups(), "wind,visibility,cloud");
+}
+
+TEST(CommandLineArgs, groupsUnrecognised) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "-g";
+    char arg2[] = "wind,other";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+    EXPECT_TRUE(cla.groups().empty());
+}
+
+// Filter expression
+
+TEST(CommandLineArgs, where) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--where";
+    char arg2[] = "wind_speed > 25 kt or weather contains TS";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.filter(), "wind_speed > 25 kt or weather contains TS");
+}
+
+TEST(CommandLineArgs, whereSyntaxError) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--where";
+    char arg2[] = "wind_speed >";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+    EXPECT_TRUE(cla.filter().empty());
+}
+
+// Flags
+
+TEST(CommandLineArgs, flagsWrapJson) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--wrap";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+
+    EXPECT_TRUE(cla.wrapJson());
+}
+
+TEST(CommandLineArgs, flagsRaw) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--raw";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+
+    EXPECT_TRUE(cla.includeRawStrings());
+}
+
+TEST(CommandLineArgs, flagsValidate) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--validate";
+    char arg2[] = "--failed-lines";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+
+    EXPECT_TRUE(cla.validate());
+    EXPECT_TRUE(cla.listFailedLines());
+}
+
+TEST(CommandLineArgs, failedLinesNoValidate) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--failed-lines";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Archive index
+
+TEST(CommandLineArgs, buildIndex) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--build-index";
+    char arg2[] = "--input=metar.txt.gz";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.buildIndex());
+    EXPECT_FALSE(cla.useIndex());
+}
+
+TEST(CommandLineArgs, buildIndexNoInput) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--build-index";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, useIndexTimeRange) {
+    const int argn = 5;
+    char arg0[] = "metafjson";
+    char arg1[] = "--use-index";
+    char arg2[] = "--input=metar.txt.gz";
+    char arg3[] = "--time-from=202006041230";
+    char arg4[] = "--time-to=20200605";
+    char * argv[] = {arg0, arg1, arg2, arg3, arg4};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.useIndex());
+    EXPECT_EQ(cla.timeFrom(), 1591273800);
+    EXPECT_EQ(cla.timeTo(), 1591401599);
+}
+
+TEST(CommandLineArgs, timeRangeWithoutIndex) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--input=metar.txt.gz";
+    char arg2[] = "--time-from=20200604";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Output index
+
+TEST(CommandLineArgs, outputIndex) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output-index=metar.json.idx";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.outputIndex(), "metar.json.idx");
+}
+
+TEST(CommandLineArgs, outputIndexCompressed) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--output-index=metar.json.idx";
+    char arg2[] = "--compress=gzip";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Parse cache
+
+TEST(CommandLineArgs, emitParsed) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--emit-parsed=metar.prs";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.emitParsed(), "metar.prs");
+    EXPECT_TRUE(cla.fromParsed().empty());
+}
+
+TEST(CommandLineArgs, fromParsed) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--from-parsed=metar.prs";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.fromParsed(), "metar.prs");
+    EXPECT_TRUE(cla.emitParsed().empty());
+}
+
+TEST(CommandLineArgs, fromParsedWithInput) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--from-parsed=metar.prs";
+    char arg2[] = "--input=metar.txt";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Additional outputs
+
+TEST(CommandLineArgs, alsoOutput) {
+    const int argn = 4;
+    char arg0[] = "metafjson";
+    char arg1[] = "--also-output=metar-unix.json,d=unix,u=all";
+    char arg2[] = "--also-output=metar.csv,output=csv,raw";
+    char arg3[] = "--columns=station,time";
+    char * argv[] = {arg0, arg1, arg2, arg3};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.outputFormat(), CommandLineArgs::OutputFormat::BASIC);
+    ASSERT_EQ(cla.additionalOutputs().size(), 2u);
+    const auto &unixTime = cla.additionalOutputs()[0];
+    EXPECT_EQ(unixTime.file, "metar-unix.json");
+    EXPECT_EQ(unixTime.outputFormat, CommandLineArgs::OutputFormat::BASIC);
+    EXPECT_EQ(unixTime.dateTimeFormat, CommandLineArgs::DateTimeFormat::UNIX_TIME);
+    EXPECT_EQ(unixTime.unitFormat, CommandLineArgs::UnitFormat::ALL);
+    EXPECT_FALSE(unixTime.includeRawStrings);
+    const auto &csv = cla.additionalOutputs()[1];
+    EXPECT_EQ(csv.file, "metar.csv");
+    EXPECT_EQ(csv.outputFormat, CommandLineArgs::OutputFormat::CSV);
+    EXPECT_EQ(csv.dateTimeFormat, CommandLineArgs::DateTimeFormat::BASIC);
+    EXPECT_TRUE(csv.includeRawStrings);
+
+    const auto settings = cla.forOutput(csv);
+    EXPECT_EQ(settings.outputFormat(), CommandLineArgs::OutputFormat::CSV);
+    EXPECT_TRUE(settings.includeRawStrings());
+    EXPECT_EQ(settings.columns(), "station,time");
+    EXPECT_TRUE(settings.additionalOutputs().empty());
+}
+
+TEST(CommandLineArgs, alsoOutputInvalidOption) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--also-output=metar.json,wrap";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, alsoOutputEncoding) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--also-output=metar.csv,o=csv";
+    char arg2[] = "--encoding=cbor";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Conversion cache
+
+TEST(CommandLineArgs, cacheDir) {
+    const int argn = 4;
+    char arg0[] = "metafjson";
+    char arg1[] = "--cache-dir=cache";
+    char arg2[] = "--cache-size=256";
+    char arg3[] = "--cache-stats";
+    char * argv[] = {arg0, arg1, arg2, arg3};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.cacheDir(), "cache");
+    EXPECT_EQ(cla.cacheSize(), 256u);
+    EXPECT_TRUE(cla.cacheStats());
+}
+
+TEST(CommandLineArgs, cacheDefaults) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--cache-dir=cache";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.cacheSize(), 1024u);
+    EXPECT_FALSE(cla.cacheStats());
+}
+
+TEST(CommandLineArgs, cacheSizeWithoutDir) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--cache-size=256";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, cacheDirCsv) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--cache-dir=cache";
+    char arg2[] = "--output=csv";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Sorted output
+
+TEST(CommandLineArgs, sortStationTime) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--sort=station,time";
+    char arg2[] = "--sort-memory=512";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.sortOutput());
+    EXPECT_EQ(cla.sortMemory(), 512u);
+}
+
+TEST(CommandLineArgs, sortDefaults) {
+    const int argn = 1;
+    char arg0[] = "metafjson";
+    char * argv[] = {arg0};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_FALSE(cla.sortOutput());
+    EXPECT_EQ(cla.sortMemory(), 1024u);
+}
+
+TEST(CommandLineArgs, sortUnsupportedKeys) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--sort=time,station";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, sortMemoryWithoutSort) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--sort-memory=512";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Partitioned output
+
+TEST(CommandLineArgs, partitionBy) {
+    const int argn = 4;
+    char arg0[] = "metafjson";
+    char arg1[] = "--partition-by=date,type";
+    char arg2[] = "--partition-path=lake/{date}/{type}.json";
+    char arg3[] = "--partition-open-files=16";
+    char * argv[] = {arg0, arg1, arg2, arg3};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_EQ(cla.partitionBy(), "date,type");
+    EXPECT_EQ(cla.partitionPath(), "lake/{date}/{type}.json");
+    EXPECT_EQ(cla.partitionOpenFiles(), 16u);
+}
+
+TEST(CommandLineArgs, partitionDefaults) {
+    const int argn = 1;
+    char arg0[] = "metafjson";
+    char * argv[] = {arg0};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.partitionBy().empty());
+    EXPECT_EQ(cla.partitionOpenFiles(), 64u);
+}
+
+TEST(CommandLineArgs, partitionWithoutPath) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--partition-by=type";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, partitionPathMismatch) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--partition-by=station-hash:16";
+    char arg2[] = "--partition-path={type}.json";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, partitionSort) {
+    const int argn = 4;
+    char arg0[] = "metafjson";
+    char arg1[] = "--partition-by=type";
+    char arg2[] = "--partition-path={type}.json";
+    char arg3[] = "--sort=station,time";
+    char * argv[] = {arg0, arg1, arg2, arg3};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Removal of repeated reports
+
+TEST(CommandLineArgs, dedup) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--dedup";
+    char arg2[] = "--dedup-memory=64";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.dedup());
+    EXPECT_EQ(cla.dedupMemory(), 64u);
+}
+
+TEST(CommandLineArgs, dedupDefaults) {
+    const int argn = 1;
+    char arg0[] = "metafjson";
+    char * argv[] = {arg0};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_FALSE(cla.dedup());
+    EXPECT_EQ(cla.dedupMemory(), 256u);
+}
+
+TEST(CommandLineArgs, dedupMemoryWithoutDedup) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--dedup-memory=64";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, dedupFromParsed) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--dedup";
+    char arg2[] = "--from-parsed=metar.parsed";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+// Newest reports
+
+TEST(CommandLineArgs, latest) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--latest";
+    char arg2[] = "--latest-interval=60";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.latest());
+    EXPECT_EQ(cla.latestInterval(), 60u);
+}
+
+TEST(CommandLineArgs, latestDefaults) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--latest";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.latest());
+    EXPECT_EQ(cla.latestInterval(), 0u);
+}
+
+TEST(CommandLineArgs, latestIntervalWithoutLatest) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--latest-interval=60";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, latestValidate) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--latest";
+    char arg2[] = "--validate";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, delta) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--delta";
+    char * argv[] = {arg0, arg1};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.delta());
+}
+
+TEST(CommandLineArgs, deltaSort) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--delta";
+    char arg2[] = "--sort=station,time";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, deltaCsv) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--delta";
+    char arg2[] = "--output=csv";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, deltaTuples) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--delta";
+    char arg2[] = "--tuples";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, aggregate) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--aggregate";
+    char arg2[] = "--dedup";
+    char * argv[] = {arg0, arg1, arg2};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.aggregate());
+    EXPECT_TRUE(cla.dedup());
+}
+
+TEST(CommandLineArgs, aggregateCsv) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--aggregate";
+    char arg2[] = "--output=csv";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, aggregateLatest) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--aggregate";
+    char arg2[] = "--latest";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, sketch) {
+    const int argn = 5;
+    char arg0[] = "metafjson";
+    char arg1[] = "--sketch";
+    char arg2[] = "--sketch-save=all.sketch";
+    char arg3[] = "--sketch-merge=a.sketch";
+    char arg4[] = "--sketch-merge=b.sketch";
+    char * argv[] = {arg0, arg1, arg2, arg3, arg4};
+
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::CONTINUE);
+    EXPECT_TRUE(cla.sketch());
+    EXPECT_EQ(cla.sketchSave(), "all.sketch");
+    EXPECT_EQ(cla.sketchMerge(), std::vector<std::string>({"a.sketch", "b.sketch"}));
+}
+
+TEST(CommandLineArgs, sketchSaveOnly) {
+    const int argn = 2;
+    char arg0[] = "metafjson";
+    char arg1[] = "--sketch-save=all.sketch";
+    char * argv[] = {arg0, arg1};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
+}
+
+TEST(CommandLineArgs, sketchAggregate) {
+    const int argn = 3;
+    char arg0[] = "metafjson";
+    char arg1[] = "--sketch";
+    char arg2[] = "--aggregate";
+    char * argv[] = {arg0, arg1, arg2};
+
+    testing::internal::CaptureStderr();
+    const auto cla = CommandLineArgs(argn, argv);
+    EXPECT_FALSE(testing::internal::GetCapturedStderr().empty());
+    EXPECT_EQ(cla.status(), CommandLineArgs::Status::EXIT_ERROR);
 }
 
 // Unrecognised options
@@ -0,0 +1,154 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include <zlib.h>
+#ifdef METAFJSON_ZSTD
+#include <zstd.h>
+#endif
+
+#include "compressor.hpp"
+
+// Inflates all members of gzip file and counts them
+static std::string gunzip(const std::string &s, size_t *members = nullptr)
+{
+    std::string result;
+    size_t count = 0;
+    z_stream stream{};
+    EXPECT_EQ(inflateInit2(&stream, 16 + MAX_WBITS), Z_OK);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(s.data()));
+    stream.avail_in = s.length();
+    while (stream.avail_in)
+    {
+        char buffer[4096];
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+        const auto status = inflate(&stream, Z_NO_FLUSH);
+        result.append(buffer, sizeof(buffer) - stream.avail_out);
+        if (status == Z_STREAM_END)
+        {
+            count++;
+            inflateReset(&stream);
+            continue;
+        }
+        if (status != Z_OK)
+        {
+            ADD_FAILURE() << "inflate status " << status;
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    if (members)
+        *members = count;
+    return result;
+}
+
+static std::string testData(size_t lines)
+{
+    std::string result;
+    for (auto i = 0u; i < lines; i++)
+        result += "{\"report\":{\"type\":\"metar\"},\"line\":" + std::to_string(i) + "}\n";
+    return result;
+}
+
+TEST(CompressorGzip, member)
+{
+    const auto data = testData(100);
+    std::string compressed;
+    CompressorGzip(9).compress(data, compressed);
+    const auto size = CompressorGzip::memberSize(compressed);
+    ASSERT_TRUE(size.has_value());
+    EXPECT_EQ(*size, compressed.length());
+    size_t members = 0;
+    EXPECT_EQ(gunzip(compressed, &members), data);
+    EXPECT_EQ(members, 1u);
+}
+
+TEST(CompressorGzip, memberSizeForeignHeader)
+{
+    // Header written by gzip without extra field
+    const std::string header("\x1F\x8B\x08\x00\x00\x00\x00\x00\x00\x03"
+                             "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 20);
+    EXPECT_FALSE(CompressorGzip::memberSize(header).has_value());
+    EXPECT_FALSE(CompressorGzip::memberSize("\x1F\x8B").has_value());
+}
+
+TEST(CompressorGzip, level)
+{
+    EXPECT_THROW(CompressorGzip(10), std::invalid_argument);
+    EXPECT_THROW(CompressorGzip(-1), std::invalid_argument);
+}
+
+TEST(CompressedOutput, multiMember)
+{
+    const auto data = testData(1000);
+    std::ostringstream out;
+    {
+        CompressedOutput compressed(out, std::make_unique<CompressorGzip>(), 4, 1000);
+        std::ostream os(&compressed);
+        os << data << std::flush;
+        compressed.finish();
+    }
+    size_t members = 0;
+    EXPECT_EQ(gunzip(out.str(), &members), data);
+    EXPECT_EQ(members, (data.length() + 999) / 1000);
+
+    // Members can be located by the size in the header
+    const auto s = out.str();
+    size_t pos = 0, count = 0;
+    while (pos < s.length())
+    {
+        const auto size = CompressorGzip::memberSize(std::string_view(s).substr(pos));
+        ASSERT_TRUE(size.has_value());
+        pos += *size;
+        count++;
+    }
+    EXPECT_EQ(pos, s.length());
+    EXPECT_EQ(count, members);
+}
+
+TEST(CompressedOutput, empty)
+{
+    std::ostringstream out;
+    CompressedOutput(out, std::make_unique<CompressorGzip>(), 1).finish();
+    size_t members = 0;
+    EXPECT_EQ(gunzip(out.str(), &members), "");
+    EXPECT_EQ(members, 1u);
+}
+
+TEST(CompressedOutput, finishOnDestruction)
+{
+    const auto data = testData(10);
+    std::ostringstream out;
+    {
+        CompressedOutput compressed(out, std::make_unique<CompressorGzip>(), 2);
+        std::ostream(&compressed) << data;
+    }
+    EXPECT_EQ(gunzip(out.str()), data);
+}
+
+#ifdef METAFJSON_ZSTD
+TEST(CompressedOutput, zstd)
+{
+    const auto data = testData(1000);
+    std::ostringstream out;
+    {
+        CompressedOutput compressed(out, std::make_unique<CompressorZstd>(), 4, 1000);
+        std::ostream(&compressed) << data;
+    }
+    const auto s = out.str();
+    std::string result(data.length(), '\0');
+    const auto size = ZSTD_decompress(result.data(), result.length(), s.data(), s.length());
+    ASSERT_FALSE(ZSTD_isError(size));
+    result.resize(size);
+    EXPECT_EQ(result, data);
+}
+#endif
@@ -0,0 +1,248 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <unistd.h>
+
+#include "conversioncache.hpp"
+#include "utility.hpp"
+
+static const char report[] = "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009";
+static const char json[] = "{\"report_type\":\"metar\",\"location\":\"EGYP\"}\n";
+
+class ConversionCacheTest : public ::testing::Test
+{
+protected:
+    virtual void TearDown()
+    {
+        for (const auto f : {"conversion.cache",
+                             "conversion.cache.idx",
+                             "conversion.cache.tmp",
+                             "conversion.cache.lock"})
+        {
+            std::remove((directory + "/" + f).c_str());
+        }
+        rmdir(directory.c_str());
+    }
+
+    static std::string reportNumber(size_t n)
+    {
+        return "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q" + std::to_string(n);
+    }
+
+    uint64_t dataSize() const
+    {
+        std::ifstream data(directory + "/conversion.cache", std::ios::binary | std::ios::ate);
+        return data.tellg();
+    }
+
+    const std::string directory = "test_conversioncache";
+    const RefDate refDate = RefDate(2020, 6, 4);
+};
+
+TEST_F(ConversionCacheTest, persistent)
+{
+    {
+        ConversionCache cache(directory, "output=basic");
+        std::string output;
+        EXPECT_FALSE(cache.find(report, refDate, output));
+        cache.add(report, refDate, json);
+        EXPECT_TRUE(cache.find(report, refDate, output));
+        EXPECT_EQ(output, json);
+    }
+    ConversionCache cache(directory, "output=basic");
+    std::string output = "[";
+    EXPECT_TRUE(cache.find(report, refDate, output));
+    EXPECT_EQ(output, std::string("[") + json);
+    const auto stats = cache.statistics();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 0u);
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_FALSE(stats.rebuilt);
+}
+
+TEST_F(ConversionCacheTest, key)
+{
+    {
+        ConversionCache cache(directory, "output=basic");
+        cache.add(report, refDate, json);
+        cache.add(report, RefDate(2020, 7, 4), "");
+    }
+    ConversionCache cache(directory, "output=basic;raw");
+    std::string output;
+    EXPECT_FALSE(cache.find(report, refDate, output));
+    cache.add(report, refDate, "raw");
+    EXPECT_TRUE(cache.find(report, refDate, output));
+    EXPECT_EQ(output, "raw");
+    EXPECT_EQ(cache.statistics().entries, 3u);
+    EXPECT_EQ(cache.statistics().misses, 1u);
+}
+
+TEST_F(ConversionCacheTest, refDate)
+{
+    // Same report text with different reference dates, including dates
+    // which only differ in the year or only in the day
+    const RefDate dates[] = {refDate, RefDate(2021, 6, 4), RefDate(2020, 6, 14)};
+    {
+        ConversionCache cache(directory, "output=basic");
+        for (auto i = 0u; i < std::size(dates); i++)
+            cache.add(report, dates[i], std::to_string(i));
+    }
+    ConversionCache cache(directory, "output=basic");
+    for (auto i = 0u; i < std::size(dates); i++)
+    {
+        std::string output;
+        EXPECT_TRUE(cache.find(report, dates[i], output));
+        EXPECT_EQ(output, std::to_string(i));
+    }
+    std::string output;
+    EXPECT_FALSE(cache.find(report, RefDate(2020, 6, 3), output));
+    EXPECT_EQ(cache.statistics().entries, std::size(dates));
+}
+
+TEST_F(ConversionCacheTest, emptyOutput)
+{
+    ConversionCache cache(directory, "output=basic");
+    cache.add(report, refDate, "");
+    std::string output;
+    EXPECT_TRUE(cache.find(report, refDate, output));
+    EXPECT_TRUE(output.empty());
+    EXPECT_FALSE(cache.find(report, RefDate(2020, 6, 5), output));
+}
+
+TEST_F(ConversionCacheTest, manyEntries)
+{
+    const size_t count = 5000;
+    {
+        ConversionCache cache(directory, "output=basic");
+        for (auto i = 0u; i < count; i++)
+            cache.add(reportNumber(i), refDate, std::to_string(i));
+    }
+    ConversionCache cache(directory, "output=basic");
+    for (auto i = 0u; i < count; i++)
+    {
+        std::string output;
+        ASSERT_TRUE(cache.find(reportNumber(i), refDate, output));
+        EXPECT_EQ(output, std::to_string(i));
+    }
+    EXPECT_EQ(cache.statistics().entries, count);
+    EXPECT_EQ(cache.statistics().hits, count);
+}
+
+TEST_F(ConversionCacheTest, tornRecord)
+{
+    {
+        ConversionCache cache(directory, "output=basic");
+        cache.add(report, refDate, json);
+    }
+    // Partially written record, as if the program was terminated
+    {
+        std::ofstream data(directory + "/conversion.cache", std::ios::binary | std::ios::app);
+        data << "METAR EGYP 0412";
+    }
+    ConversionCache cache(directory, "output=basic");
+    EXPECT_TRUE(cache.statistics().rebuilt);
+    std::string output;
+    EXPECT_TRUE(cache.find(report, refDate, output));
+    EXPECT_EQ(output, json);
+    cache.add(reportNumber(1), refDate, "1");
+    output.clear();
+    EXPECT_TRUE(cache.find(reportNumber(1), refDate, output));
+    EXPECT_EQ(output, "1");
+}
+
+TEST_F(ConversionCacheTest, corruptedRecord)
+{
+    {
+        ConversionCache cache(directory, "output=basic");
+        cache.add(reportNumber(1), refDate, "1");
+        cache.add(reportNumber(2), refDate, "2");
+    }
+    const auto size = dataSize();
+    // Damage the output of the last record and the index
+    {
+        std::fstream data(directory + "/conversion.cache",
+                          std::ios::binary | std::ios::in | std::ios::out);
+        data.seekp(size - 8);
+        data << 'x';
+        std::ofstream index(directory + "/conversion.cache.idx", std::ios::binary);
+    }
+    ConversionCache cache(directory, "output=basic");
+    EXPECT_TRUE(cache.statistics().rebuilt);
+    EXPECT_EQ(cache.statistics().entries, 1u);
+    EXPECT_LT(cache.statistics().size, size);
+    std::string output;
+    EXPECT_TRUE(cache.find(reportNumber(1), refDate, output));
+    EXPECT_FALSE(cache.find(reportNumber(2), refDate, output));
+}
+
+TEST_F(ConversionCacheTest, compaction)
+{
+    const uint64_t maxSize = 64 * 1024;
+    {
+        ConversionCache cache(directory, "output=basic", maxSize);
+        for (auto i = 0u; i < 300; i++)
+            cache.add(reportNumber(i), refDate, std::string(100, 'a'));
+    }
+    ConversionCache cache(directory, "output=basic", maxSize);
+    // Entries used in this run are kept by compaction
+    std::string output;
+    for (auto i = 0u; i < 10; i++)
+        ASSERT_TRUE(cache.find(reportNumber(i), refDate, output));
+    for (auto i = 300u; i < 400; i++)
+        cache.add(reportNumber(i), refDate, std::string(100, 'b'));
+    const auto stats = cache.statistics();
+    EXPECT_EQ(stats.compactions, 1u);
+    EXPECT_LE(stats.size, maxSize);
+    for (auto i = 0u; i < 10; i++)
+        EXPECT_TRUE(cache.find(reportNumber(i), refDate, output));
+    EXPECT_TRUE(cache.find(reportNumber(399), refDate, output));
+    EXPECT_TRUE(cache.find(reportNumber(299), refDate, output));
+    EXPECT_FALSE(cache.find(reportNumber(50), refDate, output));
+}
+
+TEST_F(ConversionCacheTest, tooLarge)
+{
+    ConversionCache cache(directory, "output=basic", 1024);
+    cache.add(report, refDate, std::string(1024, 'a'));
+    std::string output;
+    EXPECT_FALSE(cache.find(report, refDate, output));
+    EXPECT_EQ(cache.statistics().added, 0u);
+}
+
+TEST_F(ConversionCacheTest, locked)
+{
+    ConversionCache cache(directory, "output=basic");
+    EXPECT_THROW(ConversionCache(directory, "output=basic"), std::runtime_error);
+}
+
+TEST_F(ConversionCacheTest, invalid)
+{
+    {
+        ConversionCache cache(directory, "output=basic");
+    }
+    {
+        std::ofstream data(directory + "/conversion.cache", std::ios::binary);
+        data << "METAR EGYP 041250Z 24015KT\n";
+    }
+    EXPECT_THROW(ConversionCache(directory, "output=basic"), std::runtime_error);
+}
+
+// Cache keys are stored, so the hash must not change between runs
+TEST(ConversionCache, hash)
+{
+    EXPECT_EQ(util::hash(""), 14695981039346656037ull);
+    EXPECT_EQ(util::hash("a"), 0xaf63dc4c8601ec8cull);
+    EXPECT_NE(util::hash("ab"), util::hash("ba"));
+    EXPECT_EQ(util::hash("b", util::hash("a")), util::hash("ab"));
+}
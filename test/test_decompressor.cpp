@@ -0,0 +1,168 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include <zlib.h>
+
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+static std::string testData(size_t lines)
+{
+    std::string result;
+    for (auto i = 0u; i < lines; i++)
+        result += "METAR EGYP 041250Z 24015KT " + std::to_string(i) + "\n";
+    return result;
+}
+
+// Compress with block size using CompressedOutput
+static std::string compress(const std::string &data,
+                            std::unique_ptr<Compressor> compressor,
+                            size_t blockSize)
+{
+    std::ostringstream out;
+    {
+        CompressedOutput compressed(out, std::move(compressor), 2, blockSize);
+        std::ostream(&compressed) << data;
+    }
+    return out.str();
+}
+
+// Gzip member written by zlib without member size
+static std::string gzipMember(const std::string &data,
+                              int level = Z_DEFAULT_COMPRESSION)
+{
+    z_stream stream{};
+    deflateInit2(&stream, level, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                 Z_DEFAULT_STRATEGY);
+    std::string result(deflateBound(&stream, data.length()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = data.length();
+    stream.next_out = reinterpret_cast<Bytef *>(result.data());
+    stream.avail_out = result.length();
+    EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+    result.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result;
+}
+
+static std::string decompress(const std::string &compressed, std::string *error = nullptr)
+{
+    std::istringstream in(compressed);
+    const auto format = DecompressedInput::detect(in);
+    EXPECT_NE(format, DecompressedInput::Format::NONE);
+    DecompressedInput decompressed(in, format, 4);
+    std::ostringstream out;
+    out << std::istream(&decompressed).rdbuf();
+    if (error)
+        *error = decompressed.error();
+    else
+        EXPECT_EQ(decompressed.error(), "");
+    return out.str();
+}
+
+TEST(DecompressedInput, detect)
+{
+    std::istringstream plain("METAR EGYP 041250Z 24015KT");
+    EXPECT_EQ(DecompressedInput::detect(plain), DecompressedInput::Format::NONE);
+    EXPECT_EQ(plain.tellg(), 0);
+
+    std::istringstream gzip(gzipMember("METAR"));
+    EXPECT_EQ(DecompressedInput::detect(gzip), DecompressedInput::Format::GZIP);
+    EXPECT_EQ(gzip.tellg(), 0);
+
+    std::istringstream zstd(std::string("\x28\xB5\x2F\xFD\x00", 5));
+    EXPECT_EQ(DecompressedInput::detect(zstd), DecompressedInput::Format::ZSTD);
+
+    std::istringstream empty;
+    EXPECT_EQ(DecompressedInput::detect(empty), DecompressedInput::Format::NONE);
+}
+
+TEST(DecompressedInput, gzipMembersParallel)
+{
+    const auto data = testData(10000);
+    EXPECT_EQ(decompress(compress(data, std::make_unique<CompressorGzip>(), 1000)), data);
+}
+
+TEST(DecompressedInput, gzipMembersWithoutSize)
+{
+    const auto data1 = testData(5000);
+    const auto data2 = testData(3);
+    EXPECT_EQ(decompress(gzipMember(data1) + gzipMember(data2)), data1 + data2);
+}
+
+TEST(DecompressedInput, gzipManyMembersWithoutSize)
+{
+    // Members span several input windows
+    const auto data = testData(300000);
+    std::string compressed;
+    for (size_t pos = 0; pos < data.length(); pos += 100000)
+        compressed += gzipMember(data.substr(pos, 100000));
+    EXPECT_EQ(decompress(compressed), data);
+}
+
+TEST(DecompressedInput, gzipSingleMember)
+{
+    const auto data = testData(300000);
+    EXPECT_EQ(decompress(gzipMember(data)), data);
+}
+
+TEST(DecompressedInput, gzipMemberHeaderInData)
+{
+    // Stored member includes member header bytes which are not a member
+    // boundary
+    const auto data1 = testData(10);
+    const auto data2 = testData(30) + gzipMember(testData(20)) + testData(30);
+    const auto data3 = testData(40);
+    const auto compressed = gzipMember(data1) +
+                            gzipMember(data2, Z_NO_COMPRESSION) +
+                            gzipMember(data3);
+    EXPECT_EQ(decompress(compressed), data1 + data2 + data3);
+}
+
+TEST(DecompressedInput, gzipMixedMembers)
+{
+    const auto data1 = testData(100);
+    const auto data2 = testData(200);
+    const auto compressed =
+        compress(data1, std::make_unique<CompressorGzip>(), 1000) + gzipMember(data2);
+    EXPECT_EQ(decompress(compressed), data1 + data2);
+}
+
+TEST(DecompressedInput, gzipTruncated)
+{
+    const auto compressed = gzipMember(testData(1000));
+    std::string error;
+    decompress(compressed.substr(0, compressed.length() / 2), &error);
+    EXPECT_FALSE(error.empty());
+}
+
+TEST(DecompressedInput, gzipMemberTruncated)
+{
+    const auto compressed = compress(testData(1000), std::make_unique<CompressorGzip>(), 1000);
+    std::string error;
+    decompress(compressed.substr(0, compressed.length() - 10), &error);
+    EXPECT_FALSE(error.empty());
+}
+
+TEST(DecompressedInput, notCompressed)
+{
+    std::istringstream in("METAR");
+    EXPECT_THROW(DecompressedInput(in, DecompressedInput::Format::NONE), std::invalid_argument);
+}
+
+#ifdef METAFJSON_ZSTD
+TEST(DecompressedInput, zstd)
+{
+    const auto data = testData(10000);
+    EXPECT_EQ(decompress(compress(data, std::make_unique<CompressorZstd>(), 1000)), data);
+}
+#endif
@@ -0,0 +1,108 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include "deduplicator.hpp"
+
+static const RefDate refDate = RefDate(2020, 6, 4);
+
+static std::vector<std::string> deduplicate(Deduplicator &deduplicator,
+                                            const std::vector<std::string> &reports)
+{
+    std::vector<std::string> result;
+    const auto output = [&](const std::string &report, const RefDate &, size_t) {
+        result.push_back(report);
+    };
+    for (auto i = 0u; i < reports.size(); i++)
+        deduplicator.add(reports[i], refDate, i + 1, output);
+    deduplicator.finish(output);
+    return result;
+}
+
+TEST(Deduplicator, duplicates)
+{
+    Deduplicator deduplicator;
+    const auto result = deduplicate(deduplicator, {
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009",
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009",
+        "METAR  EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009=",
+        "SPECI EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009",
+        "METAR EGYP 041320Z 24015KT 9999 BKN008 15/13 Q1009",
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009"});
+    EXPECT_EQ(result, (std::vector<std::string>{
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009",
+        "SPECI EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009",
+        "METAR EGYP 041320Z 24015KT 9999 BKN008 15/13 Q1009"}));
+    EXPECT_EQ(deduplicator.statistics().reports, 6u);
+    EXPECT_EQ(deduplicator.statistics().duplicates, 3u);
+    EXPECT_EQ(deduplicator.statistics().corrections, 0u);
+}
+
+TEST(Deduplicator, correction)
+{
+    Deduplicator deduplicator;
+    const auto result = deduplicate(deduplicator, {
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009",
+        "METAR EGLL 041250Z 24005KT CAVOK 20/10 Q1015",
+        "METAR COR EGYP 041250Z 24015KT 9999 BKN008 15/12 Q1009",
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009"});
+    EXPECT_EQ(result, (std::vector<std::string>{
+        "METAR COR EGYP 041250Z 24015KT 9999 BKN008 15/12 Q1009",
+        "METAR EGLL 041250Z 24005KT CAVOK 20/10 Q1015"}));
+    EXPECT_EQ(deduplicator.statistics().duplicates, 1u);
+    EXPECT_EQ(deduplicator.statistics().corrections, 1u);
+}
+
+TEST(Deduplicator, correctionFirst)
+{
+    Deduplicator deduplicator;
+    const auto result = deduplicate(deduplicator, {
+        "METAR EGYP 041250Z COR 24015KT 9999 BKN008 15/12 Q1009",
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009"});
+    EXPECT_EQ(result, std::vector<std::string>{
+        "METAR EGYP 041250Z COR 24015KT 9999 BKN008 15/12 Q1009"});
+    EXPECT_EQ(deduplicator.statistics().corrections, 1u);
+}
+
+TEST(Deduplicator, delay)
+{
+    Deduplicator deduplicator(Deduplicator::defaultMemoryLimit, 1);
+    const auto result = deduplicate(deduplicator, {
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009",
+        "METAR EGLL 041250Z 24005KT CAVOK 20/10 Q1015",
+        "METAR COR EGYP 041250Z 24015KT 9999 BKN008 15/12 Q1009"});
+    // Correction follows the original report after the delay
+    EXPECT_EQ(result, (std::vector<std::string>{
+        "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009",
+        "METAR EGLL 041250Z 24005KT CAVOK 20/10 Q1015",
+        "METAR COR EGYP 041250Z 24015KT 9999 BKN008 15/12 Q1009"}));
+    EXPECT_EQ(deduplicator.statistics().corrections, 0u);
+}
+
+TEST(Deduplicator, noKey)
+{
+    Deduplicator deduplicator;
+    const auto result = deduplicate(deduplicator, {"GARBAGE", "GARBAGE"});
+    EXPECT_EQ(result, (std::vector<std::string>{"GARBAGE", "GARBAGE"}));
+}
+
+TEST(Deduplicator, memoryLimit)
+{
+    // Only the fingerprints of the recent reports are kept
+    Deduplicator deduplicator(64 * 1024, 0);
+    std::vector<std::string> reports;
+    for (auto i = 0u; i < 20000; i++)
+        reports.push_back("METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q" + std::to_string(i));
+    reports.push_back(reports.back());
+    reports.push_back(reports.front());
+    const auto result = deduplicate(deduplicator, reports);
+    EXPECT_EQ(result.size(), 20001u);
+    EXPECT_EQ(result.back(), reports.front());
+    EXPECT_EQ(deduplicator.statistics().duplicates, 1u);
+}
@@ -0,0 +1,102 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "encoder.hpp"
+
+#include "nlohmann/json.hpp"
+
+static const nlohmann::json testReport = {
+    {"report", {{"type", "metar"}}},
+    {"groups", {{{"group", "icao_location"}, {"location", "EGYP"}},
+                {{"group", "wind"}, {"type", "surface_wind"}}}}};
+
+// Reads length-prefixed frames from string
+static std::vector<std::string> readFrames(const std::string &s)
+{
+    std::vector<std::string> result;
+    size_t pos = 0;
+    while (pos + 4 <= s.length())
+    {
+        const auto length =
+            (static_cast<uint32_t>(static_cast<unsigned char>(s[pos])) << 24) |
+            (static_cast<uint32_t>(static_cast<unsigned char>(s[pos + 1])) << 16) |
+            (static_cast<uint32_t>(static_cast<unsigned char>(s[pos + 2])) << 8) |
+            static_cast<uint32_t>(static_cast<unsigned char>(s[pos + 3]));
+        pos += 4;
+        result.push_back(s.substr(pos, length));
+        pos += length;
+    }
+    EXPECT_EQ(pos, s.length());
+    return result;
+}
+
+TEST(Encoder, json) {
+    std::ostringstream out;
+    const EncoderJson encoder;
+    encoder.write(testReport, out);
+    encoder.write(testReport, out);
+    EXPECT_EQ(out.str(), testReport.dump() + "\n" + testReport.dump() + "\n");
+}
+
+TEST(Encoder, cbor) {
+    std::ostringstream out;
+    const EncoderCbor encoder;
+    encoder.write(testReport, out);
+    encoder.write(nlohmann::json::object(), out);
+    const auto frames = readFrames(out.str());
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(nlohmann::json::from_cbor(frames[0]), testReport);
+    EXPECT_EQ(nlohmann::json::from_cbor(frames[1]), nlohmann::json::object());
+}
+
+TEST(Encoder, msgpack) {
+    std::ostringstream out;
+    const EncoderMsgpack encoder;
+    encoder.write(testReport, out);
+    encoder.write(testReport, out);
+    const auto frames = readFrames(out.str());
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(nlohmann::json::from_msgpack(frames[0]), testReport);
+    EXPECT_EQ(nlohmann::json::from_msgpack(frames[1]), testReport);
+    EXPECT_LT(frames[0].length(), testReport.dump().length());
+}
+
+TEST(Encoder, begin) {
+    // Report written to the writer is the same in all encodings
+    const auto writeReport = [](const Encoder &encoder, std::ostream &out) {
+        auto &writer = encoder.begin();
+        writer.beginObject();
+        writer.member("location", "EGYP");
+        writer.key("wind");
+        writer.beginArray();
+        writer.value(240);
+        writer.value(15.5);
+        writer.value(nullptr);
+        writer.endArray();
+        writer.endObject();
+        encoder.end(out);
+    };
+    const nlohmann::json expected = {
+        {"location", "EGYP"}, {"wind", {240, 15.5, nullptr}}};
+
+    std::ostringstream jsonOut, cborOut, msgpackOut;
+    writeReport(EncoderJson(), jsonOut);
+    writeReport(EncoderCbor(), cborOut);
+    writeReport(EncoderMsgpack(), msgpackOut);
+    EXPECT_EQ(jsonOut.str(), expected.dump() + "\n");
+    const auto cborFrames = readFrames(cborOut.str());
+    ASSERT_EQ(cborFrames.size(), 1u);
+    EXPECT_EQ(nlohmann::json::from_cbor(cborFrames[0]), expected);
+    const auto msgpackFrames = readFrames(msgpackOut.str());
+    ASSERT_EQ(msgpackFrames.size(), 1u);
+    EXPECT_EQ(nlohmann::json::from_msgpack(msgpackFrames[0]), expected);
+}
@@ -0,0 +1,158 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include "metaf.hpp"
+#include "eventdetector.hpp"
+
+using Event = EventDetector::Event;
+using FlightCategory = EventDetector::FlightCategory;
+using Weather = EventDetector::Weather;
+
+static const RefDate refDate = RefDate(2020, 6, 4);
+
+static std::vector<Event> detect(EventDetector &detector, const std::string &report)
+{
+    EventDetector::Result result;
+    EXPECT_TRUE(detector.detect(metaf::Parser::parse(report), refDate, result));
+    return result.events;
+}
+
+TEST(EventDetector, flightCategory)
+{
+    EventDetector detector;
+    EXPECT_TRUE(detect(detector, "METAR EGYP 041250Z 24015KT 9999 FEW030 15/13 Q1009").empty());
+
+    auto events = detect(detector, "METAR EGYP 041320Z 24015KT 4000 BKN008 15/13 Q1009");
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].type, Event::Type::FLIGHT_CATEGORY);
+    EXPECT_EQ(events[0].from, FlightCategory::VFR);
+    EXPECT_EQ(events[0].to, FlightCategory::IFR);
+
+    events = detect(detector, "SPECI EGYP 041335Z 24015KT 0800 FG OVC002 15/13 Q1009");
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].from, FlightCategory::IFR);
+    EXPECT_EQ(events[0].to, FlightCategory::LIFR);
+
+    EXPECT_TRUE(detect(detector, "METAR EGYP 041350Z 24015KT 0600 FG VV001 15/13 Q1009").empty());
+
+    events = detect(detector, "METAR EGYP 041420Z 24015KT CAVOK 15/13 Q1009");
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].from, FlightCategory::LIFR);
+    EXPECT_EQ(events[0].to, FlightCategory::VFR);
+}
+
+TEST(EventDetector, gust)
+{
+    EventDetector detector;
+    EXPECT_TRUE(detect(detector, "METAR EGLL 041250Z 24015KT 9999 FEW030 15/13 Q1009").empty());
+
+    auto events = detect(detector, "METAR EGLL 041320Z 24020G38KT 9999 FEW030 15/13 Q1009");
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].type, Event::Type::GUST_ABOVE);
+    EXPECT_EQ(events[0].threshold, 25u);
+    EXPECT_EQ(events[1].type, Event::Type::GUST_ABOVE);
+    EXPECT_EQ(events[1].threshold, 35u);
+    ASSERT_TRUE(events[1].gust.has_value());
+    EXPECT_NEAR(*events[1].gust, 38.0, 0.01);
+
+    events = detect(detector, "METAR EGLL 041350Z 24020G30KT 9999 FEW030 15/13 Q1009");
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].type, Event::Type::GUST_BELOW);
+    EXPECT_EQ(events[0].threshold, 35u);
+
+    events = detect(detector, "METAR EGLL 041420Z 24015KT 9999 FEW030 15/13 Q1009");
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].type, Event::Type::GUST_BELOW);
+    EXPECT_EQ(events[0].threshold, 25u);
+    EXPECT_FALSE(events[0].gust.has_value());
+}
+
+TEST(EventDetector, gustThresholds)
+{
+    EventDetector detector({40, 20, 20});
+    detect(detector, "METAR EGLL 041250Z 24015KT 9999 FEW030 15/13 Q1009");
+    const auto events = detect(detector, "METAR EGLL 041320Z 24020G30KT 9999 FEW030 15/13 Q1009");
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].threshold, 20u);
+
+    std::vector<unsigned> thresholds;
+    for (auto i = 0u; i <= EventDetector::maxGustThresholds; i++)
+        thresholds.push_back(10 + i);
+    EXPECT_THROW(EventDetector{thresholds}, std::invalid_argument);
+}
+
+TEST(EventDetector, weather)
+{
+    EventDetector detector;
+    EXPECT_TRUE(detect(detector, "METAR EGLL 041250Z 24015KT 9999 -RA FEW030CB 15/13 Q1009").empty());
+
+    auto events = detect(detector, "METAR EGLL 041320Z 24015KT 9999 TSRA FEW030CB 15/13 Q1009");
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].type, Event::Type::ONSET);
+    EXPECT_EQ(events[0].weather, Weather::TS);
+
+    events = detect(detector, "METAR EGLL 041350Z 24015KT 9999 -FZRA SN FEW030 01/M01 Q1009");
+    ASSERT_EQ(events.size(), 3u);
+    EXPECT_EQ(events[0].type, Event::Type::CESSATION);
+    EXPECT_EQ(events[0].weather, Weather::TS);
+    EXPECT_EQ(events[1].type, Event::Type::ONSET);
+    EXPECT_EQ(events[1].weather, Weather::FZRA);
+    EXPECT_EQ(events[2].type, Event::Type::ONSET);
+    EXPECT_EQ(events[2].weather, Weather::SN);
+
+    // Weather in vicinity and blowing snow are not tracked
+    events = detect(detector, "METAR EGLL 041420Z 24015KT 9999 VCTS BLSN FEW030 01/M01 Q1009");
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].type, Event::Type::CESSATION);
+    EXPECT_EQ(events[0].weather, Weather::FZRA);
+    EXPECT_EQ(events[1].type, Event::Type::CESSATION);
+    EXPECT_EQ(events[1].weather, Weather::SN);
+}
+
+TEST(EventDetector, trendsAndRemarks)
+{
+    EventDetector detector;
+    detect(detector, "METAR EGLL 041250Z 24015KT 9999 FEW030 15/13 Q1009");
+    const auto events = detect(detector, "METAR EGLL 041320Z 24015KT 9999 FEW030 15/13 Q1009"
+                                         " TEMPO 24030G45KT 2000 TSRA BKN005CB");
+    EXPECT_TRUE(events.empty());
+}
+
+TEST(EventDetector, notReported)
+{
+    EventDetector detector;
+    detect(detector, "METAR EGYP 041250Z 24015G30KT 9999 FEW030 15/13 Q1009");
+    EXPECT_TRUE(detect(detector, "METAR EGYP 041320Z /////KT //// ////// 15/13 Q1009").empty());
+    const auto events = detect(detector, "METAR EGYP 041350Z 24015G30KT 4000 BKN008 15/13 Q1009");
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].from, FlightCategory::VFR);
+    EXPECT_EQ(events[0].to, FlightCategory::IFR);
+}
+
+TEST(EventDetector, skipped)
+{
+    EventDetector detector;
+    EventDetector::Result result;
+    const auto metar = metaf::Parser::parse("METAR EGYP 041320Z 24015KT 9999 FEW030 15/13 Q1009");
+    EXPECT_TRUE(detector.detect(metar, refDate, result));
+    EXPECT_EQ(result.station, "EGYP");
+
+    const auto older = metaf::Parser::parse("METAR EGYP 041250Z 24015KT 4000 BKN008 15/13 Q1009");
+    EXPECT_FALSE(detector.detect(older, refDate, result));
+    const auto taf = metaf::Parser::parse("TAF EGYP 041100Z 0412/0512 24015KT 4000 BKN008");
+    EXPECT_FALSE(detector.detect(taf, refDate, result));
+    const auto nil = metaf::Parser::parse("METAR EGYP 041350Z NIL");
+    EXPECT_FALSE(detector.detect(nil, refDate, result));
+    EXPECT_TRUE(result.events.empty());
+
+    const auto other = metaf::Parser::parse("METAR EGLL 041250Z 24015KT 4000 BKN008 15/13 Q1009");
+    EXPECT_TRUE(detector.detect(other, refDate, result));
+    EXPECT_EQ(detector.size(), 2u);
+}
@@ -0,0 +1,110 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+
+#include "filterexpression.hpp"
+#include "metaf.hpp"
+
+static bool matches(const char *expression, const char *report)
+{
+    return FilterExpression(expression).matches(metaf::Parser::parse(report));
+}
+
+static const char metarWind[] = "METAR EGYP 041250Z 22030G45KT 9999 FEW020 BKN035 12/08 Q1013";
+static const char metarTs[] = "METAR UKLL 041300Z 27008MPS 1200 +TSRA BR OVC008CB 18/17 Q1002";
+static const char metarVicinity[] = "METAR EGYP 041350Z 00000KT 9999 VCTS SCT030CB 15/12 Q1008 RETSRA";
+
+// Comparisons
+
+TEST(FilterExpression, windSpeed) {
+    EXPECT_TRUE(matches("wind_speed > 25", metarWind));
+    EXPECT_TRUE(matches("wind_speed >= 30 kt", metarWind));
+    EXPECT_FALSE(matches("wind_speed > 30 kt", metarWind));
+    EXPECT_TRUE(matches("wind speed = 30kt", metarWind));
+    EXPECT_TRUE(matches("gust_speed > 40 kt", metarWind));
+    EXPECT_FALSE(matches("gust_speed > 40 kt", metarTs));
+    // Calm wind is surface wind
+    EXPECT_TRUE(matches("wind_speed < 5", metarVicinity));
+}
+
+TEST(FilterExpression, unitConversion) {
+    EXPECT_TRUE(matches("wind_speed > 15 kt", metarTs));
+    EXPECT_TRUE(matches("wind_speed = 8 mps", metarTs));
+    EXPECT_TRUE(matches("visibility < 1 sm", metarTs));
+    EXPECT_FALSE(matches("visibility < 1 km", metarWind));
+    // CAVOK is visibility of 10 km
+    EXPECT_TRUE(matches("visibility >= 10 km", "METAR EGYP 041250Z 24015KT CAVOK 15/10 Q1013"));
+    EXPECT_TRUE(matches("temperature > 50 f", metarWind));
+    EXPECT_TRUE(matches("temperature > -5 c", metarWind));
+}
+
+TEST(FilterExpression, ceiling) {
+    EXPECT_TRUE(matches("ceiling = 3500", metarWind));
+    EXPECT_TRUE(matches("ceiling < 1000 ft", metarTs));
+    EXPECT_FALSE(matches("ceiling < 1000 ft", metarWind));
+    EXPECT_TRUE(matches("cloud_height < 2500 ft", metarWind));
+}
+
+TEST(FilterExpression, pressure) {
+    EXPECT_TRUE(matches("pressure < 1005", metarTs));
+    EXPECT_FALSE(matches("qnh < 1005 hpa", metarWind));
+}
+
+// Weather phenomena
+
+TEST(FilterExpression, weather) {
+    EXPECT_TRUE(matches("weather contains TS", metarTs));
+    EXPECT_TRUE(matches("weather contains TSRA", metarTs));
+    EXPECT_TRUE(matches("weather contains +TSRA", metarTs));
+    EXPECT_FALSE(matches("weather contains -TSRA", metarTs));
+    EXPECT_TRUE(matches("weather contains BR", metarTs));
+    EXPECT_FALSE(matches("weather contains FZRA", metarTs));
+    EXPECT_FALSE(matches("weather contains TS", metarWind));
+}
+
+TEST(FilterExpression, weatherVicinityRecent) {
+    // Weather in vicinity and recent weather only match if named
+    EXPECT_FALSE(matches("weather contains TS", metarVicinity));
+    EXPECT_TRUE(matches("weather contains VCTS", metarVicinity));
+    EXPECT_FALSE(matches("weather contains TSRA", metarVicinity));
+    EXPECT_TRUE(matches("weather contains RETSRA", metarVicinity));
+    EXPECT_TRUE(matches("weather contains RERA", metarVicinity));
+    EXPECT_FALSE(matches("weather contains VCTS", metarTs));
+}
+
+// Logical operations
+
+TEST(FilterExpression, logical) {
+    const char expression[] = "wind speed > 25 kt or visibility < 1600 m or weather contains TS";
+    EXPECT_TRUE(matches(expression, metarWind));
+    EXPECT_TRUE(matches(expression, metarTs));
+    EXPECT_FALSE(matches(expression, "METAR EGYP 041250Z 22010KT 9999 FEW020 12/08 Q1013"));
+
+    EXPECT_FALSE(matches("wind_speed > 25 and weather contains TS", metarWind));
+    EXPECT_TRUE(matches("not weather contains TS", metarWind));
+    EXPECT_TRUE(matches("!(wind_speed > 25 && weather contains TS)", metarWind));
+    EXPECT_TRUE(matches("(wind_speed > 35 || gust_speed > 35) && temperature > 10", metarWind));
+}
+
+// Syntax errors
+
+TEST(FilterExpression, syntaxErrors) {
+    EXPECT_THROW(FilterExpression(""), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("wind_speed >"), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("wind_speed 25"), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("other > 25"), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("wind_speed > 25 m"), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("(wind_speed > 25"), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("wind_speed > 25 kt visibility < 1600"), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("weather contains XX"), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("weather is TS"), std::invalid_argument);
+    EXPECT_THROW(FilterExpression("wind_speed > 25 # 1"), std::invalid_argument);
+}
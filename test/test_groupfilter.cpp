@@ -0,0 +1,59 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+
+#include "groupfilter.hpp"
+#include "metaf.hpp"
+
+TEST(GroupFilter, all) {
+    const GroupFilter filter;
+    EXPECT_TRUE(filter.includesAll());
+    for (auto i = 0u; i < std::variant_size_v<metaf::Group>; i++)
+        EXPECT_TRUE(filter.includes(i));
+}
+
+TEST(GroupFilter, list) {
+    const GroupFilter filter("wind,Visibility,cloud");
+    EXPECT_FALSE(filter.includesAll());
+    EXPECT_TRUE(filter.includes(*GroupFilter::groupKind("wind")));
+    EXPECT_TRUE(filter.includes(*GroupFilter::groupKind("visibility")));
+    EXPECT_TRUE(filter.includes(*GroupFilter::groupKind("cloud")));
+    EXPECT_FALSE(filter.includes(*GroupFilter::groupKind("weather")));
+    EXPECT_FALSE(filter.includes(*GroupFilter::groupKind("keyword")));
+    EXPECT_FALSE(filter.includes(*GroupFilter::groupKind("unknown")));
+}
+
+TEST(GroupFilter, parsedReport) {
+    const auto result = metaf::Parser::parse("METAR EGYP 041250Z 22010KT 9999 FEW020");
+    const GroupFilter filter("wind");
+    auto count = 0u;
+    for (const auto &groupInfo : result.groups)
+        if (filter.includes(groupInfo.group.index()))
+            count++;
+    EXPECT_EQ(count, 1u);
+}
+
+TEST(GroupFilter, names) {
+    for (auto i = 0u; i < std::variant_size_v<metaf::Group>; i++)
+    {
+        const auto name = GroupFilter::groupName(i);
+        EXPECT_FALSE(name.empty());
+        EXPECT_EQ(GroupFilter::groupKind(name), i);
+    }
+    EXPECT_EQ(GroupFilter::groupKind("location"), GroupFilter::groupKind("icao_location"));
+    EXPECT_FALSE(GroupFilter::groupKind("other").has_value());
+}
+
+TEST(GroupFilter, invalid) {
+    EXPECT_THROW(GroupFilter("wind,other"), std::invalid_argument);
+    EXPECT_THROW(GroupFilter(""), std::invalid_argument);
+    EXPECT_THROW(GroupFilter(","), std::invalid_argument);
+}
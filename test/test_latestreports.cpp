@@ -0,0 +1,60 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include "latestreports.hpp"
+
+static const RefDate refDate = RefDate(2020, 6, 4);
+
+static std::vector<std::string> flush(LatestReports &latestReports)
+{
+    std::vector<std::string> result;
+    latestReports.flush([&](const std::string &report, const RefDate &) {
+        result.push_back(report);
+    });
+    return result;
+}
+
+TEST(LatestReports, newest)
+{
+    LatestReports latestReports;
+    EXPECT_TRUE(latestReports.add("METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009", refDate));
+    EXPECT_TRUE(latestReports.add("TAF EGYP 041100Z 0412/0512 24015KT 9999 BKN008", refDate));
+    EXPECT_TRUE(latestReports.add("METAR EGLL 041220Z 24005KT CAVOK 20/10 Q1015", refDate));
+    EXPECT_TRUE(latestReports.add("SPECI EGYP 041310Z 24025KT 9999 BKN008 15/13 Q1009", refDate));
+    EXPECT_FALSE(latestReports.add("METAR EGYP 041220Z 24015KT 9999 BKN008 15/13 Q1009", refDate));
+    EXPECT_FALSE(latestReports.add("GARBAGE", refDate));
+    EXPECT_EQ(latestReports.size(), 3u);
+    EXPECT_EQ(flush(latestReports), (std::vector<std::string>{
+        "METAR EGLL 041220Z 24005KT CAVOK 20/10 Q1015",
+        "SPECI EGYP 041310Z 24025KT 9999 BKN008 15/13 Q1009",
+        "TAF EGYP 041100Z 0412/0512 24015KT 9999 BKN008"}));
+}
+
+TEST(LatestReports, sameTime)
+{
+    LatestReports latestReports;
+    latestReports.add("METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009", refDate);
+    EXPECT_TRUE(latestReports.add("METAR COR EGYP 041250Z 24015KT 9999 BKN008 15/12 Q1009", refDate));
+    EXPECT_EQ(flush(latestReports), std::vector<std::string>{
+        "METAR COR EGYP 041250Z 24015KT 9999 BKN008 15/12 Q1009"});
+}
+
+TEST(LatestReports, updated)
+{
+    LatestReports latestReports;
+    latestReports.add("METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009", refDate);
+    latestReports.add("METAR EGLL 041220Z 24005KT CAVOK 20/10 Q1015", refDate);
+    EXPECT_EQ(flush(latestReports).size(), 2u);
+    EXPECT_TRUE(flush(latestReports).empty());
+    latestReports.add("METAR EGLL 041250Z 24005KT CAVOK 20/10 Q1015", refDate);
+    latestReports.add("METAR EGLL 041320Z 24005KT CAVOK 20/10 Q1015", refDate);
+    EXPECT_EQ(flush(latestReports), std::vector<std::string>{
+        "METAR EGLL 041320Z 24005KT CAVOK 20/10 Q1015"});
+}
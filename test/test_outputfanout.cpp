@@ -0,0 +1,113 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "outputfanout.hpp"
+#include "outputformatbasic.hpp"
+#include "outputformatcsv.hpp"
+
+static const std::vector<std::string> reports = {
+    "METAR EGYP 041250Z 24015G25KT 1 1/2SM -RA BKN008 OVC015 15/13 Q1009",
+    "METAR EGYP 041350Z 24012KT 9999 SCT012 15/12 Q1010",
+    "TAF EGYP 041100Z 0412/0512 24015KT 9999 SCT020 TEMPO 0414/0418 4000 SHRA",
+    "METAR KJFK 041251Z VRB03KT 10SM FEW250 24/14 A3002 RMK AO2",
+    "GARBAGE"};
+
+static std::unique_ptr<const OutputFormat> makeBasic(bool rawStrings)
+{
+    return std::make_unique<OutputFormatBasic>(
+        std::make_unique<DateTimeFormatBasic>(),
+        std::make_unique<ValueFormatBasic>(),
+        rawStrings,
+        2020, 6, 4);
+}
+
+static std::unique_ptr<const OutputFormat> makeCsv()
+{
+    return std::make_unique<OutputFormatCsv>(
+        std::make_unique<DateTimeFormatBasic>(),
+        std::make_unique<ValueFormatBasic>(),
+        2020, 6, 4,
+        nullptr,
+        "station,time,wind_kt,vis_m");
+}
+
+// Output of the format serialising the reports one by one
+static std::string serialise(std::unique_ptr<const OutputFormat> format, size_t repeat)
+{
+    std::ostringstream out;
+    for (auto i = 0u; i < repeat; i++)
+        for (const auto &r : reports)
+            format->toJson(r, RefDate(2020, 6, 4), out);
+    format->finish(out);
+    return out.str();
+}
+
+TEST(OutputFanOut, sameAsSingleOutput)
+{
+    const size_t repeat = 20;
+    std::ostringstream basic, raw, csv;
+    OutputFanOut fanOut(3, 7);
+    fanOut.addOutput(makeBasic(false), basic);
+    fanOut.addOutput(makeBasic(true), raw);
+    fanOut.addOutput(makeCsv(), csv);
+    for (auto i = 0u; i < repeat; i++)
+        for (const auto &r : reports)
+            fanOut.add(r, RefDate(2020, 6, 4), metaf::Parser::parse(r));
+    fanOut.finish();
+    EXPECT_EQ(basic.str(), serialise(makeBasic(false), repeat));
+    EXPECT_EQ(raw.str(), serialise(makeBasic(true), repeat));
+    EXPECT_EQ(csv.str(), serialise(makeCsv(), repeat));
+}
+
+TEST(OutputFanOut, noReports)
+{
+    std::ostringstream basic, csv;
+    OutputFanOut fanOut(2);
+    fanOut.addOutput(makeBasic(false), basic);
+    fanOut.addOutput(makeCsv(), csv);
+    fanOut.finish();
+    EXPECT_TRUE(basic.str().empty());
+    EXPECT_EQ(csv.str(), serialise(makeCsv(), 0));
+}
+
+TEST(OutputFanOut, addOutputAfterReports)
+{
+    std::ostringstream basic, raw;
+    OutputFanOut fanOut(2);
+    fanOut.addOutput(makeBasic(false), basic);
+    fanOut.add(reports[0], RefDate(2020, 6, 4), metaf::Parser::parse(reports[0]));
+    EXPECT_THROW(fanOut.addOutput(makeBasic(true), raw), std::logic_error);
+}
+
+TEST(OutputFile, write)
+{
+    const std::string fileName = "test_outputfanout.json";
+    {
+        OutputFile file(fileName);
+        EXPECT_EQ(file.name(), fileName);
+        file << "METAR EGYP 041250Z 24015KT\n";
+        EXPECT_TRUE(file.finish());
+    }
+    std::ifstream in(fileName, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(fileName.c_str());
+    EXPECT_EQ(data, "METAR EGYP 041250Z 24015KT\n");
+}
+
+TEST(OutputFile, cannotOpen)
+{
+    EXPECT_THROW(OutputFile file("nonexistent/test_outputfanout.json"), std::runtime_error);
+}
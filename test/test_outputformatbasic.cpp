@@ -0,0 +1,156 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "nlohmann/json.hpp"
+#include "outputformatbasic.hpp"
+#include "groupfilter.hpp"
+
+static std::unique_ptr<OutputFormatBasic> makeBasic(bool tuples, 
+                                                    bool compact = false)
+{
+    return std::make_unique<OutputFormatBasic>(
+        std::make_unique<DateTimeFormatBasic>(),
+        std::make_unique<ValueFormatBasic>(),
+        false,
+        2020, 6, 4,
+        GroupFilter(),
+        nullptr,
+        nullptr,
+        tuples,
+        compact);
+}
+
+TEST(OutputFormatBasic, tupleSchema)
+{
+    const auto schema = OutputFormatBasic::tupleSchema();
+    ASSERT_TRUE(schema.contains("schema"));
+    for (const auto &[name, fields] : schema["schema"].items())
+    {
+        EXPECT_TRUE(GroupFilter::groupKind(name).has_value()) << name;
+        ASSERT_TRUE(fields.is_array());
+        EXPECT_EQ(fields.back(), "raw_string");
+    }
+    EXPECT_EQ(schema["schema"]["wind"][0], "type");
+    EXPECT_EQ(schema["schema"]["wind"][1], "direction");
+}
+
+TEST(OutputFormatBasic, tuples)
+{
+    std::ostringstream out;
+    const auto basic = makeBasic(true);
+    basic->start(out);
+    basic->toJson("METAR EGYP 041250Z 24015KT", out);
+    basic->toJson("METAR EGYP 041350Z 24016KT", out);
+
+    std::istringstream in(out.str());
+    std::string line;
+    ASSERT_TRUE(std::getline(in, line));
+    EXPECT_EQ(nlohmann::json::parse(line), OutputFormatBasic::tupleSchema());
+
+    ASSERT_TRUE(std::getline(in, line));
+    const auto report = nlohmann::json::parse(line);
+    const auto &groups = report["groups"];
+    ASSERT_EQ(groups.size(), 4u);
+    EXPECT_EQ(groups[0], (nlohmann::json{"keyword", "metar"}));
+    EXPECT_EQ(groups[1][0], "icao_location");
+    EXPECT_EQ(groups[1][1], "EGYP");
+    const auto &wind = groups[3];
+    ASSERT_EQ(wind.size(), 5u);
+    EXPECT_EQ(wind[0], "wind");
+    EXPECT_EQ(wind[1], "surface_wind");
+    EXPECT_TRUE(wind[2].is_object());
+    EXPECT_TRUE(wind[3].is_object());
+    // Gust speed is not reported
+    EXPECT_TRUE(wind[4].is_null());
+
+    // Schema is written only at start
+    ASSERT_TRUE(std::getline(in, line));
+    EXPECT_FALSE(nlohmann::json::parse(line).contains("schema"));
+    EXPECT_FALSE(std::getline(in, line));
+}
+
+TEST(OutputFormatBasic, startWithoutTuples)
+{
+    std::ostringstream out;
+    makeBasic(false)->start(out);
+    EXPECT_TRUE(out.str().empty());
+}
+
+TEST(OutputFormatBasic, compact)
+{
+    std::ostringstream out;
+    makeBasic(false)->toJson("METAR EGYP 041250Z 24015KT", out);
+    const auto wind = nlohmann::json::parse(out.str())["groups"][3];
+    ASSERT_TRUE(wind.contains("gust_speed"));
+    EXPECT_TRUE(wind["gust_speed"].is_null());
+
+    std::ostringstream outCompact;
+    makeBasic(false, true)->toJson("METAR EGYP 041250Z 24015KT", outCompact);
+    const auto windCompact = nlohmann::json::parse(outCompact.str())["groups"][3];
+    EXPECT_FALSE(windCompact.contains("gust_speed"));
+    EXPECT_EQ(windCompact["wind_speed"], wind["wind_speed"]);
+}
+
+TEST(OutputFormatBasic, delta)
+{
+    std::ostringstream out;
+    OutputFormatBasic::Delta delta(makeBasic(false));
+    delta.toJson("METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009", RefDate(2020, 6, 4), out);
+    delta.toJson("METAR EGYP 041320Z 24015KT 9999 BKN010 15/13 Q1009", RefDate(2020, 6, 4), out);
+    delta.toJson("TAF EGYP 041100Z 0412/0512 24015KT 9999 BKN008", RefDate(2020, 6, 4), out);
+    delta.toJson("METAR EGLL 041320Z 24005KT CAVOK 20/10 Q1015", RefDate(2020, 6, 4), out);
+    delta.toJson("METAR EGYP 041350Z 24015KT 9999 -RA BKN010 15/13 Q1009", RefDate(2020, 6, 4), out);
+    delta.toJson("METAR EGYP 041420Z 24015KT 9999 BKN010 15/13", RefDate(2020, 6, 4), out);
+
+    std::istringstream in(out.str());
+    std::vector<nlohmann::json> reports;
+    for (std::string line; std::getline(in, line); )
+        reports.push_back(nlohmann::json::parse(line));
+    ASSERT_EQ(reports.size(), 6u);
+
+    // First report of each station and report type is serialised in full
+    ASSERT_TRUE(reports[0].contains("groups"));
+    EXPECT_EQ(reports[0]["groups"].size(), 8u);
+    EXPECT_FALSE(reports[0].contains("delta"));
+    EXPECT_TRUE(reports[2].contains("groups"));
+    EXPECT_TRUE(reports[3].contains("groups"));
+
+    // Only changed fields of report time and cloud groups are included
+    const auto &first = reports[1];
+    EXPECT_FALSE(first.contains("groups"));
+    EXPECT_EQ(first["report"], (nlohmann::json{{"type", "metar"}}));
+    EXPECT_EQ(first["delta"]["location"], "EGYP");
+    EXPECT_TRUE(first["delta"]["removed"].empty());
+    EXPECT_TRUE(first["delta"]["added"].empty());
+    const auto &changed = first["delta"]["changed"];
+    ASSERT_EQ(changed.size(), 2u);
+    EXPECT_EQ(changed[0]["index"], 2);
+    EXPECT_EQ(changed[0]["fields"].size(), 1u);
+    EXPECT_TRUE(changed[0]["fields"].contains("report_time"));
+    EXPECT_EQ(changed[1]["index"], 5);
+    ASSERT_EQ(changed[1]["fields"].size(), 1u);
+    EXPECT_TRUE(changed[1]["fields"].contains("height"));
+
+    // Delta is from the previous report of the same station and type
+    const auto &second = reports[4];
+    EXPECT_TRUE(second["delta"]["removed"].empty());
+    ASSERT_EQ(second["delta"]["added"].size(), 1u);
+    EXPECT_EQ(second["delta"]["added"][0]["index"], 5);
+    EXPECT_EQ(second["delta"]["added"][0]["group"]["group"], "weather");
+    ASSERT_EQ(second["delta"]["changed"].size(), 1u);
+    EXPECT_EQ(second["delta"]["changed"][0]["index"], 2);
+
+    // Removed groups are indices in the previous report
+    const auto &third = reports[5];
+    EXPECT_EQ(third["delta"]["removed"], (nlohmann::json{5, 8}));
+    EXPECT_TRUE(third["delta"]["added"].empty());
+}
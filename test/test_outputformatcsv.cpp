@@ -0,0 +1,85 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "outputformatcsv.hpp"
+
+static std::unique_ptr<OutputFormatCsv> makeCsv(std::string_view columns,
+                                                char separator = ',')
+{
+    return std::make_unique<OutputFormatCsv>(
+        std::make_unique<DateTimeFormatBasic>(),
+        std::make_unique<ValueFormatBasic>(),
+        2020, 6, 4,
+        nullptr,
+        columns,
+        separator);
+}
+
+TEST(OutputFormatCsv, checkColumns)
+{
+    EXPECT_NO_THROW(OutputFormatCsv::checkColumns("station,time,wind_dir,wind_kt,"
+                                                  "vis_m,ceiling_ft,temp_c,dewpt_c,qnh_hpa"));
+    EXPECT_NO_THROW(OutputFormatCsv::checkColumns("STATION,Clouds"));
+    EXPECT_NO_THROW(OutputFormatCsv::checkColumns(""));
+    EXPECT_THROW(OutputFormatCsv::checkColumns("station,wind"), std::invalid_argument);
+    EXPECT_THROW(OutputFormatCsv::checkColumns(","), std::invalid_argument);
+}
+
+TEST(OutputFormatCsv, allColumns)
+{
+    EXPECT_EQ(OutputFormatCsv::allColumns(),
+              "station,time,type,wind_dir,wind_kt,gust_kt,vis_m,ceiling_ft,"
+              "temp_c,dewpt_c,qnh_hpa,clouds,weather");
+}
+
+TEST(OutputFormatCsv, rows)
+{
+    const auto csv = makeCsv("station,time,wind_dir,wind_kt,vis_m,ceiling_ft,"
+                             "temp_c,dewpt_c,qnh_hpa,clouds");
+    std::ostringstream out;
+    csv->start(out);
+    csv->toJson("METAR EGYP 041250Z 24015KT 5000 FEW010 BKN030 15/10 Q1013", out);
+    csv->toJson("METAR EGYP 041350Z VRB02KT", out);
+    EXPECT_EQ(out.str(),
+              "station,time,wind_dir,wind_kt,vis_m,ceiling_ft,temp_c,dewpt_c,qnh_hpa,clouds\n"
+              "EGYP,2020-06-04T12:50Z,240,15,5000,3000,15,10,1013,FEW010 BKN030\n"
+              "EGYP,2020-06-04T13:50Z,,2,,,,,,\n");
+}
+
+TEST(OutputFormatCsv, tabSeparated)
+{
+    const auto tsv = makeCsv("station,type", '\t');
+    std::ostringstream out;
+    tsv->start(out);
+    tsv->toJson("SPECI EGYP 041250Z 24015KT", out);
+    EXPECT_EQ(out.str(), "station\ttype\nEGYP\tSPECI\n");
+}
+
+TEST(OutputFormatCsv, headerOnly)
+{
+    const auto csv = makeCsv("station,time");
+    std::ostringstream out;
+    csv->start(out);
+    csv->finish(out);
+    EXPECT_EQ(out.str(), "station,time\n");
+}
+
+TEST(OutputFormatCsv, rowsWithoutStart)
+{
+    // Header is only written by start(), so rows converted separately (e.g.
+    // cached) do not contain it
+    const auto csv = makeCsv("station,type");
+    std::ostringstream out;
+    csv->toJson("METAR EGYP 041250Z 24015KT", out);
+    csv->finish(out);
+    EXPECT_EQ(out.str(), "EGYP,METAR\n");
+}
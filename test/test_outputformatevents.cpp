@@ -0,0 +1,117 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "nlohmann/json.hpp"
+
+#include "filterexpression.hpp"
+#include "outputformatevents.hpp"
+
+static std::unique_ptr<OutputFormatEvents> makeEvents()
+{
+    return std::make_unique<OutputFormatEvents>(
+        std::make_unique<DateTimeFormatBasic>(),
+        std::make_unique<ValueFormatBasic>(),
+        2020, 6, 4);
+}
+
+static const RefDate refDate(2020, 6, 4);
+
+static std::vector<nlohmann::json> records(const std::string &output)
+{
+    std::vector<nlohmann::json> result;
+    std::istringstream in(output);
+    for (std::string line; std::getline(in, line); )
+        result.push_back(nlohmann::json::parse(line));
+    return result;
+}
+
+TEST(OutputFormatEvents, records)
+{
+    OutputFormatEvents::Detector events(makeEvents());
+    std::ostringstream out;
+    events.toJson("METAR EGYP 041250Z 24015KT 9999 FEW030 15/13 Q1009", refDate, out);
+    EXPECT_TRUE(out.str().empty());
+    events.toJson("METAR EGYP 041320Z 24020G30KT 4000 TSRA BKN008CB 15/13 Q1009", refDate, out);
+    events.toJson("METAR EGYP 041350Z 24020G30KT 4000 TSRA BKN008CB 15/13 Q1009", refDate, out);
+    events.outputFormat().finish(out);
+
+    const auto r = records(out.str());
+    ASSERT_EQ(r.size(), 3u);
+    for (const auto &j : r)
+    {
+        EXPECT_EQ(j["station"], "EGYP");
+        EXPECT_EQ(j["report_time"]["hour"], 13);
+        EXPECT_EQ(j["report_time"]["minute"], 20);
+    }
+    EXPECT_EQ(r[0]["event"], "flight_category");
+    EXPECT_EQ(r[0]["from"], "VFR");
+    EXPECT_EQ(r[0]["to"], "IFR");
+    EXPECT_EQ(r[1]["event"], "gust_above");
+    EXPECT_EQ(r[1]["threshold"], 25);
+    EXPECT_EQ(r[1]["gust"], 30.0);
+    EXPECT_EQ(r[2]["event"], "onset");
+    EXPECT_EQ(r[2]["weather"], "TS");
+}
+
+TEST(OutputFormatEvents, gustThresholds)
+{
+    OutputFormatEvents::Detector events(std::make_unique<OutputFormatEvents>(
+        std::make_unique<DateTimeFormatBasic>(),
+        std::make_unique<ValueFormatBasic>(),
+        2020, 6, 4,
+        nullptr,
+        nullptr,
+        std::vector<unsigned>{30}));
+    std::ostringstream out;
+    events.toJson("METAR EGYP 041250Z 24015KT 9999 FEW030 15/13 Q1009", refDate, out);
+    events.toJson("METAR EGYP 041320Z 24015G25KT 9999 FEW030 15/13 Q1009", refDate, out);
+    EXPECT_TRUE(out.str().empty());
+    events.toJson("METAR EGYP 041350Z 24015G30KT 9999 FEW030 15/13 Q1009", refDate, out);
+    const auto r = records(out.str());
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0]["threshold"], 30);
+}
+
+TEST(OutputFormatEvents, detectorsAreIndependent)
+{
+    OutputFormatEvents::Detector a(makeEvents()), b(makeEvents());
+    std::ostringstream outA, outB;
+    a.toJson("METAR EGYP 041250Z 24015KT 9999 FEW030 15/13 Q1009", refDate, outA);
+    a.toJson("METAR EGYP 041320Z 24015KT 4000 BKN008 15/13 Q1009", refDate, outA);
+    b.toJson("METAR EGYP 041320Z 24015KT 4000 BKN008 15/13 Q1009", refDate, outB);
+    EXPECT_EQ(records(outA.str()).size(), 1u);
+    // First report of the station only sets the state
+    EXPECT_TRUE(outB.str().empty());
+}
+
+TEST(OutputFormatEvents, formatWithoutDetector)
+{
+    const auto format = makeEvents();
+    std::ostringstream out;
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(format->toJson("METAR EGYP 041250Z 24015KT 9999 FEW030 15/13 Q1009", out),
+              OutputFormat::Result::EXCEPTION);
+    testing::internal::GetCapturedStderr();
+    EXPECT_TRUE(out.str().empty());
+}
+
+TEST(OutputFormatEvents, detectorFilter)
+{
+    OutputFormatEvents::Detector events(std::make_unique<OutputFormatEvents>(
+        std::make_unique<DateTimeFormatBasic>(),
+        std::make_unique<ValueFormatBasic>(),
+        2020, 6, 4,
+        std::make_unique<FilterExpression>("wind_speed > 25")));
+    std::ostringstream out;
+    EXPECT_EQ(events.toJson("METAR EGYP 041250Z 24015KT 9999 FEW030 15/13 Q1009", refDate, out),
+              OutputFormat::Result::FILTERED);
+}
@@ -0,0 +1,162 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "metaf.hpp"
+#include "outputindex.hpp"
+#include "stationfilter.hpp"
+
+static uint32_t station(const char *icao)
+{
+    return *StationFilter::packLocation(icao);
+}
+
+// Report key
+
+TEST(ReportKey, fromReport) {
+    const auto key = ReportKey::fromReport("METAR EGYP 041250Z 24015KT", RefDate(2020, 6, 30));
+    ASSERT_TRUE(key.has_value());
+    EXPECT_EQ(key->station, station("EGYP"));
+    EXPECT_EQ(key->time, 1591275000); // 2020-06-04 12:50
+}
+
+TEST(ReportKey, fromReportModifiers) {
+    const auto key = ReportKey::fromReport("SPECI COR UKLL 041250Z 24015KT", RefDate(2020, 6, 30));
+    ASSERT_TRUE(key.has_value());
+    EXPECT_EQ(key->station, station("UKLL"));
+    EXPECT_EQ(key->time, 1591275000);
+}
+
+TEST(ReportKey, fromReportNoKey) {
+    EXPECT_FALSE(ReportKey::fromReport("METAR 041250Z 24015KT", RefDate(2020, 6, 30)).has_value());
+    EXPECT_FALSE(ReportKey::fromReport("TAF EGYP 0412/0512 24015KT", RefDate(2020, 6, 30)).has_value());
+    EXPECT_FALSE(ReportKey::fromReport("METAR EGYP", RefDate(2020, 6, 30)).has_value());
+    EXPECT_FALSE(ReportKey::fromReport("", RefDate(2020, 6, 30)).has_value());
+}
+
+TEST(ReportKey, fromParseResult) {
+    const auto key = ReportKey::fromParseResult(
+        metaf::Parser::parse("SPECI COR UKLL 041250Z 24015KT"), RefDate(2020, 6, 30));
+    ASSERT_TRUE(key.has_value());
+    EXPECT_EQ(key->station, station("UKLL"));
+    EXPECT_EQ(key->time, 1591275000);
+}
+
+TEST(ReportKey, fromParseResultNoKey) {
+    const RefDate refDate(2020, 6, 30);
+    EXPECT_FALSE(ReportKey::fromParseResult(
+        metaf::Parser::parse("TAF EGYP 0412/0512 24015KT"), refDate).has_value());
+    EXPECT_FALSE(ReportKey::fromParseResult(
+        metaf::Parser::parse("METAR 041250Z 24015KT"), refDate).has_value());
+}
+
+// Output index
+
+class OutputIndexTest : public ::testing::Test
+{
+protected:
+    virtual void TearDown()
+    {
+        std::remove(indexFileName.c_str());
+    }
+
+    void write(OutputIndex::Builder &builder, uint64_t outputSize)
+    {
+        std::ofstream index(indexFileName, std::ios::binary);
+        builder.write(index, outputSize);
+    }
+
+    const std::string indexFileName = "test_outputindex.idx";
+};
+
+TEST_F(OutputIndexTest, find) {
+    OutputIndex::Builder builder;
+    // Records are added in the order of output
+    builder.add(ReportKey{station("UKLL"), 300}, 0, 10);
+    builder.add(ReportKey{station("EGYP"), 200}, 10, 20);
+    builder.add(ReportKey{station("EGYP"), 100}, 30, 30);
+    builder.add(ReportKey{station("EGLL"), 100}, 60, 40);
+    builder.add(ReportKey{station("EGYP"), 300}, 100, 50);
+    write(builder, 150);
+
+    const OutputIndex index(indexFileName);
+    EXPECT_EQ(index.outputSize(), 150u);
+    EXPECT_EQ(index.stationCount(), 3u);
+    EXPECT_EQ(index.entryCount(), 5u);
+    ASSERT_EQ(index.stationsEnd() - index.stationsBegin(), 3);
+    EXPECT_EQ(index.stationsBegin()[0].station, station("EGLL"));
+    EXPECT_EQ(index.stationsBegin()[1].station, station("EGYP"));
+    EXPECT_EQ(index.stationsBegin()[1].count, 3u);
+    EXPECT_EQ(index.stationsBegin()[2].station, station("UKLL"));
+
+    const auto all = index.find(station("EGYP"), 0, 1000);
+    ASSERT_EQ(all.second - all.first, 3);
+    EXPECT_EQ(all.first[0].offset, 30u);
+    EXPECT_EQ(all.first[0].length, 30u);
+    EXPECT_EQ(all.first[1].offset, 10u);
+    EXPECT_EQ(all.first[2].offset, 100u);
+
+    const auto range = index.find(station("EGYP"), 150, 300);
+    ASSERT_EQ(range.second - range.first, 2);
+    EXPECT_EQ(range.first[0].time, 200);
+    EXPECT_EQ(range.first[1].time, 300);
+
+    const auto none = index.find(station("EGYP"), 400, 500);
+    EXPECT_EQ(none.first, none.second);
+    const auto other = index.find(station("KJFK"), 0, 1000);
+    EXPECT_EQ(other.first, other.second);
+}
+
+TEST_F(OutputIndexTest, empty) {
+    OutputIndex::Builder builder;
+    write(builder, 0);
+    const OutputIndex index(indexFileName);
+    EXPECT_EQ(index.stationCount(), 0u);
+    const auto none = index.find(station("EGYP"), 0, 1000);
+    EXPECT_EQ(none.first, none.second);
+}
+
+TEST_F(OutputIndexTest, invalid) {
+    {
+        std::ofstream index(indexFileName, std::ios::binary);
+        index << "{\"station\":\"EGYP\"}\n";
+    }
+    EXPECT_THROW(OutputIndex index(indexFileName), std::runtime_error);
+    EXPECT_THROW(OutputIndex index("nonexistent.idx"), std::runtime_error);
+}
+
+// Counting output
+
+TEST(CountingOutput, count) {
+    std::ostringstream sink;
+    CountingOutput counting(sink.rdbuf());
+    std::ostream out(&counting);
+    out << "METAR";
+    out.put(' ');
+    out << 12345 << std::endl;
+    EXPECT_EQ(counting.count(), 12u);
+    EXPECT_EQ(sink.str(), "METAR 12345\n");
+}
+
+TEST(CountingOutput, buffered) {
+    std::ostringstream sink;
+    CountingOutput counting(sink.rdbuf(), 4);
+    std::ostream out(&counting);
+    out << "METAR EGYP";
+    // Bytes not passed to the sink yet are counted
+    EXPECT_EQ(counting.count(), 10u);
+    EXPECT_EQ(sink.str(), "METAR EG");
+    out.flush();
+    EXPECT_EQ(sink.str(), "METAR EGYP");
+    EXPECT_EQ(counting.count(), 10u);
+}
@@ -0,0 +1,135 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "metaf.hpp"
+#include "outputformatbasic.hpp"
+#include "parsecache.hpp"
+
+static const std::vector<std::string> reports = {
+    "METAR EGYP 041250Z 24015G25KT 1 1/2SM -RA BKN008 OVC015 15/13 Q1009 RMK AO2",
+    "SPECI COR UKLL 041300Z 27008KT 9999 VCSH SCT030CB 17/11 Q1015 NOSIG",
+    "TAF EGYP 041100Z 0412/0512 24015KT 9999 SCT020 TEMPO 0414/0418 4000 SHRA BKN012",
+    "METAR KJFK 041251Z VRB03KT 10SM FEW250 24/14 A3002 RMK AO2 SLP165 T02390139",
+    "METAR EGYP NIL",
+    "GARBAGE",
+    ""};
+
+class ParseCacheTest : public ::testing::Test
+{
+protected:
+    virtual void TearDown()
+    {
+        std::remove(fileName.c_str());
+    }
+
+    void write(const std::vector<std::string> &r)
+    {
+        std::ofstream out(fileName, std::ios::binary);
+        ParseCache::Writer writer(out);
+        for (auto i = 0u; i < r.size(); i++)
+            writer.add(r[i], RefDate(2020, 6, 4 + i % 2), metaf::Parser::parse(r[i]));
+        writer.finish();
+        EXPECT_EQ(writer.reportCount(), r.size());
+    }
+
+    const std::string fileName = "test_parsecache.bin";
+};
+
+TEST_F(ParseCacheTest, groups)
+{
+    write(reports);
+    const ParseCache cache(fileName);
+    auto i = 0u;
+    cache.read([&](const std::string &report,
+                   const RefDate &refDate,
+                   const metaf::ParseResult &result) {
+        ASSERT_LT(i, reports.size());
+        EXPECT_EQ(report, reports[i]);
+        EXPECT_EQ(refDate, RefDate(2020, 6, 4 + i % 2));
+        const auto expected = metaf::Parser::parse(reports[i]);
+        EXPECT_EQ(result.reportMetadata.type, expected.reportMetadata.type);
+        EXPECT_EQ(result.reportMetadata.error, expected.reportMetadata.error);
+        EXPECT_EQ(result.reportMetadata.isSpeci, expected.reportMetadata.isSpeci);
+        EXPECT_EQ(result.reportMetadata.isCorrectional, expected.reportMetadata.isCorrectional);
+        EXPECT_EQ(result.reportMetadata.isNil, expected.reportMetadata.isNil);
+        EXPECT_EQ(result.reportMetadata.reportTime.has_value(),
+                  expected.reportMetadata.reportTime.has_value());
+        ASSERT_EQ(result.groups.size(), expected.groups.size());
+        for (auto g = 0u; g < result.groups.size(); g++)
+        {
+            EXPECT_EQ(result.groups[g].group.index(), expected.groups[g].group.index());
+            EXPECT_EQ(result.groups[g].reportPart, expected.groups[g].reportPart);
+            EXPECT_EQ(result.groups[g].rawString, expected.groups[g].rawString);
+        }
+        i++;
+    });
+    EXPECT_EQ(i, reports.size());
+    EXPECT_EQ(cache.reparsedCount(), 0u);
+}
+
+TEST_F(ParseCacheTest, sameJson)
+{
+    write(reports);
+    const std::unique_ptr<OutputFormat> basic = std::make_unique<OutputFormatBasic>(
+        std::make_unique<DateTimeFormatBasic>(),
+        std::make_unique<ValueFormatBasic>(),
+        true,
+        2020, 6, 4);
+    std::ostringstream parsed, cached;
+    for (auto i = 0u; i < reports.size(); i++)
+        basic->toJson(reports[i], RefDate(2020, 6, 4 + i % 2), parsed);
+    const ParseCache cache(fileName);
+    cache.read([&](const std::string &, const RefDate &refDate, const metaf::ParseResult &result) {
+        basic->toJson(result, refDate, cached);
+    });
+    EXPECT_EQ(cached.str(), parsed.str());
+}
+
+TEST_F(ParseCacheTest, empty)
+{
+    write({});
+    const ParseCache cache(fileName);
+    auto count = 0u;
+    cache.read([&](const std::string &, const RefDate &, const metaf::ParseResult &) {
+        count++;
+    });
+    EXPECT_EQ(count, 0u);
+}
+
+TEST_F(ParseCacheTest, corrupted)
+{
+    write(reports);
+    {
+        std::ifstream in(fileName, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream out(fileName, std::ios::binary);
+        out << data.substr(0, data.length() - 8);
+    }
+    const ParseCache cache(fileName);
+    EXPECT_THROW(
+        cache.read([](const std::string &, const RefDate &, const metaf::ParseResult &) {}),
+        std::runtime_error);
+}
+
+TEST_F(ParseCacheTest, invalid)
+{
+    {
+        std::ofstream out(fileName, std::ios::binary);
+        out << "METAR EGYP 041250Z 24015KT\n";
+    }
+    EXPECT_THROW(ParseCache cache(fileName), std::runtime_error);
+    EXPECT_THROW(ParseCache cache("nonexistent.bin"), std::runtime_error);
+}
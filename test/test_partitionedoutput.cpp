@@ -0,0 +1,156 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "metaf.hpp"
+#include "partitionedoutput.hpp"
+
+static const RefDate refDate = RefDate(2020, 6, 4);
+
+TEST(Partitioning, path)
+{
+    const Partitioning partitioning("type,date", "lake/type={type}/date={date}.json");
+    const std::string metar = "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009";
+    const std::string speci = "SPECI EGYP 041310Z 24015KT 9999 BKN008 15/13 Q1009";
+    const std::string taf = "TAF EGYP 312300Z 0100/0124 24015KT 9999 BKN008";
+    EXPECT_EQ(partitioning.path(metar, metaf::Parser::parse(metar), refDate),
+              "lake/type=metar/date=2020-06-04.json");
+    EXPECT_EQ(partitioning.path(speci, metaf::Parser::parse(speci), refDate),
+              "lake/type=speci/date=2020-06-04.json");
+    EXPECT_EQ(partitioning.path(taf, metaf::Parser::parse(taf), refDate),
+              "lake/type=taf/date=2020-05-31.json");
+}
+
+TEST(Partitioning, unknown)
+{
+    const Partitioning partitioning("station-hash:4,date,type", "{hash}-{date}-{type}");
+    const std::string report = "GARBAGE";
+    EXPECT_EQ(partitioning.path(report, metaf::Parser::parse(report), refDate),
+              "unknown-unknown-unknown");
+}
+
+TEST(Partitioning, stationHash)
+{
+    const Partitioning partitioning("station-hash:8", "{hash}.json");
+    const std::string egyp1 = "METAR EGYP 041250Z 24015KT 9999 BKN008 15/13 Q1009";
+    const std::string egyp2 = "METAR EGYP 041320Z 24015KT 9999 BKN008 15/13 Q1009";
+    const auto path = partitioning.path(egyp1, metaf::Parser::parse(egyp1), refDate);
+    EXPECT_EQ(partitioning.path(egyp2, metaf::Parser::parse(egyp2), refDate), path);
+    const auto hash = std::stoul(path);
+    EXPECT_LT(hash, 8u);
+}
+
+TEST(Partitioning, invalid)
+{
+    EXPECT_THROW(Partitioning("station", "{station}"), std::invalid_argument);
+    EXPECT_THROW(Partitioning("", "file.json"), std::invalid_argument);
+    EXPECT_THROW(Partitioning("type,type", "{type}"), std::invalid_argument);
+    EXPECT_THROW(Partitioning("station-hash:0", "{hash}"), std::invalid_argument);
+    EXPECT_THROW(Partitioning("station-hash:x", "{hash}"), std::invalid_argument);
+    EXPECT_THROW(Partitioning("type", "{type}/{date}"), std::invalid_argument);
+    EXPECT_THROW(Partitioning("type,date", "{type}"), std::invalid_argument);
+    EXPECT_THROW(Partitioning("type", "{type"), std::invalid_argument);
+}
+
+class PartitionedOutputTest : public ::testing::Test
+{
+protected:
+    virtual void TearDown()
+    {
+        for (const auto &f : files)
+            std::remove(f.c_str());
+        rmdir((directory + "/b").c_str());
+        rmdir(directory.c_str());
+    }
+
+    static std::string read(const std::string &fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        std::ostringstream result;
+        result << file.rdbuf();
+        return result.str();
+    }
+
+    const std::string directory = "test_partitionedoutput";
+    const std::vector<std::string> files = {
+        directory + "/a.json", directory + "/b/b.json", directory + "/c.json"};
+};
+
+TEST_F(PartitionedOutputTest, write)
+{
+    // Small buffers and limit of open files make the files to be reopened
+    PartitionedOutput partitionedOutput(nullptr, 2, 2, 16);
+    std::ostream out(&partitionedOutput);
+    std::vector<std::string> expected(files.size());
+    for (auto i = 0u; i < 300; i++)
+    {
+        const auto record = std::to_string(i) + '\n';
+        out << record;
+        partitionedOutput.endRecord(files[i % files.size()]);
+        expected[i % files.size()] += record;
+    }
+    // Empty record is ignored
+    partitionedOutput.endRecord(directory + "/d.json");
+    EXPECT_TRUE(partitionedOutput.finish());
+    EXPECT_TRUE(partitionedOutput.failedFiles().empty());
+    EXPECT_EQ(partitionedOutput.partitionCount(), files.size());
+    EXPECT_EQ(partitionedOutput.maxOpenFileCount(), 2u);
+    for (auto i = 0u; i < files.size(); i++)
+        EXPECT_EQ(read(files[i]), expected[i]);
+}
+
+TEST_F(PartitionedOutputTest, overwrite)
+{
+    {
+        std::ofstream file(files[0]);
+        file << "previous output\n";
+    }
+    PartitionedOutput partitionedOutput;
+    std::ostream out(&partitionedOutput);
+    out << "A\n";
+    partitionedOutput.endRecord(files[0]);
+    EXPECT_TRUE(partitionedOutput.finish());
+    EXPECT_EQ(read(files[0]), "A\n");
+}
+
+TEST_F(PartitionedOutputTest, memoryLimit)
+{
+    PartitionedOutput partitionedOutput(nullptr, 1, 1, 1024, 8);
+    std::ostream out(&partitionedOutput);
+    out << "A\n";
+    partitionedOutput.endRecord(files[0]);
+    out << "B\n";
+    partitionedOutput.endRecord(files[2]);
+    out << "C\n";
+    partitionedOutput.endRecord(files[0]);
+    out << "D\n";
+    partitionedOutput.endRecord(files[2]);
+    EXPECT_TRUE(partitionedOutput.finish());
+    EXPECT_EQ(read(files[0]), "A\nC\n");
+    EXPECT_EQ(read(files[2]), "B\nD\n");
+}
+
+TEST_F(PartitionedOutputTest, failed)
+{
+    PartitionedOutput partitionedOutput;
+    std::ostream out(&partitionedOutput);
+    out << "A\n";
+    partitionedOutput.endRecord(files[0]);
+    out << "B\n";
+    partitionedOutput.endRecord("/dev/null/b.json");
+    EXPECT_FALSE(partitionedOutput.finish());
+    EXPECT_EQ(partitionedOutput.failedFiles(), std::vector<std::string>{"/dev/null/b.json"});
+    EXPECT_EQ(read(files[0]), "A\n");
+}
@@ -0,0 +1,182 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "refdate.hpp"
+#include "reportreader.hpp"
+
+// Date strings
+
+TEST(RefDate, fromString) {
+    const auto d1 = RefDate::fromString("20190925");
+    ASSERT_TRUE(d1.has_value());
+    EXPECT_EQ(*d1, RefDate(2019, 9, 25));
+
+    const auto d2 = RefDate::fromString("2019-09-25");
+    ASSERT_TRUE(d2.has_value());
+    EXPECT_EQ(*d2, RefDate(2019, 9, 25));
+
+    const auto d3 = RefDate::fromString("2019/09/25");
+    ASSERT_TRUE(d3.has_value());
+    EXPECT_EQ(*d3, RefDate(2019, 9, 25));
+}
+
+TEST(RefDate, fromStringWithTime) {
+    const auto d1 = RefDate::fromString("2019-09-25T12:00");
+    ASSERT_TRUE(d1.has_value());
+    EXPECT_EQ(*d1, RefDate(2019, 9, 25));
+
+    const auto d2 = RefDate::fromString("2019/09/25 12:00");
+    ASSERT_TRUE(d2.has_value());
+    EXPECT_EQ(*d2, RefDate(2019, 9, 25));
+}
+
+TEST(RefDate, fromStringInvalid) {
+    EXPECT_FALSE(RefDate::fromString("").has_value());
+    EXPECT_FALSE(RefDate::fromString("201909").has_value());
+    EXPECT_FALSE(RefDate::fromString("201909251").has_value());
+    EXPECT_FALSE(RefDate::fromString("2019-09/25").has_value());
+    EXPECT_FALSE(RefDate::fromString("20191325").has_value());
+    EXPECT_FALSE(RefDate::fromString("20190231").has_value());
+    EXPECT_FALSE(RefDate::fromString("METAR").has_value());
+}
+
+// NOAA timestamp lines
+
+TEST(RefDate, fromTimestampLine) {
+    const auto d1 = RefDate::fromTimestampLine("2020/06/04 12:55");
+    ASSERT_TRUE(d1.has_value());
+    EXPECT_EQ(*d1, RefDate(2020, 6, 4));
+
+    const auto d2 = RefDate::fromTimestampLine("2020/06/04 12:55\r");
+    ASSERT_TRUE(d2.has_value());
+    EXPECT_EQ(*d2, RefDate(2020, 6, 4));
+}
+
+TEST(RefDate, fromTimestampLineInvalid) {
+    EXPECT_FALSE(RefDate::fromTimestampLine("2020/06/04").has_value());
+    EXPECT_FALSE(RefDate::fromTimestampLine("2020/06/04 25:00").has_value());
+    EXPECT_FALSE(RefDate::fromTimestampLine("2020-06-04 12:55").has_value());
+    EXPECT_FALSE(RefDate::fromTimestampLine("METAR EGYP 041250Z").has_value());
+    EXPECT_FALSE(RefDate::fromTimestampLine("2020/06/04 12:55 EGYP").has_value());
+}
+
+// File names
+
+TEST(RefDate, fromFileName) {
+    const auto d1 = RefDate::fromFileName("metar_20200604.txt");
+    ASSERT_TRUE(d1.has_value());
+    EXPECT_EQ(*d1, RefDate(2020, 6, 4));
+
+    const auto d2 = RefDate::fromFileName("/archive/2019/metar-2020-06-04-12Z.txt");
+    ASSERT_TRUE(d2.has_value());
+    EXPECT_EQ(*d2, RefDate(2020, 6, 4));
+
+    const auto d3 = RefDate::fromFileName("taf_2020_06_04");
+    ASSERT_TRUE(d3.has_value());
+    EXPECT_EQ(*d3, RefDate(2020, 6, 4));
+}
+
+TEST(RefDate, fromFileNameInvalid) {
+    EXPECT_FALSE(RefDate::fromFileName("metar.txt").has_value());
+    EXPECT_FALSE(RefDate::fromFileName("/archive/20200604/metar.txt").has_value());
+    EXPECT_FALSE(RefDate::fromFileName("metar_202006041.txt").has_value());
+}
+
+TEST(RefDate, fromUnixTime) {
+    EXPECT_EQ(RefDate::fromUnixTime(0), RefDate(1970, 1, 1));
+    EXPECT_EQ(RefDate::fromUnixTime(1591275000), RefDate(2020, 6, 4));
+    EXPECT_EQ(RefDate::fromUnixTime(1582934399), RefDate(2020, 2, 28));
+    EXPECT_EQ(RefDate::fromUnixTime(1582934400), RefDate(2020, 2, 29));
+}
+
+TEST(RefDate, unixTimeFromString) {
+    EXPECT_EQ(RefDate::unixTimeFromString("20200604", false), 1591228800);
+    EXPECT_EQ(RefDate::unixTimeFromString("20200604", true), 1591315199);
+    EXPECT_EQ(RefDate::unixTimeFromString("202006041250", false), 1591275000);
+    EXPECT_EQ(RefDate::unixTimeFromString("202006041250", true), 1591275000);
+}
+
+TEST(RefDate, unixTimeFromStringInvalid) {
+    EXPECT_FALSE(RefDate::unixTimeFromString("2020-06-04", false).has_value());
+    EXPECT_FALSE(RefDate::unixTimeFromString("20200231", false).has_value());
+    EXPECT_FALSE(RefDate::unixTimeFromString("202006042400", false).has_value());
+    EXPECT_FALSE(RefDate::unixTimeFromString("2020060412", false).has_value());
+    EXPECT_FALSE(RefDate::unixTimeFromString("20200604 1250", false).has_value());
+}
+
+// Report reader
+
+TEST(ReportReader, fixed) {
+    std::istringstream input("METAR EGYP 041250Z\nTAF EGYP 041100Z\n");
+    ReportReader reader(input, Settings::RefDateSource::FIXED, RefDate(2020, 6, 4));
+    ReportReader::Report report;
+
+    ASSERT_TRUE(reader.next(report));
+    EXPECT_EQ(report.text, "METAR EGYP 041250Z");
+    EXPECT_EQ(report.refDate, RefDate(2020, 6, 4));
+    EXPECT_EQ(report.lineNumber, 1u);
+
+    ASSERT_TRUE(reader.next(report));
+    EXPECT_EQ(report.text, "TAF EGYP 041100Z");
+    EXPECT_EQ(report.refDate, RefDate(2020, 6, 4));
+    EXPECT_EQ(report.lineNumber, 2u);
+    EXPECT_EQ(report.offset, 19u);
+
+    EXPECT_FALSE(reader.next(report));
+}
+
+TEST(ReportReader, timestamp) {
+    std::istringstream input(
+        "2020/06/04 12:55\n"
+        "METAR EGYP 041250Z\n"
+        "\n"
+        "2020/07/01 00:05\n"
+        "METAR EGYP 010000Z\n");
+    ReportReader reader(input, Settings::RefDateSource::TIMESTAMP, RefDate(2019, 1, 1));
+    ReportReader::Report report;
+
+    ASSERT_TRUE(reader.next(report));
+    EXPECT_EQ(report.text, "METAR EGYP 041250Z");
+    EXPECT_EQ(report.refDate, RefDate(2020, 6, 4));
+    EXPECT_EQ(report.lineNumber, 2u);
+
+    ASSERT_TRUE(reader.next(report));
+    EXPECT_EQ(report.text, "METAR EGYP 010000Z");
+    EXPECT_EQ(report.refDate, RefDate(2020, 7, 1));
+    EXPECT_EQ(report.lineNumber, 5u);
+
+    EXPECT_FALSE(reader.next(report));
+}
+
+TEST(ReportReader, column) {
+    std::istringstream input(
+        "20200604\tMETAR EGYP 041250Z\n"
+        "other\tMETAR EGYP 041350Z\n"
+        "METAR EGYP 041450Z\n");
+    ReportReader reader(input, Settings::RefDateSource::COLUMN, RefDate(2019, 1, 1));
+    ReportReader::Report report;
+
+    ASSERT_TRUE(reader.next(report));
+    EXPECT_EQ(report.text, "METAR EGYP 041250Z");
+    EXPECT_EQ(report.refDate, RefDate(2020, 6, 4));
+    EXPECT_EQ(report.offset, 9u);
+
+    ASSERT_TRUE(reader.next(report));
+    EXPECT_EQ(report.text, "METAR EGYP 041350Z");
+    EXPECT_EQ(report.refDate, RefDate(2020, 6, 4));
+
+    ASSERT_TRUE(reader.next(report));
+    EXPECT_EQ(report.text, "METAR EGYP 041450Z");
+    EXPECT_EQ(report.refDate, RefDate(2020, 6, 4));
+
+    EXPECT_FALSE(reader.next(report));
+}
@@ -0,0 +1,114 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include "metaf.hpp"
+#include "reportvalues.hpp"
+
+TEST(ReportValues, metar)
+{
+    const auto result = metaf::Parser::parse(
+        "METAR EGYP 041250Z 24015G25KT 5000 -RA FEW010 BKN030 OVC050 15/10 Q1013"
+        " TEMPO 2000 +TSRA BKN008CB");
+    ReportValues values;
+    values.extract(result, RefDate(2020, 6, 4));
+
+    EXPECT_EQ(values.station, "EGYP");
+    EXPECT_EQ(values.type, ReportValues::Type::METAR);
+    ASSERT_TRUE(values.time.has_value());
+    EXPECT_EQ(*values.time, 1591275000);
+    ASSERT_TRUE(values.windDirection.has_value());
+    EXPECT_EQ(*values.windDirection, 240u);
+    ASSERT_TRUE(values.windSpeed.has_value());
+    EXPECT_NEAR(*values.windSpeed, 15.0, 0.01);
+    ASSERT_TRUE(values.gustSpeed.has_value());
+    EXPECT_NEAR(*values.gustSpeed, 25.0, 0.01);
+    ASSERT_TRUE(values.visibility.has_value());
+    EXPECT_NEAR(*values.visibility, 5000.0, 0.01);
+    ASSERT_TRUE(values.ceiling.has_value());
+    EXPECT_NEAR(*values.ceiling, 3000.0, 0.01);
+    ASSERT_TRUE(values.temperature.has_value());
+    EXPECT_NEAR(*values.temperature, 15.0, 0.01);
+    ASSERT_TRUE(values.dewPoint.has_value());
+    EXPECT_NEAR(*values.dewPoint, 10.0, 0.01);
+    ASSERT_TRUE(values.qnh.has_value());
+    EXPECT_NEAR(*values.qnh, 1013.0, 0.01);
+    EXPECT_EQ(values.clouds, (std::vector<std::string>{"FEW010", "BKN030", "OVC050"}));
+    EXPECT_EQ(values.weather, std::vector<std::string>{"-RA"});
+}
+
+TEST(ReportValues, notReported)
+{
+    const auto result = metaf::Parser::parse("SPECI EGYP 041250Z VRB02KT");
+    ReportValues values;
+    values.extract(result, RefDate(2020, 6, 4));
+
+    EXPECT_EQ(values.station, "EGYP");
+    EXPECT_EQ(values.type, ReportValues::Type::SPECI);
+    EXPECT_FALSE(values.windDirection.has_value());
+    ASSERT_TRUE(values.windSpeed.has_value());
+    EXPECT_NEAR(*values.windSpeed, 2.0, 0.01);
+    EXPECT_FALSE(values.gustSpeed.has_value());
+    EXPECT_FALSE(values.visibility.has_value());
+    EXPECT_FALSE(values.ceiling.has_value());
+    EXPECT_FALSE(values.temperature.has_value());
+    EXPECT_FALSE(values.qnh.has_value());
+    EXPECT_TRUE(values.clouds.empty());
+    EXPECT_TRUE(values.weather.empty());
+}
+
+TEST(ReportValues, reuse)
+{
+    ReportValues values;
+    values.extract(metaf::Parser::parse("METAR EGYP 041250Z 24015KT 15/10 Q1013"),
+                   RefDate(2020, 6, 4));
+    values.extract(metaf::Parser::parse("TAF EGYP 041100Z 0412/0512 VRB02KT"),
+                   RefDate(2020, 6, 4));
+    EXPECT_EQ(values.type, ReportValues::Type::TAF);
+    EXPECT_FALSE(values.temperature.has_value());
+    EXPECT_FALSE(values.qnh.has_value());
+}
+
+TEST(ReportValues, typeName)
+{
+    EXPECT_EQ(ReportValues::typeName(ReportValues::Type::METAR), "METAR");
+    EXPECT_EQ(ReportValues::typeName(ReportValues::Type::SPECI), "SPECI");
+    EXPECT_EQ(ReportValues::typeName(ReportValues::Type::TAF), "TAF");
+    EXPECT_TRUE(ReportValues::typeName(ReportValues::Type::UNKNOWN).empty());
+}
+
+TEST(ReportValues, cavok)
+{
+    const auto result = metaf::Parser::parse("METAR EGYP 041250Z 24015KT CAVOK 15/10 Q1013");
+    ReportValues values;
+    values.extract(result, RefDate(2020, 6, 4));
+
+    ASSERT_TRUE(values.visibility.has_value());
+    EXPECT_NEAR(*values.visibility, 10000.0, 0.01);
+    EXPECT_FALSE(values.ceiling.has_value());
+    EXPECT_TRUE(values.skyReported);
+}
+
+TEST(ReportValues, weatherFlags)
+{
+    ReportValues values;
+    values.extract(metaf::Parser::parse(
+                       "METAR EGYP 041250Z 24015KT 3000 TSRA BLSN VCSH RESN BKN010 15/10"),
+                   RefDate(2020, 6, 4));
+    EXPECT_TRUE(values.hasWeather(ReportValues::Weather::THUNDERSTORM));
+    EXPECT_TRUE(values.hasWeather(ReportValues::Weather::PRECIPITATION));
+    EXPECT_FALSE(values.hasWeather(ReportValues::Weather::SNOW));
+    EXPECT_FALSE(values.hasWeather(ReportValues::Weather::FREEZING_RAIN));
+    EXPECT_FALSE(values.hasWeather(ReportValues::Weather::NOT_REPORTED));
+
+    values.extract(metaf::Parser::parse("METAR EGYP 041250Z AUTO 24015KT 9999 // BKN010 15/10"),
+                   RefDate(2020, 6, 4));
+    EXPECT_TRUE(values.hasWeather(ReportValues::Weather::NOT_REPORTED));
+    EXPECT_FALSE(values.hasWeather(ReportValues::Weather::PRECIPITATION));
+}
@@ -0,0 +1,219 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "nlohmann/json.hpp"
+
+#include "sketches.hpp"
+
+static const RefDate refDate = RefDate(2020, 6, 4);
+
+// Well-mixed 64-bit values (splitmix64)
+static uint64_t hashOf(uint64_t i)
+{
+    auto h = i + 0x9e3779b97f4a7c15ull;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+static nlohmann::json sketch(const std::vector<std::string> &reports,
+                             size_t threads = 2,
+                             size_t batchSize = 2)
+{
+    Sketcher sketcher(threads, batchSize);
+    for (const auto &r : reports)
+        sketcher.add(r, refDate);
+    return sketcher.finish().toJson();
+}
+
+TEST(HyperLogLog, estimate)
+{
+    HyperLogLog hll;
+    EXPECT_EQ(hll.estimate(), 0.0);
+    for (auto i = 0u; i < 100; i++)
+        hll.add(hashOf(i));
+    EXPECT_NEAR(hll.estimate(), 100, 2);
+    // Repeated items are not counted
+    for (auto n = 0; n < 3; n++)
+        for (auto i = 0u; i < 100000; i++)
+            hll.add(hashOf(i));
+    EXPECT_NEAR(hll.estimate(), 100000, 3000);
+}
+
+TEST(HyperLogLog, merge)
+{
+    HyperLogLog a, b, all;
+    for (auto i = 0u; i < 50000; i++)
+    {
+        (i % 3 ? a : b).add(hashOf(i));
+        all.add(hashOf(i));
+    }
+    // Items in both sketches are counted once
+    for (auto i = 0u; i < 1000; i++)
+        b.add(hashOf(i));
+    a.merge(b);
+    EXPECT_EQ(a.estimate(), all.estimate());
+
+    HyperLogLog other(10);
+    EXPECT_THROW(a.merge(other), std::invalid_argument);
+    EXPECT_THROW(HyperLogLog{3}, std::invalid_argument);
+}
+
+TEST(TDigest, quantile)
+{
+    TDigest digest;
+    EXPECT_FALSE(digest.quantile(0.5).has_value());
+    for (auto i = 0; i < 10000; i++)
+        digest.add((i * 7919) % 10000);
+    EXPECT_EQ(digest.count(), 10000u);
+    EXPECT_EQ(digest.min(), 0.0);
+    EXPECT_EQ(digest.max(), 9999.0);
+    EXPECT_EQ(*digest.quantile(0), 0.0);
+    EXPECT_EQ(*digest.quantile(1), 9999.0);
+    EXPECT_NEAR(*digest.quantile(0.5), 5000, 50);
+    EXPECT_NEAR(*digest.quantile(0.25), 2500, 50);
+    // Tails are more accurate
+    EXPECT_NEAR(*digest.quantile(0.01), 100, 5);
+    EXPECT_NEAR(*digest.quantile(0.999), 9990, 2);
+}
+
+TEST(TDigest, merge)
+{
+    TDigest a, b, empty;
+    for (auto i = 0; i < 10000; i++)
+        (i % 4 ? a : b).add((i * 7919) % 10000);
+    a.merge(empty);
+    empty.merge(b);
+    a.merge(empty);
+    EXPECT_EQ(a.count(), 10000u);
+    EXPECT_EQ(a.min(), 0.0);
+    EXPECT_EQ(a.max(), 9999.0);
+    EXPECT_NEAR(*a.quantile(0.5), 5000, 50);
+    EXPECT_NEAR(*a.quantile(0.9), 9000, 50);
+}
+
+TEST(TDigest, mergeDifferentCompression)
+{
+    TDigest a(100), b(200), empty(200);
+    b.add(1);
+    EXPECT_THROW(a.merge(b), std::invalid_argument);
+    EXPECT_THROW(a.merge(empty), std::invalid_argument);
+    EXPECT_EQ(a.count(), 0u);
+}
+
+TEST(CountMinSketch, estimate)
+{
+    CountMinSketch cms(64, 4);
+    for (auto i = 0u; i < 1000; i++)
+        cms.add(hashOf(i % 100), i % 100 + 1);
+    // Estimate is never less than the actual count
+    for (auto i = 0u; i < 100; i++)
+        EXPECT_GE(cms.estimate(hashOf(i)), 10 * (i + 1));
+    CountMinSketch wide;
+    wide.add(hashOf(1), 5);
+    wide.add(hashOf(2));
+    EXPECT_EQ(wide.estimate(hashOf(1)), 5u);
+    EXPECT_EQ(wide.estimate(hashOf(3)), 0u);
+
+    CountMinSketch other;
+    other.add(hashOf(1), 2);
+    wide.merge(other);
+    EXPECT_EQ(wide.estimate(hashOf(1)), 7u);
+    EXPECT_THROW(wide.merge(cms), std::invalid_argument);
+}
+
+TEST(Sketches, serialize)
+{
+    HyperLogLog hll;
+    TDigest digest;
+    CountMinSketch cms;
+    for (auto i = 0u; i < 5000; i++)
+    {
+        hll.add(hashOf(i));
+        digest.add(i % 1000);
+        cms.add(hashOf(i % 10));
+    }
+    std::stringstream stream;
+    hll.write(stream);
+    digest.write(stream);
+    cms.write(stream);
+
+    HyperLogLog hllRead(4);
+    TDigest digestRead;
+    CountMinSketch cmsRead(1, 1);
+    hllRead.read(stream);
+    digestRead.read(stream);
+    cmsRead.read(stream);
+    EXPECT_EQ(hllRead.estimate(), hll.estimate());
+    EXPECT_EQ(digestRead.count(), digest.count());
+    EXPECT_EQ(*digestRead.quantile(0.3), *digest.quantile(0.3));
+    EXPECT_EQ(cmsRead.estimate(hashOf(3)), 500u);
+
+    std::istringstream truncated(stream.str().substr(0, 100));
+    EXPECT_THROW(hllRead.read(truncated), std::runtime_error);
+}
+
+TEST(ReportSketches, reports)
+{
+    const auto result = sketch({
+        "METAR EGYP 041250Z 24015KT 9999 -RA FEW030 15/13 Q1009",
+        "METAR EGLL 041250Z 36005KT 9999 -RA BKN020 20/10 Q1015",
+        "METAR EGYP 041320Z 25020G30KT 4000 +RA BKN008 13/12 Q1007",
+        "METAR EGYP 041350Z 00000KT 3000 BR OVC006 11/11 Q1005",
+        "SPECI EGYP 041335Z 24015KT 0800 +RA OVC002 11/11 Q1005",
+        "TAF EGKK 041100Z 0412/0512 24015KT 9999 BKN008",
+        "GARBAGE"});
+    EXPECT_EQ(result["reports"], 6);
+    EXPECT_EQ(result["stations"], 3);
+    EXPECT_EQ(result["temperature_c"]["count"], 4);
+    EXPECT_EQ(result["temperature_c"]["min"], 11.0);
+    EXPECT_EQ(result["temperature_c"]["max"], 20.0);
+    EXPECT_EQ(result["wind_speed_kt"]["max"], 20.0);
+    EXPECT_EQ(result["ceiling_ft"]["count"], 3);
+    EXPECT_EQ(result["visibility_m"]["min"], 3000.0);
+    ASSERT_EQ(result["weather"].size(), 2u);
+    EXPECT_EQ(result["weather"][0]["weather"], "RA");
+    EXPECT_EQ(result["weather"][0]["count"], 3);
+    EXPECT_EQ(result["weather"][1]["weather"], "BR");
+    EXPECT_EQ(result["weather"][1]["count"], 1);
+}
+
+TEST(ReportSketches, serialize)
+{
+    std::vector<std::string> reports;
+    for (auto i = 0; i < 100; i++)
+    {
+        const auto temperature = std::to_string(10 + i % 10);
+        reports.push_back("METAR EGYP 041250Z 24015KT 9999 -RA FEW030 " +
+                          temperature + "/05 Q1009");
+    }
+    Sketcher sketcher(2, 7);
+    for (const auto &r : reports)
+        sketcher.add(r, refDate);
+    const auto sketches = sketcher.finish();
+    std::stringstream stream;
+    sketches.write(stream);
+
+    ReportSketches combined;
+    combined.read(stream);
+    EXPECT_EQ(combined.toJson(), sketches.toJson());
+    // Sketches of different runs are combined
+    combined.merge(sketches);
+    const auto result = combined.toJson();
+    EXPECT_EQ(result["reports"], 200);
+    EXPECT_EQ(result["stations"], 1);
+    EXPECT_EQ(result["temperature_c"]["count"], 200);
+    EXPECT_EQ(result["weather"][0]["count"], 200);
+
+    std::istringstream invalid("METAFOIX");
+    EXPECT_THROW(combined.read(invalid), std::runtime_error);
+}
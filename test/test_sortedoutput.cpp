@@ -0,0 +1,126 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <tuple>
+
+#include "sortedoutput.hpp"
+
+struct TestRecord
+{
+    std::optional<ReportKey> key;
+    std::string text;
+};
+
+static std::vector<TestRecord> makeRecords(size_t count, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::vector<TestRecord> result;
+    for (auto i = 0u; i < count; i++)
+    {
+        TestRecord r;
+        // Some records have the same key, some have no key
+        if (random() % 10)
+            r.key = ReportKey{static_cast<uint32_t>(random() % 50),
+                              static_cast<int64_t>(random() % 100) * 1800};
+        r.text = std::to_string(i) + '\n';
+        result.push_back(r);
+    }
+    return result;
+}
+
+// Records sorted by key keeping the order of records with the same key;
+// records without key are last
+static std::string expected(std::vector<TestRecord> records)
+{
+    std::stable_sort(records.begin(), records.end(), [](const TestRecord &a, const TestRecord &b) {
+        if (!a.key.has_value() || !b.key.has_value())
+            return a.key.has_value() && !b.key.has_value();
+        return std::tie(a.key->station, a.key->time) < std::tie(b.key->station, b.key->time);
+    });
+    std::string result;
+    for (const auto &r : records)
+        result += r.text;
+    return result;
+}
+
+static std::string sorted(SortedOutput &sortedOutput, const std::vector<TestRecord> &records)
+{
+    std::ostream out(&sortedOutput);
+    for (const auto &r : records)
+    {
+        out << r.text;
+        sortedOutput.endRecord(r.key);
+    }
+    std::string result;
+    sortedOutput.finish([&](const std::optional<ReportKey> &key, std::string_view record) {
+        const auto &r = records.at(std::stoul(std::string(record)));
+        EXPECT_EQ(key.has_value(), r.key.has_value());
+        if (key.has_value() && r.key.has_value())
+        {
+            EXPECT_EQ(key->station, r.key->station);
+            EXPECT_EQ(key->time, r.key->time);
+        }
+        result += record;
+    });
+    return result;
+}
+
+TEST(SortedOutput, inMemory)
+{
+    const auto records = makeRecords(1000, 1);
+    SortedOutput sortedOutput;
+    EXPECT_EQ(sorted(sortedOutput, records), expected(records));
+    EXPECT_EQ(sortedOutput.runCount(), 0u);
+}
+
+TEST(SortedOutput, parallel)
+{
+    const auto records = makeRecords(100000, 2);
+    SortedOutput sortedOutput(SortedOutput::defaultMemoryLimit, 4);
+    EXPECT_EQ(sorted(sortedOutput, records), expected(records));
+    EXPECT_EQ(sortedOutput.runCount(), 0u);
+}
+
+TEST(SortedOutput, runs)
+{
+    const auto records = makeRecords(10000, 3);
+    SortedOutput sortedOutput(16 * 1024, 2);
+    EXPECT_EQ(sorted(sortedOutput, records), expected(records));
+    EXPECT_GT(sortedOutput.runCount(), 1u);
+}
+
+TEST(SortedOutput, emptyRecords)
+{
+    SortedOutput sortedOutput;
+    std::ostream out(&sortedOutput);
+    out << "B\n";
+    sortedOutput.endRecord(ReportKey{2, 0});
+    sortedOutput.endRecord(ReportKey{1, 0});
+    out << "A\n";
+    sortedOutput.endRecord(ReportKey{1, 0});
+    std::string result;
+    size_t count = 0;
+    sortedOutput.finish([&](const std::optional<ReportKey> &, std::string_view record) {
+        result += record;
+        count++;
+    });
+    EXPECT_EQ(result, "A\nB\n");
+    EXPECT_EQ(count, 2u);
+}
+
+TEST(SortedOutput, noRecords)
+{
+    SortedOutput sortedOutput;
+    auto count = 0u;
+    sortedOutput.finish([&](const std::optional<ReportKey> &, std::string_view) { count++; });
+    EXPECT_EQ(count, 0u);
+}
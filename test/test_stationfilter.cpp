@@ -0,0 +1,69 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "stationfilter.hpp"
+
+// Location search
+
+TEST(StationFilter, findLocation) {
+    EXPECT_EQ(StationFilter::findLocation("METAR EGYP 041250Z 22010KT"), "EGYP");
+    EXPECT_EQ(StationFilter::findLocation("SPECI COR KJFK 041250Z"), "KJFK");
+    EXPECT_EQ(StationFilter::findLocation("TAF AMD UKLL 041100Z"), "UKLL");
+    EXPECT_EQ(StationFilter::findLocation("  EGYP 041250Z 22010KT"), "EGYP");
+    EXPECT_EQ(StationFilter::findLocation("K2J3 041250Z"), "K2J3");
+}
+
+TEST(StationFilter, findLocationNotFound) {
+    EXPECT_EQ(StationFilter::findLocation(""), "");
+    EXPECT_EQ(StationFilter::findLocation("METAR"), "");
+    EXPECT_EQ(StationFilter::findLocation("METAR 041250Z EGYP"), "");
+    EXPECT_EQ(StationFilter::findLocation("METAR 2EGY 041250Z"), "");
+}
+
+// Filtering
+
+TEST(StationFilter, empty) {
+    const StationFilter filter;
+    EXPECT_TRUE(filter.isEmpty());
+    EXPECT_TRUE(filter.matches("METAR EGYP 041250Z"));
+    EXPECT_TRUE(filter.matches(""));
+}
+
+TEST(StationFilter, list) {
+    StationFilter filter;
+    filter.addStations("EGYP,kjfk,,UKLL");
+    EXPECT_EQ(filter.size(), 3u);
+    EXPECT_TRUE(filter.matches("METAR EGYP 041250Z 22010KT"));
+    EXPECT_TRUE(filter.matches("SPECI KJFK 041250Z 22010KT"));
+    EXPECT_TRUE(filter.matches("TAF AMD UKLL 041100Z"));
+    EXPECT_FALSE(filter.matches("METAR EGLL 041250Z 22010KT"));
+    EXPECT_FALSE(filter.matches("METAR"));
+}
+
+TEST(StationFilter, stream) {
+    std::istringstream input(
+        "# Stations\n"
+        "EGYP KJFK # comments\n"
+        "UKLL,EGYP\n");
+    StationFilter filter;
+    filter.addStations(input);
+    EXPECT_EQ(filter.size(), 3u);
+    EXPECT_TRUE(filter.matches("METAR UKLL 041250Z"));
+    EXPECT_FALSE(filter.matches("METAR EGLL 041250Z"));
+}
+
+TEST(StationFilter, invalidStation) {
+    StationFilter filter;
+    EXPECT_THROW(filter.addStations("EGYP,EGY"), std::invalid_argument);
+    EXPECT_THROW(filter.addStations("1GYP"), std::invalid_argument);
+}
@@ -0,0 +1,48 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <stdexcept>
+
+#include "threadpool.hpp"
+
+TEST(ThreadPool, size)
+{
+    EXPECT_EQ(ThreadPool(3).size(), 3u);
+    EXPECT_EQ(ThreadPool().size(), ThreadPool::hardwareThreads());
+}
+
+TEST(ThreadPool, results)
+{
+    ThreadPool pool(4);
+    std::vector<std::future<int>> results;
+    for (auto i = 0; i < 100; i++)
+        results.push_back(pool.submit([i]() { return i * i; }));
+    for (auto i = 0; i < 100; i++)
+        EXPECT_EQ(results[i].get(), i * i);
+}
+
+TEST(ThreadPool, exception)
+{
+    ThreadPool pool(2);
+    auto result = pool.submit([]() -> int { throw std::runtime_error("test"); });
+    EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, completeOnDestruction)
+{
+    std::atomic<int> count = 0;
+    {
+        ThreadPool pool(2);
+        for (auto i = 0; i < 50; i++)
+            pool.submit([&count]() { count++; });
+    }
+    EXPECT_EQ(count, 50);
+}
@@ -0,0 +1,46 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include "validator.hpp"
+
+#include "nlohmann/json.hpp"
+
+TEST(Validator, summary) {
+    Validator validator(true);
+    validator.setInputName("metar.txt");
+    validator.validate("METAR EGYP 041250Z 22010KT 9999 FEW020 12/08 Q1013", 1);
+    validator.validate("METAR EGYP 041350Z 22010KT 9999 FEW020 ZZZZZ 12/08 Q1013", 2);
+    validator.validate("TAF UKLL 041100Z 0412/0512 27008MPS CAVOK", 3);
+    validator.validate("", 4);
+    const auto j = validator.summary();
+
+    EXPECT_EQ(j["reports"], 4);
+    EXPECT_EQ(j["failed"], 1);
+    EXPECT_EQ(j["exceptions"], 0);
+    EXPECT_EQ(j["unknown_groups"], 1);
+    EXPECT_EQ(j["report_types"]["metar"], 2);
+    EXPECT_EQ(j["report_types"]["taf"], 1);
+    EXPECT_EQ(j["errors"]["empty_report"], 1);
+    EXPECT_EQ(j["groups"]["wind"], 3);
+    EXPECT_EQ(j["groups"]["unknown"], 1);
+    EXPECT_EQ(j["failed_stations"]["EGYP"]["unknown_groups"], 1);
+    EXPECT_EQ(j["failed_stations"]["EGYP"]["reports"], 2);
+    EXPECT_FALSE(j["failed_stations"].contains("UKLL"));
+    ASSERT_EQ(j["failed_lines"]["metar.txt"].size(), 1u);
+    EXPECT_EQ(j["failed_lines"]["metar.txt"][0], 4);
+}
+
+TEST(Validator, noFailedLines) {
+    Validator validator;
+    validator.validate("", 1);
+    const auto j = validator.summary();
+    EXPECT_EQ(j["failed"], 1);
+    EXPECT_FALSE(j.contains("failed_lines"));
+}
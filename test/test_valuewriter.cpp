@@ -0,0 +1,201 @@
+/*
+* Copyright (C) 2020 Nick Naumenko (https://gitlab.com/nnaumenko,
+* https:://github.com/nnaumenko)
+* All rights reserved.
+* This software may be modified and distributed under the terms
+* of the MIT license. See the LICENSE file for details.
+*/
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "valuewriter.hpp"
+
+#include "nlohmann/json.hpp"
+
+static const nlohmann::json testValue = {
+    {"string", "EGYP"},
+    {"empty", ""},
+    {"long_string", std::string(300, 'x')},
+    {"bool", true},
+    {"null", nullptr},
+    {"small", 7},
+    {"negative", -5},
+    {"large_negative", -100000},
+    {"unsigned", 4000000000u},
+    {"huge", 0x123456789ull},
+    {"single", 1.5},
+    {"double", 0.063},
+    {"array", {1, "two", {{"three", 3}}, nlohmann::json::array()}},
+    {"object", {{"nested", {{"deep", false}}}}},
+    {"empty_object", nlohmann::json::object()}};
+
+static std::string toBytes(std::initializer_list<int> bytes)
+{
+    std::string result;
+    for (const auto b : bytes)
+        result.push_back(static_cast<char>(b));
+    return result;
+}
+
+TEST(ValueWriter, json)
+{
+    nlohmann::json j;
+    JsonValueWriter writer(j);
+    writer.json(testValue);
+    EXPECT_EQ(j, testValue);
+
+    writer.beginArray();
+    writer.value(1u);
+    writer.beginObject();
+    writer.member("a", "b");
+    writer.endObject();
+    writer.endArray();
+    EXPECT_EQ(j, (nlohmann::json{1, {{"a", "b"}}}));
+}
+
+TEST(ValueWriter, toJsonValue)
+{
+    const auto j = toJsonValue([](ValueWriter &writer) {
+        writer.beginObject();
+        writer.member("hour", 12u);
+        writer.endObject();
+    });
+    EXPECT_EQ(j, (nlohmann::json{{"hour", 12}}));
+}
+
+TEST(ValueWriter, cbor)
+{
+    CborWriter writer;
+    writer.json(testValue);
+    EXPECT_EQ(nlohmann::json::from_cbor(writer.data()), testValue);
+
+    writer.clear();
+    writer.beginObject();
+    writer.member("a", 1);
+    writer.member("b", -1);
+    writer.key("c");
+    writer.beginArray();
+    writer.value(1.5);
+    writer.value(false);
+    writer.value(nullptr);
+    writer.endArray();
+    writer.endObject();
+    EXPECT_EQ(writer.data(), toBytes({0xA3,
+                                      0x61, 'a', 0x01,
+                                      0x61, 'b', 0x20,
+                                      0x61, 'c', 0x83,
+                                      0xFA, 0x3F, 0xC0, 0x00, 0x00,
+                                      0xF4,
+                                      0xF6}));
+
+    // Header of large array is longer
+    writer.clear();
+    writer.beginArray();
+    for (auto i = 0; i < 24; i++)
+        writer.value(i);
+    writer.endArray();
+    EXPECT_EQ(writer.data().substr(0, 2), toBytes({0x98, 24}));
+    EXPECT_EQ(writer.data().length(), 2u + 24u);
+}
+
+TEST(ValueWriter, msgpack)
+{
+    MsgpackWriter writer;
+    writer.json(testValue);
+    EXPECT_EQ(nlohmann::json::from_msgpack(writer.data()), testValue);
+
+    writer.clear();
+    writer.beginObject();
+    writer.member("a", 1);
+    writer.member("b", -1);
+    writer.key("c");
+    writer.beginArray();
+    writer.value(1.5);
+    writer.value(200);
+    writer.value(nullptr);
+    writer.endArray();
+    writer.endObject();
+    EXPECT_EQ(writer.data(), toBytes({0x83,
+                                      0xA1, 'a', 0x01,
+                                      0xA1, 'b', 0xFF,
+                                      0xA1, 'c', 0x93,
+                                      0xCA, 0x3F, 0xC0, 0x00, 0x00,
+                                      0xCC, 0xC8,
+                                      0xC0}));
+
+    // Header of large object is longer
+    writer.clear();
+    writer.beginObject();
+    for (auto i = 0; i < 16; i++)
+        writer.member(std::string(1, static_cast<char>('a' + i)), true);
+    writer.endObject();
+    EXPECT_EQ(writer.data().substr(0, 3), toBytes({0xDE, 0x00, 16}));
+}
+
+TEST(ValueWriter, nestedHeaders)
+{
+    // Headers of different lengths at several levels of nesting
+    nlohmann::json value = nlohmann::json::array();
+    for (auto i = 0; i < 30; i++)
+    {
+        nlohmann::json item = nlohmann::json::object();
+        for (auto j = 0; j < 20; j++)
+            item[std::string(1, static_cast<char>('a' + j))] = {i, j, std::string(i, 'x')};
+        value.push_back(item);
+    }
+    value.push_back(nlohmann::json::array());
+
+    CborWriter cbor;
+    cbor.json(value);
+    const auto expectedCbor = nlohmann::json::to_cbor(value);
+    EXPECT_EQ(cbor.data(), std::string(expectedCbor.begin(), expectedCbor.end()));
+
+    MsgpackWriter msgpack;
+    msgpack.json(value);
+    const auto expectedMsgpack = nlohmann::json::to_msgpack(value);
+    EXPECT_EQ(msgpack.data(), std::string(expectedMsgpack.begin(), expectedMsgpack.end()));
+}
+
+TEST(ValueWriter, mismatchedEnd)
+{
+    CborWriter writer;
+    writer.beginObject();
+    EXPECT_THROW(writer.endArray(), std::logic_error);
+}
+
+TEST(ValueWriter, recorder)
+{
+    ValueRecorder recorder;
+    recorder.json(testValue);
+    const ValueRecorder::Range all{0, recorder.position()};
+    nlohmann::json j;
+    JsonValueWriter writer(j);
+    recorder.replay(all, writer);
+    EXPECT_EQ(j, testValue);
+
+    std::vector<ValueRecorder::Member> members;
+    recorder.members(all, members);
+    ASSERT_EQ(members.size(), testValue.size());
+    for (const auto &m : members)
+    {
+        nlohmann::json value;
+        JsonValueWriter valueWriter(value);
+        recorder.replay(m.value, valueWriter);
+        EXPECT_EQ(value, testValue[std::string(m.key)]) << m.key;
+    }
+
+    ValueRecorder other;
+    other.beginArray();
+    other.json(testValue);
+    other.endArray();
+    EXPECT_TRUE(recorder.equal(all, other, ValueRecorder::Range{1, other.position() - 1}));
+    EXPECT_FALSE(recorder.equal(all, other, ValueRecorder::Range{0, other.position()}));
+
+    auto changed = testValue;
+    changed["double"] = 0.064;
+    other.clear();
+    other.json(changed);
+    EXPECT_FALSE(recorder.equal(all, other, ValueRecorder::Range{0, other.position()}));
+}